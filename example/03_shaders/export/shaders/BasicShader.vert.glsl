@@ -1,5 +1,5 @@
 attribute vec2 position;
 void main()
 {
-	gl_Position = vec4(position, 0.0, 1.0);
+	gl_Position = vec4(transformPosition(decodePosition(vec4(position, 0.0, 1.0))).xy, 0.0, 1.0);
 }
\ No newline at end of file
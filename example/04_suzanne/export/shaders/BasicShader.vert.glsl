@@ -1,6 +1,6 @@
 #version 300 es
 
-layout(location = 0) in vec2 position;
+layout(location = 0) in vec4 position;
 layout(location = 1) in vec3 normal;
 layout(location = 2) in vec2 texCoord;
 
@@ -9,7 +9,9 @@ out vec3 vNormal;
 
 void main()
 {
-	vTexCoords = texCoord;
-	vNormal = normal;
-	gl_Position = vec4(position, 0.0, 1.0);
+	// decode* helpers come from the loader prelude, they undo the vertex quantization;
+	// transformPosition applies the world matrix of the node and the camera
+	vTexCoords = decodeTexCoord(texCoord);
+	vNormal = decodeNormal(normal);
+	gl_Position = vec4(transformPosition(decodePosition(position)).xy, 0.0, 1.0);
 }
@@ -1,6 +1,6 @@
 #version 300 es
 
-layout(location = 0) in vec3 position;
+layout(location = 0) in vec4 position;
 layout(location = 1) in vec3 normal;
 layout(location = 2) in vec2 texCoord;
 
@@ -11,7 +11,9 @@ uniform float time;
 
 void main()
 {
-	vTexCoords = texCoord;
-	vNormal = normal;
-	gl_Position = vec4(position, 1.0);
+	// decode* helpers come from the loader prelude, they undo the vertex quantization;
+	// transformPosition applies the world matrix of the node and the camera
+	vTexCoords = decodeTexCoord(texCoord);
+	vNormal = decodeNormal(normal);
+	gl_Position = transformPosition(decodePosition(position));
 }
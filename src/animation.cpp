@@ -0,0 +1,290 @@
+#include "animation.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include "simd_float4.hpp"
+
+namespace
+{
+    // Keys stepped over one by one before falling back to a binary search
+    const uint32_t kLinearKeySearch = 4;
+
+    // Function to find the key k such that times[k] <= time < times[k + 1], clamped to the first and last
+    // intervals, starting from the key of the previous lookup. keyCount is at least 2
+    uint32_t findKey(const float* times, uint32_t keyCount, float time, uint32_t& cursor)
+    {
+        uint32_t lastInterval = keyCount - 2;
+        uint32_t key = std::min(cursor, lastInterval);
+        if (time >= times[key])
+        {
+            // Playing forward usually stays on the same key or moves to the next one
+            for (uint32_t step = 0; step < kLinearKeySearch && key < lastInterval && time >= times[key + 1]; step++)
+            {
+                key++;
+            }
+            if (key < lastInterval && time >= times[key + 1])
+            {
+                key = static_cast<uint32_t>(std::upper_bound(times + key + 1, times + keyCount, time) - times) - 1;
+                key = std::min(key, lastInterval);
+            }
+        }
+        else
+        {
+            // Looping or seeking backwards
+            key = static_cast<uint32_t>(std::upper_bound(times, times + key, time) - times);
+            key = key > 0 ? key - 1 : 0;
+        }
+        cursor = key;
+        return key;
+    }
+
+    // Function to write the value of a track: a node property, whose slot is flagged dirty in the scene
+    // graph, or the morph weights of the node. Element e of the value is read at values[e * stride]
+    void storeTrackValue(const MeshData& meshData, const AnimationTrack& track, const float* values, size_t stride,
+                         SceneGraph& graph, std::vector<float>& morphWeights)
+    {
+        if (track.path == AnimationPath::Weights)
+        {
+            const SceneNode& node = meshData.nodes[track.node];
+            for (uint32_t weight = 0; weight < node.morphWeightCount; weight++)
+            {
+                morphWeights[node.firstMorphWeight + weight] = values[weight * stride];
+            }
+            return;
+        }
+        uint32_t slot = graph.nodeSlots[track.node];
+        std::vector<float>* planes = track.path == AnimationPath::Translation ? graph.translations
+                                   : (track.path == AnimationPath::Rotation ? graph.rotations : graph.scales);
+        uint32_t componentCount = track.path == AnimationPath::Rotation ? 4 : 3;
+        for (uint32_t c = 0; c < componentCount; c++)
+        {
+            planes[c][slot] = values[c * stride];
+        }
+        markSceneGraphSlotDirty(graph, slot);
+    }
+
+    // Function to renormalize 4 quaternions stored as x, y, z, w planes
+    void normalizeQuaternions(Float4 q[4])
+    {
+        Float4 inverseLength = reciprocalSqrtFloat4(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+        for (int c = 0; c < 4; c++)
+        {
+            q[c] = q[c] * inverseLength;
+        }
+    }
+
+    // Function to interpolate linearly between the key planes a and b, 4 tracks at a time; results replace a.
+    // Rotations take the shortest path and correct t so that nlerp follows slerp's constant angular speed
+    // (polynomial fit of the slerp / nlerp angle ratio, no trigonometry)
+    void interpolateLinear(float* a, const float* b, const float* t, uint32_t componentCount, bool rotation, size_t laneCount)
+    {
+        for (size_t lane = 0; lane < laneCount; lane += 4)
+        {
+            Float4 va[4], vb[4];
+            for (uint32_t c = 0; c < componentCount; c++)
+            {
+                va[c] = loadFloat4(a + c * laneCount + lane);
+                vb[c] = loadFloat4(b + c * laneCount + lane);
+            }
+            Float4 vt = loadFloat4(t + lane);
+            if (rotation)
+            {
+                Float4 dot = va[0] * vb[0] + va[1] * vb[1] + va[2] * vb[2] + va[3] * vb[3];
+                for (int c = 0; c < 4; c++)
+                {
+                    vb[c] = flipSignFloat4(vb[c], dot);
+                }
+                Float4 d = absFloat4(dot);
+                Float4 ka = splatFloat4(1.0904f) + d * (splatFloat4(-3.2452f) + d * (splatFloat4(3.55645f) - d * splatFloat4(1.43519f)));
+                Float4 kb = splatFloat4(0.848013f) + d * (splatFloat4(-1.06021f) + d * splatFloat4(0.215638f));
+                Float4 centered = vt - splatFloat4(0.5f);
+                Float4 k = ka * centered * centered + kb;
+                vt = vt + vt * centered * (vt - splatFloat4(1.0f)) * k;
+            }
+            for (uint32_t c = 0; c < componentCount; c++)
+            {
+                va[c] = va[c] + (vb[c] - va[c]) * vt;
+            }
+            if (rotation)
+            {
+                normalizeQuaternions(va);
+            }
+            for (uint32_t c = 0; c < componentCount; c++)
+            {
+                storeFloat4(a + c * laneCount + lane, va[c]);
+            }
+        }
+    }
+
+    // Function to evaluate cubic Hermite splines between the values v0, v1 with tangents m0, m1 (already
+    // scaled by the key interval), 4 tracks at a time; results replace v0
+    void interpolateCubicSpline(float* v0, const float* m0, const float* v1, const float* m1, const float* t,
+                                uint32_t componentCount, bool rotation, size_t laneCount)
+    {
+        for (size_t lane = 0; lane < laneCount; lane += 4)
+        {
+            Float4 vt = loadFloat4(t + lane);
+            Float4 t2 = vt * vt;
+            Float4 t3 = t2 * vt;
+            Float4 h00 = splatFloat4(2.0f) * t3 - splatFloat4(3.0f) * t2 + splatFloat4(1.0f);
+            Float4 h10 = t3 - splatFloat4(2.0f) * t2 + vt;
+            Float4 h01 = splatFloat4(3.0f) * t2 - splatFloat4(2.0f) * t3;
+            Float4 h11 = t3 - t2;
+            Float4 result[4];
+            for (uint32_t c = 0; c < componentCount; c++)
+            {
+                size_t offset = c * laneCount + lane;
+                result[c] = h00 * loadFloat4(v0 + offset) + h10 * loadFloat4(m0 + offset) +
+                            h01 * loadFloat4(v1 + offset) + h11 * loadFloat4(m1 + offset);
+            }
+            if (rotation)
+            {
+                normalizeQuaternions(result);
+            }
+            for (uint32_t c = 0; c < componentCount; c++)
+            {
+                storeFloat4(v0 + c * laneCount + lane, result[c]);
+            }
+        }
+    }
+
+    // Function to sample a run of tracks sharing their path and interpolation.
+    // Every track fills one lane, except weight tracks which fill one lane per morph target weight
+    void sampleTracks(const MeshData& meshData, uint32_t firstTrack, uint32_t trackCount, float time, AnimationState& state,
+                      SceneGraph& graph, std::vector<float>& morphWeights)
+    {
+        const AnimationTrack& first = meshData.animationTracks[firstTrack];
+        bool weights = first.path == AnimationPath::Weights;
+        uint32_t componentCount = weights ? 1 : (first.path == AnimationPath::Rotation ? 4 : 3);
+        bool rotation = first.path == AnimationPath::Rotation;
+        bool cubic = first.interpolation == AnimationInterpolation::CubicSpline;
+        auto getTrackLanes = [&](const AnimationTrack& track) {
+            return weights ? meshData.nodes[track.node].morphWeightCount : 1u;
+        };
+
+        // Planes of the kernels: a / b (linear) or v0 / m0 / v1 / m1 (cubic), one per component, then t
+        size_t usedLanes = 0;
+        for (uint32_t i = 0; i < trackCount; i++)
+        {
+            usedLanes += getTrackLanes(meshData.animationTracks[firstTrack + i]);
+        }
+        size_t laneCount = (usedLanes + 3) & ~static_cast<size_t>(3);
+        size_t planeCount = (cubic ? 4 : 2) * componentCount;
+        if (first.interpolation != AnimationInterpolation::Step)
+        {
+            // Padding lanes hold unit values so that normalizing them stays finite
+            state.lanes.assign((planeCount + 1) * laneCount, 1.0f);
+        }
+        float* planes = state.lanes.data();
+        float* t = planes + planeCount * laneCount;
+
+        // Gather the keys around the time of every track into the planes
+        size_t lane = 0;
+        for (uint32_t i = 0; i < trackCount; i++)
+        {
+            const AnimationTrack& track = meshData.animationTracks[firstTrack + i];
+            const float* times = &meshData.animationTimes[track.firstKey];
+            const float* values = &meshData.animationValues[track.firstValue];
+            uint32_t trackLanes = getTrackLanes(track);
+            size_t keyStride = static_cast<size_t>(trackLanes) * componentCount;    // Floats per key value
+            uint32_t key = 0, next = 0;
+            float factor = 0.0f, interval = 0.0f;
+            if (track.keyCount > 1)
+            {
+                key = findKey(times, track.keyCount, time, state.keyCursors[firstTrack + i]);
+                next = key + 1;
+                interval = times[next] - times[key];
+                factor = interval > 0.0f ? std::min(std::max((time - times[key]) / interval, 0.0f), 1.0f) : 0.0f;
+            }
+
+            if (track.interpolation == AnimationInterpolation::Step)
+            {
+                const float* value = values + (time >= times[next] ? next : key) * keyStride;
+                storeTrackValue(meshData, track, value, 1, graph, morphWeights);
+                continue;
+            }
+            for (uint32_t trackLane = 0; trackLane < trackLanes; trackLane++, lane++)
+            {
+                for (uint32_t c = 0; c < componentCount; c++)
+                {
+                    size_t component = trackLane * componentCount + c;
+                    if (cubic)
+                    {
+                        // Every key holds its in-tangents, values and out-tangents
+                        planes[c * laneCount + lane] = values[(key * 3 + 1) * keyStride + component];
+                        planes[(componentCount + c) * laneCount + lane] = values[(key * 3 + 2) * keyStride + component] * interval;
+                        planes[(2 * componentCount + c) * laneCount + lane] = values[(next * 3 + 1) * keyStride + component];
+                        planes[(3 * componentCount + c) * laneCount + lane] = values[next * 3 * keyStride + component] * interval;
+                    }
+                    else
+                    {
+                        planes[c * laneCount + lane] = values[key * keyStride + component];
+                        planes[(componentCount + c) * laneCount + lane] = values[next * keyStride + component];
+                    }
+                }
+                t[lane] = factor;
+            }
+        }
+        if (first.interpolation == AnimationInterpolation::Step)
+        {
+            return;
+        }
+
+        // Interpolate, the results land in the first planes
+        if (cubic)
+        {
+            interpolateCubicSpline(planes, planes + componentCount * laneCount, planes + 2 * componentCount * laneCount,
+                                   planes + 3 * componentCount * laneCount, t, componentCount, rotation, laneCount);
+        }
+        else
+        {
+            interpolateLinear(planes, planes + componentCount * laneCount, t, componentCount, rotation, laneCount);
+        }
+
+        // Scatter the results into the scene graph: a node property spans the component planes of its lane,
+        // the weights of a node span consecutive lanes of the first plane
+        lane = 0;
+        for (uint32_t i = 0; i < trackCount; i++)
+        {
+            const AnimationTrack& track = meshData.animationTracks[firstTrack + i];
+            storeTrackValue(meshData, track, planes + lane, weights ? 1 : laneCount, graph, morphWeights);
+            lane += getTrackLanes(track);
+        }
+    }
+}
+
+void sampleAnimation(const MeshData& meshData, uint32_t animation, float time, AnimationState& state,
+                     SceneGraph& graph, std::vector<float>& morphWeights)
+{
+    if (animation >= meshData.animations.size())
+    {
+        return;
+    }
+    const AnimationClip& clip = meshData.animations[animation];
+    state.keyCursors.resize(meshData.animationTracks.size(), 0);
+
+    // Loop over the duration of the animation
+    float duration = clip.endTime - clip.startTime;
+    float localTime = clip.startTime;
+    if (duration > 0.0f)
+    {
+        float wrapped = std::fmod(time, duration);
+        localTime += wrapped < 0.0f ? wrapped + duration : wrapped;
+    }
+
+    // Tracks are sorted by interpolation and path, each run goes through one kernel
+    uint32_t end = clip.firstTrack + clip.trackCount;
+    uint32_t runStart = clip.firstTrack;
+    while (runStart < end)
+    {
+        const AnimationTrack& first = meshData.animationTracks[runStart];
+        uint32_t runEnd = runStart + 1;
+        while (runEnd < end && meshData.animationTracks[runEnd].path == first.path &&
+               meshData.animationTracks[runEnd].interpolation == first.interpolation)
+        {
+            runEnd++;
+        }
+        sampleTracks(meshData, runStart, runEnd - runStart, localTime, state, graph, morphWeights);
+        runStart = runEnd;
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef ANIMATION_HPP
+#define ANIMATION_HPP
+
+#include <cstdint>
+#include <vector>
+#include "mesh_data.hpp"
+#include "scene_graph.hpp"
+
+// Playback state of the animations of a mesh, kept from frame to frame
+struct AnimationState
+{
+    std::vector<uint32_t> keyCursors;   // Key found by the last lookup of every track, indexed like MeshData::animationTracks
+    std::vector<float> lanes;           // Structure-of-arrays scratch of the batched kernels
+};
+
+// Function to sample an animation at a time in seconds, wrapped to the animation's duration, and write the
+// animated translations, rotations and scales into the scene graph (flagging the nodes dirty) and the
+// animated weights into morphWeights (laid out like MeshData::morphWeights).
+// Key lookups resume from the key of the previous call, so playing forward costs O(1) per track;
+// tracks sharing a path and an interpolation are interpolated 4 at a time
+void sampleAnimation(const MeshData& meshData, uint32_t animation, float time, AnimationState& state,
+                     SceneGraph& graph, std::vector<float>& morphWeights);
+
+#endif // ANIMATION_HPP
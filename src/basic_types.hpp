@@ -1,6 +1,10 @@
 #ifndef BASIC_TYPES_HPP
 #define BASIC_TYPES_HPP 
 
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
 class Vector4{
 public:
     float x, y, z, w;
@@ -25,5 +29,19 @@ public:
     Vector2(): x(0), y(0){}
 };
 
+// View of raw bytes owned by somebody else (a mapped file, a tinygltf buffer, a std::vector)
+struct ByteSpan
+{
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+};
+
+// Byte range of a file that is mapped when it is needed (images inside a GLB or a .bin buffer, image files)
+struct FileRange
+{
+    std::string path;       // File holding the bytes, empty if there is none
+    uint64_t offset = 0;    // First byte of the range
+    uint64_t size = 0;      // Size of the range, 0 for the rest of the file
+};
 
 #endif // BASIC_TYPES_HPP
\ No newline at end of file
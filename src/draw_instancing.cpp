@@ -0,0 +1,121 @@
+#include "draw_instancing.hpp"
+
+#include <GLES3/gl3.h>
+#include <algorithm>
+#include "transform_math.hpp"
+
+namespace
+{
+    // Function to tell whether a draw can be drawn as an instance: rigid draws of nodes of the scene graph.
+    // Skinned draws are placed by their joints and ignore the node instances
+    bool isInstanceable(const DrawCommand& draw, const SceneGraph& graph)
+    {
+        return draw.skin == kNoSkin && draw.node < graph.nodeSlots.size();
+    }
+
+    // Function to tell whether two draws can share an instanced batch: same primitive (index range) and material.
+    // Morph weights belong to the node, so morphed draws are only batched with themselves
+    bool isSameBatch(const DrawCommand& a, const DrawCommand& b)
+    {
+        return a.material == b.material && a.segment == b.segment && a.indexType == b.indexType &&
+               a.indexOffset == b.indexOffset && a.indexCount == b.indexCount && a.morph == kNoMorph && b.morph == kNoMorph;
+    }
+
+    // Function to append the world matrices of the instances of a draw: its node's instances, or the node itself
+    void appendDrawInstances(const DrawCommand& draw, const MeshData& meshData, const SceneGraph& graph, std::vector<float>& matrices)
+    {
+        const float* world = getNodeWorldMatrix(graph, draw.node);
+        const SceneNode* node = draw.node < meshData.nodes.size() ? &meshData.nodes[draw.node] : nullptr;
+        if (!node || node->instanceCount == 0)
+        {
+            matrices.insert(matrices.end(), world, world + 16);
+            return;
+        }
+        size_t first = matrices.size();
+        matrices.resize(first + static_cast<size_t>(node->instanceCount) * 16);
+        for (uint32_t instance = 0; instance < node->instanceCount; instance++)
+        {
+            multiplyMatrices(world, &meshData.instanceMatrices[(static_cast<size_t>(node->firstInstance) + instance) * 16],
+                             &matrices[first + static_cast<size_t>(instance) * 16]);
+        }
+    }
+}
+
+uint32_t buildInstancedDraws(const std::vector<DrawCommand>& draws, const MeshData& meshData, const SceneGraph& graph,
+                             InstancedDrawList& list)
+{
+    list.draws.clear();
+    list.firstInstances.clear();
+    list.instanceCounts.clear();
+    list.instanceMatrices.clear();
+    list.ringIndices.clear();
+    uint32_t savedDraws = 0;
+    size_t drawIdx = 0;
+    while (drawIdx < draws.size())
+    {
+        const DrawCommand& first = draws[drawIdx];
+        size_t endIdx = drawIdx + 1;
+        bool instanced = isInstanceable(first, graph);
+        if (instanced)
+        {
+            while (endIdx < draws.size() && isInstanceable(draws[endIdx], graph) && isSameBatch(first, draws[endIdx]))
+            {
+                endIdx++;
+            }
+            instanced = endIdx - drawIdx > 1 || (first.node < meshData.nodes.size() && meshData.nodes[first.node].instanceCount > 0);
+        }
+
+        list.draws.push_back(first);
+        uint32_t firstInstance = static_cast<uint32_t>(list.instanceMatrices.size() / 16);
+        list.firstInstances.push_back(firstInstance);
+        if (instanced)
+        {
+            for (size_t batchIdx = drawIdx; batchIdx < endIdx; batchIdx++)
+            {
+                appendDrawInstances(draws[batchIdx], meshData, graph, list.instanceMatrices);
+            }
+            uint32_t instanceCount = static_cast<uint32_t>(list.instanceMatrices.size() / 16) - firstInstance;
+            list.instanceCounts.push_back(instanceCount);
+            savedDraws += instanceCount - 1;
+        }
+        else
+        {
+            list.instanceCounts.push_back(0);
+        }
+        list.ringIndices.push_back(0);
+        drawIdx = endIdx;
+    }
+    return savedDraws;
+}
+
+void uploadInstanceMatrices(InstanceBufferGLContext& context, const InstancedDrawList& list)
+{
+    size_t size = list.instanceMatrices.size() * sizeof(float);
+    if (size == 0)
+    {
+        return;
+    }
+    if (!context.buffer)
+    {
+        glGenBuffers(1, &context.buffer);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, context.buffer);
+    context.capacity = std::max(context.capacity, size);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(context.capacity), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(size), list.instanceMatrices.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void bindInstanceMatrices(const InstanceBufferGLContext& context, uint32_t firstInstance)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, context.buffer);
+    for (uint32_t column = 0; column < 4; column++)
+    {
+        uintptr_t offset = (static_cast<uintptr_t>(firstInstance) * 16 + column * 4) * sizeof(float);
+        glEnableVertexAttribArray(kInstanceMatrixLocation + column);
+        glVertexAttribPointer(kInstanceMatrixLocation + column, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float),
+                              reinterpret_cast<const void*>(offset));
+        glVertexAttribDivisor(kInstanceMatrixLocation + column, 1);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
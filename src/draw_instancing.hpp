@@ -0,0 +1,42 @@
+#ifndef DRAW_INSTANCING_HPP
+#define DRAW_INSTANCING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "mesh_data.hpp"
+#include "scene_graph.hpp"
+
+// Draw list in which the draws of one primitive placed by several transforms are merged into instanced draws:
+// consecutive rigid draws of the same index range and material (the draw list is sorted so that they are adjacent),
+// and the draws of nodes with EXT_mesh_gpu_instancing instances. Other draws are kept as they are
+struct InstancedDrawList
+{
+    std::vector<DrawCommand> draws;         // First draw of every batch
+    std::vector<uint32_t> firstInstances;   // First instance of every batch in instanceMatrices
+    std::vector<uint32_t> instanceCounts;   // Instances of every batch, 0 for a draw placed by its node alone
+    std::vector<float> instanceMatrices;    // World matrix of every instance (16 floats each)
+    std::vector<unsigned char> ringIndices; // 1 for the batches whose index range is in the meshlet index ring
+};
+
+// Function to merge the draws of a draw list into instanced batches; world matrices come from the scene graph and
+// the node instances of meshData. Returns the number of draw calls saved
+uint32_t buildInstancedDraws(const std::vector<DrawCommand>& draws, const MeshData& meshData, const SceneGraph& graph,
+                             InstancedDrawList& list);
+
+// GPU copy of the instance matrices, read as a per-instance vertex attribute at kInstanceMatrixLocation
+struct InstanceBufferGLContext
+{
+    uint32_t buffer = 0;                    // Array buffer holding the matrices
+    size_t capacity = 0;                    // Size of the buffer storage in bytes
+};
+
+// Function to upload the instance matrices of a draw list, the storage is orphaned so that the upload does
+// not wait for the draws of the previous frame
+void uploadInstanceMatrices(InstanceBufferGLContext& context, const InstancedDrawList& list);
+
+// Function to point the instance matrix attribute of the bound vertex array object at the matrices of a batch
+// (OpenGL ES 3.0 has no base instance, the attribute offset selects the first instance)
+void bindInstanceMatrices(const InstanceBufferGLContext& context, uint32_t firstInstance);
+
+#endif // DRAW_INSTANCING_HPP
@@ -0,0 +1,177 @@
+#include "frustum_culling.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include "simd_float4.hpp"
+
+namespace
+{
+    // Boxes tested per iteration of the culling kernel
+    const uint32_t kCullingLanes = 4;
+
+    // Function to transform a model-space box (center, half extent) into the world-space box around it
+    void transformBox(const float matrix[16], const float* localBox, float center[3], float extent[3])
+    {
+        for (int row = 0; row < 3; row++)
+        {
+            center[row] = matrix[12 + row];
+            extent[row] = 0.0f;
+            for (int column = 0; column < 3; column++)
+            {
+                center[row] += matrix[column * 4 + row] * localBox[column];
+                extent[row] += std::fabs(matrix[column * 4 + row]) * localBox[3 + column];
+            }
+        }
+    }
+
+    // Function to store the world-space box of a box slot
+    void storeWorldBox(DrawCullingState& state, uint32_t box, const float center[3], const float extent[3])
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            state.centers[axis][box] = center[axis];
+            state.extents[axis][box] = extent[axis];
+        }
+    }
+}
+
+void extractFrustumPlanes(const float viewProjection[16], Frustum& frustum)
+{
+    // Each plane is the last row of the matrix plus or minus one of the others (Gribb / Hartmann)
+    for (int plane = 0; plane < 6; plane++)
+    {
+        int row = plane / 2;
+        float sign = plane % 2 == 0 ? 1.0f : -1.0f;
+        for (int column = 0; column < 4; column++)
+        {
+            frustum.planes[plane][column] = viewProjection[column * 4 + 3] + sign * viewProjection[column * 4 + row];
+        }
+    }
+}
+
+void initDrawCulling(DrawCullingState& state, const std::vector<DrawCommand>& draws, const SceneGraph& graph)
+{
+    state.drawBoxes.assign(draws.size(), UINT32_MAX);
+    state.boxDraws.clear();
+    state.localBoxes.clear();
+    for (uint32_t drawIdx = 0; drawIdx < draws.size(); drawIdx++)
+    {
+        const DrawCommand& draw = draws[drawIdx];
+        if (!hasDrawBounds(draw))
+        {
+            continue;
+        }
+        state.drawBoxes[drawIdx] = static_cast<uint32_t>(state.boxDraws.size());
+        state.boxDraws.push_back(drawIdx);
+        for (int axis = 0; axis < 3; axis++)
+        {
+            state.localBoxes.push_back((draw.boundsMin[axis] + draw.boundsMax[axis]) * 0.5f);
+        }
+        for (int axis = 0; axis < 3; axis++)
+        {
+            state.localBoxes.push_back((draw.boundsMax[axis] - draw.boundsMin[axis]) * 0.5f);
+        }
+    }
+
+    // Padding boxes are never read back, the kernel only reports the lanes of real boxes
+    size_t boxCount = state.boxDraws.size();
+    size_t paddedCount = (boxCount + kCullingLanes - 1) / kCullingLanes * kCullingLanes;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        state.centers[axis].assign(paddedCount, 0.0f);
+        state.extents[axis].assign(paddedCount, 0.0f);
+    }
+    state.visible.assign(boxCount, 1);
+
+    // Draws of nodes outside the scene graph are drawn with the identity, their box never moves
+    float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+    for (uint32_t box = 0; box < boxCount; box++)
+    {
+        if (draws[state.boxDraws[box]].node >= graph.nodeSlots.size())
+        {
+            float center[3], extent[3];
+            transformBox(identity, &state.localBoxes[static_cast<size_t>(box) * 6], center, extent);
+            storeWorldBox(state, box, center, extent);
+        }
+    }
+}
+
+void updateDrawWorldBounds(DrawCullingState& state, const std::vector<DrawCommand>& draws, const SceneGraph& graph)
+{
+    if (graph.changedBegin >= graph.changedEnd)
+    {
+        return;
+    }
+    for (uint32_t box = 0; box < state.boxDraws.size(); box++)
+    {
+        uint32_t node = draws[state.boxDraws[box]].node;
+        if (node >= graph.nodeSlots.size())
+        {
+            continue;
+        }
+        uint32_t slot = graph.nodeSlots[node];
+        if (slot < graph.changedBegin || slot >= graph.changedEnd)
+        {
+            continue;
+        }
+        float center[3], extent[3];
+        transformBox(getNodeWorldMatrix(graph, node), &state.localBoxes[static_cast<size_t>(box) * 6], center, extent);
+        storeWorldBox(state, box, center, extent);
+    }
+}
+
+uint32_t cullDraws(DrawCullingState& state, const Frustum& frustum, const std::vector<DrawCommand>& draws,
+                   std::vector<DrawCommand>& visibleDraws)
+{
+    // A box is outside when it lies entirely behind one plane: the distance of its center plus its projected
+    // radius (half extents along the absolute plane normal) is negative
+    Float4 planes[6][4];
+    Float4 normalMagnitudes[6][3];
+    for (int plane = 0; plane < 6; plane++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            planes[plane][c] = splatFloat4(frustum.planes[plane][c]);
+            if (c < 3)
+            {
+                normalMagnitudes[plane][c] = splatFloat4(std::fabs(frustum.planes[plane][c]));
+            }
+        }
+    }
+    Float4 zero = splatFloat4(0.0f);
+    uint32_t boxCount = static_cast<uint32_t>(state.boxDraws.size());
+    for (uint32_t lane = 0; lane < boxCount; lane += kCullingLanes)
+    {
+        Float4 centerX = loadFloat4(&state.centers[0][lane]);
+        Float4 centerY = loadFloat4(&state.centers[1][lane]);
+        Float4 centerZ = loadFloat4(&state.centers[2][lane]);
+        Float4 extentX = loadFloat4(&state.extents[0][lane]);
+        Float4 extentY = loadFloat4(&state.extents[1][lane]);
+        Float4 extentZ = loadFloat4(&state.extents[2][lane]);
+        int outside = 0;
+        for (int plane = 0; plane < 6 && outside != 0xF; plane++)
+        {
+            Float4 distance = centerX * planes[plane][0] + centerY * planes[plane][1] + centerZ * planes[plane][2] + planes[plane][3];
+            Float4 radius = extentX * normalMagnitudes[plane][0] + extentY * normalMagnitudes[plane][1] +
+                            extentZ * normalMagnitudes[plane][2];
+            outside |= lessThanMaskFloat4(distance + radius, zero);
+        }
+        uint32_t laneCount = std::min(kCullingLanes, boxCount - lane);
+        for (uint32_t box = 0; box < laneCount; box++)
+        {
+            state.visible[lane + box] = (outside >> box) & 1 ? 0 : 1;
+        }
+    }
+
+    // Compact the draw list, keeping its order
+    visibleDraws.clear();
+    for (uint32_t drawIdx = 0; drawIdx < draws.size(); drawIdx++)
+    {
+        uint32_t box = drawIdx < state.drawBoxes.size() ? state.drawBoxes[drawIdx] : UINT32_MAX;
+        if (box == UINT32_MAX || state.visible[box])
+        {
+            visibleDraws.push_back(draws[drawIdx]);
+        }
+    }
+    return static_cast<uint32_t>(draws.size() - visibleDraws.size());
+}
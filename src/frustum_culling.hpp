@@ -0,0 +1,46 @@
+#ifndef FRUSTUM_CULLING_HPP
+#define FRUSTUM_CULLING_HPP
+
+#include <cstdint>
+#include <vector>
+#include "mesh_data.hpp"
+#include "scene_graph.hpp"
+
+// View frustum as 6 planes (a, b, c, d), a point (x, y, z) is inside when a * x + b * y + c * z + d >= 0 for all of them.
+// Order: left, right, bottom, top, near, far
+struct Frustum
+{
+    float planes[6][4];
+};
+
+// Function to extract the frustum planes of a column-major view projection matrix (OpenGL clip space, -w <= z <= w).
+// The planes are not normalized, which the box test does not need
+void extractFrustumPlanes(const float viewProjection[16], Frustum& frustum);
+
+// World-space boxes of the draws of a draw list, kept as center / half extent planes (structure of arrays)
+// so that the culling kernel tests 4 boxes per iteration. Draws without bounds (skinned draws) are always visible
+struct DrawCullingState
+{
+    std::vector<uint32_t> drawBoxes;        // Box of every draw, UINT32_MAX for the draws without bounds
+    std::vector<uint32_t> boxDraws;         // Draw of every box
+    std::vector<float> localBoxes;          // Model-space center and half extent of every box (6 floats)
+    std::vector<float> centers[3];          // World-space box centers, padded to a multiple of 4 boxes
+    std::vector<float> extents[3];          // World-space box half extents, padded the same way
+    std::vector<unsigned char> visible;     // Result of the last culling pass, per box
+};
+
+// Function to gather the boxes of a draw list. Their world-space copies are filled by updateDrawWorldBounds once
+// the scene graph has computed the world matrices (every slot is reported as changed by the first update)
+void initDrawCulling(DrawCullingState& state, const std::vector<DrawCommand>& draws, const SceneGraph& graph);
+
+// Function to transform the boxes of the draws whose node is in the changed range of the scene graph.
+// Must run after updateSceneGraph and before uploadNodeMatrices, which resets the changed range
+void updateDrawWorldBounds(DrawCullingState& state, const std::vector<DrawCommand>& draws, const SceneGraph& graph);
+
+// Function to test the boxes against the frustum and copy the draws that may be visible to visibleDraws, in draw
+// list order (the order the draw submission relies on to merge adjacent index ranges).
+// Returns the number of culled draws
+uint32_t cullDraws(DrawCullingState& state, const Frustum& frustum, const std::vector<DrawCommand>& draws,
+                   std::vector<DrawCommand>& visibleDraws);
+
+#endif // FRUSTUM_CULLING_HPP
@@ -0,0 +1,827 @@
+#include "gltf_asset.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include "json.hpp"
+#include "meshopt_decoder.hpp"
+#include "thread_pool.hpp"
+
+namespace
+{
+    // GLB container constants (glTF 2.0 specification, "Binary glTF Layout")
+    const uint32_t kGlbMagic = 0x46546C67;          // "glTF"
+    const uint32_t kGlbVersion = 2;
+    const uint32_t kGlbChunkTypeJson = 0x4E4F534A;  // "JSON"
+    const uint32_t kGlbChunkTypeBin = 0x004E4942;   // "BIN\0"
+    const size_t kGlbHeaderSize = 12;
+    const size_t kGlbChunkHeaderSize = 8;
+
+    // Tiny embedded payload handed to tinygltf instead of the real buffer, so that it
+    // parses the document without reading or copying any binary data
+    const char* kPlaceholderBufferUri = "data:application/octet-stream;base64,AAAAAA==";
+    const size_t kPlaceholderBufferSize = 4;
+
+    // Extensions an asset may list in extensionsRequired
+    const char* kSupportedRequiredExtensions[] = {
+        "KHR_mesh_quantization",    // Integer attribute types, handled by readAccessorFloats
+        "EXT_meshopt_compression",  // Compressed buffer views, decoded at load time
+        "EXT_mesh_gpu_instancing",  // Instance transforms of the nodes, drawn with instanced draws
+#if defined(USE_BASISU_TRANSCODER)
+        "KHR_texture_basisu",       // Basis Universal KTX2 textures, transcoded at load time
+#endif
+    };
+
+    // Where the bytes of a glTF buffer come from
+    enum class BufferSource
+    {
+        Embedded,   // data: URI, decoded by tinygltf
+        GlbChunk,   // BIN chunk of the GLB container
+        External,   // Separate file referenced by a relative URI
+        None        // No payload (e.g. a fallback buffer of a compression extension)
+    };
+
+    // Function to tell whether a glTF buffer is the uncompressed fallback of EXT_meshopt_compression
+    bool isMeshoptFallbackBuffer(const nlohmann::json& gltfBuffer)
+    {
+        if (!gltfBuffer.is_object() || !gltfBuffer.contains("extensions") || !gltfBuffer["extensions"].is_object() ||
+            !gltfBuffer["extensions"].contains("EXT_meshopt_compression"))
+        {
+            return false;
+        }
+        const nlohmann::json& extension = gltfBuffer["extensions"]["EXT_meshopt_compression"];
+        return extension.is_object() && extension.contains("fallback") && extension["fallback"].is_boolean() &&
+               extension["fallback"].get<bool>();
+    }
+
+    uint32_t readUint32(const unsigned char* bytes)
+    {
+        // GLB is little-endian, as are all the platforms we target
+        uint32_t value;
+        std::memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+
+    int hexDigitValue(char c)
+    {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    // Decode %XX escapes of a relative URI into a file name
+    std::string decodeUri(const std::string& uri)
+    {
+        std::string result;
+        result.reserve(uri.size());
+        for (size_t i = 0; i < uri.size(); i++)
+        {
+            if (uri[i] == '%' && i + 2 < uri.size())
+            {
+                int high = hexDigitValue(uri[i + 1]);
+                int low = hexDigitValue(uri[i + 2]);
+                if (high >= 0 && low >= 0)
+                {
+                    result.push_back(static_cast<char>(high * 16 + low));
+                    i += 2;
+                    continue;
+                }
+            }
+            result.push_back(uri[i]);
+        }
+        return result;
+    }
+
+    bool isDataUri(const std::string& uri)
+    {
+        return uri.compare(0, 5, "data:") == 0;
+    }
+
+    // A buffer view compressed with EXT_meshopt_compression
+    struct CompressedBufferView
+    {
+        size_t bufferView;          // Index of the view receiving the decoded bytes
+        size_t buffer;              // Buffer holding the compressed bytes
+        size_t byteOffset;          // Offset of the compressed bytes in the buffer
+        size_t byteLength;          // Size of the compressed bytes
+        size_t byteStride;          // Size of one decoded element
+        size_t count;               // Number of decoded elements
+        std::string mode;           // ATTRIBUTES, TRIANGLES or INDICES
+        MeshoptFilter filter;       // Filter applied after decoding (ATTRIBUTES only)
+    };
+
+    size_t getJsonSize(const nlohmann::json& object, const char* key)
+    {
+        return object.contains(key) && object[key].is_number_unsigned() ? object[key].get<size_t>() : 0;
+    }
+
+    // Function to find the file bytes of every image of the document: an image file, or a buffer view of
+    // the GLB BIN chunk or of an external buffer. Images are never decoded here, the texture loader maps them.
+    // binChunkOffset is the offset of the BIN chunk payload in the GLB file
+    void locateImages(const nlohmann::json& document, const std::filesystem::path& path, const std::filesystem::path& directory,
+                      const std::vector<BufferSource>& sources, const std::vector<std::filesystem::path>& externalPaths,
+                      uint64_t binChunkOffset, std::vector<FileRange>& images, std::string& warn)
+    {
+        images.clear();
+        if (!document.contains("images") || !document["images"].is_array())
+        {
+            return;
+        }
+        const nlohmann::json& gltfImages = document["images"];
+        images.resize(gltfImages.size());
+        for (size_t imageIdx = 0; imageIdx < gltfImages.size(); imageIdx++)
+        {
+            const nlohmann::json& gltfImage = gltfImages[imageIdx];
+            FileRange& image = images[imageIdx];
+            if (!gltfImage.is_object())
+            {
+                continue;
+            }
+            if (gltfImage.contains("uri") && gltfImage["uri"].is_string())
+            {
+                std::string uri = gltfImage["uri"].get<std::string>();
+                if (isDataUri(uri))
+                {
+                    warn += "Image " + std::to_string(imageIdx) + " is a data: URI, it is ignored\n";
+                    continue;
+                }
+                image.path = (directory / std::filesystem::u8path(decodeUri(uri))).string();
+                continue;
+            }
+
+            // Image stored in a buffer view, located in the file backing its buffer
+            size_t bufferViewIdx = getJsonSize(gltfImage, "bufferView");
+            if (!gltfImage.contains("bufferView") || !document.contains("bufferViews") ||
+                bufferViewIdx >= document["bufferViews"].size())
+            {
+                continue;
+            }
+            const nlohmann::json& bufferView = document["bufferViews"][bufferViewIdx];
+            size_t bufferIdx = getJsonSize(bufferView, "buffer");
+            if (bufferIdx >= sources.size())
+            {
+                continue;
+            }
+            if (sources[bufferIdx] == BufferSource::GlbChunk)
+            {
+                image.path = path.string();
+                image.offset = binChunkOffset;
+            }
+            else if (sources[bufferIdx] == BufferSource::External)
+            {
+                image.path = externalPaths[bufferIdx].string();
+            }
+            else
+            {
+                warn += "Image " + std::to_string(imageIdx) + " is in an embedded buffer, it is ignored\n";
+                continue;
+            }
+            image.offset += getJsonSize(bufferView, "byteOffset");
+            image.size = getJsonSize(bufferView, "byteLength");
+            if (image.size == 0)
+            {
+                image.path.clear();     // An empty range would mean the whole file
+            }
+        }
+    }
+
+    // Function to decode the buffer views compressed with EXT_meshopt_compression, in parallel on the worker pool.
+    // The decoded bytes are stored in asset.decodedBufferViews and take precedence over the (fallback) buffer
+    bool decodeCompressedBufferViews(const nlohmann::json& document, GltfAsset& asset, std::string& err)
+    {
+        if (!document.contains("bufferViews") || !document["bufferViews"].is_array())
+        {
+            return true;
+        }
+
+        std::vector<CompressedBufferView> views;
+        const nlohmann::json& gltfBufferViews = document["bufferViews"];
+        for (size_t viewIdx = 0; viewIdx < gltfBufferViews.size(); viewIdx++)
+        {
+            const nlohmann::json& gltfBufferView = gltfBufferViews[viewIdx];
+            if (!gltfBufferView.is_object() || !gltfBufferView.contains("extensions") ||
+                !gltfBufferView["extensions"].is_object() || !gltfBufferView["extensions"].contains("EXT_meshopt_compression"))
+            {
+                continue;
+            }
+            const nlohmann::json& extension = gltfBufferView["extensions"]["EXT_meshopt_compression"];
+            CompressedBufferView view;
+            view.bufferView = viewIdx;
+            view.buffer = getJsonSize(extension, "buffer");
+            view.byteOffset = getJsonSize(extension, "byteOffset");
+            view.byteLength = getJsonSize(extension, "byteLength");
+            view.byteStride = getJsonSize(extension, "byteStride");
+            view.count = getJsonSize(extension, "count");
+            view.mode = extension.contains("mode") && extension["mode"].is_string() ? extension["mode"].get<std::string>() : "";
+            std::string filter = extension.contains("filter") && extension["filter"].is_string() ? extension["filter"].get<std::string>() : "";
+
+            // The compressed bytes must be in a loaded buffer and the decoded bytes must fit the view
+            size_t viewLength = getJsonSize(gltfBufferView, "byteLength");
+            if (view.buffer >= asset.buffers.size() || !asset.buffers[view.buffer].data ||
+                view.byteOffset + view.byteLength > asset.buffers[view.buffer].size ||
+                view.count * view.byteStride > viewLength || !parseMeshoptFilter(filter, view.filter))
+            {
+                err = "Invalid EXT_meshopt_compression data in buffer view " + std::to_string(viewIdx);
+                return false;
+            }
+            views.push_back(view);
+        }
+        if (views.empty())
+        {
+            return true;
+        }
+
+        asset.decodedBufferViews.resize(gltfBufferViews.size());
+        std::vector<char> decoded(views.size(), 0);
+        getWorkerPool().parallelFor(views.size(), [&](size_t jobIdx) {
+            const CompressedBufferView& view = views[jobIdx];
+            std::vector<unsigned char>& output = asset.decodedBufferViews[view.bufferView];
+            output.assign(getJsonSize(gltfBufferViews[view.bufferView], "byteLength"), 0);
+            const unsigned char* source = asset.buffers[view.buffer].data + view.byteOffset;
+            bool success = false;
+            if (view.mode == "ATTRIBUTES")
+            {
+                success = decodeMeshoptVertexBuffer(output.data(), view.count, view.byteStride, source, view.byteLength) &&
+                          applyMeshoptFilter(view.filter, output.data(), view.count, view.byteStride);
+            }
+            else if (view.mode == "TRIANGLES")
+            {
+                success = decodeMeshoptIndexBuffer(output.data(), view.count, view.byteStride, source, view.byteLength);
+            }
+            else if (view.mode == "INDICES")
+            {
+                success = decodeMeshoptIndexSequence(output.data(), view.count, view.byteStride, source, view.byteLength);
+            }
+            decoded[jobIdx] = success ? 1 : 0;
+        });
+
+        for (size_t jobIdx = 0; jobIdx < views.size(); jobIdx++)
+        {
+            if (!decoded[jobIdx])
+            {
+                err = "Cannot decode EXT_meshopt_compression buffer view " + std::to_string(views[jobIdx].bufferView);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Location of the elements of an accessor inside its buffer view
+    struct AccessorElements
+    {
+        const unsigned char* data = nullptr;   // First element, nullptr for an accessor without buffer view
+        size_t stride = 0;                      // Distance between two elements in bytes
+        size_t componentSize = 0;               // Size of one component in bytes
+        size_t componentCount = 0;              // Number of components per element
+    };
+
+    // Function to locate the elements of an accessor, checking that they all lie inside the buffer view
+    bool locateAccessorElements(const GltfAsset& asset, const tinygltf::Accessor& accessor, AccessorElements& elements)
+    {
+        int componentSize = tinygltf::GetComponentSizeInBytes(accessor.componentType);
+        int componentCount = tinygltf::GetNumComponentsInType(accessor.type);
+        if (componentSize <= 0 || componentCount <= 0)
+        {
+            return false;
+        }
+        elements.componentSize = componentSize;
+        elements.componentCount = componentCount;
+
+        // Accessors without buffer view are all zeros (until sparse values are applied)
+        if (accessor.bufferView < 0)
+        {
+            return true;
+        }
+
+        const unsigned char* bufferViewData = getBufferViewData(asset, accessor.bufferView);
+        if (!bufferViewData)
+        {
+            return false;
+        }
+        const tinygltf::BufferView& bufferView = asset.model.bufferViews[accessor.bufferView];
+        size_t elementSize = elements.componentSize * elements.componentCount;
+        elements.stride = bufferView.byteStride ? bufferView.byteStride : elementSize;
+        if (accessor.count > 0 &&
+            accessor.byteOffset + elements.stride * (accessor.count - 1) + elementSize > bufferView.byteLength)
+        {
+            return false;
+        }
+        elements.data = bufferViewData + accessor.byteOffset;
+        return true;
+    }
+
+    // Function to apply the glTF normalization rules to a component value read as float
+    float normalizeComponent(float value, int componentType, bool normalized)
+    {
+        if (!normalized)
+        {
+            return value;
+        }
+        switch (componentType)
+        {
+        case TINYGLTF_COMPONENT_TYPE_BYTE:
+            return std::max(value / 127.0f, -1.0f);
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+            return value / 255.0f;
+        case TINYGLTF_COMPONENT_TYPE_SHORT:
+            return std::max(value / 32767.0f, -1.0f);
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+            return value / 65535.0f;
+        default:
+            return value;
+        }
+    }
+
+    // Function to convert one component to float following the glTF normalization rules
+    float readComponentAsFloat(const unsigned char* component, int componentType, bool normalized)
+    {
+        switch (componentType)
+        {
+        case TINYGLTF_COMPONENT_TYPE_FLOAT:
+        {
+            float value;
+            std::memcpy(&value, component, sizeof(value));
+            return value;
+        }
+        case TINYGLTF_COMPONENT_TYPE_BYTE:
+            return normalizeComponent(static_cast<float>(static_cast<int8_t>(component[0])), componentType, normalized);
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+            return normalizeComponent(static_cast<float>(component[0]), componentType, normalized);
+        case TINYGLTF_COMPONENT_TYPE_SHORT:
+        {
+            int16_t raw;
+            std::memcpy(&raw, component, sizeof(raw));
+            return normalizeComponent(static_cast<float>(raw), componentType, normalized);
+        }
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+        {
+            uint16_t raw;
+            std::memcpy(&raw, component, sizeof(raw));
+            return normalizeComponent(static_cast<float>(raw), componentType, normalized);
+        }
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+        {
+            uint32_t raw;
+            std::memcpy(&raw, component, sizeof(raw));
+            return static_cast<float>(raw);
+        }
+        default:
+            return 0.0f;
+        }
+    }
+
+    // Function to read one unsigned integer component (index data), false for other component types
+    bool readIndexComponent(const unsigned char* data, int componentType, uint32_t& value)
+    {
+        switch (componentType)
+        {
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+            value = data[0];
+            return true;
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+        {
+            uint16_t shortValue;
+            std::memcpy(&shortValue, data, sizeof(shortValue));
+            value = shortValue;
+            return true;
+        }
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+            std::memcpy(&value, data, sizeof(value));
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // Sparse storage of an accessor, located in its buffer views
+    struct SparseElements
+    {
+        const unsigned char* indices;   // Tightly packed element indices
+        const unsigned char* values;    // Tightly packed element values
+        int indexComponentType;         // Component type of the indices
+        int indexSize;                  // Bytes of one index
+        size_t valueSize;               // Bytes of one value (all components)
+        size_t count;                   // Number of substituted elements
+    };
+
+    // Function to locate and validate the sparse storage of an accessor, false when it is malformed
+    bool locateSparseElements(const GltfAsset& asset, const tinygltf::Accessor& accessor, SparseElements& elements)
+    {
+        const tinygltf::Accessor::Sparse& sparse = accessor.sparse;
+        const unsigned char* indexData = getBufferViewData(asset, sparse.indices.bufferView);
+        const unsigned char* valueData = getBufferViewData(asset, sparse.values.bufferView);
+        int indexSize = tinygltf::GetComponentSizeInBytes(sparse.indices.componentType);
+        int componentSize = tinygltf::GetComponentSizeInBytes(accessor.componentType);
+        int accessorComponents = tinygltf::GetNumComponentsInType(accessor.type);
+        if (sparse.count < 0 || !indexData || !valueData || indexSize <= 0 || componentSize <= 0 || accessorComponents <= 0)
+        {
+            return false;
+        }
+
+        // Sparse indices and values are tightly packed
+        size_t count = static_cast<size_t>(sparse.count);
+        size_t valueSize = static_cast<size_t>(componentSize) * accessorComponents;
+        if (sparse.indices.byteOffset + count * indexSize > asset.model.bufferViews[sparse.indices.bufferView].byteLength ||
+            sparse.values.byteOffset + count * valueSize > asset.model.bufferViews[sparse.values.bufferView].byteLength)
+        {
+            return false;
+        }
+        elements.indices = indexData + sparse.indices.byteOffset;
+        elements.values = valueData + sparse.values.byteOffset;
+        elements.indexComponentType = sparse.indices.componentType;
+        elements.indexSize = indexSize;
+        elements.valueSize = valueSize;
+        elements.count = count;
+        return true;
+    }
+
+    // Function to read the element index of the i-th sparse substitution, false when it is out of the accessor
+    bool readSparseIndex(const SparseElements& elements, const tinygltf::Accessor& accessor, size_t i, uint32_t& index)
+    {
+        return readIndexComponent(elements.indices + i * elements.indexSize, elements.indexComponentType, index) &&
+               index < accessor.count;
+    }
+
+    // Function to overwrite the elements listed by the sparse storage of an accessor, straight into the
+    // destination of readAccessorFloats; the indices and values are read in place from their buffer views
+    bool applySparseFloats(const GltfAsset& asset, const tinygltf::Accessor& accessor, float* destination,
+                           size_t componentCount, size_t destinationStride)
+    {
+        if (!accessor.sparse.isSparse)
+        {
+            return true;
+        }
+        SparseElements elements;
+        if (!locateSparseElements(asset, accessor, elements))
+        {
+            return false;
+        }
+
+        int componentSize = tinygltf::GetComponentSizeInBytes(accessor.componentType);
+        size_t copiedComponents = std::min(componentCount, static_cast<size_t>(tinygltf::GetNumComponentsInType(accessor.type)));
+        for (size_t i = 0; i < elements.count; i++)
+        {
+            uint32_t index;
+            if (!readSparseIndex(elements, accessor, i, index))
+            {
+                return false;
+            }
+
+            float* output = destination + index * destinationStride;
+            const unsigned char* value = elements.values + i * elements.valueSize;
+            for (size_t component = 0; component < copiedComponents; component++)
+            {
+                output[component] = readComponentAsFloat(value + component * componentSize, accessor.componentType,
+                                                         accessor.normalized);
+            }
+        }
+        return true;
+    }
+
+    // Function to overwrite the indices listed by the sparse storage of a scalar accessor, the counterpart of
+    // applySparseFloats for readAccessorIndices
+    bool applySparseIndices(const GltfAsset& asset, const tinygltf::Accessor& accessor, uint32_t* destination)
+    {
+        if (!accessor.sparse.isSparse)
+        {
+            return true;
+        }
+        SparseElements elements;
+        if (!locateSparseElements(asset, accessor, elements))
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < elements.count; i++)
+        {
+            uint32_t index;
+            if (!readSparseIndex(elements, accessor, i, index) ||
+                !readIndexComponent(elements.values + i * elements.valueSize, accessor.componentType, destination[index]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+bool loadGltfAsset(const std::filesystem::path& path, GltfAsset& asset, std::string& err, std::string& warn)
+{
+    asset.directory = path.parent_path();
+
+    // Map the asset itself; for GLB the mapping also backs the BIN chunk
+    MappedFile file;
+    if (!file.open(path))
+    {
+        err = "Cannot open file " + path.string();
+        return false;
+    }
+
+    const char* jsonBegin = reinterpret_cast<const char*>(file.data());
+    const char* jsonEnd = jsonBegin + file.size();
+    ByteSpan binChunk;
+    bool isBinary = file.size() >= kGlbHeaderSize && readUint32(file.data()) == kGlbMagic;
+
+    if (isBinary)
+    {
+        // Validate the GLB header: magic, version, total length
+        uint32_t version = readUint32(file.data() + 4);
+        uint32_t length = readUint32(file.data() + 8);
+        if (version != kGlbVersion || length > file.size() || length < kGlbHeaderSize + kGlbChunkHeaderSize)
+        {
+            err = "Invalid GLB header in " + path.string();
+            return false;
+        }
+
+        // The first chunk must be the JSON document
+        const unsigned char* chunk = file.data() + kGlbHeaderSize;
+        uint32_t jsonLength = readUint32(chunk);
+        if (readUint32(chunk + 4) != kGlbChunkTypeJson || kGlbHeaderSize + kGlbChunkHeaderSize + jsonLength > length)
+        {
+            err = "GLB file does not start with a JSON chunk: " + path.string();
+            return false;
+        }
+        jsonBegin = reinterpret_cast<const char*>(chunk + kGlbChunkHeaderSize);
+        jsonEnd = jsonBegin + jsonLength;
+
+        // The optional second chunk holds the binary buffer
+        size_t binOffset = kGlbHeaderSize + kGlbChunkHeaderSize + jsonLength;
+        if (binOffset + kGlbChunkHeaderSize <= length)
+        {
+            const unsigned char* binHeader = file.data() + binOffset;
+            uint32_t binLength = readUint32(binHeader);
+            if (readUint32(binHeader + 4) == kGlbChunkTypeBin && binOffset + kGlbChunkHeaderSize + binLength <= length)
+            {
+                binChunk.data = binHeader + kGlbChunkHeaderSize;
+                binChunk.size = binLength;
+            }
+        }
+    }
+
+    // Parse the document once to redirect every binary buffer away from tinygltf
+    nlohmann::json document = nlohmann::json::parse(jsonBegin, jsonEnd, nullptr, false);
+    if (document.is_discarded() || !document.is_object())
+    {
+        err = "Invalid glTF JSON in " + path.string();
+        return false;
+    }
+
+    // Refuse assets that cannot be rendered correctly without an extension we do not implement
+    if (document.contains("extensionsRequired") && document["extensionsRequired"].is_array())
+    {
+        for (const nlohmann::json& extension : document["extensionsRequired"])
+        {
+            if (!extension.is_string() ||
+                std::find(std::begin(kSupportedRequiredExtensions), std::end(kSupportedRequiredExtensions),
+                          extension.get<std::string>()) == std::end(kSupportedRequiredExtensions))
+            {
+                err = "Unsupported required extension " + extension.dump() + " in " + path.string();
+                return false;
+            }
+        }
+    }
+
+    std::vector<BufferSource> sources;
+    std::vector<std::filesystem::path> externalPaths;
+    std::vector<size_t> byteLengths;
+    if (document.contains("buffers") && document["buffers"].is_array())
+    {
+        nlohmann::json& gltfBuffers = document["buffers"];
+        for (size_t bufferIdx = 0; bufferIdx < gltfBuffers.size(); bufferIdx++)
+        {
+            nlohmann::json& gltfBuffer = gltfBuffers[bufferIdx];
+            BufferSource source = BufferSource::None;
+            std::filesystem::path externalPath;
+            if (isMeshoptFallbackBuffer(gltfBuffer))
+            {
+                // Only read through EXT_meshopt_compression views, which are decoded from another buffer:
+                // the fallback file is never mapped, may be missing and is not a dependency of the asset
+            }
+            else if (gltfBuffer.contains("uri") && gltfBuffer["uri"].is_string())
+            {
+                std::string uri = gltfBuffer["uri"].get<std::string>();
+                if (isDataUri(uri))
+                {
+                    source = BufferSource::Embedded;
+                }
+                else
+                {
+                    source = BufferSource::External;
+                    externalPath = asset.directory / std::filesystem::u8path(decodeUri(uri));
+                }
+            }
+            else if (isBinary && bufferIdx == 0 && binChunk.data)
+            {
+                // A buffer without URI in a GLB refers to the BIN chunk
+                source = BufferSource::GlbChunk;
+            }
+
+            size_t byteLength = 0;
+            if (gltfBuffer.contains("byteLength") && gltfBuffer["byteLength"].is_number())
+            {
+                byteLength = gltfBuffer["byteLength"].get<size_t>();
+            }
+
+            // Keep data: URIs as they are, everything else gets a placeholder payload
+            if (source != BufferSource::Embedded)
+            {
+                gltfBuffer["uri"] = kPlaceholderBufferUri;
+                gltfBuffer["byteLength"] = kPlaceholderBufferSize;
+            }
+
+            sources.push_back(source);
+            externalPaths.push_back(externalPath);
+            byteLengths.push_back(byteLength);
+        }
+    }
+
+    // Images are located here and loaded by the texture loader, tinygltf would decode them all into RGBA8
+    uint64_t binChunkOffset = binChunk.data ? static_cast<uint64_t>(binChunk.data - file.data()) : 0;
+    locateImages(document, path, asset.directory, sources, externalPaths, binChunkOffset, asset.images, warn);
+    document.erase("images");
+
+    // Let tinygltf parse the redirected document as plain text glTF
+    std::string patchedJson = document.dump();
+    tinygltf::TinyGLTF loader;
+    if (!loader.LoadASCIIFromString(&asset.model, &err, &warn, patchedJson.c_str(),
+                                    static_cast<unsigned int>(patchedJson.size()), asset.directory.string()))
+    {
+        return false;
+    }
+
+    if (asset.model.buffers.size() != sources.size())
+    {
+        err = "Unexpected buffer count after parsing " + path.string();
+        return false;
+    }
+
+    // Resolve the payload of every buffer
+    asset.buffers.assign(sources.size(), ByteSpan());
+    for (size_t bufferIdx = 0; bufferIdx < sources.size(); bufferIdx++)
+    {
+        ByteSpan& span = asset.buffers[bufferIdx];
+        switch (sources[bufferIdx])
+        {
+        case BufferSource::Embedded:
+            span.data = asset.model.buffers[bufferIdx].data.data();
+            span.size = asset.model.buffers[bufferIdx].data.size();
+            break;
+        case BufferSource::GlbChunk:
+            span = binChunk;
+            break;
+        case BufferSource::External:
+        {
+            MappedFile bufferFile;
+            if (!bufferFile.open(externalPaths[bufferIdx]))
+            {
+                err = "Cannot open buffer file " + externalPaths[bufferIdx].string();
+                return false;
+            }
+            span.data = bufferFile.data();
+            span.size = bufferFile.size();
+            asset.mappedFiles.push_back(std::move(bufferFile));
+            asset.externalFiles.push_back(externalPaths[bufferIdx]);
+            break;
+        }
+        case BufferSource::None:
+            break;
+        }
+
+        if (sources[bufferIdx] != BufferSource::None && span.size < byteLengths[bufferIdx])
+        {
+            err = "Buffer " + std::to_string(bufferIdx) + " is smaller than its byteLength";
+            return false;
+        }
+
+        // The placeholder payload is of no use to anybody, drop it
+        if (sources[bufferIdx] != BufferSource::Embedded)
+        {
+            std::vector<unsigned char>().swap(asset.model.buffers[bufferIdx].data);
+        }
+    }
+
+    // Only a GLB needs its own mapping after parsing (it backs the BIN chunk)
+    if (binChunk.data)
+    {
+        asset.mappedFiles.push_back(std::move(file));
+    }
+
+    return decodeCompressedBufferViews(document, asset, err);
+}
+
+const unsigned char* getBufferViewData(const GltfAsset& asset, int bufferViewIndex)
+{
+    if (bufferViewIndex < 0 || static_cast<size_t>(bufferViewIndex) >= asset.model.bufferViews.size())
+    {
+        return nullptr;
+    }
+    // Compressed views are read from their decoded copy
+    if (static_cast<size_t>(bufferViewIndex) < asset.decodedBufferViews.size() &&
+        !asset.decodedBufferViews[bufferViewIndex].empty())
+    {
+        return asset.decodedBufferViews[bufferViewIndex].data();
+    }
+    const tinygltf::BufferView& bufferView = asset.model.bufferViews[bufferViewIndex];
+    if (bufferView.buffer < 0 || static_cast<size_t>(bufferView.buffer) >= asset.buffers.size())
+    {
+        return nullptr;
+    }
+    const ByteSpan& span = asset.buffers[bufferView.buffer];
+    if (!span.data || bufferView.byteOffset + bufferView.byteLength > span.size)
+    {
+        return nullptr;
+    }
+    return span.data + bufferView.byteOffset;
+}
+
+bool readAccessorFloats(const GltfAsset& asset, int accessorIndex, float* destination,
+                        size_t componentCount, size_t destinationStride)
+{
+    if (accessorIndex < 0 || static_cast<size_t>(accessorIndex) >= asset.model.accessors.size())
+    {
+        return false;
+    }
+    const tinygltf::Accessor& accessor = asset.model.accessors[accessorIndex];
+    AccessorElements elements;
+    if (!locateAccessorElements(asset, accessor, elements))
+    {
+        return false;
+    }
+
+    size_t copiedComponents = std::min(componentCount, elements.componentCount);
+    for (size_t elementIdx = 0; elementIdx < accessor.count; elementIdx++)
+    {
+        float* output = destination + elementIdx * destinationStride;
+        if (!elements.data)
+        {
+            std::fill(output, output + copiedComponents, 0.0f);
+            continue;
+        }
+
+        const unsigned char* element = elements.data + elementIdx * elements.stride;
+        if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT)
+        {
+            // Common case, no conversion needed
+            std::memcpy(output, element, copiedComponents * sizeof(float));
+            continue;
+        }
+        for (size_t component = 0; component < copiedComponents; component++)
+        {
+            output[component] = readComponentAsFloat(element + component * elements.componentSize,
+                                                     accessor.componentType, accessor.normalized);
+        }
+    }
+    return applySparseFloats(asset, accessor, destination, componentCount, destinationStride);
+}
+
+bool readAccessorIndices(const GltfAsset& asset, int accessorIndex, uint32_t* destination)
+{
+    if (accessorIndex < 0 || static_cast<size_t>(accessorIndex) >= asset.model.accessors.size())
+    {
+        return false;
+    }
+    const tinygltf::Accessor& accessor = asset.model.accessors[accessorIndex];
+    AccessorElements elements;
+    if (!locateAccessorElements(asset, accessor, elements) || elements.componentCount != 1)
+    {
+        return false;
+    }
+    if (!elements.data)
+    {
+        std::fill(destination, destination + accessor.count, 0u);
+        return applySparseIndices(asset, accessor, destination);
+    }
+
+    for (size_t elementIdx = 0; elementIdx < accessor.count; elementIdx++)
+    {
+        if (!readIndexComponent(elements.data + elementIdx * elements.stride, accessor.componentType, destination[elementIdx]))
+        {
+            return false;
+        }
+    }
+    return applySparseIndices(asset, accessor, destination);
+}
+
+bool readAccessorBounds(const GltfAsset& asset, int accessorIndex, float minimum[3], float maximum[3])
+{
+    if (accessorIndex < 0 || static_cast<size_t>(accessorIndex) >= asset.model.accessors.size())
+    {
+        return false;
+    }
+    const tinygltf::Accessor& accessor = asset.model.accessors[accessorIndex];
+    if (accessor.type != TINYGLTF_TYPE_VEC3 || accessor.minValues.size() != 3 || accessor.maxValues.size() != 3)
+    {
+        return false;
+    }
+    for (int axis = 0; axis < 3; axis++)
+    {
+        minimum[axis] = normalizeComponent(static_cast<float>(accessor.minValues[axis]), accessor.componentType, accessor.normalized);
+        maximum[axis] = normalizeComponent(static_cast<float>(accessor.maxValues[axis]), accessor.componentType, accessor.normalized);
+        if (!(minimum[axis] <= maximum[axis]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
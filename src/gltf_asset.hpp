@@ -0,0 +1,48 @@
+#ifndef GLTF_ASSET_HPP
+#define GLTF_ASSET_HPP
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "tiny_gltf.h"
+#include "basic_types.hpp"
+#include "mapped_file.hpp"
+
+// A parsed glTF / GLB asset together with the storage backing its binary buffers.
+// tinygltf only parses the JSON document. The GLB BIN chunk and external .bin files
+// are memory-mapped and exposed through `buffers`, so tinygltf::Buffer::data must
+// not be used to read buffer contents. Buffer views compressed with EXT_meshopt_compression
+// are decoded at load time; getBufferViewData returns the right bytes in both cases.
+struct GltfAsset
+{
+    tinygltf::Model model;                  // Parsed glTF document
+    std::filesystem::path directory;        // Directory of the asset, used to resolve relative URIs
+    std::vector<MappedFile> mappedFiles;    // Mappings that keep the buffer bytes alive
+    std::vector<ByteSpan> buffers;          // Payload of every glTF buffer, indexed like model.buffers
+    std::vector<std::filesystem::path> externalFiles;   // External buffer files the asset depends on
+    std::vector<std::vector<unsigned char>> decodedBufferViews;  // Decoded EXT_meshopt_compression views (empty if not compressed)
+    std::vector<FileRange> images;          // Encoded bytes of every glTF image (empty path if unavailable), model.images stays empty
+};
+
+// Function to load a .gltf or .glb file (detected from the file header) without copying its buffers
+bool loadGltfAsset(const std::filesystem::path& path, GltfAsset& asset, std::string& err, std::string& warn);
+
+// Function to get the first byte of a buffer view, returns nullptr if the view is outside its buffer
+const unsigned char* getBufferViewData(const GltfAsset& asset, int bufferViewIndex);
+
+// Function to read an accessor as floats, whatever its component type
+// Normalized integers are converted to [0, 1] / [-1, 1]; destinationStride is counted in floats
+// and at most componentCount components are written per element. Sparse values are written over
+// the base elements (zeros without buffer view) as they are read, without an intermediate copy
+bool readAccessorFloats(const GltfAsset& asset, int accessorIndex, float* destination,
+                        size_t componentCount, size_t destinationStride);
+
+// Function to read a scalar integer accessor (typically indices) as 32-bit values
+// Sparse values are written over the base elements like in readAccessorFloats
+bool readAccessorIndices(const GltfAsset& asset, int accessorIndex, uint32_t* destination);
+
+// Function to read the min / max properties of a VEC3 accessor, normalized like its values.
+// Returns false if the accessor does not declare valid bounds
+bool readAccessorBounds(const GltfAsset& asset, int accessorIndex, float minimum[3], float maximum[3]);
+
+#endif // GLTF_ASSET_HPP
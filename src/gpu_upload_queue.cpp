@@ -0,0 +1,152 @@
+#include "gpu_upload_queue.hpp"
+
+#include <GLES3/gl3.h>
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+namespace
+{
+    // Largest glBufferSubData or glTexSubImage2D call, small enough for the time budget to be checked often
+    const size_t kUploadChunkSize = 256u << 10;
+}
+
+void GpuUploadQueue::queueBuffer(uint32_t buffer, ByteSpan bytes)
+{
+    // GL_COPY_WRITE_BUFFER is not VAO state, binding it never disturbs the vertex array objects
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(bytes.size), nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    if (bytes.size == 0)
+    {
+        return;
+    }
+    Item item;
+    item.buffer = buffer;
+    item.bytes = bytes;
+    items_.push_back(std::move(item));
+    pendingBytes_ += bytes.size;
+}
+
+void GpuUploadQueue::queueTextureRegion(const TextureRegion& region)
+{
+    if (region.bytes.size == 0 || region.height == 0)
+    {
+        return;
+    }
+    Item item;
+    item.region = region;
+    item.bytes = region.bytes;
+    items_.push_back(std::move(item));
+    pendingBytes_ += region.bytes.size;
+}
+
+void GpuUploadQueue::queueTask(std::function<void()> task)
+{
+    Item item;
+    item.task = std::move(task);
+    items_.push_back(std::move(item));
+}
+
+bool GpuUploadQueue::process(const UploadBudget& budget)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                std::chrono::duration<float, std::milli>(budget.millisecondsPerFrame));
+    size_t uploadedBytes = 0;
+    bool progressed = false;
+
+    uint32_t boundBuffer = 0;
+    uint32_t boundTexture = 0;
+    while (!items_.empty())
+    {
+        // Stop once the frame budget is spent, unless nothing has been done yet this frame
+        if (progressed && (uploadedBytes >= budget.bytesPerFrame || std::chrono::steady_clock::now() >= deadline))
+        {
+            break;
+        }
+
+        Item& item = items_.front();
+        if (item.task)
+        {
+            item.task();
+            items_.pop_front();
+            boundTexture = 0;       // Tasks may bind other textures
+            progressed = true;
+            continue;
+        }
+
+        size_t remainingBudget = budget.bytesPerFrame > uploadedBytes ? budget.bytesPerFrame - uploadedBytes : 0;
+        if (item.region.texture)
+        {
+            const TextureRegion& region = item.region;
+            if (region.texture != boundTexture)
+            {
+                glBindTexture(GL_TEXTURE_2D, region.texture);
+                boundTexture = region.texture;
+            }
+
+            size_t chunkSize = item.bytes.size;
+            if (region.type == 0)
+            {
+                // Compressed blocks are copied one whole level at a time
+                glCompressedTexSubImage2D(GL_TEXTURE_2D, region.level, 0, 0, region.width, region.height, region.format,
+                                          static_cast<GLsizei>(chunkSize), item.bytes.data);
+                item.uploadedRows = region.height;
+            }
+            else
+            {
+                // Copy the next band of rows, within what is left of the byte budget
+                size_t rowSize = item.bytes.size / region.height;
+                size_t bandSize = std::min(kUploadChunkSize, std::max<size_t>(remainingBudget, 1));
+                uint32_t rows = std::min(region.height - item.uploadedRows,
+                                         static_cast<uint32_t>(std::max<size_t>(bandSize / rowSize, 1)));
+                chunkSize = rows * rowSize;
+                glTexSubImage2D(GL_TEXTURE_2D, region.level, 0, static_cast<GLint>(item.uploadedRows), region.width, rows,
+                                region.format, region.type, item.bytes.data + item.uploadedBytes);
+                item.uploadedRows += rows;
+            }
+            item.uploadedBytes += chunkSize;
+            uploadedBytes += chunkSize;
+            pendingBytes_ -= chunkSize;
+            progressed = true;
+
+            if (item.uploadedRows == region.height)
+            {
+                items_.pop_front();
+            }
+            continue;
+        }
+
+        // Copy the next chunk of the buffer, within what is left of the byte budget
+        size_t chunkSize = std::min({ item.bytes.size - item.uploadedBytes, kUploadChunkSize,
+                                      std::max<size_t>(remainingBudget, 1) });
+        if (item.buffer != boundBuffer)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, item.buffer);
+            boundBuffer = item.buffer;
+        }
+        glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(item.uploadedBytes),
+                        static_cast<GLsizeiptr>(chunkSize), item.bytes.data + item.uploadedBytes);
+        item.uploadedBytes += chunkSize;
+        uploadedBytes += chunkSize;
+        pendingBytes_ -= chunkSize;
+        progressed = true;
+
+        if (item.uploadedBytes == item.bytes.size)
+        {
+            items_.pop_front();
+        }
+    }
+
+    if (boundBuffer != 0)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    if (boundTexture != 0)
+    {
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    return items_.empty();
+}
@@ -0,0 +1,69 @@
+#ifndef GPU_UPLOAD_QUEUE_HPP
+#define GPU_UPLOAD_QUEUE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include "basic_types.hpp"
+
+// Amount of GL upload work the render thread may do in one frame
+struct UploadBudget
+{
+    size_t bytesPerFrame = 4u << 20;        // Buffer and texture bytes copied per frame
+    float millisecondsPerFrame = 4.0f;      // CPU time spent issuing uploads and GL tasks per frame
+};
+
+// Region of a texture level to copy, the texture storage must be allocated (glTexStorage2D)
+struct TextureRegion
+{
+    uint32_t texture = 0;           // Destination texture object
+    int32_t level = 0;              // Mip level
+    uint32_t width = 0;             // Size of the level
+    uint32_t height = 0;
+    uint32_t format = 0;            // Pixel format, or internal format of compressed blocks
+    uint32_t type = 0;              // Pixel type, 0 for compressed blocks
+    ByteSpan bytes;                 // Tightly packed rows of the level
+};
+
+// Uploads waiting for the render thread.
+// Buffer contents are copied with glBufferSubData in chunks and uncompressed texture levels with
+// glTexSubImage2D in bands of rows, so that a large scene is spread over several frames; compressed
+// levels are copied whole. Other GL work (shader compilation, ...) is queued as tasks.
+// Every call must be made on the thread owning the GL context.
+class GpuUploadQueue
+{
+public:
+    // Function to allocate a buffer's storage now and queue the copy of its contents
+    // The bytes must stay alive until the queue is empty
+    void queueBuffer(uint32_t buffer, ByteSpan bytes);
+
+    // Function to queue the copy of a texture level, the bytes must stay alive until the queue is empty
+    void queueTextureRegion(const TextureRegion& region);
+
+    // Function to queue GL work that is not a buffer copy, tasks run in order with the buffer copies
+    void queueTask(std::function<void()> task);
+
+    // Function to run queued uploads until the frame budget is spent, returns true once the queue is empty
+    // At least one chunk, band or task is processed per call so that uploads always make progress
+    bool process(const UploadBudget& budget);
+
+    bool empty() const { return items_.empty(); }
+    size_t pendingBytes() const { return pendingBytes_; }
+
+private:
+    struct Item
+    {
+        uint32_t buffer = 0;            // Destination buffer (0 for textures and tasks)
+        ByteSpan bytes;                 // Bytes to copy into the buffer or texture level
+        size_t uploadedBytes = 0;       // Bytes already copied
+        TextureRegion region;           // Destination texture level (texture 0 for buffers and tasks)
+        uint32_t uploadedRows = 0;      // Rows of the level already copied
+        std::function<void()> task;     // GL work to run (empty for copies)
+    };
+
+    std::deque<Item> items_;            // Pending work, oldest first
+    size_t pendingBytes_ = 0;           // Buffer and texture bytes not copied yet
+};
+
+#endif // GPU_UPLOAD_QUEUE_HPP
@@ -0,0 +1,105 @@
+#include "hash.hpp"
+
+#include <cstring>
+
+namespace
+{
+    const uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+    const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+    const uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+    const uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+    const uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+    uint64_t rotateLeft(uint64_t value, int bits)
+    {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    uint64_t read64(const unsigned char* bytes)
+    {
+        uint64_t value;
+        std::memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+
+    uint32_t read32(const unsigned char* bytes)
+    {
+        uint32_t value;
+        std::memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+
+    uint64_t hashRound(uint64_t accumulator, uint64_t input)
+    {
+        accumulator += input * kPrime2;
+        accumulator = rotateLeft(accumulator, 31);
+        return accumulator * kPrime1;
+    }
+
+    uint64_t hashMergeRound(uint64_t accumulator, uint64_t value)
+    {
+        accumulator ^= hashRound(0, value);
+        return accumulator * kPrime1 + kPrime4;
+    }
+}
+
+// 64-bit xxHash (XXH64)
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    const unsigned char* end = bytes + size;
+    uint64_t hash;
+    if (size >= 32)
+    {
+        uint64_t v1 = seed + kPrime1 + kPrime2;
+        uint64_t v2 = seed + kPrime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kPrime1;
+        const unsigned char* limit = end - 32;
+        do
+        {
+            v1 = hashRound(v1, read64(bytes));
+            v2 = hashRound(v2, read64(bytes + 8));
+            v3 = hashRound(v3, read64(bytes + 16));
+            v4 = hashRound(v4, read64(bytes + 24));
+            bytes += 32;
+        } while (bytes <= limit);
+        hash = rotateLeft(v1, 1) + rotateLeft(v2, 7) + rotateLeft(v3, 12) + rotateLeft(v4, 18);
+        hash = hashMergeRound(hash, v1);
+        hash = hashMergeRound(hash, v2);
+        hash = hashMergeRound(hash, v3);
+        hash = hashMergeRound(hash, v4);
+    }
+    else
+    {
+        hash = seed + kPrime5;
+    }
+
+    hash += static_cast<uint64_t>(size);
+    while (bytes + 8 <= end)
+    {
+        hash ^= hashRound(0, read64(bytes));
+        hash = rotateLeft(hash, 27) * kPrime1 + kPrime4;
+        bytes += 8;
+    }
+    if (bytes + 4 <= end)
+    {
+        hash ^= static_cast<uint64_t>(read32(bytes)) * kPrime1;
+        hash = rotateLeft(hash, 23) * kPrime2 + kPrime3;
+        bytes += 4;
+    }
+    while (bytes < end)
+    {
+        hash ^= (*bytes) * kPrime5;
+        hash = rotateLeft(hash, 11) * kPrime1;
+        bytes++;
+    }
+
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
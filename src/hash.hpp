@@ -0,0 +1,10 @@
+#ifndef HASH_HPP
+#define HASH_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Function to compute the 64-bit xxHash (XXH64) of a block of memory
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed);
+
+#endif // HASH_HPP
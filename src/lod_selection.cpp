@@ -0,0 +1,86 @@
+#include "lod_selection.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Function to find the coarsest level of a draw whose error stays within maxPixelError, for an error scale
+    // (pixels per unit of relative error); the errors of the levels never decrease along the chain
+    uint32_t findCoarsestLevel(const DrawCommand& draw, const std::vector<DrawLod>& lods, float errorScale, float maxPixelError)
+    {
+        uint32_t level = 0;
+        while (level < draw.lodCount && lods[draw.firstLod + level].error * errorScale <= maxPixelError)
+        {
+            level++;
+        }
+        return level;
+    }
+}
+
+void initDrawLods(DrawLodState& state, const std::vector<DrawCommand>& draws, std::vector<DrawCommand>& lodDraws)
+{
+    state.levels.assign(draws.size(), 0);
+    lodDraws = draws;
+}
+
+uint32_t selectDrawLods(DrawLodState& state, const DrawCullingState& culling, const std::vector<DrawCommand>& draws,
+                        const std::vector<DrawLod>& lods, const float viewProjection[16], float viewportWidth,
+                        float viewportHeight, std::vector<DrawCommand>& lodDraws)
+{
+    // Pixels covered by a world-space length at clip w = 1, along the screen axis that magnifies it most
+    float scaleX = std::sqrt(viewProjection[0] * viewProjection[0] + viewProjection[4] * viewProjection[4] +
+                             viewProjection[8] * viewProjection[8]) * viewportWidth * 0.5f;
+    float scaleY = std::sqrt(viewProjection[1] * viewProjection[1] + viewProjection[5] * viewProjection[5] +
+                             viewProjection[9] * viewProjection[9]) * viewportHeight * 0.5f;
+    float pixelScale = std::max(scaleX, scaleY);
+    // Growth of clip w with the distance along the view direction (0 for orthographic projections)
+    float depthScale = std::sqrt(viewProjection[3] * viewProjection[3] + viewProjection[7] * viewProjection[7] +
+                                 viewProjection[11] * viewProjection[11]);
+
+    uint32_t simplifiedCount = 0;
+    for (uint32_t box = 0; box < culling.boxDraws.size(); box++)
+    {
+        uint32_t drawIdx = culling.boxDraws[box];
+        const DrawCommand& draw = draws[drawIdx];
+        if (draw.lodCount == 0)
+        {
+            continue;
+        }
+
+        // The errors are relative to the size of the draw, which its bounding sphere diameter bounds from above
+        float center[3], radiusSquared = 0.0f;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            center[axis] = culling.centers[axis][box];
+            radiusSquared += culling.extents[axis][box] * culling.extents[axis][box];
+        }
+        float radius = std::sqrt(radiusSquared);
+        // Projected at the point of the sphere nearest to the camera; a camera inside the sphere keeps full detail
+        float w = viewProjection[3] * center[0] + viewProjection[7] * center[1] + viewProjection[11] * center[2] +
+                  viewProjection[15] - radius * depthScale;
+        uint32_t level = 0;
+        if (w > 0.0f)
+        {
+            float errorScale = 2.0f * radius * pixelScale / w;
+            uint32_t coarsest = findCoarsestLevel(draw, lods, errorScale, kLodPixelError);
+            uint32_t switchCoarser = findCoarsestLevel(draw, lods, errorScale, kLodPixelError * (1.0f - kLodHysteresis));
+            level = std::min(std::max(state.levels[drawIdx], switchCoarser), coarsest);
+        }
+        state.levels[drawIdx] = level;
+
+        DrawCommand& lodDraw = lodDraws[drawIdx];
+        if (level == 0)
+        {
+            lodDraw.indexOffset = draw.indexOffset;
+            lodDraw.indexCount = draw.indexCount;
+        }
+        else
+        {
+            lodDraw.indexOffset = lods[draw.firstLod + level - 1].indexOffset;
+            lodDraw.indexCount = lods[draw.firstLod + level - 1].indexCount;
+            simplifiedCount++;
+        }
+    }
+    return simplifiedCount;
+}
@@ -0,0 +1,34 @@
+#ifndef LOD_SELECTION_HPP
+#define LOD_SELECTION_HPP
+
+#include <cstdint>
+#include <vector>
+#include "frustum_culling.hpp"
+#include "mesh_data.hpp"
+
+// Largest screen-space error of a level of detail, in pixels
+const float kLodPixelError = 1.0f;
+// Margin between the errors that switch to a coarser and back to a finer level: a draw only moves to a coarser
+// level once its error falls below (1 - kLodHysteresis) * kLodPixelError, so that it does not flip between two
+// levels every frame when its size sits at a threshold
+const float kLodHysteresis = 0.25f;
+
+// Level of detail currently drawn for every draw of a draw list, 0 is the full-detail index range and
+// level l > 0 is MeshData::lods[firstLod + l - 1]
+struct DrawLodState
+{
+    std::vector<uint32_t> levels;
+};
+
+// Function to start every draw at full detail; lodDraws receives the copy of the draw list whose index ranges
+// selectDrawLods rewrites
+void initDrawLods(DrawLodState& state, const std::vector<DrawCommand>& draws, std::vector<DrawCommand>& lodDraws);
+
+// Function to select the level of every draw with bounds from the size of its bounding sphere on screen (around the
+// world-space box kept by the culling state), for a column-major view projection matrix and a viewport in pixels.
+// The chosen index range is written to the matching draw of lodDraws; returns the number of draws at a simplified level
+uint32_t selectDrawLods(DrawLodState& state, const DrawCullingState& culling, const std::vector<DrawCommand>& draws,
+                        const std::vector<DrawLod>& lods, const float viewProjection[16], float viewportWidth,
+                        float viewportHeight, std::vector<DrawCommand>& lodDraws);
+
+#endif // LOD_SELECTION_HPP
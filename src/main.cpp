@@ -1,28 +1,93 @@
 #include <iostream>
 #include <GLFW/glfw3.h>
 #include <GLES3/gl3.h>
-#include "tiny_gltf.h"
+#include "animation.hpp"
+#include "gpu_upload_queue.hpp"
+#include "memory_stats.hpp"
+#include "mesh_builder.hpp"
+#include "frustum_culling.hpp"
+#include "lod_selection.hpp"
+#include "draw_instancing.hpp"
+#include "meshlet_culling.hpp"
+#include "scene_graph.hpp"
+#include "scene_loader.hpp"
+#include "vertex_layout.hpp"
+#include "shader_prelude.hpp"
+#include "skinning.hpp"
+#include "uniform_table.hpp"
 #include <filesystem>
-#include <fstream>
-#include <sstream>
 #include <chrono>
-#include <unordered_map>
+#include <future>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <vector>
 #include <string>
 #include "basic_types.hpp"
+#include "transform_math.hpp"
+
+// Directory holding the baked mesh caches (relative to the working directory)
+static const char* kMeshCacheDirectory = "mesh_cache";
+// Texture unit of the morph target delta texture, next to the joint palette's
+static const GLuint kMorphDeltaTextureUnit = 14;
+// Material textures use the units below the world matrix texture
+static const GLuint kMaxMaterialTextureUnits = kNodeMatrixTextureUnit;
+
+// Texture bound to a unit while a material is drawn
+struct MaterialTextureBinding
+{
+    GLuint unit;            // Unit read by the sampler uniform
+    uint32_t texture;       // Index in WindowGLContext::textures
+};
+
+// Structure to store the OpenGL state of one material
+struct MaterialGLContext
+{
+    GLint program = 0;             // Shader program handle
+    UniformTable uniforms;                      // Active uniforms of the program, with the values of the material
+    UniformHandle<float> timeUniform;           // Shadertoy-style iTime, updated every frame
+    UniformHandle<UniformMatrix4> positionDequantization;   // Prelude's position dequantization matrix
+    UniformHandle<Vector4> texCoordTransform;       // Prelude's texture coordinate transform
+    UniformHandle<int32_t> skinned;                 // Prelude's skinning switch
+    UniformHandle<int32_t> skinJointOffset;         // Prelude's first joint in the palette texture
+    UniformHandle<int32_t> morphTexelBase;          // Prelude's morph target parameters
+    UniformHandle<int32_t> morphTargetCount;
+    UniformHandle<int32_t> morphTexelsPerTarget;
+    UniformHandle<Vector4> morphWeights;
+    UniformHandle<UniformMatrix4> viewProjection;   // Prelude's view projection matrix
+    UniformHandle<int32_t> nodeIndex;               // Prelude's node slot (GLSL ES 3.00)
+    UniformHandle<UniformMatrix4> nodeMatrix;       // Prelude's world matrix (GLSL ES 1.00)
+    UniformHandle<int32_t> instanced;               // Prelude's instancing switch (GLSL ES 3.00)
+    std::vector<MaterialTextureBinding> textures;   // Textures of the sampler uniforms
+};
 
 // Structure to store OpenGL-related objects and state for the window
 struct WindowGLContext 
 {
-    std::unordered_map<std::string, float> materialUniformFloats;
-    std::unordered_map<std::string, int> materialUniformInts; 
-    std::unordered_map<std::string, Vector3> materialUniformVector3;    
-    std::unordered_map<std::string, Vector2> materialUniformVector2;
-    std::unordered_map<std::string, Vector4> materialUniformVector4;
+    std::vector<MaterialGLContext> materials;   // Materials, indexed by DrawCommand::material
+    std::vector<DrawCommand> draws;             // Draw list, sorted by material
+    std::vector<DrawLod> lods;                  // Simplified levels of the draws
+    std::vector<DrawCommand> lodDraws;          // Draw list with the index range of the level selected for every draw
+    std::vector<DrawCommand> visibleDraws;      // Draws of the list inside the view frustum, rebuilt every frame
+    InstancedDrawList instancedDraws;           // Visible draws with the copies of a primitive merged into instanced draws
+    InstanceBufferGLContext instanceBuffer;     // World matrices of the instances, refilled every frame
+    MeshletCullingState meshletCulling;         // Index bytes and scratch of the meshlet culling
+    IndexRingGLContext indexRing;               // Compacted index ranges of the meshlet draws, refilled every frame
+    DrawCullingState culling;                  // World-space boxes of the draws
+    DrawLodState lodState;                     // Level of detail drawn for every draw
 
-    GLuint indicesCount;           // Number of indices to render
     GLuint indexBuffer;            // OpenGL buffer object for indices
-    GLuint vertexArrayObject;      // Vertex Array Object (VAO) handle
-    GLint program;                 // Shader program handle
+    std::vector<GLuint> vertexArrayObjects;    // One Vertex Array Object (VAO) per vertex segment
+    std::vector<VertexSegment> segments;       // Vertex segments, with their dequantization parameters
+    size_t gpuBufferBytes = 0;                 // Storage of the vertex and index buffers
+    GLuint morphDeltaTexture = 0;              // Morph target deltas, fetched by vertex index
+    std::vector<MorphTargetSet> morphTargetSets;   // Morph targets of the primitives, indexed by DrawCommand::morph
+    std::vector<GLuint> textures;              // Texture objects, indexed like the glTF textures
+    size_t textureBytes = 0;                   // Storage of the textures
+    size_t uniformUploadBytes = 0;             // Bytes of uniforms sent by the last submitDraws
+    JointPaletteGLContext jointPalette;        // Joint matrices of every skin, updated when a node moves
+    NodeMatrixGLContext nodeMatrices;          // World matrix of every node, updated when a node moves
+    float viewProjection[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };  // Camera, identity: positions are in clip space
 
 };
 
@@ -106,125 +171,19 @@ static float getcurrentTime()
     return duration / 1000.0f; // Convert milliseconds to seconds
 }
 
-static void materialSetProperty(WindowGLContext& windowContext, std::string uniformName, int value)
-{
-    if (windowContext.materialUniformInts.find(uniformName) != windowContext.materialUniformInts.end())
-    {
-        windowContext.materialUniformInts[uniformName] = value;
-    }
-}
-
-static void materialSetProperty(WindowGLContext& windowContext, std::string uniformName, Vector2 value)
-{
-    // Check if the uniform name exists in the materialUniformVector2 map
-    // If it does, update the value; otherwise, add a new entry
-    if (windowContext.materialUniformVector2.find(uniformName) != windowContext.materialUniformVector2.end())
-    {
-        windowContext.materialUniformVector2[uniformName] = value;
-    }
-}
-static void materialSetProperty(WindowGLContext& windowContext, std::string uniformName, Vector3 value)
-{
-    // Check if the uniform name exists in the materialUniformVector3 map
-    // If it does, update the value; otherwise, add a new entry
-    if (windowContext.materialUniformVector3.find(uniformName) != windowContext.materialUniformVector3.end())
-    {
-        windowContext.materialUniformVector3[uniformName] = value;
-    }
-}
-
-static void materialSetProperty(WindowGLContext& windowContext, std::string uniformName, float value)
-{
-    // Check if the uniform name exists in the materialUniformFloats map
-    // If it does, update the value; otherwise, add a new entry
-    if (windowContext.materialUniformFloats.find(uniformName) != windowContext.materialUniformFloats.end())
-    {
-        windowContext.materialUniformFloats[uniformName] = value;
-    }
-}
-
-static void materialSetProperty(WindowGLContext& windowContext, std::string uniformName, Vector4 value)
-{
-    // Check if the uniform name exists in the materialUniformVector4 map
-    // If it does, update the value; otherwise, add a new entry
-    if (windowContext.materialUniformVector4.find(uniformName) != windowContext.materialUniformVector4.end())
-    {
-        windowContext.materialUniformVector4[uniformName] = value;
-    }
-}
-
-static void materialUpdateProperties(WindowGLContext& windowContext)
-{
-    for(auto& uniform : windowContext.materialUniformInts)
-    {
-        GLint location = glGetUniformLocation(windowContext.program, uniform.first.c_str());
-        if (location != -1)
-        {
-            glUniform1i(location, uniform.second);
-        }
-        std::cout << "Uniform: " << uniform.first << " = " << uniform.second << std::endl;
-    }
-    // Iterate through the material uniform floats and set them in the shader program
-    for (auto& uniform : windowContext.materialUniformFloats)
-    {
-        GLint location = glGetUniformLocation(windowContext.program, uniform.first.c_str());
-        if (location != -1)
-        {
-            glUniform1f(location, uniform.second);
-        }
-        std::cout << "Uniform: " << uniform.first << " = " << uniform.second << std::endl;
-    }
-    for (auto& uniform : windowContext.materialUniformVector4)
-    {
-        GLint location = glGetUniformLocation(windowContext.program, uniform.first.c_str());
-        if (location != -1)
-        {
-            glUniform4f(location, uniform.second.x, uniform.second.y, uniform.second.z, uniform.second.w);
-        }
-        std::cout << "Uniform: " << uniform.first << " = (" 
-                  << uniform.second.x << ", " 
-                  << uniform.second.y << ", " 
-                  << uniform.second.z << ", " 
-                  << uniform.second.w << ")" << std::endl;
-    }
-    for (auto& uniform : windowContext.materialUniformVector3)
-    {
-        GLint location = glGetUniformLocation(windowContext.program, uniform.first.c_str());
-        if (location != -1)
-        {
-            glUniform3f(location, uniform.second.x, uniform.second.y, uniform.second.z);
-        }
-        std::cout << "Uniform: " << uniform.first << " = (" 
-                  << uniform.second.x << ", " 
-                  << uniform.second.y << ", " 
-                  << uniform.second.z << ")" << std::endl;
-    }
-    for (auto& uniform : windowContext.materialUniformVector2)
-    {
-        GLint location = glGetUniformLocation(windowContext.program, uniform.first.c_str());
-        if (location != -1)
-        {
-            glUniform2f(location, uniform.second.x, uniform.second.y);
-        }
-        std::cout << "Uniform: " << uniform.first << " = (" 
-                  << uniform.second.x << ", " 
-                  << uniform.second.y << ")" << std::endl;
-    }
-}
-// Function to load material (shaders) for a mesh, either from GLTF or use defaults
-void loadMaterial(WindowContext& windowContext, tinygltf::Model& model, std::filesystem::path gltfDirectory, unsigned int materialId) {
-    // Paths to vertex and fragment shader files
-    std::filesystem::path vertexShaderPath;
-    std::filesystem::path fragmentShaderPath;
+// Function to create the shader program and uniforms of a material from its description and shader sources
+// The prelude is inserted into the vertex shader, after its #version line
+void createMaterial(MaterialGLContext& materialContext, const MaterialDescription& material,
+                    const MaterialShaderSources& shaderSources, const std::string& vertexShaderPrelude) {
     // Strings to hold shader source code
     std::string vertexShaderSource;
     std::string fragmentShaderSource;
     
     // Default vertex shader source code (GLSL)
     const char* defaultVertexShaderSource = R"(
-        attribute vec2 position;
+        attribute vec4 position;
         void main() {
-            gl_Position = vec4(position, 0.0, 1.0);
+            gl_Position = transformPosition(decodePosition(position));
         }
     )";
 
@@ -241,127 +200,12 @@ void loadMaterial(WindowContext& windowContext, tinygltf::Model& model, std::fil
     }
 )";
 
-    
     // Check if the material exists in the GLTF file
-    if(materialId < model.materials.size())
+    if(material.fromAsset)
     {
-        // Try to get custom shader file names from the material's extras
-        auto gltfMaterialExtras = model.materials[materialId].extras;
-        if(gltfMaterialExtras.Has("shader"))
-        {
-            auto gltfMaterialShader = gltfMaterialExtras.Get("shader");
-            if(gltfMaterialShader.Has("vertex"))
-            {
-                // Get the vertex shader file name from the GLTF material
-                std::string gltfMaterialShaderVertex = gltfMaterialShader.Get("vertex").Get<std::string>();
-                vertexShaderPath = gltfDirectory / gltfMaterialShaderVertex;
-            }
-            if(gltfMaterialShader.Has("fragment"))
-            {
-                // Get the fragment shader file name from the GLTF material
-                std::string gltfMaterialShaderFragment = gltfMaterialShader.Get("fragment").Get<std::string>();
-                fragmentShaderPath = gltfDirectory / gltfMaterialShaderFragment;
-            }
-            if (gltfMaterialShader.Has("uniforms"))
-            {
-                auto gltfUniforms = gltfMaterialShader.Get("uniforms");
-                for (int uniformIdx = 0; uniformIdx < gltfUniforms.ArrayLen(); uniformIdx++)
-                {
-                    auto uniform = gltfUniforms.Get(uniformIdx);
-                    std::string uniformName;
-                    if (uniform.Has("name"))
-                    {
-                        uniformName = uniform.Get("name").Get<std::string>();
-                    }
-                    if (uniform.Has("type"))
-                    {
-                        std::string type = uniform.Get("type").Get<std::string>();
-                        auto uniformValue = uniform.Get("value");
-                        if(type == "Float")
-                        {
-                            double uniformValueFloat = uniformValue.Get(0).Get<double>();
-                            windowContext.gl.materialUniformFloats[uniformName] = uniformValueFloat;
-                            // Print the uniform name and value to standard output
-                            std::cout << "Uniform " << uniformName << " = " << uniformValueFloat << std::endl;
-                            
-                        }
-                        else if(type == "Vector4")
-                        {
-                            // Assuming the value is an array of 4 floats
-                            if (uniformValue.ArrayLen() >= 4)
-                            {
-                                double x = uniformValue.Get(0).Get<double>();
-                                double y = uniformValue.Get(1).Get<double>();
-                                double z = uniformValue.Get(2).Get<double>();
-                                double w = uniformValue.Get(3).Get<double>();
-                                windowContext.gl.materialUniformVector4[uniformName] = Vector4(x, y, z, w);
-                                // Print the uniform name and value to standard output
-                                std::cout << "Uniform " << uniformName << " = (" 
-                                          << x << ", " << y << ", " 
-                                          << z << ", " << w << ")" << std::endl;
-                            }
-                        }
-                        else if(
-                            type == "Vector3")
-                        {
-                            // Assuming the value is an array of 3 floats
-                            if (uniformValue.ArrayLen() >= 3)
-                            {
-                                double x = uniformValue.Get(0).Get<double>();
-                                double y = uniformValue.Get(1).Get<double>();
-                                double z = uniformValue.Get(2).Get<double>();
-                                windowContext.gl.materialUniformVector3[uniformName] = Vector3(x, y, z);
-                                // Print the uniform name and value to standard output
-                                std::cout << "Uniform " << uniformName << " = (" 
-                                          << x << ", " << y << ", " 
-                                          << z << ")" << std::endl;
-                            }
-                        }
-                        else if(type == "Vector2")
-                        {
-                            // Assuming the value is an array of 2 floats
-                            if (uniformValue.ArrayLen() >= 2)
-                            {
-                                double x = uniformValue.Get(0).Get<double>();
-                                double y = uniformValue.Get(1).Get<double>();
-                                windowContext.gl.materialUniformVector2[uniformName] = Vector2(x, y);
-                                // Print the uniform name and value to standard output
-                                std::cout << "Uniform " << uniformName << " = (" 
-                                          << x << ", " << y << ")" << std::endl;
-                            }
-                        }
-                        // Check for integer type uniforms
-                        else if(type == "Int")
-                        {
-                            int uniformValueInt = uniformValue.Get(0).Get<int>();
-                            windowContext.gl.materialUniformInts[uniformName] = uniformValueInt;
-                            // Print the uniform name and value to standard output
-                            std::cout << "Uniform " << uniformName << " = " << uniformValueInt << std::endl;
-                        }
-                        else
-                        {
-                            std::cerr << "Unsupported uniform type: " << type << " for uniform: " << uniformName << std::endl;
-                        }
-                    }
-                }
-            }
-        }
-        // Try to read vertex shader source code from file if path is set
-        std::ifstream vertexShaderFile(vertexShaderPath);
-        if(vertexShaderFile.is_open())
-        {
-            std::stringstream buffer;
-            buffer << vertexShaderFile.rdbuf();
-            vertexShaderSource = buffer.str();
-        }
-        // Try to read fragment shader source code from file if path is set
-        std::ifstream fragmentShaderFile(fragmentShaderPath);
-        if(fragmentShaderFile.is_open())
-        {
-            std::stringstream buffer;
-            buffer << fragmentShaderFile.rdbuf();
-            fragmentShaderSource = buffer.str();
-        }
+        // Use the shader sources read by the loader
+        vertexShaderSource = shaderSources.vertex;
+        fragmentShaderSource = shaderSources.fragment;
     }
     else
     {
@@ -374,6 +218,9 @@ void loadMaterial(WindowContext& windowContext, tinygltf::Model& model, std::fil
         vertexShaderSource = defaultVertexShaderSource;
     }
 
+    // Give the vertex shader the built-in uniforms and decoding helpers
+    vertexShaderSource = injectShaderPrelude(vertexShaderSource, vertexShaderPrelude);
+
     // Convert shader source code to    C-style strings for OpenGL
     const char *vertexShaderSourceCStr = vertexShaderSource.c_str();
     const char *fragmentShaderSourceCStr = fragmentShaderSource.c_str();
@@ -391,124 +238,452 @@ void loadMaterial(WindowContext& windowContext, tinygltf::Model& model, std::fil
 
     // Link the compiled shaders into a shader program
 
-    windowContext.gl.program = linkProgram(vertexShader, fragmentShader);
+    materialContext.program = linkProgram(vertexShader, fragmentShader);
 
-    // If linking failed, clean up shader objects
-    if (!windowContext.gl.program) {
-        glDeleteShader(vertexShader);
-        glDeleteShader(fragmentShader);
+    // The program keeps the compiled code, deleting the shader objects also frees the driver's copy of the sources
+    if (materialContext.program) {
+        glDetachShader(materialContext.program, vertexShader);
+        glDetachShader(materialContext.program, fragmentShader);
+    }
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+    if (!materialContext.program) {
         return;
     }
 
+    // Reflect the uniforms of the program once; from now on the built-in uniforms of the prelude, the material values
+    // and iTime are written through handles (unresolved when the shader does not use them)
+    UniformTable& uniforms = materialContext.uniforms;
+    buildUniformTable(uniforms, static_cast<uint32_t>(materialContext.program));
+    materialContext.timeUniform = findUniform<float>(uniforms, "iTime");
+    materialContext.positionDequantization = findUniform<UniformMatrix4>(uniforms, kPositionDequantizationUniform);
+    materialContext.texCoordTransform = findUniform<Vector4>(uniforms, kTexCoordTransformUniform);
+    materialContext.skinned = findUniform<int32_t>(uniforms, kSkinnedUniform);
+    materialContext.skinJointOffset = findUniform<int32_t>(uniforms, kSkinJointOffsetUniform);
+    materialContext.morphTexelBase = findUniform<int32_t>(uniforms, kMorphTexelBaseUniform);
+    materialContext.morphTargetCount = findUniform<int32_t>(uniforms, kMorphTargetCountUniform);
+    materialContext.morphTexelsPerTarget = findUniform<int32_t>(uniforms, kMorphTexelsPerTargetUniform);
+    materialContext.morphWeights = findUniform<Vector4>(uniforms, kMorphWeightsUniform);
+    materialContext.viewProjection = findUniform<UniformMatrix4>(uniforms, kViewProjectionUniform);
+    materialContext.nodeIndex = findUniform<int32_t>(uniforms, kNodeIndexUniform);
+    materialContext.nodeMatrix = findUniform<UniformMatrix4>(uniforms, kNodeMatrixUniform);
+    materialContext.instanced = findUniform<int32_t>(uniforms, kInstancedUniform);
+    for (const MaterialUniform& uniform : material.uniforms)
+    {
+        const char* name = getMaterialUniformName(material, uniform);
+        switch (uniform.type)
+        {
+        case MaterialUniformType::Float:
+            setUniform(uniforms, findUniform<float>(uniforms, name), uniform.values[0]);
+            // Print the uniform name and value to standard output
+            std::cout << "Uniform " << name << " = " << uniform.values[0] << std::endl;
+            break;
+        case MaterialUniformType::Int:
+            setUniform(uniforms, findUniform<int32_t>(uniforms, name), uniform.intValue);
+            std::cout << "Uniform " << name << " = " << uniform.intValue << std::endl;
+            break;
+        case MaterialUniformType::Vector2:
+            setUniform(uniforms, findUniform<Vector2>(uniforms, name), Vector2(uniform.values[0], uniform.values[1]));
+            std::cout << "Uniform " << name << " = (" << uniform.values[0] << ", " << uniform.values[1] << ")" << std::endl;
+            break;
+        case MaterialUniformType::Vector3:
+            setUniform(uniforms, findUniform<Vector3>(uniforms, name), Vector3(uniform.values[0], uniform.values[1], uniform.values[2]));
+            std::cout << "Uniform " << name << " = (" << uniform.values[0] << ", " << uniform.values[1] << ", "
+                      << uniform.values[2] << ")" << std::endl;
+            break;
+        case MaterialUniformType::Sampler2D:
+            break;      // Bound to a texture unit below
+        case MaterialUniformType::Matrix4:
+            break;      // Only reflected for the prelude, materials do not declare matrices
+        case MaterialUniformType::Vector4:
+            setUniform(uniforms, findUniform<Vector4>(uniforms, name),
+                       Vector4(uniform.values[0], uniform.values[1], uniform.values[2], uniform.values[3]));
+            std::cout << "Uniform " << name << " = (" << uniform.values[0] << ", " << uniform.values[1] << ", "
+                      << uniform.values[2] << ", " << uniform.values[3] << ")" << std::endl;
+            break;
+        }
+    }
+
     // Set the current shader program for rendering
-    glUseProgram(windowContext.gl.program);
+    glUseProgram(materialContext.program);
+
+    // The joint palette block and texture have fixed bindings, shared by every material
+    GLuint paletteBlock = glGetUniformBlockIndex(materialContext.program, kJointPaletteBlock);
+    if (paletteBlock != GL_INVALID_INDEX)
+    {
+        glUniformBlockBinding(materialContext.program, paletteBlock, kJointPaletteBinding);
+    }
+    GLint paletteTextureLocation = glGetUniformLocation(materialContext.program, kJointPaletteTextureUniform);
+    if (paletteTextureLocation >= 0)
+    {
+        glUniform1i(paletteTextureLocation, kJointPaletteTextureUnit);
+    }
+    GLint morphTextureLocation = glGetUniformLocation(materialContext.program, kMorphDeltaTextureUniform);
+    if (morphTextureLocation >= 0)
+    {
+        glUniform1i(morphTextureLocation, kMorphDeltaTextureUnit);
+    }
+    GLint nodeMatrixTextureLocation = glGetUniformLocation(materialContext.program, kNodeMatrixTextureUniform);
+    if (nodeMatrixTextureLocation >= 0)
+    {
+        glUniform1i(nodeMatrixTextureLocation, kNodeMatrixTextureUnit);
+    }
+
+    // Every sampler uniform of the material reads its texture from its own unit
+    for (const MaterialUniform& uniform : material.uniforms)
+    {
+        if (uniform.type != MaterialUniformType::Sampler2D)
+        {
+            continue;
+        }
+        uint32_t sampler = findUniformBinding(uniforms, getMaterialUniformName(material, uniform), MaterialUniformType::Sampler2D);
+        if (sampler == kNoUniform)
+        {
+            continue;
+        }
+        GLuint unit = static_cast<GLuint>(materialContext.textures.size());
+        if (unit >= kMaxMaterialTextureUnits)
+        {
+            std::cerr << "Too many textures in material, " << getMaterialUniformName(material, uniform) << " is not bound" << std::endl;
+            continue;
+        }
+        glUniform1i(uniforms.bindings[sampler].location, static_cast<GLint>(unit));
+        uniforms.intValues[uniforms.bindings[sampler].valueOffset] = static_cast<int32_t>(unit);   // Keep the shadow copy in step
+        materialContext.textures.push_back({ unit, static_cast<uint32_t>(uniform.intValue) });
+    }
 }
 
-// Function to load mesh data from a GLTF model and upload it to GPU buffers
-void loadMesh(WindowContext &windowContext, tinygltf::Model& model, unsigned int meshId)
+// Function to create the GPU buffers of mesh data, queue their contents for upload and record the attribute bindings in a VAO
+// The buffers are filled over the next frames by the upload queue, meshData must stay alive until it is empty
+void queueMeshDataUpload(WindowContext &windowContext, const MeshData& meshData, GpuUploadQueue& uploadQueue)
 {
-    // Buffer handles for vertex, normal, and texture coordinate data
-    GLuint vertexBuffer = 0;
-    GLuint normalBuffer = 0;
-    GLuint texCoordBuffer = 0;
-
-    // Get accessor indices for position, normal, texcoord, and indices from the mesh
-    uint32_t gltfAccessorPositionIndex = model.meshes[meshId].primitives[0].attributes["POSITION"];
-    uint32_t gltfAccessorNormalIndex = model.meshes[meshId].primitives[0].attributes["NORMAL"];
-    uint32_t gltfAccessorTexCoordIndex = model.meshes[meshId].primitives[0].attributes["TEXCOORD_0"];
-    uint32_t gltfAccessorIndicesIndex = model.meshes[meshId].primitives[0].indices;
-
-    // Get buffer view indices for each attribute
-    uint32_t gltfBufferViewPositionIndex = model.accessors[gltfAccessorPositionIndex].bufferView;
-    uint32_t gltfBufferViewNormalIndex = model.accessors[gltfAccessorNormalIndex].bufferView;
-    uint32_t gltfBufferViewTexCoordIndex = model.accessors[gltfAccessorTexCoordIndex].bufferView;
-    uint32_t gltfBufferIndicesIndex = model.accessors[gltfAccessorIndicesIndex].bufferView;
-
-    // Get buffer indices for each buffer view
-    uint32_t gltfBufferIndexPosition = model.bufferViews[gltfBufferViewPositionIndex].buffer;
-    uint32_t gltfBufferIndexNormal = model.bufferViews[gltfBufferViewNormalIndex].buffer;
-    uint32_t gltfBufferIndexTexCoord = model.bufferViews[gltfBufferViewTexCoordIndex].buffer;
-    uint32_t gltfBufferIndexIndices = model.bufferViews[gltfBufferIndicesIndex].buffer;
-
-    // Get raw data pointers for each buffer
-    unsigned char* gltfBufferDataPosition = model.buffers[gltfBufferIndexPosition].data.data();
-    unsigned char* gltfBufferDataNormal = model.buffers[gltfBufferIndexNormal].data.data();
-    unsigned char* gltfBufferDataTexCoord = model.buffers[gltfBufferIndexTexCoord].data.data();
-    unsigned char* gltfBufferDataIndices = model.buffers[gltfBufferIndexIndices].data.data();
-
-    // Get byte offsets for each buffer view
-    uint32_t gltfPositionByteOffset = model.bufferViews[gltfBufferViewPositionIndex].byteOffset;
-    uint32_t gltfNormalByteOffset = model.bufferViews[gltfBufferViewNormalIndex].byteOffset;
-    uint32_t gltfTexCoordByteOffset = model.bufferViews[gltfBufferViewTexCoordIndex].byteOffset;
-    uint32_t gltfIndecesByteOffset = model.bufferViews[gltfBufferIndicesIndex].byteOffset;
-
-    // Get byte lengths for each buffer view
-    uint32_t gltfPositionByteLength = model.bufferViews[gltfBufferViewPositionIndex].byteLength;
-    uint32_t gltfNormalByteLength = model.bufferViews[gltfBufferViewNormalIndex].byteLength;
-    uint32_t gltfTexCoordByteLength = model.bufferViews[gltfBufferViewTexCoordIndex].byteLength;
-    uint32_t gltfIndicesByteLength = model.bufferViews[gltfBufferIndicesIndex].byteLength;
-
-    // Calculate the number of indices to draw (for glDrawElements)
-    windowContext.gl.indicesCount = model.accessors[gltfAccessorIndicesIndex].count;
-
-    // Create and upload index buffer to the GPU
+    // Create the index buffer and queue its contents
     unsigned int indexBuffer;
     glGenBuffers(1, &indexBuffer);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, gltfIndicesByteLength, gltfBufferDataIndices + gltfIndecesByteOffset, GL_STATIC_DRAW);
+    uploadQueue.queueBuffer(indexBuffer, meshData.indices.bytes);
+    windowContext.gl.gpuBufferBytes += meshData.indices.bytes.size;
 
-    // Store the index buffer handle in the window context
+    // Store the index buffer handle and the draw list in the window context
     windowContext.gl.indexBuffer = indexBuffer;
+    windowContext.gl.draws = meshData.draws;
+    windowContext.gl.lods = meshData.lods;
+
+    // Create one vertex buffer per stream and queue its contents
+    std::vector<GLuint> vertexBuffers(meshData.streams.size());
+    glGenBuffers(static_cast<GLsizei>(vertexBuffers.size()), vertexBuffers.data());
+    for (size_t streamIdx = 0; streamIdx < meshData.streams.size(); streamIdx++)
+    {
+        uploadQueue.queueBuffer(vertexBuffers[streamIdx], meshData.streams[streamIdx].data.bytes);
+        windowContext.gl.gpuBufferBytes += meshData.streams[streamIdx].data.bytes.size;
+    }
+
+    // Create one Vertex Array Object (VAO) per vertex segment, its attribute pointers start at the
+    // first vertex of the segment so that the indices of the segment stay small
+    const std::vector<VertexSegment>& segments = meshData.segments;
+    windowContext.gl.segments = segments;
+    windowContext.gl.vertexArrayObjects.resize(segments.size());
+    glGenVertexArrays(static_cast<GLsizei>(segments.size()), windowContext.gl.vertexArrayObjects.data());
+    for (size_t segmentIdx = 0; segmentIdx < segments.size(); segmentIdx++)
+    {
+        glBindVertexArray(windowContext.gl.vertexArrayObjects[segmentIdx]);
+        // The index buffer binding is part of the VAO state
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+
+        // Bind every attribute to its location in the VAO
+        for (const VertexAttribute& attribute : meshData.attributes)
+        {
+            const VertexStream& stream = meshData.streams[attribute.stream];
+            size_t vertexSize = stream.stride ? stream.stride : getVertexAttributeSize(attribute);
+            size_t offset = attribute.offset + static_cast<size_t>(segments[segmentIdx].firstVertex) * vertexSize;
+            glBindBuffer(GL_ARRAY_BUFFER, vertexBuffers[attribute.stream]);
+            glEnableVertexAttribArray(attribute.location);
+            if (attribute.integer)
+            {
+                glVertexAttribIPointer(attribute.location, attribute.componentCount, attribute.componentType, stream.stride,
+                                       reinterpret_cast<const void*>(static_cast<uintptr_t>(offset)));
+            }
+            else
+            {
+                glVertexAttribPointer(attribute.location, attribute.componentCount, attribute.componentType,
+                                      attribute.normalized ? GL_TRUE : GL_FALSE, stream.stride,
+                                      reinterpret_cast<const void*>(static_cast<uintptr_t>(offset)));
+            }
+        }
+    }
 
-    // Create and upload vertex buffer (positions) to the GPU
-    glGenBuffers(1, &vertexBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, gltfPositionByteLength, gltfBufferDataPosition + gltfPositionByteOffset, GL_STATIC_DRAW);
-
-    // Create and upload normal buffer to the GPU
-    glGenBuffers(1, &normalBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
-    glBufferData(GL_ARRAY_BUFFER, gltfNormalByteLength, gltfBufferDataNormal + gltfNormalByteOffset, GL_STATIC_DRAW);
-
-    // Create and upload texture coordinate buffer to the GPU
-    glGenBuffers(1, &texCoordBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, texCoordBuffer);
-    glBufferData(GL_ARRAY_BUFFER, gltfTexCoordByteLength, gltfBufferDataTexCoord + gltfTexCoordByteOffset, GL_STATIC_DRAW);
-
-    // Create and bind a Vertex Array Object (VAO) to store attribute/buffer bindings
-    glGenVertexArrays(1, &windowContext.gl.vertexArrayObject);
-    glBindVertexArray(windowContext.gl.vertexArrayObject);
-
-    // Bind position buffer to attribute location 0 in the VAO
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-    // Bind normal buffer to attribute location 1 in the VAO
-    glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-    // Bind texture coordinate buffer to attribute location 2 in the VAO
-    glBindBuffer(GL_ARRAY_BUFFER, texCoordBuffer);
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, 0); // TEXCOORD_0 is usually vec2
-
-    // Unbind buffers and VAO to avoid accidental modification
+    // Unbind the VAO first, unbinding the index buffer while it is bound would detach it from the VAO
+    glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+
+    // Storage of the joint palettes, refilled every frame
+    createJointPalette(windowContext.gl.jointPalette, meshData);
+
+    // Morph target deltas: one RGB32F texel per vertex, target and attribute, in rows of kMorphDeltaTextureWidth
+    windowContext.gl.morphTargetSets = meshData.morphTargetSets;
+    if (meshData.morphDeltas.bytes.size)
+    {
+        GLint maxTextureSize = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+        GLsizei rows = static_cast<GLsizei>(meshData.morphDeltas.bytes.size / (kMorphDeltaTextureWidth * 3 * sizeof(float)));
+        if (rows > maxTextureSize)
+        {
+            std::cerr << "Morph target deltas need " << rows << " texture rows, more than " << maxTextureSize
+                      << ": drawn without morphing" << std::endl;
+            windowContext.gl.morphTargetSets.clear();
+            return;
+        }
+        glGenTextures(1, &windowContext.gl.morphDeltaTexture);
+        glActiveTexture(GL_TEXTURE0 + kMorphDeltaTextureUnit);
+        glBindTexture(GL_TEXTURE_2D, windowContext.gl.morphDeltaTexture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB32F, kMorphDeltaTextureWidth, rows);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glActiveTexture(GL_TEXTURE0);
+        windowContext.gl.textureBytes += meshData.morphDeltas.bytes.size;
+
+        // Copied in bands of rows within the frame budget, the texture stays bound to its unit
+        TextureRegion region;
+        region.texture = windowContext.gl.morphDeltaTexture;
+        region.width = kMorphDeltaTextureWidth;
+        region.height = static_cast<uint32_t>(rows);
+        region.format = GL_RGB;
+        region.type = GL_FLOAT;
+        region.bytes = meshData.morphDeltas.bytes;
+        uploadQueue.queueTextureRegion(region);
+    }
 }
 
-int main(void)
+// Function to create the texture objects of a scene and queue the upload of their levels, one queue item per level
+// The levels are read from the loaded textures, which must stay alive until the queue is empty
+void queueTextureUploads(WindowContext& windowContext, const std::vector<LoadedTexture>& textures, GpuUploadQueue& uploadQueue)
+{
+    windowContext.gl.textures.assign(textures.size(), 0);
+    if (textures.empty())
+    {
+        return;
+    }
+    glGenTextures(static_cast<GLsizei>(textures.size()), windowContext.gl.textures.data());
+    for (size_t textureIdx = 0; textureIdx < textures.size(); textureIdx++)
+    {
+        const LoadedTexture& texture = textures[textureIdx];
+        windowContext.gl.textureBytes += getTextureStorageSize(texture);
+        queueTextureUpload(texture, windowContext.gl.textures[textureIdx], uploadQueue);
+    }
+}
+
+// Function to tell whether two draws are placed by the same matrix: same node, same skin (joints are in
+// world space) or nodes whose world matrices are equal
+static bool haveSameTransform(const SceneGraph& sceneGraph, const DrawCommand& a, const DrawCommand& b)
+{
+    if (a.node == b.node || (a.skin != kNoSkin && a.skin == b.skin))
+    {
+        return true;
+    }
+    return a.skin == kNoSkin && b.skin == kNoSkin &&
+           std::memcmp(getNodeWorldMatrix(sceneGraph, a.node), getNodeWorldMatrix(sceneGraph, b.node), 16 * sizeof(float)) == 0;
+}
+
+// Function to render a draw list of the window
+// Consecutive draws using the same material, vertex segment, skin, morph targets, transform and adjacent index ranges are
+// merged into a single glDrawElements; instanced batches are drawn with one glDrawElementsInstanced, or one draw per
+// instance for programs without the instancing switch (GLSL ES 1.00)
+// Morph target weights are read from the nodes of meshData, world matrices from the scene graph and the instance buffer.
+// Uniforms (built-in and material ones) are sent only when their value changed, windowContext.uniformUploadBytes
+// counts the bytes sent
+static void submitDraws(WindowGLContext& windowContext, const InstancedDrawList& drawList, const MeshData& meshData,
+                        const SceneGraph& sceneGraph, float time)
+{
+    const std::vector<DrawCommand>& draws = drawList.draws;
+    windowContext.uniformUploadBytes = 0;
+    uint32_t currentMaterial = UINT32_MAX;
+    uint32_t currentSegment = UINT32_MAX;
+    uint32_t currentSkin = UINT32_MAX - 1;  // Neither a skin nor kNoSkin, the first draw sets the skin state
+    uint32_t currentMorphNode = UINT32_MAX;
+    uint32_t currentMorph = UINT32_MAX - 1;
+    int32_t currentNodeSlot = INT32_MIN;    // Neither a slot nor -1, the first draw sets the node state
+    bool currentInstanced = false;
+    bool currentRingIndices = false;
+    size_t drawIdx = 0;
+    while (drawIdx < draws.size())
+    {
+        const DrawCommand& first = draws[drawIdx];
+        if (first.material >= windowContext.materials.size() || !windowContext.materials[first.material].program ||
+            first.segment >= windowContext.vertexArrayObjects.size())
+        {
+            drawIdx++;
+            continue;
+        }
+
+        // Bind the material program and its uniforms when it changes
+        MaterialGLContext& material = windowContext.materials[first.material];
+        bool materialChanged = first.material != currentMaterial;
+        if (materialChanged)
+        {
+            glUseProgram(material.program);
+            setUniform(material.uniforms, material.timeUniform, time);
+            for (const MaterialTextureBinding& binding : material.textures)
+            {
+                glActiveTexture(GL_TEXTURE0 + binding.unit);
+                glBindTexture(GL_TEXTURE_2D, binding.texture < windowContext.textures.size() ? windowContext.textures[binding.texture] : 0);
+            }
+            glActiveTexture(GL_TEXTURE0);
+            setUniform(material.uniforms, material.viewProjection, windowContext.viewProjection);
+            currentMaterial = first.material;
+        }
+
+        // Bind the VAO of the vertex segment when it changes, and the index buffer the draw reads: the meshlet
+        // draws read the index ring, which the VAO keeps bound until another buffer replaces it
+        bool segmentChanged = first.segment != currentSegment;
+        if (segmentChanged)
+        {
+            glBindVertexArray(windowContext.vertexArrayObjects[first.segment]);
+            currentSegment = first.segment;
+        }
+        bool ringIndices = drawList.ringIndices[drawIdx] != 0;
+        if (segmentChanged || ringIndices != currentRingIndices)
+        {
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ringIndices ? windowContext.indexRing.buffer : windowContext.indexBuffer);
+            currentRingIndices = ringIndices;
+        }
+
+        // The dequantization parameters belong to the segment but live in the program
+        if (materialChanged || segmentChanged)
+        {
+            const VertexSegment& segment = windowContext.segments[first.segment];
+            const float* texCoordTransform = segment.texCoordTransform;
+            setUniform(material.uniforms, material.positionDequantization, segment.positionDequantization);
+            setUniform(material.uniforms, material.texCoordTransform,
+                       Vector4(texCoordTransform[0], texCoordTransform[1], texCoordTransform[2], texCoordTransform[3]));
+        }
+
+        // Point the program at the palette of the skin, rigid draws turn skinning off
+        bool skinChanged = first.skin != currentSkin;
+        if (skinChanged)
+        {
+            bindJointPalette(windowContext.jointPalette, first.skin);
+            currentSkin = first.skin;
+        }
+        if (materialChanged || skinChanged)
+        {
+            setUniform(material.uniforms, material.skinned, first.skin != kNoSkin ? 1 : 0);
+            setUniform(material.uniforms, material.skinJointOffset, getJointPaletteOffset(windowContext.jointPalette, first.skin));
+        }
+
+        // Instanced batches take their world matrices from the instance attribute
+        uint32_t instanceCount = drawList.instanceCounts[drawIdx];
+        bool instanced = instanceCount > 0 && hasUniform(material.instanced);
+        if (materialChanged || instanced != currentInstanced)
+        {
+            setUniform(material.uniforms, material.instanced, instanced ? 1 : 0);
+        }
+        currentInstanced = instanced;
+
+        // World matrix of the node, skinned draws (and nodes missing from the matrix texture) use the identity
+        bool placed = first.skin == kNoSkin && first.node < sceneGraph.nodeSlots.size();
+        int32_t nodeSlot = placed && windowContext.nodeMatrices.texture ? static_cast<int32_t>(sceneGraph.nodeSlots[first.node]) : -1;
+        if (materialChanged || nodeSlot != currentNodeSlot)
+        {
+            setUniform(material.uniforms, material.nodeIndex, nodeSlot);
+            if (hasUniform(material.nodeMatrix))
+            {
+                float identity[16];
+                setIdentityMatrix(identity);
+                setUniform(material.uniforms, material.nodeMatrix, placed ? getNodeWorldMatrix(sceneGraph, first.node) : identity);
+            }
+            currentNodeSlot = nodeSlot;
+        }
+
+        // Morph targets of the primitive and weights of the node, a target count of 0 disables morphing
+        bool morphed = first.morph < windowContext.morphTargetSets.size() && first.node < meshData.nodes.size();
+        uint32_t morph = morphed ? first.morph : kNoMorph;
+        if (materialChanged || morph != currentMorph || (morph != kNoMorph && first.node != currentMorphNode))
+        {
+            if (morph == kNoMorph)
+            {
+                setUniform(material.uniforms, material.morphTargetCount, 0);
+            }
+            else
+            {
+                const MorphTargetSet& set = windowContext.morphTargetSets[morph];
+                const SceneNode& node = meshData.nodes[first.node];
+                float weights[kMaxMorphTargets] = {};
+                uint32_t targetCount = std::min(set.targetCount, node.morphWeightCount);
+                std::copy(meshData.morphWeights.begin() + node.firstMorphWeight,
+                          meshData.morphWeights.begin() + node.firstMorphWeight + targetCount, weights);
+                setUniform(material.uniforms, material.morphTexelBase, static_cast<int32_t>(set.texelBase));
+                setUniform(material.uniforms, material.morphTargetCount, static_cast<int32_t>(targetCount));
+                setUniform(material.uniforms, material.morphTexelsPerTarget, static_cast<int32_t>(set.texelsPerTarget));
+                for (uint32_t element = 0; element < (targetCount + 3) / 4; element++)
+                {
+                    const float* elementWeights = &weights[element * 4];
+                    setUniform(material.uniforms, material.morphWeights,
+                               Vector4(elementWeights[0], elementWeights[1], elementWeights[2], elementWeights[3]), element);
+                }
+            }
+            currentMorph = morph;
+            currentMorphNode = first.node;
+        }
+
+        // Send the uniforms whose value changed since the program last drew
+        windowContext.uniformUploadBytes += applyUniforms(material.uniforms);
+
+        const void* indexPointer = reinterpret_cast<const void*>(static_cast<uintptr_t>(first.indexOffset));
+        if (instanced)
+        {
+            bindInstanceMatrices(windowContext.instanceBuffer, drawList.firstInstances[drawIdx]);
+            glDrawElementsInstanced(GL_TRIANGLES, first.indexCount, first.indexType, indexPointer, static_cast<GLsizei>(instanceCount));
+            drawIdx++;
+            continue;
+        }
+        if (instanceCount > 0)
+        {
+            for (uint32_t instance = 0; instance < instanceCount; instance++)
+            {
+                size_t matrix = (static_cast<size_t>(drawList.firstInstances[drawIdx]) + instance) * 16;
+                setUniform(material.uniforms, material.nodeMatrix, &drawList.instanceMatrices[matrix]);
+                windowContext.uniformUploadBytes += applyUniforms(material.uniforms);
+                glDrawElements(GL_TRIANGLES, first.indexCount, first.indexType, indexPointer);
+            }
+            currentNodeSlot = INT32_MIN;    // The node matrix uniform now holds the last instance
+            drawIdx++;
+            continue;
+        }
+
+        // Extend the run while the next draw continues the same index range
+        uint32_t indexSize = first.indexType == GL_UNSIGNED_INT ? 4 : (first.indexType == GL_UNSIGNED_SHORT ? 2 : 1);
+        uint32_t indexCount = first.indexCount;
+        size_t nextIdx = drawIdx + 1;
+        while (nextIdx < draws.size() && drawList.instanceCounts[nextIdx] == 0 && (drawList.ringIndices[nextIdx] != 0) == ringIndices &&
+               draws[nextIdx].material == first.material &&
+               draws[nextIdx].segment == first.segment && draws[nextIdx].skin == first.skin &&
+               draws[nextIdx].morph == first.morph && haveSameTransform(sceneGraph, draws[nextIdx], first) &&
+               draws[nextIdx].indexType == first.indexType &&
+               draws[nextIdx].indexOffset == first.indexOffset + indexCount * indexSize)
+        {
+            indexCount += draws[nextIdx].indexCount;
+            nextIdx++;
+        }
+
+        // Draw the run using the index buffer (GL_TRIANGLES mode)
+        glDrawElements(GL_TRIANGLES, indexCount, first.indexType, indexPointer);
+        drawIdx = nextIdx;
+    }
+}
+
+int main(int argc, char** argv)
 {
     // Create a window context structure to hold OpenGL state
     WindowContext windowContext;
     // Pointer to the GLFW window object
     GLFWwindow* window;
 
-    // Path to the GLTF file to load (relative to the executable)
+    // Path to the GLTF / GLB file to load (relative to the executable), can be overridden on the command line
     std::string gltfFileName = R"(../example/06_shadertoy/export/shadertoy.gltf)";
+    if (argc > 1)
+    {
+        gltfFileName = argv[1];
+    }
     // Initialize the GLFW library (for window and OpenGL context management)
     if (!glfwInit())
         return -1;
@@ -531,54 +706,184 @@ int main(void)
     // Make the OpenGL context current for this thread
     glfwMakeContextCurrent(window);
 
-    // Create a tinygltf model object to hold the loaded GLTF data
-    tinygltf::Model model;
-    // Create a tinygltf loader object to load the GLTF file
-    tinygltf::TinyGLTF loader;
-    // Strings to hold error and warning messages from the loader
-    std::string err, warn;
-
-    // Load the GLTF model from file (ASCII format)
-    if(!loader.LoadASCIIFromFile(&model, &err, &warn, gltfFileName)){
-        // If loading failed, print error and warning messages
-        std::cerr << "Failed to load gltf file" << gltfFileName << "\n";    
-        std::cerr << "Error: " << err << std::endl; 
-        std::cerr << "Warning: " << warn << std::endl;
-        return 1;
-    }
-
-    // Load mesh data from the GLTF model (using mesh index 0)
-    unsigned int meshId = 0;
-    loadMesh(windowContext, model, meshId);
-
-    // Get the directory of the GLTF file (for loading shaders from the same folder)
-    std::filesystem::path gltfPath = gltfFileName;
-    std::filesystem::path gltfDirectory = gltfPath.parent_path();
-
-    // Load material (shaders) for the mesh (using material index 0)
-    loadMaterial(windowContext, model, gltfDirectory, 0);
+    // Settings of the mesh build, the cache is rebuilt whenever they change
+    SceneLoadRequest loadRequest;
+    loadRequest.gltfPath = gltfFileName;
+    loadRequest.cacheDirectory = kMeshCacheDirectory;
+    // Reorder triangles and vertices for the GPU caches; this only costs load time on a cache miss
+    loadRequest.buildOptions.optimizeMeshes = true;
+    // Quantized attributes take 16 bytes per vertex instead of 32; shaders decode them with the prelude helpers
+    loadRequest.buildOptions.quantization.positions = true;
+    loadRequest.buildOptions.quantization.normalBits = 8;
+    loadRequest.buildOptions.quantization.texCoords = TexCoordFormat::Unorm16;
+    loadRequest.buildOptions.quantization.weightBits = 8;
+    // Small textures (icons, decals) share atlases, the draws of their materials batch together
+    loadRequest.buildOptions.textureAtlas.enabled = true;
+    // Every rigid primitive gets up to 3 simplified levels, drawn once their error falls under a pixel
+    loadRequest.buildOptions.lodLevels = 3;
+    // Full-detail primitives are culled per meshlet, which drops the side of the model facing away from the camera
+    loadRequest.buildOptions.buildMeshlets = true;
+#if defined(USE_DEBUG_LOG)
+    // Clicks and touches are mapped to the triangles under them and logged, nothing else uses the picking BVH yet
+    loadRequest.pickingBvh = true;
+#endif
+    // Compressed texture formats of the GPU, Basis Universal textures are transcoded to the best of them
+    loadRequest.textureFormats = detectTextureFormatSupport();
+
+    // Load the scene on the worker threads (cache or GLTF parsing, mesh build, shader files),
+    // the window keeps presenting frames in the meantime
+    std::future<std::unique_ptr<LoadedScene>> pendingScene = loadSceneAsync(loadRequest);
+    // Loaded scene, its CPU data is released once its buffers are uploaded
+    std::unique_ptr<LoadedScene> scene;
+    // GL uploads waiting for the render thread, spread over several frames
+    GpuUploadQueue uploadQueue;
+    UploadBudget uploadBudget;
+    bool sceneReady = false;
+    // Flattened node hierarchy, its world matrices follow the animations
+    SceneGraph sceneGraph;
+    // Animation playback, the clock starts when the scene is first drawn
+    AnimationState animationState;
+    std::chrono::steady_clock::time_point animationStart;
+#if defined(USE_DEBUG_LOG)
+    // Pointer state of the previous frame, a pick happens when the button goes down
+    bool pointerPressed = false;
+    // Uniform bytes per frame last printed
+    size_t reportedUniformBytes = 0;
+#endif
 
     // Main render loop: runs until the window is closed
     while (!glfwWindowShouldClose(window))
     {
+        // Once the loader is done, create the GL objects and queue the buffer contents and shader compilations
+        if (pendingScene.valid() &&
+            pendingScene.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+        {
+            scene = pendingScene.get();
+            if (!scene)
+            {
+                glfwTerminate();
+                return 1;
+            }
+            queueMeshDataUpload(windowContext, scene->meshData, uploadQueue);
+            queueTextureUploads(windowContext, scene->textures, uploadQueue);
+            buildSceneGraph(scene->meshData.nodes, sceneGraph);
+            createNodeMatrixTexture(windowContext.gl.nodeMatrices, sceneGraph);
+            initDrawCulling(windowContext.gl.culling, windowContext.gl.draws, sceneGraph);
+            initDrawLods(windowContext.gl.lodState, windowContext.gl.draws, windowContext.gl.lodDraws);
+            windowContext.gl.gpuBufferBytes += initMeshletCulling(windowContext.gl.meshletCulling, windowContext.gl.indexRing,
+                                                                  scene->meshData);
+            windowContext.gl.materials.resize(scene->materials.size());
+            for (size_t materialId = 0; materialId < scene->materials.size(); materialId++)
+            {
+                uploadQueue.queueTask([&windowContext, &scene, materialId]() {
+                    createMaterial(windowContext.gl.materials[materialId], scene->materials[materialId],
+                                   scene->shaderSources[materialId], scene->vertexShaderPrelude);
+                });
+            }
+        }
+
+        // Issue the queued uploads within the frame budget, the scene is drawn once all of them are done
+        if (scene && !sceneReady)
+        {
+            sceneReady = uploadQueue.process(uploadBudget);
+            if (sceneReady)
+            {
+                // The GPU now has its own copy, drop the CPU one (unless the scene asked for CPU access)
+                MemoryStats memoryStats;
+                memoryStats.gpuBufferBytes = windowContext.gl.gpuBufferBytes;
+                memoryStats.textureBytes = windowContext.gl.textureBytes;
+                addLoadedSceneMemory(*scene, memoryStats);
+                memoryStats.cpuStagingBytes += getMeshletCullingMemory(windowContext.gl.meshletCulling);
+                printMemoryReport("after upload", memoryStats);
+
+                releaseLoadedSceneCpuData(*scene);
+                memoryStats = MemoryStats();
+                memoryStats.gpuBufferBytes = windowContext.gl.gpuBufferBytes;
+                memoryStats.textureBytes = windowContext.gl.textureBytes;
+                addLoadedSceneMemory(*scene, memoryStats);
+                memoryStats.cpuStagingBytes += getMeshletCullingMemory(windowContext.gl.meshletCulling);
+                printMemoryReport("resident", memoryStats);
+                animationStart = std::chrono::steady_clock::now();
+            }
+        }
+
         // Set the clear color to white (RGBA)
         glClearColor(1.0F, 1.0F, 1.0F, 1.0F);
         // Clear the color buffer (erase previous frame)
         glClear(GL_COLOR_BUFFER_BIT);
 
-        // Use the shader program for rendering
-        glUseProgram(windowContext.gl.program);
-        // Bind the VAO (vertex array object) for the mesh
-        glBindVertexArray(windowContext.gl.vertexArrayObject);
-        // Bind the index buffer for drawing
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, windowContext.gl.indexBuffer);
+        // Submit the draw list, it is sorted by material so each program is bound once,
+        // the VAO of each vertex segment (with the index buffer) is bound by submitDraws
+        if (sceneReady)
+        {
+            // Every animation of the asset plays in a loop and writes the local transforms of its nodes
+            float animationTime = std::chrono::duration<float>(std::chrono::steady_clock::now() - animationStart).count();
+            for (uint32_t animation = 0; animation < scene->meshData.animations.size(); animation++)
+            {
+                sampleAnimation(scene->meshData, animation, animationTime, animationState, sceneGraph,
+                                scene->meshData.morphWeights);
+            }
+
+            // World matrices of the moved subtrees, then the boxes of their draws and the joint matrices;
+            // nothing is recomputed or uploaded for a still scene
+            if (updateSceneGraph(sceneGraph))
+            {
+                updateDrawWorldBounds(windowContext.gl.culling, windowContext.gl.draws, sceneGraph);
+                uploadNodeMatrices(windowContext.gl.nodeMatrices, sceneGraph);
+                updateJointPalette(windowContext.gl.jointPalette, scene->meshData, sceneGraph);
+            }
 
-        materialSetProperty(windowContext.gl, "iTime", getcurrentTime());   // Example of setting a uniform property (time)
-        materialUpdateProperties(windowContext.gl);  // Update material properties (uniforms) before rendering
+            // Draws small on screen use a simplified index range, then only the draws whose box touches
+            // the view frustum are submitted
+            int framebufferWidth, framebufferHeight;
+            glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+            selectDrawLods(windowContext.gl.lodState, windowContext.gl.culling, windowContext.gl.draws, windowContext.gl.lods,
+                           windowContext.gl.viewProjection, static_cast<float>(framebufferWidth),
+                           static_cast<float>(framebufferHeight), windowContext.gl.lodDraws);
+            Frustum frustum;
+            extractFrustumPlanes(windowContext.gl.viewProjection, frustum);
+            cullDraws(windowContext.gl.culling, frustum, windowContext.gl.lodDraws, windowContext.gl.visibleDraws);
+
+            // Copies of a primitive are drawn as the instances of one draw
+            buildInstancedDraws(windowContext.gl.visibleDraws, scene->meshData, sceneGraph, windowContext.gl.instancedDraws);
+            uploadInstanceMatrices(windowContext.gl.instanceBuffer, windowContext.gl.instancedDraws);
+
+            // Full-detail draws keep only their meshlets in the frustum and facing the camera
+            cullMeshlets(windowContext.gl.meshletCulling, windowContext.gl.indexRing, scene->meshData, sceneGraph,
+                         windowContext.gl.viewProjection, windowContext.gl.instancedDraws);
+            submitDraws(windowContext.gl, windowContext.gl.instancedDraws, scene->meshData, sceneGraph, getcurrentTime());
+            fenceIndexRing(windowContext.gl.indexRing);
+
+#if defined(USE_DEBUG_LOG)
+            // Report the uniform traffic when it changes, a still scene only sends its animated values
+            if (windowContext.gl.uniformUploadBytes != reportedUniformBytes)
+            {
+                std::cout << "Uniforms: " << windowContext.gl.uniformUploadBytes << " bytes uploaded per frame" << std::endl;
+                reportedUniformBytes = windowContext.gl.uniformUploadBytes;
+            }
 
-        // Draw the mesh using the index buffer (GL_TRIANGLES mode)
-        glDrawElements(GL_TRIANGLES, windowContext.gl.indicesCount, GL_UNSIGNED_SHORT, nullptr);
-    
+            // Report what is under a click or touch (the BVH holds the rest pose of the scene)
+            bool pressed = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+            if (pressed && !pointerPressed)
+            {
+                double cursorX, cursorY;
+                int windowWidth, windowHeight;
+                glfwGetCursorPos(window, &cursorX, &cursorY);
+                glfwGetWindowSize(window, &windowWidth, &windowHeight);
+                float point[2] = { static_cast<float>(cursorX), static_cast<float>(cursorY) };
+                RayHit hit;
+                pickScreenPoints(scene->pickingBvh, windowContext.gl.viewProjection, static_cast<float>(windowWidth),
+                                 static_cast<float>(windowHeight), point, 1, &hit);
+                if (hit.draw != kNoRayHit)
+                {
+                    std::cout << "Picked node " << hit.node << " (instance " << hit.instance << "), draw " << hit.draw
+                              << ", triangle " << hit.triangle
+                              << " (barycentrics " << hit.barycentrics[0] << ", " << hit.barycentrics[1] << ")" << std::endl;
+                }
+            }
+            pointerPressed = pressed;
+#endif
+        }
 
         // Swap the front and back buffers (display the rendered image)
         glfwSwapBuffers(window);
@@ -0,0 +1,39 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <filesystem>
+
+// Read-only memory mapping of a whole file.
+// The mapped pages are handed to glBufferData directly, so asset bytes are
+// never copied into an intermediate heap buffer on the CPU side.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    // Map the file at the given path, returns false if it cannot be opened or mapped
+    bool open(const std::filesystem::path& path);
+    // Unmap the file and release the OS handles
+    void close();
+
+    bool isOpen() const { return data_ != nullptr; }
+    const unsigned char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const unsigned char* data_ = nullptr;   // Start of the mapped view
+    size_t size_ = 0;                       // Size of the mapped view in bytes
+#ifdef _WIN32
+    void* fileHandle_ = nullptr;            // Win32 file HANDLE
+    void* mappingHandle_ = nullptr;         // Win32 file mapping HANDLE
+#endif
+};
+
+#endif // MAPPED_FILE_HPP
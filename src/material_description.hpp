@@ -0,0 +1,69 @@
+#ifndef MATERIAL_DESCRIPTION_HPP
+#define MATERIAL_DESCRIPTION_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "basic_types.hpp"
+
+// Types of the uniforms declared in a material's "shader" extras
+enum class MaterialUniformType : uint32_t
+{
+    Float,
+    Int,
+    Vector2,
+    Vector3,
+    Vector4,
+    Sampler2D,      // Texture of the scene, bound to a texture unit when the material is drawn
+    Matrix4         // 4x4 float matrix, only found by reflection (built-in uniforms), materials do not declare it
+};
+
+// Sampler uniform of the base color texture of a glTF material (pbrMetallicRoughness.baseColorTexture)
+const char* const kBaseColorTextureUniform = "uBaseColorTexture";
+
+// Initial value of one material uniform.
+// Plain data: the name lives in the uniformNames pool of the material, so a uniform table is
+// built without one allocation per uniform and is stored in the mesh cache as raw bytes
+struct MaterialUniform
+{
+    uint32_t nameOffset;            // Offset of the null-terminated name in MaterialDescription::uniformNames
+    MaterialUniformType type;       // Uniform type
+    float values[4];                // Components for the float and vector types
+    int32_t intValue;               // Value for the Int type, texture index for the Sampler2D type
+};
+
+// Images and sampler state of one glTF texture, independent from tinygltf
+struct TextureDescription
+{
+    FileRange image;                // KTX2 container or PNG / JPEG file
+    FileRange fallbackImage;        // Image loaded when the first one cannot be used (empty path: none)
+    int32_t minFilter = -1;         // glTF sampler filters and wrap modes (GL enums), -1 for the default
+    int32_t magFilter = -1;
+    int32_t wrapS = -1;
+    int32_t wrapT = -1;
+    bool srgb = false;              // Holds colors, decoded images are uploaded as sRGB
+    bool isAtlas = false;           // Atlas composed at load time from the images placed in it (no image of its own)
+    uint32_t width = 0;             // Size of the image when it is known at build time (atlases and their images)
+    uint32_t height = 0;
+    int32_t atlas = -1;             // Atlas holding the image (index in the textures), -1 if it is a texture of its own
+    uint32_t atlasX = 0;            // Top-left texel of the image in its atlas
+    uint32_t atlasY = 0;
+};
+
+// Shader paths and uniforms of a material, independent from tinygltf
+struct MaterialDescription
+{
+    bool fromAsset = false;                 // False when the asset has no such material (defaults are used)
+    std::string vertexShaderPath;           // Vertex shader file, empty for the default shader
+    std::string fragmentShaderPath;         // Fragment shader file, empty for the default shader
+    std::vector<MaterialUniform> uniforms;  // Uniforms declared by the material
+    std::string uniformNames;               // Names of the uniforms, each followed by a null character
+};
+
+// Function to get the name of a uniform of a material
+inline const char* getMaterialUniformName(const MaterialDescription& material, const MaterialUniform& uniform)
+{
+    return material.uniformNames.c_str() + uniform.nameOffset;
+}
+
+#endif // MATERIAL_DESCRIPTION_HPP
@@ -0,0 +1,241 @@
+#include "material_reader.hpp"
+
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace
+{
+    // Uniform types accepted in the "type" field, with their number of components
+    struct UniformTypeName
+    {
+        const char* name;
+        MaterialUniformType type;
+        size_t componentCount;
+    };
+    const UniformTypeName kUniformTypeNames[] = {
+        { "Float", MaterialUniformType::Float, 1 },
+        { "Vector2", MaterialUniformType::Vector2, 2 },
+        { "Vector3", MaterialUniformType::Vector3, 3 },
+        { "Vector4", MaterialUniformType::Vector4, 4 },
+        { "Int", MaterialUniformType::Int, 1 },
+        { "Sampler2D", MaterialUniformType::Sampler2D, 1 },     // Value: index of a glTF texture
+    };
+
+    // Function to append a uniform to the table of a material, with its name (nameLength characters) in the name pool
+    void appendMaterialUniform(MaterialDescription& material, MaterialUniform uniform, const char* name, size_t nameLength)
+    {
+        uniform.nameOffset = static_cast<uint32_t>(material.uniformNames.size());
+        material.uniformNames.append(name, nameLength);
+        material.uniformNames.push_back('\0');
+        material.uniforms.push_back(uniform);
+    }
+
+    // Function to get the image of a texture that the loader should try first and its fallback.
+    // KHR_texture_basisu points at a KTX2 image and keeps source for viewers without KTX2 support
+    void getTextureImages(const tinygltf::Texture& texture, int& image, int& fallbackImage)
+    {
+        image = texture.source;
+        fallbackImage = -1;
+        auto basisu = texture.extensions.find("KHR_texture_basisu");
+        if (basisu != texture.extensions.end() && basisu->second.Has("source") &&
+            basisu->second.Get("source").IsNumber())
+        {
+            image = basisu->second.Get("source").GetNumberAsInt();
+            fallbackImage = texture.source;
+        }
+    }
+
+    // Function to get the i-th number of a uniform value, which is either an array or a single number
+    // JSON integers are stored as ints by tinygltf, GetNumberAsDouble accepts both representations
+    const tinygltf::Value* getUniformComponent(const tinygltf::Value& value, size_t componentIdx)
+    {
+        if (value.IsArray())
+        {
+            const tinygltf::Value::Array& components = value.Get<tinygltf::Value::Array>();
+            if (componentIdx < components.size() && components[componentIdx].IsNumber())
+            {
+                return &components[componentIdx];
+            }
+            return nullptr;
+        }
+        return componentIdx == 0 && value.IsNumber() ? &value : nullptr;
+    }
+
+    // Function to append one entry of the "uniforms" array to the uniform table of a material
+    void readMaterialUniform(const tinygltf::Value& entry, MaterialDescription& material)
+    {
+        if (!entry.IsObject())
+        {
+            return;
+        }
+
+        // Single pass over the members, keeping pointers into the document
+        const std::string* name = nullptr;
+        const std::string* typeName = nullptr;
+        const tinygltf::Value* value = nullptr;
+        for (const auto& member : entry.Get<tinygltf::Value::Object>())
+        {
+            if (member.first == "name" && member.second.IsString())
+            {
+                name = &member.second.Get<std::string>();
+            }
+            else if (member.first == "type" && member.second.IsString())
+            {
+                typeName = &member.second.Get<std::string>();
+            }
+            else if (member.first == "value")
+            {
+                value = &member.second;
+            }
+        }
+        if (!typeName)
+        {
+            return;
+        }
+
+        const UniformTypeName* type = nullptr;
+        for (const UniformTypeName& candidate : kUniformTypeNames)
+        {
+            if (*typeName == candidate.name)
+            {
+                type = &candidate;
+                break;
+            }
+        }
+        if (!type)
+        {
+            std::cerr << "Unsupported uniform type: " << *typeName << " for uniform: " << (name ? *name : std::string()) << std::endl;
+            return;
+        }
+
+        MaterialUniform uniform = {};
+        uniform.type = type->type;
+        for (size_t component = 0; component < type->componentCount; component++)
+        {
+            const tinygltf::Value* number = value ? getUniformComponent(*value, component) : nullptr;
+            if (!number)
+            {
+                return;     // Too few components, the uniform is ignored
+            }
+            if (type->type == MaterialUniformType::Int || type->type == MaterialUniformType::Sampler2D)
+            {
+                uniform.intValue = number->GetNumberAsInt();
+            }
+            else
+            {
+                uniform.values[component] = static_cast<float>(number->GetNumberAsDouble());
+            }
+        }
+
+        appendMaterialUniform(material, uniform, name ? name->data() : "", name ? name->size() : 0);
+    }
+
+    // Function to read the "shader" object of a material's extras
+    void readMaterialShader(const tinygltf::Value& shader, const std::string& directoryPrefix, MaterialDescription& material)
+    {
+        if (!shader.IsObject())
+        {
+            return;
+        }
+        for (const auto& member : shader.Get<tinygltf::Value::Object>())
+        {
+            const tinygltf::Value& field = member.second;
+            if (member.first == "vertex" && field.IsString())
+            {
+                material.vertexShaderPath = directoryPrefix + field.Get<std::string>();
+            }
+            else if (member.first == "fragment" && field.IsString())
+            {
+                material.fragmentShaderPath = directoryPrefix + field.Get<std::string>();
+            }
+            else if (member.first == "uniforms" && field.IsArray())
+            {
+                const tinygltf::Value::Array& uniforms = field.Get<tinygltf::Value::Array>();
+                material.uniforms.reserve(uniforms.size());
+                for (const tinygltf::Value& entry : uniforms)
+                {
+                    readMaterialUniform(entry, material);
+                }
+            }
+        }
+    }
+}
+
+void readMaterialDescriptions(const tinygltf::Model& model, const std::filesystem::path& gltfDirectory,
+                              std::vector<MaterialDescription>& materials)
+{
+    // Shaders are loaded from the same folder as the GLTF file, the prefix is built once for all materials
+    std::string directoryPrefix = gltfDirectory.empty() ? std::string() : (gltfDirectory / "").string();
+
+    materials.clear();
+    materials.resize(model.materials.size() + 1);
+    for (size_t materialId = 0; materialId < model.materials.size(); materialId++)
+    {
+        MaterialDescription& material = materials[materialId];
+        material.fromAsset = true;
+
+        // The base color texture is bound to a built-in sampler uniform
+        int baseColorTexture = model.materials[materialId].pbrMetallicRoughness.baseColorTexture.index;
+        if (baseColorTexture >= 0)
+        {
+            MaterialUniform uniform = {};
+            uniform.type = MaterialUniformType::Sampler2D;
+            uniform.intValue = baseColorTexture;
+            appendMaterialUniform(material, uniform, kBaseColorTextureUniform, std::strlen(kBaseColorTextureUniform));
+        }
+
+        // Try to get custom shader file names and uniforms from the material's extras
+        const tinygltf::Value& extras = model.materials[materialId].extras;
+        if (!extras.IsObject())
+        {
+            continue;
+        }
+        for (const auto& member : extras.Get<tinygltf::Value::Object>())
+        {
+            if (member.first == "shader")
+            {
+                readMaterialShader(member.second, directoryPrefix, material);
+            }
+        }
+    }
+}
+
+void readTextureDescriptions(const tinygltf::Model& model, const std::vector<FileRange>& images,
+                             std::vector<TextureDescription>& textures)
+{
+    textures.clear();
+    textures.resize(model.textures.size());
+    auto getImage = [&](int imageIdx) {
+        return imageIdx >= 0 && static_cast<size_t>(imageIdx) < images.size() ? images[imageIdx] : FileRange();
+    };
+    for (size_t textureIdx = 0; textureIdx < model.textures.size(); textureIdx++)
+    {
+        const tinygltf::Texture& gltfTexture = model.textures[textureIdx];
+        TextureDescription& texture = textures[textureIdx];
+        int image, fallbackImage;
+        getTextureImages(gltfTexture, image, fallbackImage);
+        texture.image = getImage(image);
+        texture.fallbackImage = getImage(fallbackImage);
+        if (gltfTexture.sampler >= 0 && static_cast<size_t>(gltfTexture.sampler) < model.samplers.size())
+        {
+            const tinygltf::Sampler& sampler = model.samplers[gltfTexture.sampler];
+            texture.minFilter = sampler.minFilter;
+            texture.magFilter = sampler.magFilter;
+            texture.wrapS = sampler.wrapS;
+            texture.wrapT = sampler.wrapT;
+        }
+    }
+
+    // Color textures are stored in sRGB
+    for (const tinygltf::Material& material : model.materials)
+    {
+        for (int textureIdx : { material.pbrMetallicRoughness.baseColorTexture.index, material.emissiveTexture.index })
+        {
+            if (textureIdx >= 0 && static_cast<size_t>(textureIdx) < textures.size())
+            {
+                textures[textureIdx].srgb = true;
+            }
+        }
+    }
+}
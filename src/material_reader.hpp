@@ -0,0 +1,20 @@
+#ifndef MATERIAL_READER_HPP
+#define MATERIAL_READER_HPP
+
+#include <filesystem>
+#include <vector>
+#include "tiny_gltf.h"
+#include "material_description.hpp"
+
+// Function to read the description of every material of a model from its "shader" extras and its
+// base color texture, followed by the default material in the last slot. Shader paths are resolved against gltfDirectory.
+// Each extras tree is walked once, by reference, and matched against the expected keys
+void readMaterialDescriptions(const tinygltf::Model& model, const std::filesystem::path& gltfDirectory,
+                              std::vector<MaterialDescription>& materials);
+
+// Function to read the description of every texture of a model, indexed like model.textures.
+// images holds the location of the encoded bytes of every glTF image (see GltfAsset::images)
+void readTextureDescriptions(const tinygltf::Model& model, const std::vector<FileRange>& images,
+                             std::vector<TextureDescription>& textures);
+
+#endif // MATERIAL_READER_HPP
@@ -0,0 +1,23 @@
+#include "memory_stats.hpp"
+
+#include <iostream>
+
+namespace
+{
+    // Function to print one line of the report, in KiB
+    void printMemoryLine(const char* category, size_t bytes)
+    {
+        std::cout << "  " << category << ": " << (bytes + 1023) / 1024 << " KiB" << std::endl;
+    }
+}
+
+void printMemoryReport(const char* title, const MemoryStats& stats)
+{
+    std::cout << "Memory (" << title << ")" << std::endl;
+    printMemoryLine("CPU staging", stats.cpuStagingBytes);
+    printMemoryLine("Mapped files", stats.mappedFileBytes);
+    printMemoryLine("GPU buffers", stats.gpuBufferBytes);
+    printMemoryLine("Textures", stats.textureBytes);
+    printMemoryLine("Shader sources", stats.shaderSourceBytes);
+    printMemoryLine("Picking BVH", stats.pickingBytes);
+}
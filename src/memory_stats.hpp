@@ -0,0 +1,20 @@
+#ifndef MEMORY_STATS_HPP
+#define MEMORY_STATS_HPP
+
+#include <cstddef>
+
+// Bytes held by the application, by category
+struct MemoryStats
+{
+    size_t cpuStagingBytes = 0;     // Heap copies of GPU data (built vertex / index blobs, decoded buffer views and images, tinygltf buffers)
+    size_t mappedFileBytes = 0;     // File mappings (glTF buffers, mesh cache, KTX2 textures), clean pages the OS can drop under pressure
+    size_t gpuBufferBytes = 0;      // Vertex and index buffer storage
+    size_t textureBytes = 0;        // Texture storage
+    size_t shaderSourceBytes = 0;   // Shader sources kept on the CPU
+    size_t pickingBytes = 0;        // Picking BVH nodes and triangles
+};
+
+// Function to print a memory report, one line per category
+void printMemoryReport(const char* title, const MemoryStats& stats);
+
+#endif // MEMORY_STATS_HPP
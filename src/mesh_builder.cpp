@@ -0,0 +1,1563 @@
+#include "mesh_builder.hpp"
+#include "hash.hpp"
+#include "mesh_optimizer.hpp"
+#include "mesh_simplifier.hpp"
+#include "meshlet_builder.hpp"
+#include "thread_pool.hpp"
+#include "transform_math.hpp"
+
+#include <GLES3/gl3.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <vector>
+
+namespace
+{
+    // Largest vertex counts addressable with 8-bit and 16-bit indices.
+    // 0xFF / 0xFFFF are never used as vertex indices so the buffers stay valid if GL_PRIMITIVE_RESTART_FIXED_INDEX,
+    // which turns them into the restart index, is ever enabled.
+    const uint32_t kMaxByteIndexVertices = 0xFF;
+    const uint32_t kMaxShortIndexVertices = 0xFFFF;
+
+    // One GLTF primitive after conversion to a triangle list
+    struct PackedPrimitive
+    {
+        int mesh;                       // GLTF mesh index
+        int primitive;                  // Primitive index inside the mesh
+        uint32_t material;              // Material slot
+        uint32_t firstVertex;           // First vertex inside the shared vertex streams
+        uint32_t vertexCount;           // Number of vertices
+        uint32_t sourceVertexCount;     // Number of vertices of the GLTF primitive
+        std::vector<uint32_t> sourceVertices;   // GLTF vertex of every packed vertex (empty when not split)
+        std::vector<uint32_t> indices;  // Triangle list, relative to firstVertex
+        uint32_t segment;               // Vertex segment holding the vertices
+        uint32_t indexOffset;           // Byte offset of the first index inside the shared index buffer
+        float boundsMin[3];             // Model-space box, boundsMin[0] > boundsMax[0] when unknown
+        float boundsMax[3];
+    };
+
+    // Function to create a vertex segment starting at firstVertex, with unquantized attributes
+    VertexSegment makeVertexSegment(uint32_t firstVertex)
+    {
+        VertexSegment segment;
+        segment.firstVertex = firstVertex;
+        segment.vertexCount = 0;
+        std::fill(segment.positionDequantization, segment.positionDequantization + 16, 0.0f);
+        for (int axis = 0; axis < 4; axis++)
+        {
+            segment.positionDequantization[axis * 5] = 1.0f;
+        }
+        segment.texCoordTransform[0] = 1.0f;
+        segment.texCoordTransform[1] = 1.0f;
+        segment.texCoordTransform[2] = 0.0f;
+        segment.texCoordTransform[3] = 0.0f;
+        return segment;
+    }
+
+    // Function to get the size in bytes of a GL index type
+    uint32_t getIndexSize(uint32_t indexType)
+    {
+        return indexType == GL_UNSIGNED_INT ? 4 : (indexType == GL_UNSIGNED_SHORT ? 2 : 1);
+    }
+
+    // Function to select the smallest index type able to address a vertex segment
+    uint32_t selectIndexType(uint32_t vertexCount, uint32_t minIndexSize)
+    {
+        if (minIndexSize <= 1 && vertexCount <= kMaxByteIndexVertices)
+        {
+            return GL_UNSIGNED_BYTE;
+        }
+        if (minIndexSize <= 2 && vertexCount <= kMaxShortIndexVertices)
+        {
+            return GL_UNSIGNED_SHORT;
+        }
+        return GL_UNSIGNED_INT;
+    }
+
+    // Function to split a primitive into pieces that each reference at most maxVertices vertices.
+    // Triangles keep their order; every piece lists the GLTF vertices it uses in sourceVertices
+    void splitPrimitive(const PackedPrimitive& primitive, uint32_t maxVertices, std::vector<PackedPrimitive>& pieces)
+    {
+        const uint32_t kUnused = UINT32_MAX;
+        std::vector<uint32_t> remap(primitive.vertexCount, kUnused);   // GLTF vertex -> vertex of the current piece
+
+        PackedPrimitive piece;
+        piece.mesh = primitive.mesh;
+        piece.primitive = primitive.primitive;
+        piece.material = primitive.material;
+        piece.sourceVertexCount = primitive.vertexCount;
+        piece.segment = 0;
+        piece.indexOffset = 0;
+        auto finishPiece = [&]() {
+            for (uint32_t vertex : piece.sourceVertices)
+            {
+                remap[vertex] = kUnused;
+            }
+            piece.vertexCount = static_cast<uint32_t>(piece.sourceVertices.size());
+            pieces.push_back(piece);
+            piece.sourceVertices.clear();
+            piece.indices.clear();
+        };
+
+        for (size_t triangle = 0; triangle + 2 < primitive.indices.size(); triangle += 3)
+        {
+            uint32_t a = primitive.indices[triangle];
+            uint32_t b = primitive.indices[triangle + 1];
+            uint32_t c = primitive.indices[triangle + 2];
+            size_t newVertices = (remap[a] == kUnused) + (b != a && remap[b] == kUnused) + (c != a && c != b && remap[c] == kUnused);
+            if (piece.sourceVertices.size() + newVertices > maxVertices)
+            {
+                finishPiece();
+            }
+            for (uint32_t vertex : { a, b, c })
+            {
+                if (remap[vertex] == kUnused)
+                {
+                    remap[vertex] = static_cast<uint32_t>(piece.sourceVertices.size());
+                    piece.sourceVertices.push_back(vertex);
+                }
+                piece.indices.push_back(remap[vertex]);
+            }
+        }
+        if (!piece.indices.empty())
+        {
+            finishPiece();
+        }
+    }
+
+    // Function to collect the nodes that carry a mesh, in scene traversal order
+    std::vector<int> collectMeshNodes(const tinygltf::Model& model)
+    {
+        std::vector<int> meshNodes;
+        std::vector<char> visited(model.nodes.size(), 0);
+        std::vector<int> stack;
+
+        // Walk the default scene, or the first one; without scenes every node is a root
+        int sceneId = model.defaultScene >= 0 ? model.defaultScene : 0;
+        if (static_cast<size_t>(sceneId) < model.scenes.size())
+        {
+            const std::vector<int>& roots = model.scenes[sceneId].nodes;
+            stack.assign(roots.rbegin(), roots.rend());
+        }
+        else
+        {
+            for (int nodeId = static_cast<int>(model.nodes.size()) - 1; nodeId >= 0; nodeId--)
+            {
+                stack.push_back(nodeId);
+            }
+        }
+
+        // Depth-first, children in declaration order; malformed cyclic graphs are visited once
+        while (!stack.empty())
+        {
+            int nodeId = stack.back();
+            stack.pop_back();
+            if (nodeId < 0 || static_cast<size_t>(nodeId) >= model.nodes.size() || visited[nodeId])
+            {
+                continue;
+            }
+            visited[nodeId] = 1;
+
+            const tinygltf::Node& node = model.nodes[nodeId];
+            if (node.mesh >= 0 && static_cast<size_t>(node.mesh) < model.meshes.size())
+            {
+                meshNodes.push_back(nodeId);
+            }
+            for (auto child = node.children.rbegin(); child != node.children.rend(); ++child)
+            {
+                stack.push_back(*child);
+            }
+        }
+        return meshNodes;
+    }
+
+    // Function to read the indices of a primitive and convert strips and fans to a triangle list
+    bool readTriangleList(const GltfAsset& asset, const tinygltf::Primitive& primitive, uint32_t vertexCount,
+                          std::vector<uint32_t>& triangles)
+    {
+        // Non-indexed primitives use their vertices in order
+        std::vector<uint32_t> indices;
+        if (primitive.indices >= 0)
+        {
+            if (static_cast<size_t>(primitive.indices) >= asset.model.accessors.size())
+            {
+                return false;
+            }
+            indices.resize(asset.model.accessors[primitive.indices].count);
+            if (!readAccessorIndices(asset, primitive.indices, indices.data()))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            indices.resize(vertexCount);
+            for (uint32_t vertex = 0; vertex < vertexCount; vertex++)
+            {
+                indices[vertex] = vertex;
+            }
+        }
+
+        switch (primitive.mode)
+        {
+        case -1:
+        case TINYGLTF_MODE_TRIANGLES:
+            indices.resize(indices.size() - indices.size() % 3);
+            triangles = std::move(indices);
+            break;
+        case TINYGLTF_MODE_TRIANGLE_STRIP:
+            triangles.clear();
+            for (size_t i = 2; i < indices.size(); i++)
+            {
+                // Every other triangle of a strip has its winding flipped
+                if (i % 2 == 0)
+                {
+                    triangles.insert(triangles.end(), { indices[i - 2], indices[i - 1], indices[i] });
+                }
+                else
+                {
+                    triangles.insert(triangles.end(), { indices[i - 1], indices[i - 2], indices[i] });
+                }
+            }
+            break;
+        case TINYGLTF_MODE_TRIANGLE_FAN:
+            triangles.clear();
+            for (size_t i = 2; i < indices.size(); i++)
+            {
+                triangles.insert(triangles.end(), { indices[0], indices[i - 1], indices[i] });
+            }
+            break;
+        default:
+            // Points and lines are not rendered
+            return false;
+        }
+
+        // Reject indices pointing past the primitive's vertices
+        for (uint32_t index : triangles)
+        {
+            if (index >= vertexCount)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Function to tell whether a GLTF primitive carries skinning attributes
+    bool hasSkinAttributes(const tinygltf::Primitive& primitive)
+    {
+        return primitive.attributes.count("JOINTS_0") && primitive.attributes.count("WEIGHTS_0");
+    }
+
+    // Function to read the hierarchy, local transform and morph target weights of every node; matrices are split into T, R, S
+    void readSceneNodes(const tinygltf::Model& model, MeshData& meshData)
+    {
+        std::vector<SceneNode>& nodes = meshData.nodes;
+        nodes.resize(model.nodes.size());
+        for (size_t nodeId = 0; nodeId < model.nodes.size(); nodeId++)
+        {
+            const tinygltf::Node& gltfNode = model.nodes[nodeId];
+            SceneNode& node = nodes[nodeId];
+            node.parent = -1;
+            float identityRotation[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+            std::fill(node.translation, node.translation + 3, 0.0f);
+            std::copy(identityRotation, identityRotation + 4, node.rotation);
+            std::fill(node.scale, node.scale + 3, 1.0f);
+
+            // One weight per morph target of the mesh, from the node or else from the mesh (default 0)
+            node.firstMorphWeight = static_cast<uint32_t>(meshData.morphWeights.size());
+            node.morphWeightCount = 0;
+            if (gltfNode.mesh >= 0 && static_cast<size_t>(gltfNode.mesh) < model.meshes.size())
+            {
+                const tinygltf::Mesh& mesh = model.meshes[gltfNode.mesh];
+                for (const tinygltf::Primitive& primitive : mesh.primitives)
+                {
+                    node.morphWeightCount = std::max(node.morphWeightCount, static_cast<uint32_t>(primitive.targets.size()));
+                }
+                const std::vector<double>& weights = gltfNode.weights.empty() ? mesh.weights : gltfNode.weights;
+                for (uint32_t target = 0; target < node.morphWeightCount; target++)
+                {
+                    meshData.morphWeights.push_back(target < weights.size() ? static_cast<float>(weights[target]) : 0.0f);
+                }
+            }
+
+            if (gltfNode.matrix.size() == 16)
+            {
+                float matrix[16];
+                std::copy(gltfNode.matrix.begin(), gltfNode.matrix.end(), matrix);
+                decomposeMatrix(matrix, node.translation, node.rotation, node.scale);
+                continue;
+            }
+            if (gltfNode.translation.size() == 3)
+            {
+                std::copy(gltfNode.translation.begin(), gltfNode.translation.end(), node.translation);
+            }
+            if (gltfNode.rotation.size() == 4)
+            {
+                std::copy(gltfNode.rotation.begin(), gltfNode.rotation.end(), node.rotation);
+            }
+            if (gltfNode.scale.size() == 3)
+            {
+                std::copy(gltfNode.scale.begin(), gltfNode.scale.end(), node.scale);
+            }
+        }
+
+        // A node has at most one parent; malformed graphs keep the first one found
+        for (size_t nodeId = 0; nodeId < model.nodes.size(); nodeId++)
+        {
+            for (int child : model.nodes[nodeId].children)
+            {
+                if (child >= 0 && static_cast<size_t>(child) < nodes.size() && static_cast<size_t>(child) != nodeId &&
+                    nodes[child].parent < 0)
+                {
+                    nodes[child].parent = static_cast<int32_t>(nodeId);
+                }
+            }
+        }
+    }
+
+    // Function to read the instance transforms of the nodes using EXT_mesh_gpu_instancing, as local matrices.
+    // Attributes missing from the extension keep their default (no translation or rotation, unit scale)
+    bool readNodeInstances(const GltfAsset& asset, MeshData& meshData)
+    {
+        const tinygltf::Model& model = asset.model;
+        const char* attributeNames[] = { "TRANSLATION", "ROTATION", "SCALE" };
+        const size_t componentCounts[] = { 3, 4, 3 };
+        for (size_t nodeId = 0; nodeId < model.nodes.size(); nodeId++)
+        {
+            const tinygltf::Node& gltfNode = model.nodes[nodeId];
+            SceneNode& node = meshData.nodes[nodeId];
+            node.firstInstance = static_cast<uint32_t>(meshData.instanceMatrices.size() / 16);
+            node.instanceCount = 0;
+            auto extension = gltfNode.extensions.find("EXT_mesh_gpu_instancing");
+            if (gltfNode.mesh < 0 || extension == gltfNode.extensions.end() || !extension->second.Has("attributes"))
+            {
+                continue;
+            }
+
+            // Every attribute holds one element per instance
+            const tinygltf::Value& attributes = extension->second.Get("attributes");
+            int accessors[3] = { -1, -1, -1 };
+            size_t instanceCount = 0;
+            bool valid = true;
+            for (int attribute = 0; attribute < 3 && valid; attribute++)
+            {
+                if (!attributes.Has(attributeNames[attribute]))
+                {
+                    continue;
+                }
+                const tinygltf::Value& accessor = attributes.Get(attributeNames[attribute]);
+                valid = accessor.IsNumber() && accessor.GetNumberAsInt() >= 0 &&
+                        static_cast<size_t>(accessor.GetNumberAsInt()) < model.accessors.size();
+                if (valid)
+                {
+                    accessors[attribute] = accessor.GetNumberAsInt();
+                    size_t count = model.accessors[accessors[attribute]].count;
+                    valid = instanceCount == 0 || count == instanceCount;
+                    instanceCount = count;
+                }
+            }
+            std::vector<float> components[3];
+            float defaults[3][4] = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 1.0f, 1.0f, 1.0f } };
+            for (int attribute = 0; attribute < 3 && valid; attribute++)
+            {
+                size_t componentCount = componentCounts[attribute];
+                components[attribute].resize(instanceCount * componentCount);
+                for (size_t instance = 0; instance < instanceCount; instance++)
+                {
+                    std::copy(defaults[attribute], defaults[attribute] + componentCount, &components[attribute][instance * componentCount]);
+                }
+                valid = accessors[attribute] < 0 ||
+                        readAccessorFloats(asset, accessors[attribute], components[attribute].data(), componentCount, componentCount);
+            }
+            if (!valid)
+            {
+                std::cerr << "Invalid EXT_mesh_gpu_instancing attributes in node " << nodeId << std::endl;
+                return false;
+            }
+
+            for (size_t instance = 0; instance < instanceCount; instance++)
+            {
+                float matrix[16];
+                composeMatrix(&components[0][instance * 3], &components[1][instance * 4], &components[2][instance * 3], matrix);
+                meshData.instanceMatrices.insert(meshData.instanceMatrices.end(), matrix, matrix + 16);
+            }
+            node.instanceCount = static_cast<uint32_t>(instanceCount);
+        }
+        return true;
+    }
+
+    // Function to grow a model-space box into the box around its copies placed by a set of instance matrices
+    void getInstancedBounds(const float* matrices, uint32_t instanceCount, float boundsMin[3], float boundsMax[3])
+    {
+        float center[3], extent[3], instancedMin[3], instancedMax[3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            center[axis] = (boundsMin[axis] + boundsMax[axis]) * 0.5f;
+            extent[axis] = (boundsMax[axis] - boundsMin[axis]) * 0.5f;
+            instancedMin[axis] = FLT_MAX;
+            instancedMax[axis] = -FLT_MAX;
+        }
+        for (uint32_t instance = 0; instance < instanceCount; instance++)
+        {
+            const float* matrix = matrices + static_cast<size_t>(instance) * 16;
+            for (int row = 0; row < 3; row++)
+            {
+                float instanceCenter = matrix[12 + row];
+                float instanceExtent = 0.0f;
+                for (int column = 0; column < 3; column++)
+                {
+                    instanceCenter += matrix[column * 4 + row] * center[column];
+                    instanceExtent += std::fabs(matrix[column * 4 + row]) * extent[column];
+                }
+                instancedMin[row] = std::min(instancedMin[row], instanceCenter - instanceExtent);
+                instancedMax[row] = std::max(instancedMax[row], instanceCenter + instanceExtent);
+            }
+        }
+        std::copy(instancedMin, instancedMin + 3, boundsMin);
+        std::copy(instancedMax, instancedMax + 3, boundsMax);
+    }
+
+    // Function to read the joints and inverse bind matrices of every skin
+    bool readSkins(const GltfAsset& asset, MeshData& meshData)
+    {
+        const tinygltf::Model& model = asset.model;
+        for (size_t skinId = 0; skinId < model.skins.size(); skinId++)
+        {
+            const tinygltf::Skin& gltfSkin = model.skins[skinId];
+            Skin skin;
+            skin.firstJoint = static_cast<uint32_t>(meshData.skinJoints.size());
+            skin.jointCount = static_cast<uint32_t>(gltfSkin.joints.size());
+            for (int joint : gltfSkin.joints)
+            {
+                if (joint < 0 || static_cast<size_t>(joint) >= model.nodes.size())
+                {
+                    std::cerr << "Invalid joint " << joint << " in skin " << skinId << std::endl;
+                    return false;
+                }
+                meshData.skinJoints.push_back(static_cast<uint32_t>(joint));
+            }
+
+            // Without inverse bind matrices every joint uses the identity
+            size_t firstMatrix = meshData.inverseBindMatrices.size();
+            meshData.inverseBindMatrices.resize(firstMatrix + static_cast<size_t>(skin.jointCount) * 16, 0.0f);
+            float* matrices = &meshData.inverseBindMatrices[firstMatrix];
+            int accessor = gltfSkin.inverseBindMatrices;
+            if (accessor >= 0)
+            {
+                std::vector<float> values;
+                bool valid = static_cast<size_t>(accessor) < model.accessors.size() &&
+                             model.accessors[accessor].count >= skin.jointCount;
+                if (valid)
+                {
+                    values.resize(model.accessors[accessor].count * 16);
+                    valid = readAccessorFloats(asset, accessor, values.data(), 16, 16);
+                }
+                if (!valid)
+                {
+                    std::cerr << "Invalid inverseBindMatrices accessor in skin " << skinId << std::endl;
+                    return false;
+                }
+                std::copy(values.begin(), values.begin() + static_cast<size_t>(skin.jointCount) * 16, matrices);
+            }
+            else
+            {
+                for (uint32_t joint = 0; joint < skin.jointCount; joint++)
+                {
+                    setIdentityMatrix(matrices + joint * 16);
+                }
+            }
+            meshData.skins.push_back(skin);
+        }
+        return true;
+    }
+
+    // Function to read the channels of every animation into key tracks.
+    // Channels with an invalid target (unknown path, missing node, weights of a node without morph targets) or sampler are skipped
+    bool readAnimations(const GltfAsset& asset, MeshData& meshData)
+    {
+        const tinygltf::Model& model = asset.model;
+        std::map<int, uint32_t> inputKeys;     // Input accessor -> first key time, tracks sharing an input share the times
+        for (size_t animationId = 0; animationId < model.animations.size(); animationId++)
+        {
+            const tinygltf::Animation& animation = model.animations[animationId];
+            AnimationClip clip;
+            clip.firstTrack = static_cast<uint32_t>(meshData.animationTracks.size());
+            clip.startTime = 0.0f;
+            clip.endTime = 0.0f;
+            bool firstTrack = true;
+            for (const tinygltf::AnimationChannel& channel : animation.channels)
+            {
+                AnimationTrack track;
+                if (channel.target_path == "translation")
+                {
+                    track.path = AnimationPath::Translation;
+                }
+                else if (channel.target_path == "rotation")
+                {
+                    track.path = AnimationPath::Rotation;
+                }
+                else if (channel.target_path == "scale")
+                {
+                    track.path = AnimationPath::Scale;
+                }
+                else if (channel.target_path == "weights")
+                {
+                    track.path = AnimationPath::Weights;
+                }
+                else
+                {
+                    continue;
+                }
+                if (channel.target_node < 0 || static_cast<size_t>(channel.target_node) >= model.nodes.size() ||
+                    channel.sampler < 0 || static_cast<size_t>(channel.sampler) >= animation.samplers.size() ||
+                    (track.path == AnimationPath::Weights && meshData.nodes[channel.target_node].morphWeightCount == 0))
+                {
+                    continue;
+                }
+                const tinygltf::AnimationSampler& sampler = animation.samplers[channel.sampler];
+                track.node = static_cast<uint32_t>(channel.target_node);
+                track.interpolation = sampler.interpolation == "STEP" ? AnimationInterpolation::Step
+                                    : sampler.interpolation == "CUBICSPLINE" ? AnimationInterpolation::CubicSpline
+                                    : AnimationInterpolation::Linear;
+
+                // Key times, read once per input accessor
+                if (sampler.input < 0 || static_cast<size_t>(sampler.input) >= model.accessors.size() ||
+                    sampler.output < 0 || static_cast<size_t>(sampler.output) >= model.accessors.size())
+                {
+                    std::cerr << "Invalid sampler accessors in animation " << animationId << std::endl;
+                    return false;
+                }
+                track.keyCount = static_cast<uint32_t>(model.accessors[sampler.input].count);
+                auto input = inputKeys.find(sampler.input);
+                if (input == inputKeys.end())
+                {
+                    uint32_t firstKey = static_cast<uint32_t>(meshData.animationTimes.size());
+                    meshData.animationTimes.resize(firstKey + static_cast<size_t>(track.keyCount));
+                    if (track.keyCount == 0 || !readAccessorFloats(asset, sampler.input, &meshData.animationTimes[firstKey], 1, 1))
+                    {
+                        std::cerr << "Invalid input accessor in animation " << animationId << std::endl;
+                        return false;
+                    }
+                    input = inputKeys.emplace(sampler.input, firstKey).first;
+                }
+                track.firstKey = input->second;
+
+                // Key values, with their tangents for cubic splines
+                uint32_t componentCount = track.path == AnimationPath::Weights ? meshData.nodes[track.node].morphWeightCount
+                                        : track.path == AnimationPath::Rotation ? 4 : 3;
+                // Weights are scalar elements, one per target and key
+                uint32_t elementComponents = track.path == AnimationPath::Weights ? 1 : componentCount;
+                size_t valueCount = static_cast<size_t>(track.keyCount) *
+                                    (track.interpolation == AnimationInterpolation::CubicSpline ? 3 : 1);
+                if (model.accessors[sampler.output].count != valueCount * (componentCount / elementComponents))
+                {
+                    std::cerr << "Output accessor of animation " << animationId << " does not match its keys" << std::endl;
+                    return false;
+                }
+                track.firstValue = static_cast<uint32_t>(meshData.animationValues.size());
+                meshData.animationValues.resize(track.firstValue + valueCount * componentCount);
+                if (!readAccessorFloats(asset, sampler.output, &meshData.animationValues[track.firstValue], elementComponents,
+                                        elementComponents))
+                {
+                    std::cerr << "Invalid output accessor in animation " << animationId << std::endl;
+                    return false;
+                }
+
+                const float* times = &meshData.animationTimes[track.firstKey];
+                clip.startTime = firstTrack ? times[0] : std::min(clip.startTime, times[0]);
+                clip.endTime = firstTrack ? times[track.keyCount - 1] : std::max(clip.endTime, times[track.keyCount - 1]);
+                firstTrack = false;
+                meshData.animationTracks.push_back(track);
+            }
+
+            // Tracks with the same path and interpolation are sampled by the same batched kernel
+            auto firstTrackIt = meshData.animationTracks.begin() + clip.firstTrack;
+            std::stable_sort(firstTrackIt, meshData.animationTracks.end(), [](const AnimationTrack& a, const AnimationTrack& b) {
+                if (a.interpolation != b.interpolation)
+                {
+                    return a.interpolation < b.interpolation;
+                }
+                return a.path < b.path;
+            });
+            clip.trackCount = static_cast<uint32_t>(meshData.animationTracks.size()) - clip.firstTrack;
+            meshData.animations.push_back(clip);
+        }
+        return true;
+    }
+
+    // Function to pack the position and normal deltas of the morph targets of every primitive into the texels of
+    // the morph delta texture. primitiveMorphs receives the target set of each primitive (kNoMorph without targets)
+    bool packMorphTargets(const GltfAsset& asset, const std::vector<PackedPrimitive>& primitives,
+                          const std::vector<VertexSegment>& segments, MeshData& meshData, std::vector<uint32_t>& primitiveMorphs)
+    {
+        const tinygltf::Model& model = asset.model;
+        const char* const kDeltaAttributes[] = { "POSITION", "NORMAL" };
+        std::vector<float> texels;      // RGB of every texel
+        std::vector<float> deltas;
+        primitiveMorphs.assign(primitives.size(), kNoMorph);
+        for (size_t primitiveId = 0; primitiveId < primitives.size(); primitiveId++)
+        {
+            const PackedPrimitive& primitive = primitives[primitiveId];
+            const std::vector<std::map<std::string, int>>& targets = model.meshes[primitive.mesh].primitives[primitive.primitive].targets;
+            if (targets.empty())
+            {
+                continue;
+            }
+            if (targets.size() > kMaxMorphTargets)
+            {
+                std::cerr << "Mesh " << primitive.mesh << " has " << targets.size() << " morph targets, only the first "
+                          << kMaxMorphTargets << " are used" << std::endl;
+            }
+            MorphTargetSet set;
+            set.targetCount = std::min(static_cast<uint32_t>(targets.size()), kMaxMorphTargets);
+            set.texelsPerTarget = 1;
+            for (uint32_t target = 0; target < set.targetCount; target++)
+            {
+                set.texelsPerTarget = targets[target].count("NORMAL") ? 2 : set.texelsPerTarget;
+            }
+
+            // Texels are ordered by vertex, then target, then attribute; targets without an attribute keep zeros
+            size_t firstTexel = texels.size() / 3;
+            size_t texelsPerVertex = static_cast<size_t>(set.targetCount) * set.texelsPerTarget;
+            texels.resize(texels.size() + primitive.vertexCount * texelsPerVertex * 3, 0.0f);
+            for (uint32_t target = 0; target < set.targetCount; target++)
+            {
+                for (uint32_t attribute = 0; attribute < set.texelsPerTarget; attribute++)
+                {
+                    auto accessor = targets[target].find(kDeltaAttributes[attribute]);
+                    if (accessor == targets[target].end())
+                    {
+                        continue;
+                    }
+                    deltas.resize(static_cast<size_t>(primitive.sourceVertexCount) * 3);
+                    if (accessor->second < 0 || static_cast<size_t>(accessor->second) >= model.accessors.size() ||
+                        model.accessors[accessor->second].count != primitive.sourceVertexCount ||
+                        !readAccessorFloats(asset, accessor->second, deltas.data(), 3, 3))
+                    {
+                        std::cerr << "Invalid " << kDeltaAttributes[attribute] << " morph target " << target << " in mesh "
+                                  << primitive.mesh << std::endl;
+                        return false;
+                    }
+                    for (uint32_t vertex = 0; vertex < primitive.vertexCount; vertex++)
+                    {
+                        uint32_t sourceVertex = primitive.sourceVertices.empty() ? vertex : primitive.sourceVertices[vertex];
+                        size_t texel = firstTexel + vertex * texelsPerVertex + target * set.texelsPerTarget + attribute;
+                        std::memcpy(&texels[texel * 3], &deltas[sourceVertex * 3], 3 * sizeof(float));
+                    }
+                }
+            }
+
+            // gl_VertexID counts from the first vertex of the segment, not of the primitive
+            int64_t segmentVertex = primitive.firstVertex - segments[primitive.segment].firstVertex;
+            int64_t texelBase = static_cast<int64_t>(firstTexel) - segmentVertex * static_cast<int64_t>(texelsPerVertex);
+            if (texels.size() / 3 > static_cast<size_t>(INT32_MAX) || texelBase < INT32_MIN)
+            {
+                std::cerr << "Too many morph target deltas" << std::endl;
+                return false;
+            }
+            set.texelBase = static_cast<int32_t>(texelBase);
+            primitiveMorphs[primitiveId] = static_cast<uint32_t>(meshData.morphTargetSets.size());
+            meshData.morphTargetSets.push_back(set);
+        }
+
+        // The texture is uploaded in full rows
+        if (!texels.empty())
+        {
+            size_t rowFloats = static_cast<size_t>(kMorphDeltaTextureWidth) * 3;
+            texels.resize((texels.size() + rowFloats - 1) / rowFloats * rowFloats, 0.0f);
+            std::vector<unsigned char>& storage = meshData.morphDeltas.storage;
+            storage.resize(texels.size() * sizeof(float));
+            std::memcpy(storage.data(), texels.data(), storage.size());
+            meshData.morphDeltas.bytes.data = storage.data();
+            meshData.morphDeltas.bytes.size = storage.size();
+        }
+        return true;
+    }
+
+    // Function to reorder the triangles of every primitive for the post-transform cache and overdraw,
+    // then its vertices in first-use order; unreferenced vertices are dropped.
+    // Prints the ACMR / ATVR of the whole asset before and after
+    bool optimizePrimitives(const GltfAsset& asset, const MeshBuildOptions& options, std::vector<PackedPrimitive>& primitives)
+    {
+        const tinygltf::Model& model = asset.model;
+        VertexCacheStats before, after;
+        int sourceAccessor = -1;                // Accessor held in sourcePositions (split primitives share it)
+        std::vector<float> sourcePositions;
+        std::vector<float> positions;
+        std::vector<uint32_t> reordered, clusters, remap, sourceVertices;
+        for (PackedPrimitive& primitive : primitives)
+        {
+            int positionAccessor = model.meshes[primitive.mesh].primitives[primitive.primitive].attributes.at("POSITION");
+            if (positionAccessor != sourceAccessor)
+            {
+                sourcePositions.resize(model.accessors[positionAccessor].count * 3);
+                if (!readAccessorFloats(asset, positionAccessor, sourcePositions.data(), 3, 3))
+                {
+                    std::cerr << "Invalid POSITION accessor in mesh " << primitive.mesh << std::endl;
+                    return false;
+                }
+                sourceAccessor = positionAccessor;
+            }
+
+            // Positions of the packed vertices, through the split remap if any
+            positions.resize(static_cast<size_t>(primitive.vertexCount) * 3);
+            for (uint32_t vertex = 0; vertex < primitive.vertexCount; vertex++)
+            {
+                uint32_t sourceVertex = primitive.sourceVertices.empty() ? vertex : primitive.sourceVertices[vertex];
+                std::memcpy(&positions[vertex * 3], &sourcePositions[sourceVertex * 3], 3 * sizeof(float));
+            }
+
+            size_t indexCount = primitive.indices.size();
+            VertexCacheStats stats = analyzeVertexCache(primitive.indices.data(), indexCount, primitive.vertexCount, options.vertexCacheSize);
+            before.triangleCount += stats.triangleCount;
+            before.vertexCount += stats.vertexCount;
+            before.transformCount += stats.transformCount;
+
+            // Triangle order: vertex cache first, then clusters sorted for overdraw
+            reordered.resize(indexCount);
+            optimizeVertexCache(reordered.data(), primitive.indices.data(), indexCount, primitive.vertexCount,
+                                options.vertexCacheSize, clusters);
+            optimizeOverdraw(primitive.indices.data(), reordered.data(), indexCount, positions.data(), 3, primitive.vertexCount,
+                             clusters, options.vertexCacheSize, options.overdrawThreshold);
+
+            // Vertex order: first use by the new triangle order
+            remap.resize(primitive.vertexCount);
+            size_t usedVertices = optimizeVertexFetchRemap(remap.data(), primitive.indices.data(), indexCount, primitive.vertexCount);
+            sourceVertices.assign(usedVertices, 0);
+            for (uint32_t vertex = 0; vertex < primitive.vertexCount; vertex++)
+            {
+                if (remap[vertex] != UINT32_MAX)
+                {
+                    sourceVertices[remap[vertex]] = primitive.sourceVertices.empty() ? vertex : primitive.sourceVertices[vertex];
+                }
+            }
+            for (uint32_t& index : primitive.indices)
+            {
+                index = remap[index];
+            }
+            primitive.sourceVertices.swap(sourceVertices);
+            primitive.vertexCount = static_cast<uint32_t>(usedVertices);
+
+            stats = analyzeVertexCache(primitive.indices.data(), indexCount, primitive.vertexCount, options.vertexCacheSize);
+            after.triangleCount += stats.triangleCount;
+            after.vertexCount += stats.vertexCount;
+            after.transformCount += stats.transformCount;
+        }
+
+        std::cout << "Mesh optimization (cache size " << options.vertexCacheSize << "): ACMR " << before.acmr() << " -> "
+                  << after.acmr() << ", ATVR " << before.atvr() << " -> " << after.atvr() << std::endl;
+        return true;
+    }
+
+    // Function to get the model-space box of a primitive: the bounds of its POSITION accessor when declared
+    // (they also hold for the pieces of a split primitive), else the box of its gathered positions.
+    // Morph targets widen the box by the bounds of their position displacements, for weights in [0, 1].
+    // Returns false when a morph target has no bounds
+    bool computePrimitiveBounds(const GltfAsset& asset, const PackedPrimitive& primitive, const std::vector<float>& positions,
+                                float boundsMin[3], float boundsMax[3])
+    {
+        const tinygltf::Primitive& gltfPrimitive = asset.model.meshes[primitive.mesh].primitives[primitive.primitive];
+        if (!readAccessorBounds(asset, gltfPrimitive.attributes.at("POSITION"), boundsMin, boundsMax))
+        {
+            std::fill(boundsMin, boundsMin + 3, FLT_MAX);
+            std::fill(boundsMax, boundsMax + 3, -FLT_MAX);
+            const float* position = positions.data() + static_cast<size_t>(primitive.firstVertex) * 3;
+            for (uint32_t vertex = 0; vertex < primitive.vertexCount; vertex++, position += 3)
+            {
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    boundsMin[axis] = std::min(boundsMin[axis], position[axis]);
+                    boundsMax[axis] = std::max(boundsMax[axis], position[axis]);
+                }
+            }
+        }
+        size_t targetCount = std::min(gltfPrimitive.targets.size(), static_cast<size_t>(kMaxMorphTargets));
+        for (size_t target = 0; target < targetCount; target++)
+        {
+            auto displacement = gltfPrimitive.targets[target].find("POSITION");
+            if (displacement == gltfPrimitive.targets[target].end())
+            {
+                continue;
+            }
+            float displacementMin[3], displacementMax[3];
+            if (!readAccessorBounds(asset, displacement->second, displacementMin, displacementMax))
+            {
+                return false;
+            }
+            for (int axis = 0; axis < 3; axis++)
+            {
+                boundsMin[axis] += std::min(displacementMin[axis], 0.0f);
+                boundsMax[axis] += std::max(displacementMax[axis], 0.0f);
+            }
+        }
+        return true;
+    }
+
+    // Simplified levels of a primitive, finer levels first
+    struct PrimitiveLods
+    {
+        std::vector<std::vector<uint32_t>> indices; // Triangle list of every level, relative to firstVertex
+        std::vector<float> errors;                  // Error of every level, relative to the size of the primitive
+        std::vector<uint32_t> indexOffsets;         // Byte offset of every level inside the shared index buffer
+    };
+
+    // Function to simplify every rigid primitive into up to options.lodLevels coarser levels, on the worker pool.
+    // Each level is simplified from the full-detail triangles, with the normals and texture coordinates weighing
+    // against collapses across creases and texture gradients; the chain stops at the first level that removes
+    // too few triangles or reaches the error bound
+    void buildPrimitiveLods(const GltfAsset& asset, const MeshBuildOptions& options, const std::vector<PackedPrimitive>& primitives,
+                            const std::vector<float>& positions, const std::vector<float>& normals,
+                            const std::vector<float>& texCoords, std::vector<PrimitiveLods>& lods)
+    {
+        // Weight of the squared normal and texture coordinate differences next to squared relative distances
+        const float kLodAttributeWeight = 0.01f;
+        // Primitives smaller than this are cheap enough in full
+        const size_t kMinLodTriangles = 64;
+        // A level must keep at most this fraction of the indices of the previous one
+        const float kMinLodReduction = 0.8f;
+
+        lods.assign(primitives.size(), PrimitiveLods());
+        getWorkerPool().parallelFor(primitives.size(), [&](size_t primitiveId) {
+            const PackedPrimitive& primitive = primitives[primitiveId];
+            if (primitive.indices.size() < kMinLodTriangles * 3 ||
+                hasSkinAttributes(asset.model.meshes[primitive.mesh].primitives[primitive.primitive]))
+            {
+                return;
+            }
+            std::vector<float> attributes(static_cast<size_t>(primitive.vertexCount) * 5);
+            for (uint32_t vertex = 0; vertex < primitive.vertexCount; vertex++)
+            {
+                size_t packedVertex = static_cast<size_t>(primitive.firstVertex) + vertex;
+                std::memcpy(&attributes[vertex * 5], &normals[packedVertex * 3], 3 * sizeof(float));
+                std::memcpy(&attributes[vertex * 5 + 3], &texCoords[packedVertex * 2], 2 * sizeof(float));
+            }
+
+            PrimitiveLods& primitiveLods = lods[primitiveId];
+            std::vector<uint32_t> simplified(primitive.indices.size());
+            std::vector<uint32_t> clusters;
+            size_t previousCount = primitive.indices.size();
+            float previousError = 0.0f;
+            float targetCount = static_cast<float>(primitive.indices.size() / 3);
+            for (uint32_t level = 0; level < options.lodLevels; level++)
+            {
+                targetCount *= options.lodTriangleRatio;
+                float error = 0.0f;
+                size_t count = simplifyMesh(simplified.data(), primitive.indices.data(), primitive.indices.size(),
+                                            &positions[static_cast<size_t>(primitive.firstVertex) * 3], primitive.vertexCount,
+                                            attributes.data(), 5, kLodAttributeWeight, static_cast<size_t>(targetCount) * 3,
+                                            options.lodMaxError, error);
+                if (count == 0 || static_cast<float>(count) > static_cast<float>(previousCount) * kMinLodReduction)
+                {
+                    break;
+                }
+                std::vector<uint32_t> levelIndices(simplified.begin(), simplified.begin() + count);
+                if (options.optimizeMeshes)
+                {
+                    optimizeVertexCache(levelIndices.data(), simplified.data(), count, primitive.vertexCount,
+                                        options.vertexCacheSize, clusters);
+                }
+                // Coarser levels never claim a smaller error, the selection walks the chain in order
+                previousError = std::max(previousError, error);
+                previousCount = count;
+                primitiveLods.indices.push_back(std::move(levelIndices));
+                primitiveLods.errors.push_back(previousError);
+            }
+        });
+    }
+
+    // Function to cut the full-detail triangles of every rigid primitive without morph targets into meshlets, on the
+    // worker pool, and append them to meshData.meshlets primitive after primitive. Skinned and morphed vertices move
+    // away from the bounds computed here; primitives fitting in a single meshlet gain nothing over the draw culling
+    void buildPrimitiveMeshlets(const GltfAsset& asset, const std::vector<PackedPrimitive>& primitives, const std::vector<float>& positions,
+                                const std::vector<uint32_t>& primitiveMorphs, MeshData& meshData,
+                                std::vector<uint32_t>& firstMeshlets, std::vector<uint32_t>& meshletCounts)
+    {
+        std::vector<std::vector<Meshlet>> meshlets(primitives.size());
+        getWorkerPool().parallelFor(primitives.size(), [&](size_t primitiveId) {
+            const PackedPrimitive& primitive = primitives[primitiveId];
+            if (primitive.indices.size() <= kMeshletMaxTriangles * 3 || primitiveMorphs[primitiveId] != kNoMorph ||
+                hasSkinAttributes(asset.model.meshes[primitive.mesh].primitives[primitive.primitive]))
+            {
+                return;
+            }
+            buildMeshlets(primitive.indices.data(), primitive.indices.size(), &positions[static_cast<size_t>(primitive.firstVertex) * 3],
+                          primitive.vertexCount, meshlets[primitiveId]);
+            if (meshlets[primitiveId].size() <= 1)
+            {
+                meshlets[primitiveId].clear();
+            }
+        });
+        for (size_t primitiveId = 0; primitiveId < primitives.size(); primitiveId++)
+        {
+            firstMeshlets[primitiveId] = static_cast<uint32_t>(meshData.meshlets.size());
+            meshletCounts[primitiveId] = static_cast<uint32_t>(meshlets[primitiveId].size());
+            meshData.meshlets.insert(meshData.meshlets.end(), meshlets[primitiveId].begin(), meshlets[primitiveId].end());
+        }
+    }
+
+    // Function to tell whether two materials are interchangeable (same shaders and uniform values)
+    bool isSameMaterial(const MaterialDescription& a, const MaterialDescription& b)
+    {
+        return a.fromAsset == b.fromAsset && a.vertexShaderPath == b.vertexShaderPath &&
+               a.fragmentShaderPath == b.fragmentShaderPath && a.uniformNames == b.uniformNames &&
+               a.uniforms.size() == b.uniforms.size() &&
+               std::memcmp(a.uniforms.data(), b.uniforms.data(), a.uniforms.size() * sizeof(MaterialUniform)) == 0;
+    }
+
+    // Function to pack the textures that qualify into atlases (see buildSceneMeshData), rewrite the texture
+    // coordinates of the primitives sampling them and merge the materials that became identical
+    void packPrimitiveTextures(const TextureAtlasOptions& options, std::vector<PackedPrimitive>& primitives,
+                               std::vector<float>& texCoords, std::vector<MaterialDescription>& materials,
+                               std::vector<TextureDescription>& textures)
+    {
+        // Texture of every material sampling exactly one; textures sampled along with others are excluded
+        std::vector<int32_t> materialTextures(materials.size(), -1);
+        std::vector<unsigned char> eligible(textures.size(), 1);
+        std::vector<unsigned char> sampled(textures.size(), 0);
+        for (size_t materialId = 0; materialId < materials.size(); materialId++)
+        {
+            std::vector<int32_t> samplers;
+            for (const MaterialUniform& uniform : materials[materialId].uniforms)
+            {
+                if (uniform.type == MaterialUniformType::Sampler2D && uniform.intValue >= 0 &&
+                    static_cast<size_t>(uniform.intValue) < textures.size())
+                {
+                    samplers.push_back(uniform.intValue);
+                }
+            }
+            if (samplers.size() == 1)
+            {
+                materialTextures[materialId] = samplers[0];
+            }
+            for (size_t samplerIdx = 0; samplers.size() > 1 && samplerIdx < samplers.size(); samplerIdx++)
+            {
+                eligible[samplers[samplerIdx]] = 0;
+            }
+        }
+
+        // Coordinates outside the image would wrap, they cannot be moved into an atlas
+        for (const PackedPrimitive& primitive : primitives)
+        {
+            int32_t texture = primitive.material < materialTextures.size() ? materialTextures[primitive.material] : -1;
+            if (texture < 0)
+            {
+                continue;
+            }
+            sampled[texture] = 1;
+            const float* first = texCoords.data() + static_cast<size_t>(primitive.firstVertex) * 2;
+            const float* last = first + static_cast<size_t>(primitive.vertexCount) * 2;
+            if (std::any_of(first, last, [](float value) { return !(value >= 0.0f && value <= 1.0f); }))
+            {
+                eligible[texture] = 0;
+            }
+        }
+
+        std::vector<uint32_t> candidates;
+        for (size_t textureId = 0; textureId < textures.size(); textureId++)
+        {
+            TextureDescription& texture = textures[textureId];
+            uint32_t width, height;
+            if (eligible[textureId] && sampled[textureId] && !texture.isAtlas && texture.fallbackImage.path.empty() &&
+                probeTextureImageSize(texture.image, width, height) && width <= options.maxImageSize &&
+                height <= options.maxImageSize)
+            {
+                texture.width = width;
+                texture.height = height;
+                candidates.push_back(static_cast<uint32_t>(textureId));
+            }
+        }
+        size_t textureCount = textures.size();
+        uint32_t packedCount = packTextureAtlases(options, candidates, textures);
+        if (packedCount == 0)
+        {
+            return;
+        }
+
+        for (const PackedPrimitive& primitive : primitives)
+        {
+            int32_t texture = primitive.material < materialTextures.size() ? materialTextures[primitive.material] : -1;
+            if (texture >= 0 && textures[texture].atlas >= 0)
+            {
+                transformAtlasTexCoords(textures[texture], textures[textures[texture].atlas],
+                                        texCoords.data() + static_cast<size_t>(primitive.firstVertex) * 2, primitive.vertexCount);
+            }
+        }
+        for (MaterialDescription& material : materials)
+        {
+            for (MaterialUniform& uniform : material.uniforms)
+            {
+                if (uniform.type == MaterialUniformType::Sampler2D && uniform.intValue >= 0 &&
+                    static_cast<size_t>(uniform.intValue) < textureCount && textures[uniform.intValue].atlas >= 0)
+                {
+                    uniform.intValue = textures[uniform.intValue].atlas;
+                }
+            }
+        }
+
+        // Primitives of merged materials get the first of them, their draws end up next to each other
+        std::vector<uint32_t> materialRemap(materials.size());
+        uint32_t mergedCount = 0;
+        for (size_t materialId = 0; materialId < materials.size(); materialId++)
+        {
+            materialRemap[materialId] = static_cast<uint32_t>(materialId);
+            for (size_t otherId = 0; otherId < materialId; otherId++)
+            {
+                if (materialRemap[otherId] == otherId && isSameMaterial(materials[otherId], materials[materialId]))
+                {
+                    materialRemap[materialId] = static_cast<uint32_t>(otherId);
+                    mergedCount++;
+                    break;
+                }
+            }
+        }
+        for (PackedPrimitive& primitive : primitives)
+        {
+            if (primitive.material < materialRemap.size())
+            {
+                primitive.material = materialRemap[primitive.material];
+            }
+        }
+
+        std::cout << "Texture atlases: " << packedCount << " textures packed into " << textures.size() - textureCount
+                  << " atlases, " << mergedCount << " materials merged" << std::endl;
+    }
+}
+
+uint64_t hashMeshBuildOptions(const MeshBuildOptions& options)
+{
+    const VertexLayoutOptions& layout = options.vertexLayout;
+    uint32_t values[] = {
+        layout.attributeAlignment,
+        layout.strideAlignment,
+        layout.separatePositionStream ? 1u : 0u,
+        layout.positionLocation,
+        static_cast<uint32_t>(layout.order.size()),
+        options.minIndexSize,
+        options.splitSegments ? 1u : 0u,
+        options.optimizeMeshes ? 1u : 0u,
+        options.vertexCacheSize,
+        options.quantization.positions ? 1u : 0u,
+        options.quantization.normalBits,
+        static_cast<uint32_t>(options.quantization.texCoords),
+        options.quantization.weightBits,
+        options.textureAtlas.enabled ? 1u : 0u,
+        options.textureAtlas.maxImageSize,
+        options.textureAtlas.atlasSize,
+        options.lodLevels,
+        options.buildMeshlets ? 1u : 0u,
+    };
+    uint64_t hash = hashBytes(values, sizeof(values), 0);
+    hash = hashBytes(&options.overdrawThreshold, sizeof(options.overdrawThreshold), hash);
+    hash = hashBytes(&options.lodTriangleRatio, sizeof(options.lodTriangleRatio), hash);
+    hash = hashBytes(&options.lodMaxError, sizeof(options.lodMaxError), hash);
+    return hashBytes(layout.order.data(), layout.order.size() * sizeof(uint32_t), hash);
+}
+
+bool buildSceneMeshData(const GltfAsset& asset, const MeshBuildOptions& options, std::vector<MaterialDescription>& materials,
+                        std::vector<TextureDescription>& textures, MeshData& meshData)
+{
+    const tinygltf::Model& model = asset.model;
+    uint32_t defaultMaterial = static_cast<uint32_t>(model.materials.size());
+    uint32_t maxSegmentVertices = options.splitSegments ? kMaxShortIndexVertices : UINT32_MAX;
+
+    // Every mesh referenced by the scene is packed once, however many nodes use it
+    std::vector<int> meshNodes = collectMeshNodes(model);
+    std::vector<PackedPrimitive> primitives;
+    std::map<int, std::vector<size_t>> meshPrimitives;
+    uint32_t vertexCount = 0;
+    for (int nodeId : meshNodes)
+    {
+        int meshId = model.nodes[nodeId].mesh;
+        if (meshPrimitives.count(meshId))
+        {
+            continue;
+        }
+        std::vector<size_t>& packedIds = meshPrimitives[meshId];
+
+        const tinygltf::Mesh& mesh = model.meshes[meshId];
+        for (size_t primitiveIdx = 0; primitiveIdx < mesh.primitives.size(); primitiveIdx++)
+        {
+            const tinygltf::Primitive& gltfPrimitive = mesh.primitives[primitiveIdx];
+            auto position = gltfPrimitive.attributes.find("POSITION");
+            if (position == gltfPrimitive.attributes.end() || position->second < 0 ||
+                static_cast<size_t>(position->second) >= model.accessors.size())
+            {
+                std::cerr << "Skipping primitive " << primitiveIdx << " of mesh " << meshId << ": no POSITION" << std::endl;
+                continue;
+            }
+
+            PackedPrimitive primitive;
+            primitive.mesh = meshId;
+            primitive.primitive = static_cast<int>(primitiveIdx);
+            primitive.material = (gltfPrimitive.material >= 0 && static_cast<uint32_t>(gltfPrimitive.material) < defaultMaterial)
+                ? gltfPrimitive.material : defaultMaterial;
+            primitive.vertexCount = static_cast<uint32_t>(model.accessors[position->second].count);
+            primitive.sourceVertexCount = primitive.vertexCount;
+            primitive.firstVertex = 0;
+            primitive.segment = 0;
+            primitive.indexOffset = 0;
+            if (!readTriangleList(asset, gltfPrimitive, primitive.vertexCount, primitive.indices))
+            {
+                std::cerr << "Skipping primitive " << primitiveIdx << " of mesh " << meshId
+                          << ": unsupported mode or invalid indices" << std::endl;
+                continue;
+            }
+
+            // Primitives too large for one segment become several pieces drawn separately
+            std::vector<PackedPrimitive> pieces;
+            if (primitive.vertexCount > maxSegmentVertices)
+            {
+                splitPrimitive(primitive, maxSegmentVertices, pieces);
+            }
+            else
+            {
+                pieces.push_back(std::move(primitive));
+            }
+            for (PackedPrimitive& piece : pieces)
+            {
+                packedIds.push_back(primitives.size());
+                primitives.push_back(std::move(piece));
+            }
+        }
+    }
+
+    // Optional reordering of the triangles and vertices of every primitive
+    if (options.optimizeMeshes && !optimizePrimitives(asset, options, primitives))
+    {
+        return false;
+    }
+
+    // Lay the vertices of the primitives out one after another
+    for (PackedPrimitive& primitive : primitives)
+    {
+        primitive.firstVertex = vertexCount;
+        vertexCount += primitive.vertexCount;
+    }
+
+    // Skinning attributes are only stored when some primitive is skinned
+    bool skinned = false;
+    for (const PackedPrimitive& primitive : primitives)
+    {
+        skinned = skinned || hasSkinAttributes(model.meshes[primitive.mesh].primitives[primitive.primitive]);
+    }
+
+    // Gather the attributes of all primitives into shared streams; missing attributes read as zero
+    std::vector<float> positions(vertexCount * 3, 0.0f);
+    std::vector<float> normals(vertexCount * 3, 0.0f);
+    std::vector<float> texCoords(vertexCount * 2, 0.0f);
+    std::vector<float> joints(skinned ? vertexCount * 4 : 0, 0.0f);
+    std::vector<float> weights(skinned ? vertexCount * 4 : 0, 0.0f);
+    struct
+    {
+        const char* name;
+        std::vector<float>* values;
+        size_t componentCount;
+        int scratchAccessor;            // Accessor currently held in scratch (split primitives read it once)
+        std::vector<float> scratch;     // Whole accessor, for split primitives
+    } streams[] = {
+        { "POSITION", &positions, 3, -1, {} },
+        { "NORMAL", &normals, 3, -1, {} },
+        { "TEXCOORD_0", &texCoords, 2, -1, {} },
+        { "JOINTS_0", &joints, 4, -1, {} },
+        { "WEIGHTS_0", &weights, 4, -1, {} },
+    };
+    for (const PackedPrimitive& primitive : primitives)
+    {
+        const std::map<std::string, int>& attributes = model.meshes[primitive.mesh].primitives[primitive.primitive].attributes;
+        for (auto& stream : streams)
+        {
+            auto attribute = attributes.find(stream.name);
+            if (attribute == attributes.end() || stream.values->empty())
+            {
+                continue;
+            }
+            // The accessor must provide one element per vertex of the primitive
+            bool valid = attribute->second >= 0 && static_cast<size_t>(attribute->second) < model.accessors.size() &&
+                         model.accessors[attribute->second].count >= primitive.sourceVertexCount;
+            float* destination = stream.values->data() + static_cast<size_t>(primitive.firstVertex) * stream.componentCount;
+            if (valid && primitive.sourceVertices.empty())
+            {
+                valid = readAccessorFloats(asset, attribute->second, destination, stream.componentCount, stream.componentCount);
+            }
+            else if (valid)
+            {
+                if (stream.scratchAccessor != attribute->second)
+                {
+                    stream.scratch.resize(model.accessors[attribute->second].count * stream.componentCount);
+                    valid = readAccessorFloats(asset, attribute->second, stream.scratch.data(), stream.componentCount, stream.componentCount);
+                    stream.scratchAccessor = valid ? attribute->second : -1;
+                }
+                for (size_t vertex = 0; valid && vertex < primitive.sourceVertices.size(); vertex++)
+                {
+                    std::memcpy(destination + vertex * stream.componentCount,
+                                stream.scratch.data() + primitive.sourceVertices[vertex] * stream.componentCount,
+                                stream.componentCount * sizeof(float));
+                }
+            }
+            if (!valid)
+            {
+                std::cerr << "Invalid " << stream.name << " accessor in mesh " << primitive.mesh << std::endl;
+                return false;
+            }
+        }
+    }
+
+    // Culling boxes, before the positions are quantized
+    for (PackedPrimitive& primitive : primitives)
+    {
+        if (!computePrimitiveBounds(asset, primitive, positions, primitive.boundsMin, primitive.boundsMax))
+        {
+            primitive.boundsMin[0] = 1.0f;
+            primitive.boundsMax[0] = -1.0f;
+        }
+    }
+
+    // Levels of detail, before the texture coordinates move into atlases
+    std::vector<PrimitiveLods> primitiveLods;
+    if (options.lodLevels > 0)
+    {
+        buildPrimitiveLods(asset, options, primitives, positions, normals, texCoords, primitiveLods);
+    }
+    else
+    {
+        primitiveLods.resize(primitives.size());
+    }
+
+    // Move the coordinates of small textures into atlases, before they are quantized per segment
+    if (options.textureAtlas.enabled)
+    {
+        packPrimitiveTextures(options.textureAtlas, primitives, texCoords, materials, textures);
+    }
+
+    // Cut the vertex streams into segments addressable with 16-bit indices; primitives never straddle two segments
+    for (PackedPrimitive& primitive : primitives)
+    {
+        if (meshData.segments.empty() ||
+            primitive.firstVertex + primitive.vertexCount - meshData.segments.back().firstVertex > maxSegmentVertices)
+        {
+            meshData.segments.push_back(makeVertexSegment(primitive.firstVertex));
+        }
+        VertexSegment& segment = meshData.segments.back();
+        segment.vertexCount = primitive.firstVertex + primitive.vertexCount - segment.firstVertex;
+        primitive.segment = static_cast<uint32_t>(meshData.segments.size() - 1);
+    }
+
+    // Quantize the attributes if requested; positions and texture coordinates are quantized over the
+    // bounds of each segment, the dequantization is applied by the shader prelude
+    const VertexQuantizationOptions& quantization = options.quantization;
+    std::vector<int16_t> quantizedPositions;
+    std::vector<unsigned char> quantizedNormals;
+    std::vector<uint16_t> quantizedTexCoords;
+    VertexLayoutBuilder layoutBuilder(options.vertexLayout);
+    if (quantization.positions)
+    {
+        quantizedPositions.resize(static_cast<size_t>(vertexCount) * 4);
+        for (VertexSegment& segment : meshData.segments)
+        {
+            quantizePositions(&positions[segment.firstVertex * 3], segment.vertexCount, &quantizedPositions[segment.firstVertex * 4],
+                              segment.positionDequantization);
+        }
+        layoutBuilder.addAttribute(kPositionLocation, 3, GL_SHORT, true, quantizedPositions.data(), 4 * sizeof(int16_t));
+    }
+    else
+    {
+        layoutBuilder.addAttribute(kPositionLocation, 3, GL_FLOAT, false, positions.data(), 3 * sizeof(float));
+    }
+    if (quantization.normalBits == 8 || quantization.normalBits == 16)
+    {
+        size_t normalSize = 2 * (quantization.normalBits / 8);
+        quantizedNormals.resize(vertexCount * normalSize);
+        encodeOctahedralNormals(normals.data(), vertexCount, quantization.normalBits, quantizedNormals.data());
+        layoutBuilder.addAttribute(kNormalLocation, 2, quantization.normalBits == 8 ? GL_BYTE : GL_SHORT, true,
+                                   quantizedNormals.data(), normalSize);
+    }
+    else
+    {
+        layoutBuilder.addAttribute(kNormalLocation, 3, GL_FLOAT, false, normals.data(), 3 * sizeof(float));
+    }
+    if (quantization.texCoords != TexCoordFormat::Float)
+    {
+        quantizedTexCoords.resize(static_cast<size_t>(vertexCount) * 2);
+        for (VertexSegment& segment : meshData.segments)
+        {
+            quantizeTexCoords(&texCoords[segment.firstVertex * 2], segment.vertexCount, quantization.texCoords,
+                              &quantizedTexCoords[segment.firstVertex * 2], segment.texCoordTransform);
+        }
+        bool unorm = quantization.texCoords == TexCoordFormat::Unorm16;
+        layoutBuilder.addAttribute(kTexCoordLocation, 2, unorm ? GL_UNSIGNED_SHORT : GL_HALF_FLOAT, unorm,
+                                   quantizedTexCoords.data(), 2 * sizeof(uint16_t));
+    }
+    else
+    {
+        layoutBuilder.addAttribute(kTexCoordLocation, 2, GL_FLOAT, false, texCoords.data(), 2 * sizeof(float));
+    }
+    std::vector<uint8_t> jointBytes;
+    std::vector<uint16_t> jointShorts;
+    std::vector<unsigned char> quantizedWeights;
+    if (skinned)
+    {
+        // Joint indices are integers, stored as bytes when no skin needs more than 256 joints
+        float maxJoint = joints.empty() ? 0.0f : *std::max_element(joints.begin(), joints.end());
+        if (maxJoint < 256.0f)
+        {
+            jointBytes.resize(joints.size());
+            std::transform(joints.begin(), joints.end(), jointBytes.begin(), [](float joint) { return static_cast<uint8_t>(std::max(joint, 0.0f)); });
+            layoutBuilder.addIntegerAttribute(kJointsLocation, 4, GL_UNSIGNED_BYTE, jointBytes.data(), 4);
+        }
+        else
+        {
+            jointShorts.resize(joints.size());
+            std::transform(joints.begin(), joints.end(), jointShorts.begin(), [](float joint) { return static_cast<uint16_t>(std::max(joint, 0.0f)); });
+            layoutBuilder.addIntegerAttribute(kJointsLocation, 4, GL_UNSIGNED_SHORT, jointShorts.data(), 4 * sizeof(uint16_t));
+        }
+        if (quantization.weightBits == 8 || quantization.weightBits == 16)
+        {
+            size_t weightSize = 4 * (quantization.weightBits / 8);
+            quantizedWeights.resize(vertexCount * weightSize);
+            quantizeJointWeights(weights.data(), vertexCount, quantization.weightBits, quantizedWeights.data());
+            layoutBuilder.addAttribute(kWeightsLocation, 4, quantization.weightBits == 8 ? GL_UNSIGNED_BYTE : GL_UNSIGNED_SHORT, true,
+                                       quantizedWeights.data(), weightSize);
+        }
+        else
+        {
+            layoutBuilder.addAttribute(kWeightsLocation, 4, GL_FLOAT, false, weights.data(), 4 * sizeof(float));
+        }
+    }
+    layoutBuilder.build(vertexCount, meshData);
+    std::vector<uint32_t> segmentIndexTypes;
+    for (const VertexSegment& segment : meshData.segments)
+    {
+        segmentIndexTypes.push_back(selectIndexType(segment.vertexCount, options.minIndexSize));
+    }
+
+    // Lay the indices out grouped by material and segment, so that draws sharing both are contiguous
+    std::vector<size_t> packingOrder(primitives.size());
+    for (size_t i = 0; i < packingOrder.size(); i++)
+    {
+        packingOrder[i] = i;
+    }
+    std::stable_sort(packingOrder.begin(), packingOrder.end(), [&](size_t a, size_t b) {
+        return primitives[a].material != primitives[b].material ? primitives[a].material < primitives[b].material
+                                                                : primitives[a].segment < primitives[b].segment;
+    });
+
+    // Append a triangle list of a primitive to the index buffer, rebased onto its vertex segment
+    std::vector<unsigned char>& indexStorage = meshData.indices.storage;
+    auto appendIndices = [&](const PackedPrimitive& primitive, const std::vector<uint32_t>& indices) {
+        uint32_t indexType = segmentIndexTypes[primitive.segment];
+        size_t indexSize = getIndexSize(indexType);
+
+        // GL requires the offset of an index range to be a multiple of the index size
+        size_t offset = (indexStorage.size() + indexSize - 1) / indexSize * indexSize;
+        indexStorage.resize(offset + indices.size() * indexSize);
+
+        uint32_t segmentBase = primitive.firstVertex - meshData.segments[primitive.segment].firstVertex;
+        unsigned char* output = &indexStorage[offset];
+        for (uint32_t index : indices)
+        {
+            uint32_t segmentIndex = segmentBase + index;
+            if (indexType == GL_UNSIGNED_BYTE)
+            {
+                *output = static_cast<unsigned char>(segmentIndex);
+            }
+            else if (indexType == GL_UNSIGNED_SHORT)
+            {
+                uint16_t shortIndex = static_cast<uint16_t>(segmentIndex);
+                std::memcpy(output, &shortIndex, sizeof(shortIndex));
+            }
+            else
+            {
+                std::memcpy(output, &segmentIndex, sizeof(segmentIndex));
+            }
+            output += indexSize;
+        }
+        return static_cast<uint32_t>(offset);
+    };
+    std::vector<uint32_t> sharedIndices;
+    uint32_t indexCount = 0;
+    for (size_t primitiveId : packingOrder)
+    {
+        PackedPrimitive& primitive = primitives[primitiveId];
+        primitive.indexOffset = appendIndices(primitive, primitive.indices);
+        for (uint32_t index : primitive.indices)
+        {
+            sharedIndices.push_back(primitive.firstVertex + index);
+        }
+        indexCount += static_cast<uint32_t>(primitive.indices.size());
+    }
+
+    // Simplified levels follow, one level of every primitive after another, so that the draws selecting the
+    // same level keep contiguous index ranges and still merge
+    uint32_t lodIndexCount = 0;
+    size_t lodLevelCount = 0;
+    for (size_t level = 0; level < options.lodLevels; level++)
+    {
+        for (size_t primitiveId : packingOrder)
+        {
+            PrimitiveLods& levels = primitiveLods[primitiveId];
+            if (level < levels.indices.size())
+            {
+                levels.indexOffsets.push_back(appendIndices(primitives[primitiveId], levels.indices[level]));
+                lodIndexCount += static_cast<uint32_t>(levels.indices[level].size());
+                lodLevelCount++;
+            }
+        }
+    }
+    std::vector<uint32_t> primitiveFirstLods(primitives.size(), 0);
+    for (size_t primitiveId = 0; primitiveId < primitives.size(); primitiveId++)
+    {
+        const PrimitiveLods& levels = primitiveLods[primitiveId];
+        primitiveFirstLods[primitiveId] = static_cast<uint32_t>(meshData.lods.size());
+        for (size_t level = 0; level < levels.indices.size(); level++)
+        {
+            meshData.lods.push_back({ levels.indexOffsets[level], static_cast<uint32_t>(levels.indices[level].size()), levels.errors[level] });
+        }
+    }
+    meshData.indices.bytes.data = indexStorage.data();
+    meshData.indices.bytes.size = indexStorage.size();
+
+    // Scene graph (with the instances of the nodes), skins and animations, the node transforms and joint matrices are
+    // computed from them at run time
+    readSceneNodes(model, meshData);
+    if (!readNodeInstances(asset, meshData) || !readSkins(asset, meshData) || !readAnimations(asset, meshData))
+    {
+        return false;
+    }
+
+    // Morph target deltas, blended by the shader prelude with the weights of each node
+    std::vector<uint32_t> primitiveMorphs;
+    if (!packMorphTargets(asset, primitives, meshData.segments, meshData, primitiveMorphs))
+    {
+        return false;
+    }
+
+    // Meshlets of the full-detail triangles, shared by the draws of a primitive like its levels of detail
+    std::vector<uint32_t> primitiveFirstMeshlets(primitives.size(), 0);
+    std::vector<uint32_t> primitiveMeshletCounts(primitives.size(), 0);
+    if (options.buildMeshlets)
+    {
+        buildPrimitiveMeshlets(asset, primitives, positions, primitiveMorphs, meshData, primitiveFirstMeshlets, primitiveMeshletCounts);
+    }
+
+    // Largest joint index used by every skinned primitive, checked against the skin of each node
+    std::vector<uint32_t> primitiveMaxJoints(primitives.size(), 0);
+    for (size_t primitiveId = 0; skinned && primitiveId < primitives.size(); primitiveId++)
+    {
+        const PackedPrimitive& primitive = primitives[primitiveId];
+        auto first = joints.begin() + static_cast<size_t>(primitive.firstVertex) * 4;
+        auto last = first + static_cast<size_t>(primitive.vertexCount) * 4;
+        primitiveMaxJoints[primitiveId] = first != last ? static_cast<uint32_t>(*std::max_element(first, last)) : 0;
+    }
+
+    // One draw per (node, primitive piece), sorted by material, segment and then by index range
+    for (int nodeId : meshNodes)
+    {
+        const tinygltf::Node& node = model.nodes[nodeId];
+        for (size_t primitiveId : meshPrimitives[node.mesh])
+        {
+            const PackedPrimitive& primitive = primitives[primitiveId];
+            DrawCommand draw;
+            draw.indexCount = static_cast<uint32_t>(primitive.indices.size());
+            draw.indexType = segmentIndexTypes[primitive.segment];
+            draw.indexOffset = primitive.indexOffset;
+            draw.material = primitive.material;
+            draw.node = static_cast<uint32_t>(nodeId);
+            draw.segment = primitive.segment;
+            draw.skin = kNoSkin;
+            draw.morph = primitiveMorphs[primitiveId];
+            draw.firstLod = primitiveFirstLods[primitiveId];
+            draw.lodCount = static_cast<uint32_t>(primitiveLods[primitiveId].indices.size());
+            draw.firstMeshlet = primitiveFirstMeshlets[primitiveId];
+            draw.meshletCount = primitiveMeshletCounts[primitiveId];
+            std::copy(primitive.boundsMin, primitive.boundsMin + 3, draw.boundsMin);
+            std::copy(primitive.boundsMax, primitive.boundsMax + 3, draw.boundsMax);
+            if (node.skin >= 0 && static_cast<size_t>(node.skin) < meshData.skins.size() &&
+                hasSkinAttributes(model.meshes[primitive.mesh].primitives[primitive.primitive]))
+            {
+                if (primitiveMaxJoints[primitiveId] < meshData.skins[node.skin].jointCount)
+                {
+                    // The joints move the vertices anywhere, skinned draws are not culled
+                    draw.skin = static_cast<uint32_t>(node.skin);
+                    draw.boundsMin[0] = 1.0f;
+                    draw.boundsMax[0] = -1.0f;
+                }
+                else
+                {
+                    std::cerr << "Mesh " << primitive.mesh << " uses joints missing from skin " << node.skin
+                              << ", drawn without skinning" << std::endl;
+                }
+            }
+            // The box of an instanced draw holds every instance, the draw is culled as a whole
+            const SceneNode& sceneNode = meshData.nodes[nodeId];
+            if (sceneNode.instanceCount > 0 && hasDrawBounds(draw))
+            {
+                getInstancedBounds(&meshData.instanceMatrices[static_cast<size_t>(sceneNode.firstInstance) * 16],
+                                   sceneNode.instanceCount, draw.boundsMin, draw.boundsMax);
+            }
+            meshData.draws.push_back(draw);
+        }
+    }
+    std::stable_sort(meshData.draws.begin(), meshData.draws.end(), [](const DrawCommand& a, const DrawCommand& b) {
+        if (a.material != b.material)
+        {
+            return a.material < b.material;
+        }
+        return a.segment != b.segment ? a.segment < b.segment : a.indexOffset < b.indexOffset;
+    });
+
+    // Compare the vertex fetch traffic of the chosen layout with one tightly packed stream per attribute
+    std::vector<VertexAttribute> separateAttributes = {
+        { kPositionLocation, 0, 3, GL_FLOAT, 0, 0, 0 },
+        { kNormalLocation, 1, 3, GL_FLOAT, 0, 0, 0 },
+        { kTexCoordLocation, 2, 2, GL_FLOAT, 0, 0, 0 },
+    };
+    std::vector<uint32_t> separateStrides = { 12, 12, 8 };
+    if (skinned)
+    {
+        separateAttributes.push_back({ kJointsLocation, 3, 4, GL_UNSIGNED_SHORT, 0, 0, 1 });
+        separateAttributes.push_back({ kWeightsLocation, 4, 4, GL_FLOAT, 0, 0, 0 });
+        separateStrides.insert(separateStrides.end(), { 8, 16 });
+    }
+    std::vector<uint32_t> layoutStrides;
+    for (const VertexStream& stream : meshData.streams)
+    {
+        layoutStrides.push_back(stream.stride);
+    }
+    uint64_t separateBytes = estimateVertexFetchBytes(separateAttributes, separateStrides, vertexCount, sharedIndices);
+    uint64_t layoutBytes = estimateVertexFetchBytes(meshData.attributes, layoutStrides, vertexCount, sharedIndices);
+    std::cout << "Vertex fetch (simulated 64-byte lines): " << separateBytes << " bytes with separate streams, "
+              << layoutBytes << " bytes with " << meshData.streams.size() << " interleaved stream(s)";
+    if (separateBytes > 0)
+    {
+        std::cout << " (" << (100.0 * static_cast<double>(layoutBytes) / static_cast<double>(separateBytes)) << "%)";
+    }
+    std::cout << std::endl;
+
+    std::cout << "Packed " << primitives.size() << " primitives (" << vertexCount << " vertices, "
+              << indexCount << " indices) into " << meshData.draws.size() << " draws over "
+              << meshData.segments.size() << " vertex segment(s)" << std::endl;
+    if (!meshData.instanceMatrices.empty())
+    {
+        size_t instancedNodes = std::count_if(meshData.nodes.begin(), meshData.nodes.end(), [](const SceneNode& node) { return node.instanceCount > 0; });
+        std::cout << "Node instances: " << meshData.instanceMatrices.size() / 16 << " instances over " << instancedNodes
+                  << " nodes" << std::endl;
+    }
+    if (lodLevelCount > 0)
+    {
+        std::cout << "Levels of detail: " << lodLevelCount << " levels (" << lodIndexCount << " indices) over "
+                  << primitives.size() << " primitives" << std::endl;
+    }
+    if (!meshData.meshlets.empty())
+    {
+        size_t meshletPrimitives = std::count_if(primitiveMeshletCounts.begin(), primitiveMeshletCounts.end(), [](uint32_t count) { return count > 0; });
+        std::cout << "Meshlets: " << meshData.meshlets.size() << " meshlets over " << meshletPrimitives << " primitives" << std::endl;
+    }
+    std::cout << "Index buffer: " << indexStorage.size() << " bytes (" << static_cast<size_t>(indexCount + lodIndexCount) * sizeof(uint32_t)
+              << " bytes as 32-bit indices)" << std::endl;
+    return !meshData.draws.empty();
+}
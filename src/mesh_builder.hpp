@@ -0,0 +1,49 @@
+#ifndef MESH_BUILDER_HPP
+#define MESH_BUILDER_HPP
+
+#include "gltf_asset.hpp"
+#include "material_description.hpp"
+#include "mesh_data.hpp"
+#include "texture_atlas.hpp"
+#include "vertex_layout.hpp"
+#include "vertex_quantization.hpp"
+
+// Settings of the mesh build; they are hashed into the mesh cache key
+struct MeshBuildOptions
+{
+    VertexLayoutOptions vertexLayout;       // Interleaving of the vertex attributes
+    uint32_t minIndexSize = 2;              // Smallest index size in bytes (1 enables 8-bit indices, 4 disables narrowing)
+    bool splitSegments = true;              // Split the vertices into segments small enough for 16-bit indices
+    bool optimizeMeshes = false;            // Reorder triangles (vertex cache, overdraw) and vertices (fetch)
+    uint32_t vertexCacheSize = 16;          // Post-transform cache size targeted by the optimization
+    float overdrawThreshold = 1.05f;        // Vertex cache efficiency that may be traded for less overdraw
+    VertexQuantizationOptions quantization; // Storage formats of the vertex attributes
+    TextureAtlasOptions textureAtlas;       // Packing of small textures into atlases
+    uint32_t lodLevels = 0;                 // Simplified levels of detail generated per primitive (0 disables them)
+    float lodTriangleRatio = 0.5f;          // Triangles kept by each level relative to the previous one
+    float lodMaxError = 0.05f;              // Largest error of a level, relative to the size of the primitive
+    bool buildMeshlets = false;             // Cut rigid primitives into meshlets for per-cluster culling
+};
+
+// Function to hash the build options, so that cached meshes built with other settings are rebuilt
+uint64_t hashMeshBuildOptions(const MeshBuildOptions& options);
+
+// Function to pack every primitive reachable from the asset's scene into shared vertex and
+// index buffers, with one draw command per (node, primitive) pair.
+// Indices are narrowed per vertex segment to the smallest type that fits; primitives too large
+// for 16-bit indices are split into several draws when options.splitSegments is set.
+// Draw commands reference the GLTF material index, or model.materials.size() for primitives
+// without material (the default material slot).
+// With options.textureAtlas, small textures are packed into atlases appended to textures: a texture
+// qualifies when it has no fallback image, every material sampling it samples nothing else and every
+// primitive drawn with those materials keeps its TEXCOORD_0 inside [0, 1]. The coordinates of those
+// primitives are moved into the atlas, the materials sample the atlas, and materials left identical
+// are merged so that their draws are batched together.
+// With options.lodLevels, every rigid primitive is simplified into coarser index ranges over its own vertices
+// (DrawCommand::firstLod / lodCount), stored after the full-detail indices one level after another.
+// With options.buildMeshlets, the full-detail triangles of every rigid primitive without morph targets are cut into
+// meshlets (DrawCommand::firstMeshlet / meshletCount) in their packed order.
+bool buildSceneMeshData(const GltfAsset& asset, const MeshBuildOptions& options, std::vector<MaterialDescription>& materials,
+                        std::vector<TextureDescription>& textures, MeshData& meshData);
+
+#endif // MESH_BUILDER_HPP
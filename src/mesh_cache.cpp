@@ -0,0 +1,607 @@
+#include "mesh_cache.hpp"
+#include "hash.hpp"
+
+#include <GLES3/gl3.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <system_error>
+
+namespace
+{
+    const uint32_t kMeshCacheMagic = 0x434D4C47;    // "GLMC"
+    // Bump whenever the layout of MeshData, MaterialDescription or of the file changes
+    const uint32_t kMeshCacheVersion = 15;
+    // Blobs are aligned so that they can be uploaded straight from the mapping
+    const size_t kBlobAlignment = 16;
+
+    // Function to get the size of an index type in bytes, 0 for a type the builder never writes
+    size_t getIndexTypeSize(uint32_t indexType)
+    {
+        switch (indexType)
+        {
+        case GL_UNSIGNED_BYTE:
+            return 1;
+        case GL_UNSIGNED_SHORT:
+            return 2;
+        case GL_UNSIGNED_INT:
+            return 4;
+        default:
+            return 0;
+        }
+    }
+
+    // Function to tell whether an index range lies inside the index buffer
+    bool isIndexRangeInside(uint32_t indexOffset, uint32_t indexCount, size_t indexSize, const MeshBlob& indices)
+    {
+        return indexOffset <= indices.bytes.size && static_cast<size_t>(indexCount) * indexSize <= indices.bytes.size - indexOffset;
+    }
+
+    // Fixed-size header at the start of the file, followed by the blobs and then the metadata
+    struct MeshCacheHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t sourceHash;        // Hash of the source asset and of its dependencies
+        uint64_t metadataOffset;    // Byte offset of the metadata section
+        uint64_t metadataSize;      // Size of the metadata section in bytes
+    };
+
+    // Function to hash the source asset followed by each of its dependencies
+    bool hashSources(const std::filesystem::path& sourcePath, const std::vector<std::filesystem::path>& dependencies,
+                     uint64_t settingsHash, uint64_t& hash)
+    {
+        hash = hashBytes(&kMeshCacheVersion, sizeof(kMeshCacheVersion), settingsHash);
+        MappedFile file;
+        if (!file.open(sourcePath))
+        {
+            return false;
+        }
+        hash = hashBytes(file.data(), file.size(), hash);
+        for (const std::filesystem::path& dependency : dependencies)
+        {
+            if (!file.open(dependency))
+            {
+                return false;
+            }
+            hash = hashBytes(file.data(), file.size(), hash);
+        }
+        return true;
+    }
+
+    // Append-only little-endian writer for the metadata section
+    class BinaryWriter
+    {
+    public:
+        explicit BinaryWriter(std::vector<unsigned char>& output) : output_(output) {}
+
+        void writeBytes(const void* bytes, size_t size)
+        {
+            const unsigned char* begin = static_cast<const unsigned char*>(bytes);
+            output_.insert(output_.end(), begin, begin + size);
+        }
+        void writeU32(uint32_t value) { writeBytes(&value, sizeof(value)); }
+        void writeU64(uint64_t value) { writeBytes(&value, sizeof(value)); }
+        void writeString(const std::string& value)
+        {
+            writeU32(static_cast<uint32_t>(value.size()));
+            writeBytes(value.data(), value.size());
+        }
+        // Element count followed by the raw elements, for arrays of plain structures
+        template <typename T>
+        void writeArray(const std::vector<T>& values)
+        {
+            writeU32(static_cast<uint32_t>(values.size()));
+            writeBytes(values.data(), values.size() * sizeof(T));
+        }
+
+    private:
+        std::vector<unsigned char>& output_;
+    };
+
+    // Bounds-checked reader over the mapped metadata section
+    class BinaryReader
+    {
+    public:
+        BinaryReader(const unsigned char* begin, size_t size) : cursor_(begin), end_(begin + size) {}
+
+        bool readBytes(void* bytes, size_t size)
+        {
+            if (static_cast<size_t>(end_ - cursor_) < size)
+            {
+                return false;
+            }
+            if (size == 0)
+            {
+                return true;    // Empty arrays have no storage to copy into
+            }
+            std::memcpy(bytes, cursor_, size);
+            cursor_ += size;
+            return true;
+        }
+        bool readU32(uint32_t& value) { return readBytes(&value, sizeof(value)); }
+        bool readU64(uint64_t& value) { return readBytes(&value, sizeof(value)); }
+        bool readString(std::string& value)
+        {
+            uint32_t length;
+            if (!readU32(length) || static_cast<size_t>(end_ - cursor_) < length)
+            {
+                return false;
+            }
+            value.assign(reinterpret_cast<const char*>(cursor_), length);
+            cursor_ += length;
+            return true;
+        }
+        template <typename T>
+        bool readArray(std::vector<T>& values)
+        {
+            uint32_t count;
+            if (!readU32(count) || static_cast<size_t>(end_ - cursor_) / sizeof(T) < count)
+            {
+                return false;
+            }
+            values.resize(count);
+            return readBytes(values.data(), count * sizeof(T));
+        }
+
+    private:
+        const unsigned char* cursor_;
+        const unsigned char* end_;
+    };
+
+    // Functions to store the location of a texture image
+    void writeFileRange(BinaryWriter& writer, const FileRange& range)
+    {
+        writer.writeString(range.path);
+        writer.writeU64(range.offset);
+        writer.writeU64(range.size);
+    }
+    bool readFileRange(BinaryReader& reader, FileRange& range)
+    {
+        return reader.readString(range.path) && reader.readU64(range.offset) && reader.readU64(range.size);
+    }
+
+    // Function to append a blob to the file image, returns its offset and size
+    void appendBlob(std::vector<unsigned char>& file, const MeshBlob& blob, uint64_t& offset, uint64_t& size)
+    {
+        file.resize((file.size() + kBlobAlignment - 1) & ~(kBlobAlignment - 1), 0);
+        offset = file.size();
+        size = blob.bytes.size;
+        if (blob.bytes.size)
+        {
+            file.insert(file.end(), blob.bytes.data, blob.bytes.data + blob.bytes.size);
+        }
+    }
+
+    // Function to point a blob at a range of the mapped cache file
+    bool mapBlob(const MappedFile& file, uint64_t offset, uint64_t size, MeshBlob& blob)
+    {
+        if (offset > file.size() || size > file.size() - offset)
+        {
+            return false;
+        }
+        blob.bytes.data = file.data() + offset;
+        blob.bytes.size = static_cast<size_t>(size);
+        return true;
+    }
+}
+
+std::filesystem::path getMeshCachePath(const std::filesystem::path& cacheDirectory, const std::filesystem::path& sourcePath)
+{
+    // Assets with the same name in different folders must not share a cache file
+    std::error_code error;
+    std::string absolutePath = std::filesystem::absolute(sourcePath, error).lexically_normal().generic_u8string();
+    uint64_t pathHash = hashBytes(absolutePath.data(), absolutePath.size(), 0);
+
+    char pathHashText[17];
+    std::snprintf(pathHashText, sizeof(pathHashText), "%016llx", static_cast<unsigned long long>(pathHash));
+    return cacheDirectory / (sourcePath.stem().u8string() + "-" + pathHashText + ".meshcache");
+}
+
+bool loadMeshCache(const std::filesystem::path& cachePath, const std::filesystem::path& sourcePath, uint64_t settingsHash,
+                   MeshData& meshData, std::vector<MaterialDescription>& materials,
+                   std::vector<TextureDescription>& textures)
+{
+    MappedFile file;
+    if (!file.open(cachePath))
+    {
+        return false;
+    }
+
+    MeshCacheHeader header;
+    if (file.size() < sizeof(header))
+    {
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (header.magic != kMeshCacheMagic || header.version != kMeshCacheVersion ||
+        header.metadataOffset > file.size() || header.metadataSize > file.size() - header.metadataOffset)
+    {
+        return false;
+    }
+
+    BinaryReader reader(file.data() + header.metadataOffset, static_cast<size_t>(header.metadataSize));
+
+    // Dependencies are stored relative to the source asset and must hash to the recorded key
+    uint32_t dependencyCount;
+    if (!reader.readU32(dependencyCount))
+    {
+        return false;
+    }
+    std::vector<std::filesystem::path> dependencies;
+    for (uint32_t dependencyIdx = 0; dependencyIdx < dependencyCount; dependencyIdx++)
+    {
+        std::string relativePath;
+        if (!reader.readString(relativePath))
+        {
+            return false;
+        }
+        dependencies.push_back(sourcePath.parent_path() / std::filesystem::u8path(relativePath));
+    }
+    uint64_t sourceHash;
+    if (!hashSources(sourcePath, dependencies, settingsHash, sourceHash) || sourceHash != header.sourceHash)
+    {
+        std::cout << "Mesh cache " << cachePath.string() << " is stale" << std::endl;
+        return false;
+    }
+
+    // Vertex streams
+    MeshData result;
+    uint32_t streamCount;
+    if (!reader.readU32(streamCount))
+    {
+        return false;
+    }
+    result.streams.resize(streamCount);
+    for (VertexStream& stream : result.streams)
+    {
+        uint64_t offset, size;
+        if (!reader.readU32(stream.stride) || !reader.readU64(offset) || !reader.readU64(size) ||
+            !mapBlob(file, offset, size, stream.data))
+        {
+            return false;
+        }
+    }
+
+    // Attribute layout
+    uint32_t attributeCount;
+    if (!reader.readU32(attributeCount))
+    {
+        return false;
+    }
+    result.attributes.resize(attributeCount);
+    if (!reader.readBytes(result.attributes.data(), attributeCount * sizeof(VertexAttribute)))
+    {
+        return false;
+    }
+
+    // Index buffer
+    uint64_t indexOffset, indexSize;
+    if (!reader.readU64(indexOffset) || !reader.readU64(indexSize) || !mapBlob(file, indexOffset, indexSize, result.indices))
+    {
+        return false;
+    }
+
+    // Morph target deltas
+    uint64_t morphOffset, morphSize;
+    if (!reader.readU64(morphOffset) || !reader.readU64(morphSize) || !mapBlob(file, morphOffset, morphSize, result.morphDeltas))
+    {
+        return false;
+    }
+
+    // Draw parameters
+    uint32_t drawCount;
+    if (!reader.readU32(drawCount))
+    {
+        return false;
+    }
+    result.draws.resize(drawCount);
+    if (!reader.readBytes(result.draws.data(), drawCount * sizeof(DrawCommand)))
+    {
+        return false;
+    }
+
+    // Vertex segments
+    uint32_t segmentCount;
+    if (!reader.readU32(segmentCount))
+    {
+        return false;
+    }
+    result.segments.resize(segmentCount);
+    if (!reader.readBytes(result.segments.data(), segmentCount * sizeof(VertexSegment)))
+    {
+        return false;
+    }
+
+    // Scene graph, skins and animations
+    if (!reader.readArray(result.nodes) || !reader.readArray(result.skins) || !reader.readArray(result.skinJoints) ||
+        !reader.readArray(result.inverseBindMatrices) || !reader.readArray(result.morphTargetSets) ||
+        !reader.readArray(result.morphWeights) || !reader.readArray(result.animations) ||
+        !reader.readArray(result.animationTracks) || !reader.readArray(result.animationTimes) ||
+        !reader.readArray(result.animationValues) || !reader.readArray(result.lods) ||
+        !reader.readArray(result.instanceMatrices) || !reader.readArray(result.meshlets))
+    {
+        return false;
+    }
+    // Vertex streams, index ranges, skins, morph weights, instances and animations are used without further checks
+    for (const VertexAttribute& attribute : result.attributes)
+    {
+        if (attribute.stream >= result.streams.size())
+        {
+            return false;
+        }
+    }
+    size_t inverseBindMatrixCount = result.inverseBindMatrices.size() / 16;
+    for (const Skin& skin : result.skins)
+    {
+        if (skin.firstJoint > result.skinJoints.size() || skin.jointCount > result.skinJoints.size() - skin.firstJoint ||
+            skin.firstJoint > inverseBindMatrixCount || skin.jointCount > inverseBindMatrixCount - skin.firstJoint)
+        {
+            return false;
+        }
+    }
+    size_t instanceCount = result.instanceMatrices.size() / 16;
+    for (const SceneNode& node : result.nodes)
+    {
+        if (node.firstMorphWeight > result.morphWeights.size() || node.morphWeightCount > result.morphWeights.size() - node.firstMorphWeight ||
+            node.firstInstance > instanceCount || node.instanceCount > instanceCount - node.firstInstance)
+        {
+            return false;
+        }
+    }
+    for (const AnimationTrack& track : result.animationTracks)
+    {
+        if (track.node >= result.nodes.size())
+        {
+            return false;
+        }
+        uint32_t componentCount = track.path == AnimationPath::Weights ? result.nodes[track.node].morphWeightCount
+                                : track.path == AnimationPath::Rotation ? 4 : 3;
+        size_t valueCount = static_cast<size_t>(track.keyCount) * componentCount *
+                            (track.interpolation == AnimationInterpolation::CubicSpline ? 3 : 1);
+        if (track.keyCount == 0 ||
+            track.firstKey > result.animationTimes.size() || track.keyCount > result.animationTimes.size() - track.firstKey ||
+            track.firstValue > result.animationValues.size() || valueCount > result.animationValues.size() - track.firstValue)
+        {
+            return false;
+        }
+    }
+    for (const AnimationClip& clip : result.animations)
+    {
+        if (clip.firstTrack > result.animationTracks.size() || clip.trackCount > result.animationTracks.size() - clip.firstTrack)
+        {
+            return false;
+        }
+    }
+    // World matrices are looked up by the nodes of the draws and joints, skins, levels of detail and meshlets by the
+    // draws; the index ranges of the draws and their levels are read from the index buffer and meshlets index triangles
+    // of their draw's full-detail range
+    for (const DrawCommand& draw : result.draws)
+    {
+        size_t indexSize = getIndexTypeSize(draw.indexType);
+        if (draw.node >= result.nodes.size() || draw.firstLod > result.lods.size() || draw.lodCount > result.lods.size() - draw.firstLod ||
+            draw.firstMeshlet > result.meshlets.size() || draw.meshletCount > result.meshlets.size() - draw.firstMeshlet ||
+            (draw.skin != kNoSkin && draw.skin >= result.skins.size()) || indexSize == 0 ||
+            !isIndexRangeInside(draw.indexOffset, draw.indexCount, indexSize, result.indices))
+        {
+            return false;
+        }
+        for (uint32_t lodId = draw.firstLod; lodId < draw.firstLod + draw.lodCount; lodId++)
+        {
+            const DrawLod& lod = result.lods[lodId];
+            if (!isIndexRangeInside(lod.indexOffset, lod.indexCount, indexSize, result.indices))
+            {
+                return false;
+            }
+        }
+        for (uint32_t meshletId = draw.firstMeshlet; meshletId < draw.firstMeshlet + draw.meshletCount; meshletId++)
+        {
+            const Meshlet& meshlet = result.meshlets[meshletId];
+            if (meshlet.firstTriangle > draw.indexCount / 3 || meshlet.triangleCount > draw.indexCount / 3 - meshlet.firstTriangle)
+            {
+                return false;
+            }
+        }
+    }
+    for (uint32_t joint : result.skinJoints)
+    {
+        if (joint >= result.nodes.size())
+        {
+            return false;
+        }
+    }
+
+    // Materials
+    uint32_t materialCount;
+    if (!reader.readU32(materialCount))
+    {
+        return false;
+    }
+    std::vector<MaterialDescription> cachedMaterials(materialCount);
+    for (MaterialDescription& material : cachedMaterials)
+    {
+        uint32_t fromAsset, uniformCount;
+        if (!reader.readU32(fromAsset) || !reader.readString(material.vertexShaderPath) ||
+            !reader.readString(material.fragmentShaderPath) || !reader.readU32(uniformCount))
+        {
+            return false;
+        }
+        material.fromAsset = fromAsset != 0;
+        // The uniform table is plain data, it is read in one go after its name pool
+        material.uniforms.resize(uniformCount);
+        if (!reader.readBytes(material.uniforms.data(), uniformCount * sizeof(MaterialUniform)) ||
+            !reader.readString(material.uniformNames))
+        {
+            return false;
+        }
+    }
+
+    // Textures, referenced by the sampler uniforms of the materials
+    uint32_t textureCount;
+    if (!reader.readU32(textureCount))
+    {
+        return false;
+    }
+    std::vector<TextureDescription> cachedTextures(textureCount);
+    for (TextureDescription& texture : cachedTextures)
+    {
+        int32_t fields[11];
+        if (!readFileRange(reader, texture.image) || !readFileRange(reader, texture.fallbackImage) ||
+            !reader.readBytes(fields, sizeof(fields)))
+        {
+            return false;
+        }
+        texture.minFilter = fields[0];
+        texture.magFilter = fields[1];
+        texture.wrapS = fields[2];
+        texture.wrapT = fields[3];
+        texture.srgb = fields[4] != 0;
+        texture.isAtlas = fields[5] != 0;
+        texture.width = static_cast<uint32_t>(fields[6]);
+        texture.height = static_cast<uint32_t>(fields[7]);
+        texture.atlas = fields[8];
+        texture.atlasX = static_cast<uint32_t>(fields[9]);
+        texture.atlasY = static_cast<uint32_t>(fields[10]);
+    }
+    for (const TextureDescription& texture : cachedTextures)
+    {
+        if (texture.atlas >= 0 && (static_cast<uint32_t>(texture.atlas) >= textureCount || !cachedTextures[texture.atlas].isAtlas))
+        {
+            return false;
+        }
+    }
+    for (const MaterialDescription& material : cachedMaterials)
+    {
+        for (const MaterialUniform& uniform : material.uniforms)
+        {
+            if (uniform.nameOffset >= material.uniformNames.size() ||
+                (uniform.type == MaterialUniformType::Sampler2D && static_cast<uint32_t>(uniform.intValue) >= textureCount))
+            {
+                return false;
+            }
+        }
+    }
+
+    // The blobs point into the mapping, which now belongs to the mesh data
+    result.backingFile = std::move(file);
+    meshData = std::move(result);
+    materials = std::move(cachedMaterials);
+    textures = std::move(cachedTextures);
+    return true;
+}
+
+bool writeMeshCache(const std::filesystem::path& cachePath, const std::filesystem::path& sourcePath, uint64_t settingsHash,
+                    const std::vector<std::filesystem::path>& dependencies,
+                    const MeshData& meshData, const std::vector<MaterialDescription>& materials,
+                    const std::vector<TextureDescription>& textures)
+{
+    MeshCacheHeader header = {};
+    header.magic = kMeshCacheMagic;
+    header.version = kMeshCacheVersion;
+    if (!hashSources(sourcePath, dependencies, settingsHash, header.sourceHash))
+    {
+        return false;
+    }
+
+    // Blobs come first, right after the header
+    std::vector<unsigned char> fileImage(sizeof(header));
+    std::vector<unsigned char> metadata;
+    BinaryWriter writer(metadata);
+
+    writer.writeU32(static_cast<uint32_t>(dependencies.size()));
+    for (const std::filesystem::path& dependency : dependencies)
+    {
+        writer.writeString(dependency.lexically_relative(sourcePath.parent_path()).generic_u8string());
+    }
+
+    writer.writeU32(static_cast<uint32_t>(meshData.streams.size()));
+    for (const VertexStream& stream : meshData.streams)
+    {
+        uint64_t offset, size;
+        appendBlob(fileImage, stream.data, offset, size);
+        writer.writeU32(stream.stride);
+        writer.writeU64(offset);
+        writer.writeU64(size);
+    }
+
+    writer.writeU32(static_cast<uint32_t>(meshData.attributes.size()));
+    writer.writeBytes(meshData.attributes.data(), meshData.attributes.size() * sizeof(VertexAttribute));
+
+    uint64_t indexOffset, indexSize;
+    appendBlob(fileImage, meshData.indices, indexOffset, indexSize);
+    writer.writeU64(indexOffset);
+    writer.writeU64(indexSize);
+
+    uint64_t morphOffset, morphSize;
+    appendBlob(fileImage, meshData.morphDeltas, morphOffset, morphSize);
+    writer.writeU64(morphOffset);
+    writer.writeU64(morphSize);
+
+    writer.writeU32(static_cast<uint32_t>(meshData.draws.size()));
+    writer.writeBytes(meshData.draws.data(), meshData.draws.size() * sizeof(DrawCommand));
+
+    writer.writeU32(static_cast<uint32_t>(meshData.segments.size()));
+    writer.writeBytes(meshData.segments.data(), meshData.segments.size() * sizeof(VertexSegment));
+
+    writer.writeArray(meshData.nodes);
+    writer.writeArray(meshData.skins);
+    writer.writeArray(meshData.skinJoints);
+    writer.writeArray(meshData.inverseBindMatrices);
+    writer.writeArray(meshData.morphTargetSets);
+    writer.writeArray(meshData.morphWeights);
+    writer.writeArray(meshData.animations);
+    writer.writeArray(meshData.animationTracks);
+    writer.writeArray(meshData.animationTimes);
+    writer.writeArray(meshData.animationValues);
+    writer.writeArray(meshData.lods);
+    writer.writeArray(meshData.instanceMatrices);
+    writer.writeArray(meshData.meshlets);
+
+    writer.writeU32(static_cast<uint32_t>(materials.size()));
+    for (const MaterialDescription& material : materials)
+    {
+        writer.writeU32(material.fromAsset ? 1 : 0);
+        writer.writeString(material.vertexShaderPath);
+        writer.writeString(material.fragmentShaderPath);
+        writer.writeU32(static_cast<uint32_t>(material.uniforms.size()));
+        writer.writeBytes(material.uniforms.data(), material.uniforms.size() * sizeof(MaterialUniform));
+        writer.writeString(material.uniformNames);
+    }
+
+    writer.writeU32(static_cast<uint32_t>(textures.size()));
+    for (const TextureDescription& texture : textures)
+    {
+        writeFileRange(writer, texture.image);
+        writeFileRange(writer, texture.fallbackImage);
+        int32_t fields[11] = {
+            texture.minFilter, texture.magFilter, texture.wrapS, texture.wrapT, texture.srgb ? 1 : 0,
+            texture.isAtlas ? 1 : 0, static_cast<int32_t>(texture.width), static_cast<int32_t>(texture.height),
+            texture.atlas, static_cast<int32_t>(texture.atlasX), static_cast<int32_t>(texture.atlasY),
+        };
+        writer.writeBytes(fields, sizeof(fields));
+    }
+
+    // Metadata goes last, its location is recorded in the header
+    header.metadataOffset = fileImage.size();
+    header.metadataSize = metadata.size();
+    fileImage.insert(fileImage.end(), metadata.begin(), metadata.end());
+    std::memcpy(fileImage.data(), &header, sizeof(header));
+
+    // Write to a temporary file first so that a crash never leaves a truncated cache behind
+    std::error_code error;
+    std::filesystem::create_directories(cachePath.parent_path(), error);
+    std::filesystem::path temporaryPath = cachePath;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream output(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!output.write(reinterpret_cast<const char*>(fileImage.data()), fileImage.size()))
+        {
+            return false;
+        }
+    }
+    std::filesystem::rename(temporaryPath, cachePath, error);
+    return !error;
+}
@@ -0,0 +1,30 @@
+#ifndef MESH_CACHE_HPP
+#define MESH_CACHE_HPP
+
+#include <filesystem>
+#include <vector>
+#include "mesh_data.hpp"
+#include "material_description.hpp"
+
+// Baked mesh cache.
+// A cache file stores the GPU-ready vertex/index blobs, the attribute layout, the draw
+// parameters and the material and texture descriptions of one glTF asset. It is keyed by a hash of the
+// source .gltf/.glb, of every external buffer file and of the settings used to build the mesh
+// data (settingsHash), and is loaded with a single mapping and without any JSON parsing.
+
+// Function to get the cache file used for a source asset inside a cache directory
+std::filesystem::path getMeshCachePath(const std::filesystem::path& cacheDirectory, const std::filesystem::path& sourcePath);
+
+// Function to load a baked mesh cache, returns false on a miss (missing, stale or corrupt file)
+// On success the blobs of meshData point into meshData.backingFile
+bool loadMeshCache(const std::filesystem::path& cachePath, const std::filesystem::path& sourcePath, uint64_t settingsHash,
+                   MeshData& meshData, std::vector<MaterialDescription>& materials,
+                   std::vector<TextureDescription>& textures);
+
+// Function to bake the mesh data, materials and textures of a source asset into a cache file
+bool writeMeshCache(const std::filesystem::path& cachePath, const std::filesystem::path& sourcePath, uint64_t settingsHash,
+                    const std::vector<std::filesystem::path>& dependencies,
+                    const MeshData& meshData, const std::vector<MaterialDescription>& materials,
+                    const std::vector<TextureDescription>& textures);
+
+#endif // MESH_CACHE_HPP
@@ -0,0 +1,203 @@
+#ifndef MESH_DATA_HPP
+#define MESH_DATA_HPP
+
+#include <cstdint>
+#include <vector>
+#include "basic_types.hpp"
+#include "mapped_file.hpp"
+
+// Attribute locations shared by every shader
+const uint32_t kPositionLocation = 0;
+const uint32_t kNormalLocation = 1;
+const uint32_t kTexCoordLocation = 2;
+const uint32_t kJointsLocation = 3;
+const uint32_t kWeightsLocation = 4;
+// World matrix of the instance of an instanced draw, one location per column (5 to 8)
+const uint32_t kInstanceMatrixLocation = 5;
+
+// Skin index of the draws that are not skinned
+const uint32_t kNoSkin = UINT32_MAX;
+// Morph target set of the draws without morph targets
+const uint32_t kNoMorph = UINT32_MAX;
+
+// Texels per row of the morph delta texture
+const uint32_t kMorphDeltaTextureWidth = 1024;
+// Morph targets blended per primitive, further targets are ignored
+const uint32_t kMaxMorphTargets = 64;
+
+// GPU-ready bytes: either borrowed from a mapped file or owned by the blob itself
+struct MeshBlob
+{
+    ByteSpan bytes;                         // Bytes to upload with glBufferData
+    std::vector<unsigned char> storage;     // Backing storage when the bytes were produced on the CPU
+};
+
+// Layout of one vertex attribute inside a vertex stream
+struct VertexAttribute
+{
+    uint32_t location;          // Shader attribute location
+    uint32_t stream;            // Index of the vertex stream holding the attribute
+    uint32_t componentCount;    // Number of components (1 to 4)
+    uint32_t componentType;     // GL component type (GL_FLOAT, GL_UNSIGNED_SHORT, ...)
+    uint32_t normalized;        // Non-zero for normalized integer attributes
+    uint32_t offset;            // Byte offset of the attribute inside the stream
+    uint32_t integer;           // Non-zero for integer attributes (glVertexAttribIPointer, ivec / uvec in shaders)
+};
+
+// One GL vertex buffer
+struct VertexStream
+{
+    uint32_t stride;            // Distance between two vertices in bytes (0 = tightly packed)
+    MeshBlob data;              // Vertex bytes
+};
+
+// Parameters of one glDrawElements call
+struct DrawCommand
+{
+    uint32_t indexCount;        // Number of indices to render
+    uint32_t indexType;         // GL index type (GL_UNSIGNED_SHORT, GL_UNSIGNED_INT, ...)
+    uint32_t indexOffset;       // Byte offset of the first index in the index buffer
+    uint32_t material;          // Material index used by the draw
+    uint32_t node;              // GLTF node the draw belongs to
+    uint32_t segment;           // Vertex segment the indices are relative to
+    uint32_t skin;              // Skin deforming the draw, kNoSkin for rigid draws
+    uint32_t morph;             // Morph target set of the primitive, kNoMorph without morph targets
+    uint32_t firstLod;          // First simplified level of the primitive in MeshData::lods
+    uint32_t lodCount;          // Number of simplified levels (0 when the draw is always drawn in full)
+    uint32_t firstMeshlet;      // First cluster of the full-detail triangles in MeshData::meshlets
+    uint32_t meshletCount;      // Number of clusters (0 when the draw is not culled per cluster)
+    float boundsMin[3];         // Model-space box of the primitive, used for culling; boundsMin[0] > boundsMax[0]
+    float boundsMax[3];         // when the draw has no bounds (skinned), such draws are never culled
+};
+
+// Function to tell whether a draw has a bounding box
+inline bool hasDrawBounds(const DrawCommand& draw)
+{
+    return draw.boundsMin[0] <= draw.boundsMax[0];
+}
+
+// Simplified level of detail of a draw: another index range over the same vertices, drawn in place of
+// DrawCommand::indexOffset / indexCount when the draw covers few pixels
+struct DrawLod
+{
+    uint32_t indexOffset;       // Byte offset of the first index in the index buffer (same index type as the draw)
+    uint32_t indexCount;        // Number of indices
+    float error;                // Geometric error of the level, relative to the largest side of the box around the vertices
+};
+
+// Cluster of consecutive triangles of a draw, culled on its own against the view frustum and when it faces away
+// from the camera. Meshlets cover the full-detail index range of their draw in order
+struct Meshlet
+{
+    float center[3];            // Model-space bounding sphere of the triangles
+    float radius;
+    float coneAxis[3];          // Unit axis of the cone holding the triangle normals
+    float coneCutoff;           // Sine of the widest angle between the axis and a normal, 1 when the cone is too wide to cull
+    uint32_t firstTriangle;     // First triangle among the full-detail triangles of the draw
+    uint32_t triangleCount;     // Number of triangles
+};
+
+// Range of the vertex streams addressed by the indices of a draw.
+// Each segment gets its own vertex array object whose attribute pointers start at firstVertex,
+// which lets large scenes keep 16-bit indices without glDrawElementsBaseVertex (not in ES 3.0)
+struct VertexSegment
+{
+    uint32_t firstVertex;       // First vertex of the segment inside the vertex streams
+    uint32_t vertexCount;       // Number of vertices in the segment
+    float positionDequantization[16];   // Column-major matrix from stored to model space positions
+    float texCoordTransform[4];         // Scale (xy) and offset (zw) from stored to original texture coordinates
+};
+
+// Node of the scene graph, indexed like the GLTF nodes
+struct SceneNode
+{
+    int32_t parent;             // Parent node, -1 for roots
+    float translation[3];       // Local transform, applied as T * R * S
+    float rotation[4];          // Unit quaternion (x, y, z, w)
+    float scale[3];
+    uint32_t firstMorphWeight;  // First morph target weight in MeshData::morphWeights
+    uint32_t morphWeightCount;  // Number of morph target weights of the node's mesh (0 without morph targets)
+    uint32_t firstInstance;     // First local matrix of the node's instances in MeshData::instanceMatrices
+    uint32_t instanceCount;     // Instances of the node's mesh (EXT_mesh_gpu_instancing), 0 when it is drawn once
+};
+
+// Joints of a GLTF skin
+struct Skin
+{
+    uint32_t firstJoint;        // First entry of the skin in MeshData::skinJoints
+    uint32_t jointCount;        // Number of joints, the JOINTS_0 values index them
+};
+
+// Morph targets of a primitive. The delta texture holds, for every vertex and then every target,
+// a position delta texel followed by a normal delta texel when the targets have normals
+struct MorphTargetSet
+{
+    int32_t texelBase;          // Texel of the deltas of vertex index 0 of the draw's segment
+    uint32_t targetCount;       // Number of targets
+    uint32_t texelsPerTarget;   // 1 (position) or 2 (position and normal) texels per vertex and target
+};
+
+// Node property driven by an animation track
+enum class AnimationPath : uint32_t
+{
+    Translation,
+    Rotation,
+    Scale,
+    Weights,                    // Morph target weights, one value per target of the node's mesh
+};
+
+// Interpolation between the keys of an animation track
+enum class AnimationInterpolation : uint32_t
+{
+    Step,
+    Linear,
+    CubicSpline,                // Every key holds an in-tangent, the value and an out-tangent
+};
+
+// Keyframes of one animated node property (one GLTF channel)
+struct AnimationTrack
+{
+    uint32_t node;                          // Animated node
+    AnimationPath path;                     // Animated property, 3 floats (translation, scale), 4 (rotation) or one per weight
+    AnimationInterpolation interpolation;
+    uint32_t firstKey;                      // First key time in MeshData::animationTimes
+    uint32_t keyCount;                      // Number of keys
+    uint32_t firstValue;                    // First float of the key values in MeshData::animationValues
+};
+
+// GLTF animation: tracks sorted by path and interpolation so that they are sampled in batches
+struct AnimationClip
+{
+    uint32_t firstTrack;        // First track in MeshData::animationTracks
+    uint32_t trackCount;        // Number of tracks
+    float startTime;            // Time of the earliest key in seconds
+    float endTime;              // Time of the latest key in seconds
+};
+
+// Everything needed to create the GL buffers of a mesh and draw it,
+// produced either from a glTF asset or from the baked mesh cache
+struct MeshData
+{
+    std::vector<VertexStream> streams;          // Vertex buffers
+    std::vector<VertexAttribute> attributes;    // Attribute layout over the streams
+    MeshBlob indices;                           // Index buffer
+    MeshBlob morphDeltas;                       // RGB32F texels of the morph delta texture, in full rows
+    std::vector<DrawCommand> draws;             // Draw parameters
+    std::vector<DrawLod> lods;                  // Simplified levels of the draws, coarser levels last
+    std::vector<Meshlet> meshlets;              // Triangle clusters of the draws
+    std::vector<VertexSegment> segments;        // Vertex ranges addressed by the draws
+    std::vector<SceneNode> nodes;               // Scene graph, the joints of the skins are nodes
+    std::vector<Skin> skins;                    // Skins, indexed like the GLTF skins
+    std::vector<uint32_t> skinJoints;           // Node of every skin joint
+    std::vector<float> inverseBindMatrices;     // Inverse bind matrix of every skin joint (16 floats each)
+    std::vector<MorphTargetSet> morphTargetSets; // Morph targets of the primitives, indexed by DrawCommand::morph
+    std::vector<float> morphWeights;            // Morph target weights of every node
+    std::vector<float> instanceMatrices;        // Local matrix of every node instance (16 floats each)
+    std::vector<AnimationClip> animations;      // Animations, indexed like the GLTF animations
+    std::vector<AnimationTrack> animationTracks; // Tracks of every animation
+    std::vector<float> animationTimes;          // Key times of the tracks, shared by tracks with the same input
+    std::vector<float> animationValues;         // Key values of the tracks
+    MappedFile backingFile;                     // Mapped cache file the blobs point into (cache hit only)
+};
+
+#endif // MESH_DATA_HPP
@@ -0,0 +1,315 @@
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    // Triangles using each vertex, stored as offsets into a flat triangle list
+    struct TriangleAdjacency
+    {
+        std::vector<uint32_t> counts;       // Live (not yet emitted) triangles per vertex
+        std::vector<uint32_t> offsets;      // First entry of every vertex in data
+        std::vector<uint32_t> data;         // Triangle indices
+    };
+
+    // Function to build the vertex -> triangles adjacency of a triangle list
+    void buildTriangleAdjacency(TriangleAdjacency& adjacency, const uint32_t* indices, size_t indexCount, size_t vertexCount)
+    {
+        adjacency.counts.assign(vertexCount, 0);
+        adjacency.offsets.assign(vertexCount, 0);
+        adjacency.data.resize(indexCount);
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            adjacency.counts[indices[i]]++;
+        }
+        uint32_t offset = 0;
+        for (size_t vertex = 0; vertex < vertexCount; vertex++)
+        {
+            adjacency.offsets[vertex] = offset;
+            offset += adjacency.counts[vertex];
+        }
+        // Fill the lists, using offsets as cursors and restoring them afterwards
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            adjacency.data[adjacency.offsets[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+        for (size_t vertex = 0; vertex < vertexCount; vertex++)
+        {
+            adjacency.offsets[vertex] -= adjacency.counts[vertex];
+        }
+    }
+
+    // Function to count the cache misses of a range of triangles on a FIFO cache.
+    // timestamps / time carry the cache state between calls
+    uint32_t countCacheMisses(const uint32_t* indices, size_t firstTriangle, size_t triangleCount, uint32_t cacheSize,
+                              std::vector<uint32_t>& timestamps, uint32_t& time)
+    {
+        uint32_t misses = 0;
+        for (size_t i = firstTriangle * 3; i < (firstTriangle + triangleCount) * 3; i++)
+        {
+            uint32_t vertex = indices[i];
+            if (time - timestamps[vertex] > cacheSize)
+            {
+                timestamps[vertex] = time++;
+                misses++;
+            }
+        }
+        return misses;
+    }
+}
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+{
+    VertexCacheStats stats;
+    stats.triangleCount = indexCount / 3;
+
+    // FIFO cache simulated with timestamps: a vertex is cached while fewer than cacheSize misses happened since it was loaded
+    std::vector<uint32_t> timestamps(vertexCount, 0);
+    std::vector<char> referenced(vertexCount, 0);
+    uint32_t time = cacheSize + 1;
+    stats.transformCount = countCacheMisses(indices, 0, stats.triangleCount, cacheSize, timestamps, time);
+    for (size_t i = 0; i < stats.triangleCount * 3; i++)
+    {
+        stats.vertexCount += referenced[indices[i]] ? 0 : 1;
+        referenced[indices[i]] = 1;
+    }
+    return stats;
+}
+
+void optimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                         uint32_t cacheSize, std::vector<uint32_t>& clusters)
+{
+    clusters.clear();
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    TriangleAdjacency adjacency;
+    buildTriangleAdjacency(adjacency, indices, triangleCount * 3, vertexCount);
+
+    std::vector<uint32_t> liveTriangles = adjacency.counts;
+    std::vector<uint32_t> timestamps(vertexCount, 0);
+    std::vector<char> emitted(triangleCount, 0);
+    std::vector<uint32_t> deadEnd;          // Recently used vertices, candidates when fanning gets stuck
+    std::vector<uint32_t> candidates;       // Vertices of the triangles emitted around the current fanning vertex
+    uint32_t time = cacheSize + 1;
+    size_t inputCursor = 0;                 // Next vertex to try once the dead-end stack is exhausted
+    size_t outputTriangle = 0;
+
+    int64_t fanningVertex = 0;
+    while (fanningVertex >= 0 && liveTriangles[fanningVertex] == 0)
+    {
+        fanningVertex = ++inputCursor < vertexCount ? static_cast<int64_t>(inputCursor) : -1;
+    }
+    clusters.push_back(0);
+
+    while (fanningVertex >= 0)
+    {
+        // Emit every remaining triangle around the fanning vertex
+        candidates.clear();
+        uint32_t begin = adjacency.offsets[fanningVertex];
+        uint32_t end = begin + adjacency.counts[fanningVertex];
+        for (uint32_t entry = begin; entry < end; entry++)
+        {
+            uint32_t triangle = adjacency.data[entry];
+            if (emitted[triangle])
+            {
+                continue;
+            }
+            emitted[triangle] = 1;
+            for (int corner = 0; corner < 3; corner++)
+            {
+                uint32_t vertex = indices[triangle * 3 + corner];
+                destination[outputTriangle * 3 + corner] = vertex;
+                deadEnd.push_back(vertex);
+                candidates.push_back(vertex);
+                liveTriangles[vertex]--;
+                if (time - timestamps[vertex] > cacheSize)
+                {
+                    timestamps[vertex] = time++;
+                }
+            }
+            outputTriangle++;
+        }
+
+        // Pick the candidate that will still be in the cache after emitting its remaining triangles
+        int64_t nextVertex = -1;
+        uint32_t bestPriority = 0;
+        bool foundPriority = false;
+        for (uint32_t vertex : candidates)
+        {
+            if (liveTriangles[vertex] == 0)
+            {
+                continue;
+            }
+            uint32_t priority = 0;
+            uint32_t age = time - timestamps[vertex];
+            if (age + 2 * liveTriangles[vertex] <= cacheSize)
+            {
+                priority = age;
+            }
+            if (!foundPriority || priority > bestPriority)
+            {
+                bestPriority = priority;
+                nextVertex = vertex;
+                foundPriority = true;
+            }
+        }
+
+        // Dead end: fall back to recently used vertices, then to the input order
+        if (nextVertex < 0)
+        {
+            while (!deadEnd.empty() && nextVertex < 0)
+            {
+                uint32_t vertex = deadEnd.back();
+                deadEnd.pop_back();
+                if (liveTriangles[vertex] > 0)
+                {
+                    nextVertex = vertex;
+                }
+            }
+            while (nextVertex < 0 && inputCursor < vertexCount)
+            {
+                if (liveTriangles[inputCursor] > 0)
+                {
+                    nextVertex = static_cast<int64_t>(inputCursor);
+                }
+                else
+                {
+                    inputCursor++;
+                }
+            }
+
+            // The cache contents are unrelated to the next triangles, start a new cluster
+            if (nextVertex >= 0)
+            {
+                clusters.push_back(static_cast<uint32_t>(outputTriangle));
+            }
+        }
+        fanningVertex = nextVertex;
+    }
+}
+
+void optimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions,
+                      size_t positionStride, size_t vertexCount, const std::vector<uint32_t>& clusters,
+                      uint32_t cacheSize, float threshold)
+{
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    // Split the hard clusters wherever the running miss ratio of the current cluster is already good enough
+    std::vector<uint32_t> timestamps(vertexCount, 0);
+    uint32_t time = cacheSize + 1;
+    float meshRatio = analyzeVertexCache(indices, triangleCount * 3, vertexCount, cacheSize).acmr();
+    std::vector<uint32_t> softClusters;
+    for (size_t clusterIdx = 0; clusterIdx < clusters.size(); clusterIdx++)
+    {
+        size_t clusterBegin = clusters[clusterIdx];
+        size_t clusterEnd = clusterIdx + 1 < clusters.size() ? clusters[clusterIdx + 1] : triangleCount;
+        softClusters.push_back(static_cast<uint32_t>(clusterBegin));
+
+        // Clusters are drawn in a new order, so each one starts with a cold cache
+        time += cacheSize + 1;
+        uint32_t misses = 0;
+        size_t start = clusterBegin;
+        for (size_t triangle = clusterBegin; triangle < clusterEnd; triangle++)
+        {
+            misses += countCacheMisses(indices, triangle, 1, cacheSize, timestamps, time);
+            if (triangle + 1 < clusterEnd && misses <= (triangle + 1 - start) * meshRatio * threshold)
+            {
+                softClusters.push_back(static_cast<uint32_t>(triangle + 1));
+                start = triangle + 1;
+                misses = 0;
+                time += cacheSize + 1;
+            }
+        }
+    }
+
+    // Area-weighted centroid and normal of every cluster, and centroid of the whole mesh
+    struct ClusterSortKey
+    {
+        float dot;
+        size_t cluster;
+    };
+    std::vector<float> clusterData(softClusters.size() * 7, 0.0f);     // centroid xyz, normal xyz, area
+    float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+    float meshArea = 0.0f;
+    for (size_t clusterIdx = 0; clusterIdx < softClusters.size(); clusterIdx++)
+    {
+        size_t clusterEnd = clusterIdx + 1 < softClusters.size() ? softClusters[clusterIdx + 1] : triangleCount;
+        float* data = &clusterData[clusterIdx * 7];
+        for (size_t triangle = softClusters[clusterIdx]; triangle < clusterEnd; triangle++)
+        {
+            const float* a = positions + indices[triangle * 3] * positionStride;
+            const float* b = positions + indices[triangle * 3 + 1] * positionStride;
+            const float* c = positions + indices[triangle * 3 + 2] * positionStride;
+            float ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            float ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+            float normal[3] = { ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0] };
+            float area = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            for (int axis = 0; axis < 3; axis++)
+            {
+                data[axis] += (a[axis] + b[axis] + c[axis]) / 3.0f * area;
+                data[3 + axis] += normal[axis];
+            }
+            data[6] += area;
+        }
+        for (int axis = 0; axis < 3; axis++)
+        {
+            meshCentroid[axis] += data[axis];
+            data[axis] = data[6] > 0.0f ? data[axis] / data[6] : 0.0f;
+        }
+        meshArea += data[6];
+    }
+    for (int axis = 0; axis < 3; axis++)
+    {
+        meshCentroid[axis] = meshArea > 0.0f ? meshCentroid[axis] / meshArea : 0.0f;
+    }
+
+    // Clusters facing away from the mesh center occlude the others, draw them first
+    std::vector<ClusterSortKey> keys(softClusters.size());
+    for (size_t clusterIdx = 0; clusterIdx < softClusters.size(); clusterIdx++)
+    {
+        const float* data = &clusterData[clusterIdx * 7];
+        float normalLength = std::sqrt(data[3] * data[3] + data[4] * data[4] + data[5] * data[5]);
+        float dot = 0.0f;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            dot += (data[axis] - meshCentroid[axis]) * (normalLength > 0.0f ? data[3 + axis] / normalLength : 0.0f);
+        }
+        keys[clusterIdx] = { dot, clusterIdx };
+    }
+    std::stable_sort(keys.begin(), keys.end(), [](const ClusterSortKey& a, const ClusterSortKey& b) {
+        return a.dot > b.dot;
+    });
+
+    size_t outputTriangle = 0;
+    for (const ClusterSortKey& key : keys)
+    {
+        size_t clusterBegin = softClusters[key.cluster];
+        size_t clusterEnd = key.cluster + 1 < softClusters.size() ? softClusters[key.cluster + 1] : triangleCount;
+        std::memcpy(destination + outputTriangle * 3, indices + clusterBegin * 3, (clusterEnd - clusterBegin) * 3 * sizeof(uint32_t));
+        outputTriangle += clusterEnd - clusterBegin;
+    }
+}
+
+size_t optimizeVertexFetchRemap(uint32_t* remap, const uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+    std::fill(remap, remap + vertexCount, UINT32_MAX);
+    uint32_t nextVertex = 0;
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        if (remap[indices[i]] == UINT32_MAX)
+        {
+            remap[indices[i]] = nextVertex++;
+        }
+    }
+    return nextVertex;
+}
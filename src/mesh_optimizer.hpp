@@ -0,0 +1,42 @@
+#ifndef MESH_OPTIMIZER_HPP
+#define MESH_OPTIMIZER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Post-transform vertex cache statistics of a triangle list
+struct VertexCacheStats
+{
+    size_t triangleCount = 0;       // Number of triangles
+    size_t vertexCount = 0;         // Number of distinct vertices referenced
+    size_t transformCount = 0;      // Number of vertex shader invocations (cache misses)
+
+    // Average cache miss ratio: transformed vertices per triangle (0.5 is optimal, 3 is worst)
+    float acmr() const { return triangleCount ? static_cast<float>(transformCount) / triangleCount : 0.0f; }
+    // Average transform to vertex ratio: transformed vertices per vertex (1 is optimal)
+    float atvr() const { return vertexCount ? static_cast<float>(transformCount) / vertexCount : 0.0f; }
+};
+
+// Function to simulate a FIFO post-transform cache of cacheSize entries over a triangle list
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize);
+
+// Function to reorder triangles for the post-transform cache (Tipsify, Sander et al. 2007).
+// destination must not alias indices. clusters receives the index of the first triangle of every
+// cluster: the points where the reordering restarted with a cold cache
+void optimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                         uint32_t cacheSize, std::vector<uint32_t>& clusters);
+
+// Function to sort the clusters produced by optimizeVertexCache so that outward-facing geometry is
+// drawn first, reducing overdraw (Sander et al. 2007, linear-speed sort).
+// Clusters are further split where their own miss ratio stays within threshold times the mesh ratio,
+// threshold = 1.05 trades at most 5% of the cache efficiency for overdraw
+void optimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions,
+                      size_t positionStride, size_t vertexCount, const std::vector<uint32_t>& clusters,
+                      uint32_t cacheSize, float threshold);
+
+// Function to build a remap table ordering vertices by first use, so that vertex fetches are sequential.
+// Unreferenced vertices are mapped to UINT32_MAX; returns the number of referenced vertices
+size_t optimizeVertexFetchRemap(uint32_t* remap, const uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+#endif // MESH_OPTIMIZER_HPP
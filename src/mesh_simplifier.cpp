@@ -0,0 +1,383 @@
+#include "mesh_simplifier.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    // Sum of squared distances to planes, weighted by the area of the triangles they come from:
+    // Q(p) = p^T A p + 2 b . p + c with A = n n^T, b = d n, c = d^2 for a plane n . p + d = 0
+    struct Quadric
+    {
+        float a00 = 0.0f, a11 = 0.0f, a22 = 0.0f, a01 = 0.0f, a02 = 0.0f, a12 = 0.0f;
+        float b0 = 0.0f, b1 = 0.0f, b2 = 0.0f;
+        float c = 0.0f;
+        float weight = 0.0f;        // Sum of the plane weights, the error is averaged over it
+    };
+
+    // Function to add a weighted plane (unit normal n, offset d) to a quadric
+    void addPlane(Quadric& quadric, const float n[3], float d, float weight)
+    {
+        quadric.a00 += weight * n[0] * n[0];
+        quadric.a11 += weight * n[1] * n[1];
+        quadric.a22 += weight * n[2] * n[2];
+        quadric.a01 += weight * n[0] * n[1];
+        quadric.a02 += weight * n[0] * n[2];
+        quadric.a12 += weight * n[1] * n[2];
+        quadric.b0 += weight * n[0] * d;
+        quadric.b1 += weight * n[1] * d;
+        quadric.b2 += weight * n[2] * d;
+        quadric.c += weight * d * d;
+        quadric.weight += weight;
+    }
+
+    // Function to add a quadric to another
+    void addQuadric(Quadric& quadric, const Quadric& other)
+    {
+        quadric.a00 += other.a00;
+        quadric.a11 += other.a11;
+        quadric.a22 += other.a22;
+        quadric.a01 += other.a01;
+        quadric.a02 += other.a02;
+        quadric.a12 += other.a12;
+        quadric.b0 += other.b0;
+        quadric.b1 += other.b1;
+        quadric.b2 += other.b2;
+        quadric.c += other.c;
+        quadric.weight += other.weight;
+    }
+
+    // Function to evaluate the sum of two quadrics at a point, as a mean squared distance
+    float evaluateQuadrics(const Quadric& a, const Quadric& b, const float p[3])
+    {
+        Quadric q = a;
+        addQuadric(q, b);
+        float value = q.a00 * p[0] * p[0] + q.a11 * p[1] * p[1] + q.a22 * p[2] * p[2] +
+                      2.0f * (q.a01 * p[0] * p[1] + q.a02 * p[0] * p[2] + q.a12 * p[1] * p[2]) +
+                      2.0f * (q.b0 * p[0] + q.b1 * p[1] + q.b2 * p[2]) + q.c;
+        return q.weight > 0.0f ? std::max(value, 0.0f) / q.weight : 0.0f;
+    }
+
+    // Function to get the (unnormalized) normal of a triangle
+    void getTriangleNormal(const float* a, const float* b, const float* c, float normal[3])
+    {
+        float ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+        float ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+        normal[0] = ab[1] * ac[2] - ab[2] * ac[1];
+        normal[1] = ab[2] * ac[0] - ab[0] * ac[2];
+        normal[2] = ab[0] * ac[1] - ab[1] * ac[0];
+    }
+
+    // Triangles using each vertex, rebuilt at every pass
+    struct VertexTriangles
+    {
+        std::vector<uint32_t> offsets;      // First entry of every vertex in triangles, plus the total
+        std::vector<uint32_t> triangles;    // Triangle indices
+    };
+
+    // Function to build the vertex -> triangles lists of a triangle list
+    void buildVertexTriangles(VertexTriangles& lists, const std::vector<uint32_t>& indices, size_t vertexCount)
+    {
+        lists.offsets.assign(vertexCount + 1, 0);
+        for (uint32_t index : indices)
+        {
+            lists.offsets[index + 1]++;
+        }
+        for (size_t vertex = 0; vertex < vertexCount; vertex++)
+        {
+            lists.offsets[vertex + 1] += lists.offsets[vertex];
+        }
+        lists.triangles.resize(indices.size());
+        std::vector<uint32_t> cursors(lists.offsets.begin(), lists.offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            lists.triangles[cursors[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    // Function to tell whether moving vertex u onto v keeps the surface sound: every triangle of u that survives keeps
+    // its orientation, and u and v share no neighbour besides the vertices opposite to their edge (link condition),
+    // which would fold the surface onto itself
+    bool canCollapse(uint32_t u, uint32_t v, const std::vector<uint32_t>& indices, const VertexTriangles& lists,
+                     const float* positions, std::vector<uint32_t>& scratch)
+    {
+        // Neighbours of v
+        scratch.clear();
+        for (uint32_t entry = lists.offsets[v]; entry < lists.offsets[v + 1]; entry++)
+        {
+            const uint32_t* triangle = &indices[static_cast<size_t>(lists.triangles[entry]) * 3];
+            for (int corner = 0; corner < 3; corner++)
+            {
+                if (triangle[corner] != v)
+                {
+                    scratch.push_back(triangle[corner]);
+                }
+            }
+        }
+        // Vertices opposite to the edge, shared legitimately
+        size_t neighbourCount = scratch.size();
+        for (uint32_t entry = lists.offsets[u]; entry < lists.offsets[u + 1]; entry++)
+        {
+            const uint32_t* triangle = &indices[static_cast<size_t>(lists.triangles[entry]) * 3];
+            if (triangle[0] == v || triangle[1] == v || triangle[2] == v)
+            {
+                for (int corner = 0; corner < 3; corner++)
+                {
+                    if (triangle[corner] != u && triangle[corner] != v)
+                    {
+                        scratch.push_back(triangle[corner]);
+                    }
+                }
+            }
+        }
+        auto isNeighbourOfV = [&](uint32_t vertex) {
+            return std::find(scratch.begin(), scratch.begin() + neighbourCount, vertex) != scratch.begin() + neighbourCount;
+        };
+        auto isOpposite = [&](uint32_t vertex) {
+            return std::find(scratch.begin() + neighbourCount, scratch.end(), vertex) != scratch.end();
+        };
+
+        for (uint32_t entry = lists.offsets[u]; entry < lists.offsets[u + 1]; entry++)
+        {
+            const uint32_t* triangle = &indices[static_cast<size_t>(lists.triangles[entry]) * 3];
+            if (triangle[0] == v || triangle[1] == v || triangle[2] == v)
+            {
+                continue;
+            }
+            const float* corners[3];
+            const float* moved[3];
+            for (int corner = 0; corner < 3; corner++)
+            {
+                uint32_t vertex = triangle[corner];
+                if (vertex != u && isNeighbourOfV(vertex) && !isOpposite(vertex))
+                {
+                    return false;
+                }
+                corners[corner] = positions + static_cast<size_t>(vertex) * 3;
+                moved[corner] = positions + static_cast<size_t>(vertex == u ? v : vertex) * 3;
+            }
+            float before[3], after[3];
+            getTriangleNormal(corners[0], corners[1], corners[2], before);
+            getTriangleNormal(moved[0], moved[1], moved[2], after);
+            if (before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0.0f)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Position key of a vertex, vertices with bitwise equal positions form a seam
+    struct PositionKey
+    {
+        uint32_t bits[3];
+        bool operator==(const PositionKey& other) const { return std::memcmp(bits, other.bits, sizeof(bits)) == 0; }
+    };
+
+    struct PositionKeyHash
+    {
+        size_t operator()(const PositionKey& key) const
+        {
+            return (key.bits[0] * 73856093u) ^ (key.bits[1] * 19349663u) ^ (key.bits[2] * 83492791u);
+        }
+    };
+}
+
+size_t simplifyMesh(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount,
+                    const float* attributes, size_t attributeStride, float attributeWeight, size_t targetIndexCount,
+                    float maxError, float& error)
+{
+    error = 0.0f;
+    std::vector<uint32_t> result(indices, indices + indexCount);
+
+    // Positions in a unit box, the errors do not depend on the size of the mesh
+    float boxMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float boxMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (uint32_t index : result)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            boxMin[axis] = std::min(boxMin[axis], positions[static_cast<size_t>(index) * 3 + axis]);
+            boxMax[axis] = std::max(boxMax[axis], positions[static_cast<size_t>(index) * 3 + axis]);
+        }
+    }
+    float extent = std::max(std::max(boxMax[0] - boxMin[0], boxMax[1] - boxMin[1]), boxMax[2] - boxMin[2]);
+    if (indexCount <= targetIndexCount || !(extent > 0.0f))
+    {
+        std::copy(result.begin(), result.end(), destination);
+        return result.size();
+    }
+    std::vector<float> unitPositions(vertexCount * 3);
+    for (size_t vertex = 0; vertex < vertexCount; vertex++)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            unitPositions[vertex * 3 + axis] = (positions[vertex * 3 + axis] - boxMin[axis]) / extent;
+        }
+    }
+
+    // Seams: a position shared by several vertices (split normals or texture coordinates)
+    std::vector<unsigned char> locked(vertexCount, 0);
+    std::unordered_map<PositionKey, uint32_t, PositionKeyHash> positionVertices;
+    for (size_t vertex = 0; vertex < vertexCount; vertex++)
+    {
+        PositionKey key;
+        std::memcpy(key.bits, positions + vertex * 3, sizeof(key.bits));
+        auto inserted = positionVertices.insert({ key, static_cast<uint32_t>(vertex) });
+        if (!inserted.second)
+        {
+            locked[vertex] = 1;
+            locked[inserted.first->second] = 1;
+        }
+    }
+    // Borders: edges used by a single triangle, and non-manifold edges used by more than two
+    std::unordered_map<uint64_t, uint32_t> edgeUses;
+    for (size_t i = 0; i < indexCount; i += 3)
+    {
+        for (int corner = 0; corner < 3; corner++)
+        {
+            uint64_t a = result[i + corner], b = result[i + (corner + 1) % 3];
+            edgeUses[a < b ? (a << 32) | b : (b << 32) | a]++;
+        }
+    }
+    for (const auto& edge : edgeUses)
+    {
+        if (edge.second != 2)
+        {
+            locked[edge.first >> 32] = 1;
+            locked[edge.first & 0xFFFFFFFFu] = 1;
+        }
+    }
+
+    // Planes of the original triangles around every vertex
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < indexCount; i += 3)
+    {
+        const float* corners[3] = { &unitPositions[static_cast<size_t>(result[i]) * 3], &unitPositions[static_cast<size_t>(result[i + 1]) * 3],
+                                    &unitPositions[static_cast<size_t>(result[i + 2]) * 3] };
+        float normal[3];
+        getTriangleNormal(corners[0], corners[1], corners[2], normal);
+        float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        if (length == 0.0f)
+        {
+            continue;
+        }
+        for (float& component : normal)
+        {
+            component /= length;
+        }
+        float d = -(normal[0] * corners[0][0] + normal[1] * corners[0][1] + normal[2] * corners[0][2]);
+        for (int corner = 0; corner < 3; corner++)
+        {
+            addPlane(quadrics[result[i + corner]], normal, d, length * 0.5f);
+        }
+    }
+
+    // Passes of independent collapses: the cheapest collapse of every vertex, applied in order of cost as long as
+    // the vertices around it were not changed by an earlier collapse of the same pass
+    float maxCost = maxError * maxError;
+    VertexTriangles lists;
+    std::vector<uint32_t> targets(vertexCount), remap(vertexCount), order, scratch;
+    std::vector<float> costs(vertexCount);
+    std::vector<unsigned char> touched(vertexCount);
+    while (result.size() > targetIndexCount)
+    {
+        buildVertexTriangles(lists, result, vertexCount);
+        std::fill(costs.begin(), costs.end(), FLT_MAX);
+        for (size_t i = 0; i < result.size(); i++)
+        {
+            uint32_t a = result[i];
+            uint32_t b = result[i - i % 3 + (i + 1) % 3];
+            for (int direction = 0; direction < 2; direction++)
+            {
+                uint32_t u = direction == 0 ? a : b;
+                uint32_t v = direction == 0 ? b : a;
+                if (locked[u])
+                {
+                    continue;
+                }
+                float cost = evaluateQuadrics(quadrics[u], quadrics[v], &unitPositions[static_cast<size_t>(v) * 3]);
+                for (size_t component = 0; attributes && component < attributeStride; component++)
+                {
+                    float difference = attributes[u * attributeStride + component] - attributes[v * attributeStride + component];
+                    cost += attributeWeight * difference * difference;
+                }
+                if (cost < costs[u])
+                {
+                    costs[u] = cost;
+                    targets[u] = v;
+                }
+            }
+        }
+        order.clear();
+        for (uint32_t vertex = 0; vertex < vertexCount; vertex++)
+        {
+            if (costs[vertex] <= maxCost)
+            {
+                order.push_back(vertex);
+            }
+        }
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return costs[a] < costs[b]; });
+
+        std::fill(touched.begin(), touched.end(), 0);
+        for (uint32_t vertex = 0; vertex < vertexCount; vertex++)
+        {
+            remap[vertex] = vertex;
+        }
+        size_t liveIndexCount = result.size();
+        bool collapsed = false;
+        for (uint32_t u : order)
+        {
+            if (liveIndexCount <= targetIndexCount)
+            {
+                break;
+            }
+            uint32_t v = targets[u];
+            if (touched[u] || touched[v] || !canCollapse(u, v, result, lists, unitPositions.data(), scratch))
+            {
+                continue;
+            }
+            for (uint32_t entry = lists.offsets[u]; entry < lists.offsets[u + 1]; entry++)
+            {
+                const uint32_t* triangle = &result[static_cast<size_t>(lists.triangles[entry]) * 3];
+                bool removed = triangle[0] == v || triangle[1] == v || triangle[2] == v;
+                liveIndexCount -= removed ? 3 : 0;
+                for (int corner = 0; corner < 3; corner++)
+                {
+                    touched[triangle[corner]] = 1;
+                }
+            }
+            touched[v] = 1;
+            remap[u] = v;
+            addQuadric(quadrics[v], quadrics[u]);
+            error = std::max(error, costs[u]);
+            collapsed = true;
+        }
+        if (!collapsed)
+        {
+            break;
+        }
+
+        // Move the collapsed vertices and drop the triangles that became degenerate
+        size_t written = 0;
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            uint32_t a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+            if (a != b && b != c && a != c)
+            {
+                result[written++] = a;
+                result[written++] = b;
+                result[written++] = c;
+            }
+        }
+        result.resize(written);
+    }
+
+    error = std::sqrt(error);
+    std::copy(result.begin(), result.end(), destination);
+    return result.size();
+}
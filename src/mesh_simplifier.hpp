@@ -0,0 +1,21 @@
+#ifndef MESH_SIMPLIFIER_HPP
+#define MESH_SIMPLIFIER_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Function to simplify a triangle list by collapsing edges in order of quadric error (Garland & Heckbert 1997).
+// Collapses are half-edge collapses: a vertex merges into one of its neighbours, so the result indexes the same
+// vertices and needs no new vertex data. Errors are measured with the positions scaled to a unit box, as the
+// distance to the planes of the original triangles around the merged vertices; attributes (attributeStride floats
+// per vertex, such as the normal and texture coordinates) add attributeWeight times the squared difference of the
+// merged vertices. Vertices on open borders and on attribute seams (a position shared by several vertices) never
+// move, so no crack opens between the two sides of a seam.
+// Stops once at most targetIndexCount indices are left or when the next collapse would exceed maxError.
+// destination (indexCount entries) may alias indices; returns the index count of the result and error receives
+// the largest error of the applied collapses
+size_t simplifyMesh(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount,
+                    const float* attributes, size_t attributeStride, float attributeWeight, size_t targetIndexCount,
+                    float maxError, float& error);
+
+#endif // MESH_SIMPLIFIER_HPP
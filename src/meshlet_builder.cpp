@@ -0,0 +1,147 @@
+#include "meshlet_builder.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Normal cones narrower than this (cosine of the widest normal angle) are worth testing
+    const float kMinConeSpread = 0.1f;
+
+    // Function to get the squared distance between two points
+    float getDistanceSquared(const float* a, const float* b)
+    {
+        float dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+        return dx * dx + dy * dy + dz * dz;
+    }
+
+    // Function to find a sphere around a set of vertices (Ritter 1990): the two farthest apart of three extreme
+    // points seed the sphere, which grows to take every vertex left outside
+    void computeBoundingSphere(const std::vector<uint32_t>& vertices, const float* positions, float center[3], float& radius)
+    {
+        const float* first = positions + static_cast<size_t>(vertices[0]) * 3;
+        const float* a = first;
+        for (uint32_t vertex : vertices)
+        {
+            const float* p = positions + static_cast<size_t>(vertex) * 3;
+            a = getDistanceSquared(p, first) > getDistanceSquared(a, first) ? p : a;
+        }
+        const float* b = a;
+        for (uint32_t vertex : vertices)
+        {
+            const float* p = positions + static_cast<size_t>(vertex) * 3;
+            b = getDistanceSquared(p, a) > getDistanceSquared(b, a) ? p : b;
+        }
+        for (int axis = 0; axis < 3; axis++)
+        {
+            center[axis] = (a[axis] + b[axis]) * 0.5f;
+        }
+        radius = std::sqrt(getDistanceSquared(a, b)) * 0.5f;
+        for (uint32_t vertex : vertices)
+        {
+            const float* p = positions + static_cast<size_t>(vertex) * 3;
+            float distance = std::sqrt(getDistanceSquared(p, center));
+            if (distance > radius)
+            {
+                // Move the center toward the point by half the overshoot, the far side of the sphere stays put
+                float grow = (distance - radius) * 0.5f;
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    center[axis] += (p[axis] - center[axis]) * (grow / distance);
+                }
+                radius += grow;
+            }
+        }
+    }
+
+    // Function to compute the bounds of the triangles [firstTriangle, firstTriangle + triangleCount) of an index list
+    void computeMeshletBounds(const uint32_t* indices, const float* positions, const std::vector<uint32_t>& vertices,
+                              Meshlet& meshlet)
+    {
+        computeBoundingSphere(vertices, positions, meshlet.center, meshlet.radius);
+
+        // Cone axis: the area-weighted average normal; its spread: the widest angle to a triangle normal
+        std::vector<float> normals(static_cast<size_t>(meshlet.triangleCount) * 3, 0.0f);
+        float axis[3] = { 0.0f, 0.0f, 0.0f };
+        for (uint32_t triangle = 0; triangle < meshlet.triangleCount; triangle++)
+        {
+            const uint32_t* corners = indices + (static_cast<size_t>(meshlet.firstTriangle) + triangle) * 3;
+            const float* p0 = positions + static_cast<size_t>(corners[0]) * 3;
+            const float* p1 = positions + static_cast<size_t>(corners[1]) * 3;
+            const float* p2 = positions + static_cast<size_t>(corners[2]) * 3;
+            float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            float* normal = &normals[static_cast<size_t>(triangle) * 3];
+            normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+            normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+            normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+            for (int component = 0; component < 3; component++)
+            {
+                axis[component] += normal[component];
+            }
+        }
+        float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+        float minDot = axisLength > 0.0f ? 1.0f : -1.0f;
+        for (uint32_t triangle = 0; triangle < meshlet.triangleCount && axisLength > 0.0f; triangle++)
+        {
+            const float* normal = &normals[static_cast<size_t>(triangle) * 3];
+            float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            if (length > 0.0f)
+            {
+                float dot = (normal[0] * axis[0] + normal[1] * axis[1] + normal[2] * axis[2]) / (length * axisLength);
+                minDot = std::min(minDot, dot);
+            }
+        }
+        for (int component = 0; component < 3; component++)
+        {
+            meshlet.coneAxis[component] = axisLength > 0.0f ? axis[component] / axisLength : 0.0f;
+        }
+        meshlet.coneCutoff = minDot > kMinConeSpread ? std::sqrt(1.0f - minDot * minDot) : 1.0f;
+    }
+}
+
+size_t buildMeshlets(const uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount,
+                     std::vector<Meshlet>& meshlets)
+{
+    size_t firstMeshlet = meshlets.size();
+    std::vector<uint32_t> vertexMeshlets(vertexCount, UINT32_MAX);  // Last meshlet using every vertex
+    std::vector<uint32_t> vertices;                                 // Vertices of the current meshlet
+    Meshlet meshlet = {};
+    uint32_t meshletId = 0;
+    size_t triangleCount = indexCount / 3;
+    for (size_t triangle = 0; triangle < triangleCount; triangle++)
+    {
+        const uint32_t* corners = indices + triangle * 3;
+        uint32_t newVertices = 0;
+        for (int corner = 0; corner < 3; corner++)
+        {
+            bool repeated = (corner > 0 && corners[corner] == corners[0]) || (corner > 1 && corners[corner] == corners[1]);
+            newVertices += vertexMeshlets[corners[corner]] != meshletId && !repeated ? 1 : 0;
+        }
+        if (meshlet.triangleCount > 0 &&
+            (vertices.size() + newVertices > kMeshletMaxVertices || meshlet.triangleCount + 1 > kMeshletMaxTriangles))
+        {
+            computeMeshletBounds(indices, positions, vertices, meshlet);
+            meshlets.push_back(meshlet);
+            meshlet = {};
+            meshlet.firstTriangle = static_cast<uint32_t>(triangle);
+            vertices.clear();
+            meshletId++;
+        }
+        for (int corner = 0; corner < 3; corner++)
+        {
+            if (vertexMeshlets[corners[corner]] != meshletId)
+            {
+                vertexMeshlets[corners[corner]] = meshletId;
+                vertices.push_back(corners[corner]);
+            }
+        }
+        meshlet.triangleCount++;
+    }
+    if (meshlet.triangleCount > 0)
+    {
+        computeMeshletBounds(indices, positions, vertices, meshlet);
+        meshlets.push_back(meshlet);
+    }
+    return meshlets.size() - firstMeshlet;
+}
@@ -0,0 +1,21 @@
+#ifndef MESHLET_BUILDER_HPP
+#define MESHLET_BUILDER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "mesh_data.hpp"
+
+// Limits of a meshlet, the sizes mesh shading hardware works with: clusters small enough to be culled
+// precisely, large enough that the per-cluster tests stay cheap next to the triangles they remove
+const uint32_t kMeshletMaxVertices = 64;
+const uint32_t kMeshletMaxTriangles = 124;
+
+// Function to cut a triangle list into meshlets of consecutive triangles, in the order of the list (which the
+// vertex cache optimization keeps spatially coherent), and to compute their bounding spheres and normal cones.
+// A meshlet ends when its next triangle would exceed kMeshletMaxVertices or kMeshletMaxTriangles.
+// The meshlets are appended to meshlets; returns how many were appended
+size_t buildMeshlets(const uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount,
+                     std::vector<Meshlet>& meshlets);
+
+#endif // MESHLET_BUILDER_HPP
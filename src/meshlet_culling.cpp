@@ -0,0 +1,348 @@
+#include "meshlet_culling.hpp"
+
+#include <GLES3/gl3.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "frustum_culling.hpp"
+#include "thread_pool.hpp"
+#include "transform_math.hpp"
+
+namespace
+{
+    // Meshlets tested per task of the worker pool
+    const size_t kMeshletsPerTask = 256;
+    // Largest relative difference between the axis scales of a matrix considered uniform
+    const float kUniformScaleTolerance = 1e-3f;
+
+    // Function to get the size of an index type in bytes
+    size_t getIndexTypeSize(uint32_t indexType)
+    {
+        return indexType == GL_UNSIGNED_INT ? 4 : (indexType == GL_UNSIGNED_SHORT ? 2 : 1);
+    }
+
+    // Function to tell whether a draw of the list is drawn once at full detail with meshlets: its index range is the
+    // one the meshlets cover, a simplified level is shorter
+    bool hasFullDetailMeshlets(const DrawCommand& draw, const MeshData& meshData, const SceneGraph& graph)
+    {
+        if (draw.meshletCount == 0 || draw.skin != kNoSkin || draw.node >= graph.nodeSlots.size())
+        {
+            return false;
+        }
+        const Meshlet& last = meshData.meshlets[draw.firstMeshlet + draw.meshletCount - 1];
+        return (static_cast<size_t>(last.firstTriangle) + last.triangleCount) * 3 == draw.indexCount;
+    }
+
+    // Function to find the copy of the full-detail index range starting at an index buffer offset, null if it has none
+    const MeshletIndexRange* findIndexRange(const MeshletCullingState& state, uint32_t indexOffset)
+    {
+        auto range = std::lower_bound(state.indexRanges.begin(), state.indexRanges.end(), indexOffset,
+                                      [](const MeshletIndexRange& a, uint32_t offset) { return a.indexOffset < offset; });
+        return range != state.indexRanges.end() && range->indexOffset == indexOffset ? &*range : nullptr;
+    }
+
+    // Function to get the largest axis scale of a world matrix, negated when the matrix is not a rotation with a
+    // uniform scale (the normal cones do not survive shears and non-uniform scales)
+    float getConeScale(const float matrix[16])
+    {
+        float lengths[3];
+        for (int column = 0; column < 3; column++)
+        {
+            const float* axis = matrix + column * 4;
+            lengths[column] = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+        }
+        float scale = std::max(lengths[0], std::max(lengths[1], lengths[2]));
+        float tolerance = scale * kUniformScaleTolerance;
+        bool uniform = scale - std::min(lengths[0], std::min(lengths[1], lengths[2])) <= tolerance;
+        for (int a = 0; a < 3 && uniform; a++)
+        {
+            const float* u = matrix + a * 4;
+            const float* v = matrix + ((a + 1) % 3) * 4;
+            uniform = std::fabs(u[0] * v[0] + u[1] * v[1] + u[2] * v[2]) <= tolerance * scale;
+        }
+        return uniform ? scale : -scale;
+    }
+}
+
+size_t initMeshletCulling(MeshletCullingState& state, IndexRingGLContext& ring, const MeshData& meshData)
+{
+    // Every draw with meshlets may be visible at full detail with all of them, each padded to its index size.
+    // The draws of a primitive share its range, which is copied once
+    size_t sectionSize = 0;
+    state.indexBytes.clear();
+    state.indexRanges.clear();
+    const unsigned char* indices = static_cast<const unsigned char*>(meshData.indices.bytes.data);
+    for (const DrawCommand& draw : meshData.draws)
+    {
+        if (draw.meshletCount == 0)
+        {
+            continue;
+        }
+        size_t indexSize = getIndexTypeSize(draw.indexType);
+        size_t rangeSize = static_cast<size_t>(draw.indexCount) * indexSize;
+        sectionSize += rangeSize + indexSize - 1;
+        if (!findIndexRange(state, draw.indexOffset))
+        {
+            auto range = std::lower_bound(state.indexRanges.begin(), state.indexRanges.end(), draw.indexOffset,
+                                          [](const MeshletIndexRange& a, uint32_t offset) { return a.indexOffset < offset; });
+            state.indexRanges.insert(range, { draw.indexOffset, static_cast<uint32_t>(state.indexBytes.size()) });
+            state.indexBytes.insert(state.indexBytes.end(), indices + draw.indexOffset, indices + draw.indexOffset + rangeSize);
+        }
+    }
+    state.indexBytes.shrink_to_fit();
+    if (sectionSize == 0)
+    {
+        return 0;
+    }
+
+    // Sections start on 4-byte boundaries, which suits every index type
+    ring.sectionSize = (sectionSize + 3) / 4 * 4;
+    ring.section = 0;
+    glGenBuffers(1, &ring.buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ring.buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(ring.sectionSize * kIndexRingSections), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return ring.sectionSize * kIndexRingSections;
+}
+
+size_t getMeshletCullingMemory(const MeshletCullingState& state)
+{
+    return state.indexBytes.capacity() + state.indexRanges.capacity() * sizeof(MeshletIndexRange) +
+           (state.jobs.capacity() + state.firstFlags.capacity() + state.outputCounts.capacity()) * sizeof(uint32_t) +
+           state.visible.capacity() + state.outputOffsets.capacity() * sizeof(size_t);
+}
+
+uint32_t cullMeshlets(MeshletCullingState& state, IndexRingGLContext& ring, const MeshData& meshData, const SceneGraph& graph,
+                      const float viewProjection[16], InstancedDrawList& list)
+{
+    list.ringIndices.assign(list.draws.size(), 0);
+    if (!ring.buffer)
+    {
+        return 0;
+    }
+
+    // Draws whose meshlets are tested, and the place of their flags
+    state.jobs.clear();
+    state.firstFlags.clear();
+    for (uint32_t entry = 0; entry < list.draws.size(); entry++)
+    {
+        if (list.instanceCounts[entry] == 0 && hasFullDetailMeshlets(list.draws[entry], meshData, graph) &&
+            findIndexRange(state, list.draws[entry].indexOffset))
+        {
+            state.firstFlags.push_back(state.jobs.empty() ? 0 : state.firstFlags.back() + list.draws[state.jobs.back()].meshletCount);
+            state.jobs.push_back(entry);
+        }
+    }
+    if (state.jobs.empty())
+    {
+        return 0;
+    }
+    state.firstFlags.push_back(state.firstFlags.back() + list.draws[state.jobs.back()].meshletCount);
+    state.visible.resize(state.firstFlags.back());
+
+    // Frustum planes normalized, so that their distances compare with the sphere radii
+    Frustum frustum;
+    extractFrustumPlanes(viewProjection, frustum);
+    for (float* plane : frustum.planes)
+    {
+        float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        for (int component = 0; component < 4; component++)
+        {
+            plane[component] = length > 0.0f ? plane[component] / length : 0.0f;
+        }
+    }
+
+    // Camera: the point whose clip position is (0, 0, 1, 0) up to a scale. A perspective camera maps it to the eye,
+    // an orthographic one leaves it at infinity along the view direction
+    float inverse[16];
+    bool hasCamera = invertMatrix(viewProjection, inverse);
+    float camera[3] = { inverse[8], inverse[9], inverse[10] };
+    float cameraLength = std::sqrt(camera[0] * camera[0] + camera[1] * camera[1] + camera[2] * camera[2]);
+    bool perspective = std::fabs(inverse[11]) > cameraLength * 1e-6f;
+    for (int axis = 0; axis < 3 && hasCamera; axis++)
+    {
+        camera[axis] = perspective ? camera[axis] / inverse[11] : (cameraLength > 0.0f ? camera[axis] / cameraLength : 0.0f);
+    }
+
+    size_t flagCount = state.visible.size();
+    size_t taskCount = (flagCount + kMeshletsPerTask - 1) / kMeshletsPerTask;
+    getWorkerPool().parallelFor(taskCount, [&](size_t task) {
+        size_t flag = task * kMeshletsPerTask;
+        size_t endFlag = std::min(flag + kMeshletsPerTask, flagCount);
+        size_t job = std::upper_bound(state.firstFlags.begin(), state.firstFlags.end(), static_cast<uint32_t>(flag)) - state.firstFlags.begin() - 1;
+        const float* world = nullptr;
+        float scale = 0.0f;
+        size_t jobEnd = 0;
+        for (; flag < endFlag; flag++)
+        {
+            if (!world || flag >= jobEnd)
+            {
+                while (state.firstFlags[job + 1] <= flag)
+                {
+                    job++;
+                }
+                world = getNodeWorldMatrix(graph, list.draws[state.jobs[job]].node);
+                scale = getConeScale(world);
+                jobEnd = state.firstFlags[job + 1];
+            }
+            const DrawCommand& draw = list.draws[state.jobs[job]];
+            const Meshlet& meshlet = meshData.meshlets[draw.firstMeshlet + (flag - state.firstFlags[job])];
+
+            float center[3];
+            for (int row = 0; row < 3; row++)
+            {
+                center[row] = world[12 + row] + world[row] * meshlet.center[0] + world[4 + row] * meshlet.center[1] +
+                              world[8 + row] * meshlet.center[2];
+            }
+            float radius = meshlet.radius * std::fabs(scale);
+            bool visible = true;
+            for (const float* plane : frustum.planes)
+            {
+                visible = visible && plane[0] * center[0] + plane[1] * center[1] + plane[2] * center[2] + plane[3] >= -radius;
+            }
+
+            // Back-facing when every direction from the camera to the sphere is within the cone of the normals
+            if (visible && hasCamera && scale > 0.0f && meshlet.coneCutoff < 1.0f)
+            {
+                float axis[3], dot = 0.0f;
+                for (int row = 0; row < 3; row++)
+                {
+                    axis[row] = (world[row] * meshlet.coneAxis[0] + world[4 + row] * meshlet.coneAxis[1] +
+                                 world[8 + row] * meshlet.coneAxis[2]) / scale;
+                }
+                if (perspective)
+                {
+                    float view[3] = { center[0] - camera[0], center[1] - camera[1], center[2] - camera[2] };
+                    float distance = std::sqrt(view[0] * view[0] + view[1] * view[1] + view[2] * view[2]);
+                    dot = view[0] * axis[0] + view[1] * axis[1] + view[2] * axis[2];
+                    visible = dot < meshlet.coneCutoff * distance + radius;
+                }
+                else
+                {
+                    dot = camera[0] * axis[0] + camera[1] * axis[1] + camera[2] * axis[2];
+                    visible = dot < meshlet.coneCutoff;
+                }
+            }
+            state.visible[flag] = visible ? 1 : 0;
+        }
+    });
+
+    // Place the compacted ranges, aligned to their index size as GL requires
+    state.outputOffsets.resize(state.jobs.size());
+    state.outputCounts.resize(state.jobs.size());
+    size_t sectionBytes = 0;
+    for (size_t job = 0; job < state.jobs.size(); job++)
+    {
+        const DrawCommand& draw = list.draws[state.jobs[job]];
+        size_t indexSize = getIndexTypeSize(draw.indexType);
+        uint32_t indexCount = 0;
+        for (uint32_t meshletIdx = 0; meshletIdx < draw.meshletCount; meshletIdx++)
+        {
+            indexCount += state.visible[state.firstFlags[job] + meshletIdx] ? meshData.meshlets[draw.firstMeshlet + meshletIdx].triangleCount * 3 : 0;
+        }
+        sectionBytes = (sectionBytes + indexSize - 1) / indexSize * indexSize;
+        state.outputOffsets[job] = sectionBytes;
+        state.outputCounts[job] = indexCount;
+        sectionBytes += indexCount * indexSize;
+    }
+    if (sectionBytes > ring.sectionSize)
+    {
+        return 0;
+    }
+
+    // The GPU may still read this section for the frame kIndexRingSections - 1 frames back
+    GLsync fence = static_cast<GLsync>(ring.fences[ring.section]);
+    if (fence)
+    {
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+        {
+        }
+        glDeleteSync(fence);
+        ring.fences[ring.section] = nullptr;
+    }
+
+    size_t sectionOffset = static_cast<size_t>(ring.section) * ring.sectionSize;
+    bool written = sectionBytes == 0;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ring.buffer);
+    unsigned char* output = sectionBytes == 0 ? nullptr :
+        static_cast<unsigned char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(sectionOffset),
+                                                     static_cast<GLsizeiptr>(sectionBytes),
+                                                     GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+    if (output)
+    {
+        // Consecutive visible meshlets are consecutive triangles, they are copied as one run
+        getWorkerPool().parallelFor(state.jobs.size(), [&](size_t job) {
+            const DrawCommand& draw = list.draws[state.jobs[job]];
+            size_t triangleSize = getIndexTypeSize(draw.indexType) * 3;
+            const unsigned char* source = &state.indexBytes[findIndexRange(state, draw.indexOffset)->copyOffset];
+            unsigned char* destination = output + state.outputOffsets[job];
+            uint32_t meshletIdx = 0;
+            while (meshletIdx < draw.meshletCount)
+            {
+                if (!state.visible[state.firstFlags[job] + meshletIdx])
+                {
+                    meshletIdx++;
+                    continue;
+                }
+                uint32_t firstTriangle = meshData.meshlets[draw.firstMeshlet + meshletIdx].firstTriangle;
+                uint32_t triangleCount = 0;
+                while (meshletIdx < draw.meshletCount && state.visible[state.firstFlags[job] + meshletIdx])
+                {
+                    triangleCount += meshData.meshlets[draw.firstMeshlet + meshletIdx].triangleCount;
+                    meshletIdx++;
+                }
+                std::memcpy(destination, source + firstTriangle * triangleSize, triangleCount * triangleSize);
+                destination += triangleCount * triangleSize;
+            }
+        });
+        // The contents of a buffer can be lost while it is mapped (GL_FALSE), the draws then keep their full range
+        written = glUnmapBuffer(GL_COPY_WRITE_BUFFER) == GL_TRUE;
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    if (!written)
+    {
+        return 0;
+    }
+
+    // Point the draws at their compacted ranges, draws left without triangles leave the list
+    uint32_t culledTriangles = 0;
+    for (size_t job = 0; job < state.jobs.size(); job++)
+    {
+        DrawCommand& draw = list.draws[state.jobs[job]];
+        culledTriangles += (draw.indexCount - state.outputCounts[job]) / 3;
+        draw.indexOffset = static_cast<uint32_t>(sectionOffset + state.outputOffsets[job]);
+        draw.indexCount = state.outputCounts[job];
+        list.ringIndices[state.jobs[job]] = 1;
+    }
+    size_t kept = 0;
+    for (size_t entry = 0; entry < list.draws.size(); entry++)
+    {
+        if (list.draws[entry].indexCount > 0)
+        {
+            list.draws[kept] = list.draws[entry];
+            list.firstInstances[kept] = list.firstInstances[entry];
+            list.instanceCounts[kept] = list.instanceCounts[entry];
+            list.ringIndices[kept] = list.ringIndices[entry];
+            kept++;
+        }
+    }
+    list.draws.resize(kept);
+    list.firstInstances.resize(kept);
+    list.instanceCounts.resize(kept);
+    list.ringIndices.resize(kept);
+    return culledTriangles;
+}
+
+void fenceIndexRing(IndexRingGLContext& ring)
+{
+    if (!ring.buffer)
+    {
+        return;
+    }
+    if (ring.fences[ring.section])
+    {
+        glDeleteSync(static_cast<GLsync>(ring.fences[ring.section]));
+    }
+    ring.fences[ring.section] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    ring.section = (ring.section + 1) % kIndexRingSections;
+}
@@ -0,0 +1,61 @@
+#ifndef MESHLET_CULLING_HPP
+#define MESHLET_CULLING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "draw_instancing.hpp"
+#include "mesh_data.hpp"
+#include "scene_graph.hpp"
+
+// Sections of the index ring: the CPU fills one while the GPU may still read the two previous frames
+const uint32_t kIndexRingSections = 3;
+
+// Full-detail index range of the draws with meshlets inside MeshletCullingState::indexBytes
+struct MeshletIndexRange
+{
+    uint32_t indexOffset;                   // Byte offset of the range in the index buffer
+    uint32_t copyOffset;                    // Byte offset of its copy in indexBytes
+};
+
+// CPU side of the meshlet culling: the index bytes the visible meshlets are copied from, and per-frame scratch
+struct MeshletCullingState
+{
+    std::vector<unsigned char> indexBytes;  // Copies of the index ranges of the draws with meshlets, nothing else
+    std::vector<MeshletIndexRange> indexRanges; // Ranges of indexBytes, sorted by index buffer offset
+    std::vector<uint32_t> jobs;             // Entries of the draw list culled this frame
+    std::vector<uint32_t> firstFlags;       // First visibility flag of every job, plus the total flag count
+    std::vector<unsigned char> visible;     // Visibility of the meshlets of the jobs
+    std::vector<size_t> outputOffsets;      // Byte offset of the compacted indices of every job in the section
+    std::vector<uint32_t> outputCounts;     // Index count of the compacted indices of every job
+};
+
+// Element array buffer receiving the compacted index ranges, split into kIndexRingSections sections written in turn
+struct IndexRingGLContext
+{
+    uint32_t buffer = 0;                        // Buffer object of the ring
+    size_t sectionSize = 0;                     // Bytes of a section, every draw with meshlets fits at full detail
+    uint32_t section = 0;                       // Section written by the current frame
+    void* fences[kIndexRingSections] = {};      // GLsync of the draws reading every section, null once signaled
+};
+
+// Function to copy the index ranges of the draws with meshlets and create the ring when there are some.
+// Must run before the CPU copy of the indices is released; returns the GPU storage of the ring in bytes
+size_t initMeshletCulling(MeshletCullingState& state, IndexRingGLContext& ring, const MeshData& meshData);
+
+// Function to get the CPU memory held by the meshlet culling, the index copies and the scratch
+size_t getMeshletCullingMemory(const MeshletCullingState& state);
+
+// Function to cull the meshlets of the draws of a draw list that are drawn once at full detail (instanced batches and
+// simplified levels keep their index range), on the worker pool. A meshlet is dropped when its bounding sphere is
+// outside the view frustum or when its normal cone faces away from the camera (only under rotations and uniform
+// scales, which keep the cone). The indices of the remaining meshlets are packed into the current ring section, and
+// the draws are rewritten to read them there (InstancedDrawList::ringIndices).
+// Returns the number of triangles culled
+uint32_t cullMeshlets(MeshletCullingState& state, IndexRingGLContext& ring, const MeshData& meshData, const SceneGraph& graph,
+                      const float viewProjection[16], InstancedDrawList& list);
+
+// Function to fence the ring section written this frame, once the draws reading it are submitted, and move to the next
+void fenceIndexRing(IndexRingGLContext& ring);
+
+#endif // MESHLET_CULLING_HPP
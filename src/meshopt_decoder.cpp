@@ -0,0 +1,541 @@
+#include "meshopt_decoder.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MESHOPT_DECODER_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define MESHOPT_DECODER_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+    // Vertex codec constants (meshoptimizer vertexcodec.cpp, bitstream version 0)
+    const unsigned char kVertexHeader = 0xa0;
+    const size_t kVertexBlockSizeBytes = 8192;
+    const size_t kVertexBlockMaxSize = 256;
+    const size_t kByteGroupSize = 16;
+    const size_t kByteGroupDecodeLimit = 24;
+    const size_t kVertexTailMaxSize = 32;
+
+    // Index codec constants (meshoptimizer indexcodec.cpp)
+    const unsigned char kIndexHeader = 0xe0;
+    const unsigned char kSequenceHeader = 0xd0;
+
+    // Function to get the number of vertices encoded per block for a vertex size
+    size_t getVertexBlockSize(size_t vertexSize)
+    {
+        size_t result = (kVertexBlockSizeBytes / vertexSize) & ~(kByteGroupSize - 1);
+        return result < kVertexBlockMaxSize ? result : kVertexBlockMaxSize;
+    }
+
+    // Function to decode one group of 16 bytes stored with 0, 2, 4 or 8 bits per byte.
+    // 2 and 4 bit values with all bits set are escapes: the real byte follows the packed bits
+    const unsigned char* decodeBytesGroup(const unsigned char* data, unsigned char* buffer, int bitsLog2)
+    {
+        switch (bitsLog2)
+        {
+        case 0:
+            std::memset(buffer, 0, kByteGroupSize);
+            return data;
+        case 1:
+        case 2:
+        {
+            int bits = 1 << bitsLog2;
+            unsigned char escape = static_cast<unsigned char>((1 << bits) - 1);
+            const unsigned char* escaped = data + kByteGroupSize * bits / 8;
+            for (size_t i = 0; i < kByteGroupSize; i++)
+            {
+                // Values are packed from the most significant bits of every byte
+                size_t bitOffset = i * bits;
+                unsigned char value = static_cast<unsigned char>((data[bitOffset / 8] >> (8 - bits - bitOffset % 8)) & escape);
+                buffer[i] = value == escape ? *escaped++ : value;
+            }
+            return escaped;
+        }
+        default:
+            std::memcpy(buffer, data, kByteGroupSize);
+            return data + kByteGroupSize;
+        }
+    }
+
+    // Function to decode bufferSize bytes (multiple of 16): a 2-bit mode per group, then the groups
+    const unsigned char* decodeBytes(const unsigned char* data, const unsigned char* dataEnd, unsigned char* buffer, size_t bufferSize)
+    {
+        size_t headerSize = (bufferSize / kByteGroupSize + 3) / 4;
+        if (static_cast<size_t>(dataEnd - data) < headerSize)
+        {
+            return nullptr;
+        }
+        const unsigned char* header = data;
+        data += headerSize;
+
+        for (size_t i = 0; i < bufferSize; i += kByteGroupSize)
+        {
+            // A group reads at most 24 bytes; the tail of the stream guarantees they are in range
+            if (static_cast<size_t>(dataEnd - data) < kByteGroupDecodeLimit)
+            {
+                return nullptr;
+            }
+            size_t group = i / kByteGroupSize;
+            int bitsLog2 = (header[group / 4] >> ((group % 4) * 2)) & 3;
+            data = decodeBytesGroup(data, buffer + i, bitsLog2);
+        }
+        return data;
+    }
+
+    // Function to turn zigzag deltas of one byte channel into values, 16 vertices at a time.
+    // Writes count values vertexSize bytes apart and returns the last one
+    unsigned char decodeDeltas(const unsigned char* deltas, size_t count, unsigned char previous,
+                               unsigned char* destination, size_t vertexSize)
+    {
+        size_t i = 0;
+#if defined(MESHOPT_DECODER_SSE2) || defined(MESHOPT_DECODER_NEON)
+        // deltas holds a multiple of 16 bytes, so the last group may be decoded whole
+        alignas(16) unsigned char values[kByteGroupSize];
+        for (; i < count; i += kByteGroupSize)
+        {
+#if defined(MESHOPT_DECODER_SSE2)
+            __m128i encoded = _mm_loadu_si128(reinterpret_cast<const __m128i*>(deltas + i));
+            // unzigzag: (v >> 1) ^ -(v & 1)
+            __m128i half = _mm_and_si128(_mm_srli_epi16(encoded, 1), _mm_set1_epi8(0x7F));
+            __m128i sign = _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(encoded, _mm_set1_epi8(1)));
+            __m128i sum = _mm_xor_si128(half, sign);
+            // Inclusive prefix sum over the 16 bytes, then add the last value of the previous group
+            sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 1));
+            sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 2));
+            sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 4));
+            sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 8));
+            sum = _mm_add_epi8(sum, _mm_set1_epi8(static_cast<char>(previous)));
+            _mm_store_si128(reinterpret_cast<__m128i*>(values), sum);
+#else
+            uint8x16_t encoded = vld1q_u8(deltas + i);
+            uint8x16_t zero = vdupq_n_u8(0);
+            uint8x16_t sum = veorq_u8(vshrq_n_u8(encoded, 1), vsubq_u8(zero, vandq_u8(encoded, vdupq_n_u8(1))));
+            sum = vaddq_u8(sum, vextq_u8(zero, sum, 15));
+            sum = vaddq_u8(sum, vextq_u8(zero, sum, 14));
+            sum = vaddq_u8(sum, vextq_u8(zero, sum, 12));
+            sum = vaddq_u8(sum, vextq_u8(zero, sum, 8));
+            sum = vaddq_u8(sum, vdupq_n_u8(previous));
+            vst1q_u8(values, sum);
+#endif
+            size_t groupCount = std::min(kByteGroupSize, count - i);
+            for (size_t k = 0; k < groupCount; k++)
+            {
+                destination[(i + k) * vertexSize] = values[k];
+            }
+            previous = values[groupCount - 1];
+        }
+#else
+        for (; i < count; i++)
+        {
+            unsigned char delta = static_cast<unsigned char>((deltas[i] >> 1) ^ (0 - (deltas[i] & 1)));
+            previous = static_cast<unsigned char>(previous + delta);
+            destination[i * vertexSize] = previous;
+        }
+#endif
+        return previous;
+    }
+
+    // Function to decode one block of vertices: every byte of the vertex is stored as a separate
+    // channel of deltas against the previous vertex (lastVertex for the first one)
+    const unsigned char* decodeVertexBlock(const unsigned char* data, const unsigned char* dataEnd, unsigned char* vertexData,
+                                           size_t vertexCount, size_t vertexSize, unsigned char lastVertex[256])
+    {
+        unsigned char deltas[kVertexBlockMaxSize];
+        size_t alignedCount = (vertexCount + kByteGroupSize - 1) & ~(kByteGroupSize - 1);
+        for (size_t k = 0; k < vertexSize; k++)
+        {
+            data = decodeBytes(data, dataEnd, deltas, alignedCount);
+            if (!data)
+            {
+                return nullptr;
+            }
+            lastVertex[k] = decodeDeltas(deltas, vertexCount, lastVertex[k], vertexData + k, vertexSize);
+        }
+        return data;
+    }
+
+    unsigned int decodeVByte(const unsigned char*& data)
+    {
+        unsigned char lead = *data++;
+        if (lead < 128)
+        {
+            return lead;
+        }
+        // Little-endian groups of 7 bits, at most 5 bytes
+        unsigned int result = lead & 127;
+        unsigned int shift = 7;
+        for (int i = 0; i < 4; i++)
+        {
+            unsigned char group = *data++;
+            result |= static_cast<unsigned int>(group & 127) << shift;
+            shift += 7;
+            if (group < 128)
+            {
+                break;
+            }
+        }
+        return result;
+    }
+
+    // Function to decode a zigzag delta against the last explicit index
+    unsigned int decodeIndex(const unsigned char*& data, unsigned int last)
+    {
+        unsigned int value = decodeVByte(data);
+        unsigned int delta = (value >> 1) ^ (0u - (value & 1));
+        return last + delta;
+    }
+
+    void writeIndex(unsigned char* destination, size_t position, size_t indexSize, unsigned int index)
+    {
+        if (indexSize == 2)
+        {
+            uint16_t shortIndex = static_cast<uint16_t>(index);
+            std::memcpy(destination + position * 2, &shortIndex, sizeof(shortIndex));
+        }
+        else
+        {
+            uint32_t intIndex = index;
+            std::memcpy(destination + position * 4, &intIndex, sizeof(intIndex));
+        }
+    }
+
+    // FIFOs of the index codec: recent vertices and recent edges, 16 entries each
+    struct IndexFifos
+    {
+        unsigned int vertices[16];
+        unsigned int edges[16][2];
+        size_t vertexOffset = 0;
+        size_t edgeOffset = 0;
+
+        void pushVertex(unsigned int vertex, bool condition = true)
+        {
+            vertices[vertexOffset] = vertex;
+            vertexOffset = (vertexOffset + (condition ? 1 : 0)) & 15;
+        }
+        void pushEdge(unsigned int a, unsigned int b)
+        {
+            edges[edgeOffset][0] = a;
+            edges[edgeOffset][1] = b;
+            edgeOffset = (edgeOffset + 1) & 15;
+        }
+    };
+
+    // Function to convert a float to a rounded signed integer
+    int roundToInt(float value)
+    {
+        return static_cast<int>(value + (value >= 0.0f ? 0.5f : -0.5f));
+    }
+
+    template <typename T>
+    void decodeOctahedralFilter(T* data, size_t count)
+    {
+        const float maximum = static_cast<float>((1 << (sizeof(T) * 8 - 1)) - 1);
+        for (size_t i = 0; i < count; i++)
+        {
+            // The third component holds the value encoding 1.0 at the precision used by the encoder
+            float x = static_cast<float>(data[i * 4 + 0]);
+            float y = static_cast<float>(data[i * 4 + 1]);
+            float z = static_cast<float>(data[i * 4 + 2]) - std::fabs(x) - std::fabs(y);
+
+            // Unfold the lower hemisphere
+            float t = z < 0.0f ? -z : 0.0f;
+            x += x >= 0.0f ? -t : t;
+            y += y >= 0.0f ? -t : t;
+
+            float length = std::sqrt(x * x + y * y + z * z);
+            float scale = length > 0.0f ? maximum / length : 0.0f;
+            data[i * 4 + 0] = static_cast<T>(roundToInt(x * scale));
+            data[i * 4 + 1] = static_cast<T>(roundToInt(y * scale));
+            data[i * 4 + 2] = static_cast<T>(roundToInt(z * scale));
+        }
+    }
+
+    void decodeQuaternionFilter(int16_t* data, size_t count)
+    {
+        const float scale = 1.0f / std::sqrt(2.0f);
+        for (size_t i = 0; i < count; i++)
+        {
+            // The fourth component holds the scale in its high bits and the dropped component in its low 2 bits
+            int scaleBits = data[i * 4 + 3] | 3;
+            float componentScale = scale / static_cast<float>(scaleBits);
+            float x = static_cast<float>(data[i * 4 + 0]) * componentScale;
+            float y = static_cast<float>(data[i * 4 + 1]) * componentScale;
+            float z = static_cast<float>(data[i * 4 + 2]) * componentScale;
+            float ww = 1.0f - x * x - y * y - z * z;
+            float w = std::sqrt(ww >= 0.0f ? ww : 0.0f);
+
+            int dropped = data[i * 4 + 3] & 3;
+            data[i * 4 + ((dropped + 1) & 3)] = static_cast<int16_t>(roundToInt(x * 32767.0f));
+            data[i * 4 + ((dropped + 2) & 3)] = static_cast<int16_t>(roundToInt(y * 32767.0f));
+            data[i * 4 + ((dropped + 3) & 3)] = static_cast<int16_t>(roundToInt(z * 32767.0f));
+            data[i * 4 + ((dropped + 0) & 3)] = static_cast<int16_t>(roundToInt(w * 32767.0f));
+        }
+    }
+
+    void decodeExponentialFilter(unsigned char* data, size_t valueCount)
+    {
+        for (size_t i = 0; i < valueCount; i++)
+        {
+            // Signed 8-bit exponent in the high byte, signed 24-bit mantissa below
+            int32_t packed;
+            std::memcpy(&packed, data + i * 4, sizeof(packed));
+            int exponent = packed >> 24;
+            int32_t mantissa = static_cast<int32_t>(static_cast<uint32_t>(packed) << 8) >> 8;
+            float value = std::ldexp(static_cast<float>(mantissa), exponent);
+            std::memcpy(data + i * 4, &value, sizeof(value));
+        }
+    }
+}
+
+bool decodeMeshoptVertexBuffer(unsigned char* destination, size_t count, size_t byteStride,
+                               const unsigned char* source, size_t sourceSize)
+{
+    if (byteStride == 0 || byteStride > 256 || byteStride % 4 != 0)
+    {
+        return false;
+    }
+    size_t tailSize = std::max(byteStride, kVertexTailMaxSize);
+    if (sourceSize < 1 + tailSize || source[0] != kVertexHeader)
+    {
+        return false;
+    }
+
+    const unsigned char* data = source + 1;
+    const unsigned char* dataEnd = source + sourceSize;
+
+    // The tail holds the baseline the first vertex is delta-encoded against
+    unsigned char lastVertex[256];
+    std::memcpy(lastVertex, dataEnd - byteStride, byteStride);
+
+    size_t blockSize = getVertexBlockSize(byteStride);
+    for (size_t vertexOffset = 0; vertexOffset < count; vertexOffset += blockSize)
+    {
+        size_t blockCount = std::min(blockSize, count - vertexOffset);
+        data = decodeVertexBlock(data, dataEnd, destination + vertexOffset * byteStride, blockCount, byteStride, lastVertex);
+        if (!data)
+        {
+            return false;
+        }
+    }
+    return static_cast<size_t>(dataEnd - data) == tailSize;
+}
+
+bool decodeMeshoptIndexBuffer(unsigned char* destination, size_t count, size_t indexSize,
+                              const unsigned char* source, size_t sourceSize)
+{
+    if (count % 3 != 0 || (indexSize != 2 && indexSize != 4) || sourceSize < 1 + count / 3 + 16 ||
+        (source[0] & 0xF0) != kIndexHeader || (source[0] & 0x0F) > 1)
+    {
+        return false;
+    }
+    int version = source[0] & 0x0F;
+
+    IndexFifos fifos;
+    std::fill(&fifos.vertices[0], &fifos.vertices[0] + 16, ~0u);
+    std::fill(&fifos.edges[0][0], &fifos.edges[0][0] + 32, ~0u);
+    unsigned int next = 0;  // Next vertex never referenced before
+    unsigned int last = 0;  // Last explicitly encoded index
+    int fecMax = version >= 1 ? 13 : 15;
+
+    // One code byte per triangle, then the variable length data, then a 16-byte code table
+    const unsigned char* code = source + 1;
+    const unsigned char* data = code + count / 3;
+    const unsigned char* dataSafeEnd = source + sourceSize - 16;
+    const unsigned char* codeAuxTable = dataSafeEnd;
+
+    for (size_t i = 0; i < count; i += 3)
+    {
+        // Each triangle reads at most 16 bytes of data, which the code table guarantees are in range
+        if (data > dataSafeEnd)
+        {
+            return false;
+        }
+
+        unsigned char codeTriangle = *code++;
+        if (codeTriangle < 0xF0)
+        {
+            // Triangle sharing an edge (a, b) with a recent triangle
+            int fe = codeTriangle >> 4;
+            unsigned int a = fifos.edges[(fifos.edgeOffset - 1 - fe) & 15][0];
+            unsigned int b = fifos.edges[(fifos.edgeOffset - 1 - fe) & 15][1];
+            int fec = codeTriangle & 15;
+            if (fec < fecMax)
+            {
+                // Third vertex is new (0) or recent in the vertex FIFO
+                unsigned int c = fec == 0 ? next : fifos.vertices[(fifos.vertexOffset - 1 - fec) & 15];
+                bool isNext = fec == 0;
+                next += isNext ? 1 : 0;
+                writeIndex(destination, i + 0, indexSize, a);
+                writeIndex(destination, i + 1, indexSize, b);
+                writeIndex(destination, i + 2, indexSize, c);
+                fifos.pushVertex(c, isNext);
+                fifos.pushEdge(c, b);
+                fifos.pushEdge(a, c);
+            }
+            else
+            {
+                // Third vertex is last - 1 (13), last + 1 (14) or explicit (15)
+                unsigned int c = fec != 15 ? last + (fec - (fec ^ 3)) : decodeIndex(data, last);
+                last = c;
+                writeIndex(destination, i + 0, indexSize, a);
+                writeIndex(destination, i + 1, indexSize, b);
+                writeIndex(destination, i + 2, indexSize, c);
+                fifos.pushVertex(c);
+                fifos.pushEdge(c, b);
+                fifos.pushEdge(a, c);
+            }
+        }
+        else
+        {
+            // Triangle without a recent edge; a is new, b and c come from the vertex FIFO, are new or explicit
+            unsigned char codeAux;
+            int fea = 0;
+            if (codeTriangle < 0xFE)
+            {
+                codeAux = codeAuxTable[codeTriangle & 15];
+            }
+            else
+            {
+                codeAux = *data++;
+                fea = codeTriangle == 0xFE ? 0 : 15;
+                // An explicit zero aux code restarts the numbering of new vertices
+                if (codeAux == 0)
+                {
+                    next = 0;
+                }
+            }
+            int feb = codeAux >> 4;
+            int fec = codeAux & 15;
+
+            // next is advanced for all three vertices before the explicit indices are decoded, like the encoder does
+            unsigned int a = fea == 0 ? next++ : 0;
+            unsigned int b = feb == 0 ? next++ : fifos.vertices[(fifos.vertexOffset - feb) & 15];
+            unsigned int c = fec == 0 ? next++ : fifos.vertices[(fifos.vertexOffset - fec) & 15];
+            if (fea == 15)
+            {
+                last = a = decodeIndex(data, last);
+            }
+            if (feb == 15)
+            {
+                last = b = decodeIndex(data, last);
+            }
+            if (fec == 15)
+            {
+                last = c = decodeIndex(data, last);
+            }
+
+            writeIndex(destination, i + 0, indexSize, a);
+            writeIndex(destination, i + 1, indexSize, b);
+            writeIndex(destination, i + 2, indexSize, c);
+            fifos.pushVertex(a);
+            fifos.pushVertex(b, feb == 0 || feb == 15);
+            fifos.pushVertex(c, fec == 0 || fec == 15);
+            fifos.pushEdge(b, a);
+            fifos.pushEdge(c, b);
+            fifos.pushEdge(a, c);
+        }
+    }
+
+    // All the data must have been consumed, up to the code table
+    return data == dataSafeEnd;
+}
+
+bool decodeMeshoptIndexSequence(unsigned char* destination, size_t count, size_t indexSize,
+                                const unsigned char* source, size_t sourceSize)
+{
+    if ((indexSize != 2 && indexSize != 4) || sourceSize < 1 + count + 4 ||
+        (source[0] & 0xF0) != kSequenceHeader || (source[0] & 0x0F) > 1)
+    {
+        return false;
+    }
+
+    const unsigned char* data = source + 1;
+    const unsigned char* dataSafeEnd = source + sourceSize - 4;
+
+    // Two baselines; the low bit of every code selects the one the delta applies to
+    unsigned int last[2] = { 0, 0 };
+    for (size_t i = 0; i < count; i++)
+    {
+        // Each index reads at most 5 bytes, the 4-byte tail keeps them in range
+        if (data >= dataSafeEnd)
+        {
+            return false;
+        }
+        unsigned int value = decodeVByte(data);
+        unsigned int baseline = value & 1;
+        value >>= 1;
+        unsigned int delta = (value >> 1) ^ (0u - (value & 1));
+        unsigned int index = last[baseline] + delta;
+        last[baseline] = index;
+        writeIndex(destination, i, indexSize, index);
+    }
+    return data == dataSafeEnd;
+}
+
+bool applyMeshoptFilter(MeshoptFilter filter, unsigned char* data, size_t count, size_t byteStride)
+{
+    switch (filter)
+    {
+    case MeshoptFilter::None:
+        return true;
+    case MeshoptFilter::Octahedral:
+        if (byteStride == 4)
+        {
+            decodeOctahedralFilter(reinterpret_cast<int8_t*>(data), count);
+            return true;
+        }
+        if (byteStride == 8)
+        {
+            decodeOctahedralFilter(reinterpret_cast<int16_t*>(data), count);
+            return true;
+        }
+        return false;
+    case MeshoptFilter::Quaternion:
+        if (byteStride != 8)
+        {
+            return false;
+        }
+        decodeQuaternionFilter(reinterpret_cast<int16_t*>(data), count);
+        return true;
+    case MeshoptFilter::Exponential:
+        if (byteStride % 4 != 0)
+        {
+            return false;
+        }
+        decodeExponentialFilter(data, count * byteStride / 4);
+        return true;
+    }
+    return false;
+}
+
+bool parseMeshoptFilter(const std::string& name, MeshoptFilter& filter)
+{
+    if (name.empty() || name == "NONE")
+    {
+        filter = MeshoptFilter::None;
+    }
+    else if (name == "OCTAHEDRAL")
+    {
+        filter = MeshoptFilter::Octahedral;
+    }
+    else if (name == "QUATERNION")
+    {
+        filter = MeshoptFilter::Quaternion;
+    }
+    else if (name == "EXPONENTIAL")
+    {
+        filter = MeshoptFilter::Exponential;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,36 @@
+#ifndef MESHOPT_DECODER_HPP
+#define MESHOPT_DECODER_HPP
+
+#include <cstddef>
+#include <string>
+
+// Post-decoding filters of EXT_meshopt_compression
+enum class MeshoptFilter
+{
+    None,
+    Octahedral,     // Octahedral encoded unit vectors (normals, tangents), 4 x int8 or 4 x int16
+    Quaternion,     // Unit quaternions with the largest component dropped, 4 x int16
+    Exponential,    // Floats stored as 8-bit exponent and 24-bit mantissa
+};
+
+// Function to decode a vertex buffer of the meshopt vertex codec (mode ATTRIBUTES, header 0xa0).
+// byteStride must be a multiple of 4 up to 256, destination receives count * byteStride bytes
+bool decodeMeshoptVertexBuffer(unsigned char* destination, size_t count, size_t byteStride,
+                               const unsigned char* source, size_t sourceSize);
+
+// Function to decode a triangle list of the meshopt index codec (mode TRIANGLES, header 0xe0 / 0xe1).
+// indexSize is 2 or 4, count must be a multiple of 3
+bool decodeMeshoptIndexBuffer(unsigned char* destination, size_t count, size_t indexSize,
+                              const unsigned char* source, size_t sourceSize);
+
+// Function to decode an index sequence of the meshopt index codec (mode INDICES, header 0xd1)
+bool decodeMeshoptIndexSequence(unsigned char* destination, size_t count, size_t indexSize,
+                                const unsigned char* source, size_t sourceSize);
+
+// Function to apply a filter in place on count decoded elements of byteStride bytes
+bool applyMeshoptFilter(MeshoptFilter filter, unsigned char* data, size_t count, size_t byteStride);
+
+// Function to parse the filter name of the extension, returns false for unknown names
+bool parseMeshoptFilter(const std::string& name, MeshoptFilter& filter);
+
+#endif // MESHOPT_DECODER_HPP
@@ -0,0 +1,224 @@
+#include "scene_graph.hpp"
+
+#include <GLES3/gl3.h>
+#include <iostream>
+#include <utility>
+#include "transform_math.hpp"
+
+namespace
+{
+    // Function to extend a range of slots (empty when begin >= end) to cover [begin, end)
+    void extendSlotRange(uint32_t& rangeBegin, uint32_t& rangeEnd, uint32_t begin, uint32_t end)
+    {
+        if (rangeBegin >= rangeEnd)
+        {
+            rangeBegin = begin;
+            rangeEnd = end;
+            return;
+        }
+        rangeBegin = std::min(rangeBegin, begin);
+        rangeEnd = std::max(rangeEnd, end);
+    }
+}
+
+void buildSceneGraph(const std::vector<SceneNode>& nodes, SceneGraph& graph)
+{
+    uint32_t nodeCount = static_cast<uint32_t>(nodes.size());
+
+    // Children of every node, in node order; a parent outside the nodes makes a root
+    std::vector<uint32_t> childOffsets(nodeCount + 1, 0);
+    auto getParent = [&](uint32_t node) {
+        int32_t parent = nodes[node].parent;
+        return parent >= 0 && static_cast<uint32_t>(parent) < nodeCount && static_cast<uint32_t>(parent) != node ? parent : -1;
+    };
+    for (uint32_t node = 0; node < nodeCount; node++)
+    {
+        int32_t parent = getParent(node);
+        if (parent >= 0)
+        {
+            childOffsets[parent + 1]++;
+        }
+    }
+    for (uint32_t node = 0; node < nodeCount; node++)
+    {
+        childOffsets[node + 1] += childOffsets[node];
+    }
+    std::vector<uint32_t> children(childOffsets[nodeCount]);
+    std::vector<uint32_t> childCursors(childOffsets.begin(), childOffsets.end() - 1);
+    for (uint32_t node = 0; node < nodeCount; node++)
+    {
+        int32_t parent = getParent(node);
+        if (parent >= 0)
+        {
+            children[childCursors[parent]++] = node;
+        }
+    }
+
+    // Depth-first walk from the roots, then from the nodes of parent cycles that no root reaches
+    graph.nodeSlots.assign(nodeCount, UINT32_MAX);
+    graph.slotNodes.clear();
+    graph.parents.clear();
+    std::vector<std::pair<uint32_t, int32_t>> stack;    // Node and slot of its parent
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (uint32_t start = 0; start < nodeCount; start++)
+        {
+            if (graph.nodeSlots[start] != UINT32_MAX || (pass == 0 && getParent(start) >= 0))
+            {
+                continue;
+            }
+            stack.push_back({ start, -1 });
+            while (!stack.empty())
+            {
+                std::pair<uint32_t, int32_t> entry = stack.back();
+                stack.pop_back();
+                if (graph.nodeSlots[entry.first] != UINT32_MAX)
+                {
+                    continue;
+                }
+                int32_t slot = static_cast<int32_t>(graph.slotNodes.size());
+                graph.nodeSlots[entry.first] = static_cast<uint32_t>(slot);
+                graph.slotNodes.push_back(entry.first);
+                graph.parents.push_back(entry.second);
+                // Pushed in reverse so that children keep their order
+                for (uint32_t child = childOffsets[entry.first + 1]; child-- > childOffsets[entry.first];)
+                {
+                    stack.push_back({ children[child], slot });
+                }
+            }
+        }
+    }
+
+    // Descendants follow their ancestor, a subtree ends where the last of them does
+    graph.subtreeEnds.resize(nodeCount);
+    for (uint32_t slot = 0; slot < nodeCount; slot++)
+    {
+        graph.subtreeEnds[slot] = slot + 1;
+    }
+    for (uint32_t slot = nodeCount; slot-- > 0;)
+    {
+        if (graph.parents[slot] >= 0)
+        {
+            uint32_t& parentEnd = graph.subtreeEnds[graph.parents[slot]];
+            parentEnd = std::max(parentEnd, graph.subtreeEnds[slot]);
+        }
+    }
+
+    for (int c = 0; c < 4; c++)
+    {
+        if (c < 3)
+        {
+            graph.translations[c].resize(nodeCount);
+            graph.scales[c].resize(nodeCount);
+        }
+        graph.rotations[c].resize(nodeCount);
+    }
+    for (uint32_t slot = 0; slot < nodeCount; slot++)
+    {
+        const SceneNode& node = nodes[graph.slotNodes[slot]];
+        for (int c = 0; c < 4; c++)
+        {
+            if (c < 3)
+            {
+                graph.translations[c][slot] = node.translation[c];
+                graph.scales[c][slot] = node.scale[c];
+            }
+            graph.rotations[c][slot] = node.rotation[c];
+        }
+    }
+
+    uint32_t rows = (nodeCount + kNodeMatrixTextureNodesPerRow - 1) / kNodeMatrixTextureNodesPerRow;
+    graph.worldMatrices.assign(static_cast<size_t>(rows) * kNodeMatrixTextureNodesPerRow * 16, 0.0f);
+    graph.dirty.assign(nodeCount, 1);
+    graph.dirtyBegin = 0;
+    graph.dirtyEnd = nodeCount;
+    graph.changedBegin = 0;
+    graph.changedEnd = 0;
+}
+
+bool updateSceneGraph(SceneGraph& graph)
+{
+    if (graph.dirtyBegin >= graph.dirtyEnd)
+    {
+        return false;
+    }
+
+    // A dirty slot recomputes its whole subtree, then the walk resumes after it: clean subtrees
+    // inside the range only cost a flag test, the rest of the graph is not visited at all
+    uint32_t slot = graph.dirtyBegin;
+    while (slot < graph.dirtyEnd)
+    {
+        if (!graph.dirty[slot])
+        {
+            slot++;
+            continue;
+        }
+        uint32_t subtreeEnd = graph.subtreeEnds[slot];
+        for (uint32_t current = slot; current < subtreeEnd; current++)
+        {
+            float translation[3] = { graph.translations[0][current], graph.translations[1][current], graph.translations[2][current] };
+            float rotation[4] = { graph.rotations[0][current], graph.rotations[1][current], graph.rotations[2][current],
+                                  graph.rotations[3][current] };
+            float scale[3] = { graph.scales[0][current], graph.scales[1][current], graph.scales[2][current] };
+            float* world = &graph.worldMatrices[static_cast<size_t>(current) * 16];
+            composeMatrix(translation, rotation, scale, world);
+            // Parents precede their children, the parent's world matrix is already up to date
+            int32_t parent = graph.parents[current];
+            if (parent >= 0)
+            {
+                multiplyMatrices(&graph.worldMatrices[static_cast<size_t>(parent) * 16], world, world);
+            }
+            graph.dirty[current] = 0;
+        }
+        extendSlotRange(graph.changedBegin, graph.changedEnd, slot, subtreeEnd);
+        slot = subtreeEnd;
+    }
+    graph.dirtyBegin = 0;
+    graph.dirtyEnd = 0;
+    return true;
+}
+
+void createNodeMatrixTexture(NodeMatrixGLContext& context, const SceneGraph& graph)
+{
+    context.rows = static_cast<uint32_t>(graph.worldMatrices.size() / (kNodeMatrixTextureNodesPerRow * 16));
+    if (context.rows == 0)
+    {
+        return;
+    }
+    GLint maxTextureSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    if (context.rows > static_cast<uint32_t>(maxTextureSize))
+    {
+        std::cerr << "World matrices need " << context.rows << " texture rows, more than " << maxTextureSize
+                  << ": nodes are drawn without their transform" << std::endl;
+        context.rows = 0;
+        return;
+    }
+
+    glGenTextures(1, &context.texture);
+    glActiveTexture(GL_TEXTURE0 + kNodeMatrixTextureUnit);
+    glBindTexture(GL_TEXTURE_2D, context.texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, kNodeMatrixTextureNodesPerRow * 4, context.rows);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void uploadNodeMatrices(NodeMatrixGLContext& context, SceneGraph& graph)
+{
+    if (!context.texture || graph.changedBegin >= graph.changedEnd)
+    {
+        return;
+    }
+    // Whole rows between the first and the last changed slot, in one call
+    uint32_t firstRow = graph.changedBegin / kNodeMatrixTextureNodesPerRow;
+    uint32_t endRow = (graph.changedEnd - 1) / kNodeMatrixTextureNodesPerRow + 1;
+    glActiveTexture(GL_TEXTURE0 + kNodeMatrixTextureUnit);
+    glBindTexture(GL_TEXTURE_2D, context.texture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, static_cast<GLint>(firstRow), kNodeMatrixTextureNodesPerRow * 4,
+                    static_cast<GLsizei>(endRow - firstRow), GL_RGBA, GL_FLOAT,
+                    &graph.worldMatrices[static_cast<size_t>(firstRow) * kNodeMatrixTextureNodesPerRow * 16]);
+    glActiveTexture(GL_TEXTURE0);
+    graph.changedBegin = 0;
+    graph.changedEnd = 0;
+}
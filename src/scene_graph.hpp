@@ -0,0 +1,79 @@
+#ifndef SCENE_GRAPH_HPP
+#define SCENE_GRAPH_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "mesh_data.hpp"
+
+// Texture unit of the world matrix texture, below the morph delta and joint palette textures
+const uint32_t kNodeMatrixTextureUnit = 13;
+// Nodes per row of the world matrix texture (4 RGBA32F texels per node)
+const uint32_t kNodeMatrixTextureNodesPerRow = 64;
+
+// Scene graph flattened for the per-frame transform update.
+// Nodes are stored in depth-first order: a parent always precedes its children and the descendants of a
+// node fill the slots right after it, up to subtreeEnds. Local transforms are kept as one plane per
+// component, world matrices as consecutive column-major matrices (in the layout of the GPU texture).
+// Changing a local transform only flags its slot; updateSceneGraph recomputes the flagged subtrees
+struct SceneGraph
+{
+    std::vector<uint32_t> nodeSlots;        // Slot of every node, indexed like MeshData::nodes
+    std::vector<uint32_t> slotNodes;        // Node stored in every slot
+    std::vector<int32_t> parents;           // Parent slot, -1 for roots
+    std::vector<uint32_t> subtreeEnds;      // One past the last slot of the subtree of every slot
+    std::vector<float> translations[3];     // Local transform planes (x, y, z), applied as T * R * S
+    std::vector<float> rotations[4];        // Unit quaternion planes (x, y, z, w)
+    std::vector<float> scales[3];
+    std::vector<float> worldMatrices;       // 16 floats per slot, padded to full texture rows
+    std::vector<unsigned char> dirty;       // Local transform changed since the last update
+    uint32_t dirtyBegin = 0;                // Range of slots that may be flagged dirty
+    uint32_t dirtyEnd = 0;
+    uint32_t changedBegin = 0;              // Range of slots whose world matrix changed since the last upload
+    uint32_t changedEnd = 0;
+};
+
+// Function to flatten the nodes of a mesh into a scene graph, every world matrix starts dirty.
+// Nodes of a malformed hierarchy (parent cycle) are treated as roots
+void buildSceneGraph(const std::vector<SceneNode>& nodes, SceneGraph& graph);
+
+// Function to flag the local transform of a slot as changed
+inline void markSceneGraphSlotDirty(SceneGraph& graph, uint32_t slot)
+{
+    graph.dirty[slot] = 1;
+    if (graph.dirtyBegin >= graph.dirtyEnd)
+    {
+        graph.dirtyBegin = slot;
+        graph.dirtyEnd = slot + 1;
+    }
+    else
+    {
+        graph.dirtyBegin = std::min(graph.dirtyBegin, slot);
+        graph.dirtyEnd = std::max(graph.dirtyEnd, slot + 1);
+    }
+}
+
+// Function to recompute the world matrices of the dirty subtrees in one pass over the dirty range.
+// Returns false when no local transform changed since the previous call
+bool updateSceneGraph(SceneGraph& graph);
+
+// Function to get the world matrix of a node (16 floats)
+inline const float* getNodeWorldMatrix(const SceneGraph& graph, uint32_t node)
+{
+    return &graph.worldMatrices[static_cast<size_t>(graph.nodeSlots[node]) * 16];
+}
+
+// GPU copy of the world matrices, read by the shader prelude with the slot of the draw's node
+struct NodeMatrixGLContext
+{
+    uint32_t texture = 0;                   // RGBA32F texture, 4 texels per node
+    uint32_t rows = 0;                      // Rows of the texture
+};
+
+// Function to create the world matrix texture of a scene graph and bind it to kNodeMatrixTextureUnit
+void createNodeMatrixTexture(NodeMatrixGLContext& context, const SceneGraph& graph);
+
+// Function to upload the texture rows holding the world matrices changed since the last upload
+void uploadNodeMatrices(NodeMatrixGLContext& context, SceneGraph& graph);
+
+#endif // SCENE_GRAPH_HPP
@@ -0,0 +1,216 @@
+#include "scene_loader.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <utility>
+#include "material_reader.hpp"
+#include "mesh_cache.hpp"
+#include "scene_graph.hpp"
+#include "shader_prelude.hpp"
+#include "texture_atlas.hpp"
+#include "thread_pool.hpp"
+
+namespace
+{
+    // Function to read a whole text file, returns an empty string if it cannot be opened
+    std::string readTextFile(const std::string& path)
+    {
+        std::ifstream file(path);
+        if (!file.is_open())
+        {
+            return std::string();
+        }
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        return buffer.str();
+    }
+
+    // Function to list the files a mesh cache of an asset depends on besides the asset itself: its external buffers
+    // and its image files, whose sizes decide the atlas layout and the texture coordinates baked into the cache.
+    // Images inside the asset or an external buffer are already covered, missing image files have nothing to hash
+    std::vector<std::filesystem::path> getMeshCacheDependencies(const GltfAsset& asset, const std::filesystem::path& gltfPath)
+    {
+        std::vector<std::filesystem::path> dependencies = asset.externalFiles;
+        for (const FileRange& image : asset.images)
+        {
+            std::filesystem::path imagePath(image.path);
+            std::error_code error;
+            if (image.path.empty() || imagePath == gltfPath || !std::filesystem::is_regular_file(imagePath, error) ||
+                std::find(dependencies.begin(), dependencies.end(), imagePath) != dependencies.end())
+            {
+                continue;
+            }
+            dependencies.push_back(imagePath);
+        }
+        return dependencies;
+    }
+
+    // Function to run every step of a scene load on the calling thread
+    std::unique_ptr<LoadedScene> loadScene(const SceneLoadRequest& request)
+    {
+        auto scene = std::make_unique<LoadedScene>();
+        scene->cpuAccess = request.cpuAccess;
+        uint64_t buildSettingsHash = hashMeshBuildOptions(request.buildOptions);
+        std::vector<TextureDescription> textures;
+
+        // Try the baked mesh cache first, it skips tinygltf entirely
+        std::filesystem::path meshCachePath = getMeshCachePath(request.cacheDirectory, request.gltfPath);
+        if (loadMeshCache(meshCachePath, request.gltfPath, buildSettingsHash, scene->meshData, scene->materials,
+                          textures))
+        {
+            std::cout << "Loaded mesh cache " << meshCachePath.string() << std::endl;
+        }
+        else
+        {
+            // Strings to hold error and warning messages from the loader
+            std::string err, warn;
+
+            // Load the GLTF model from file (ASCII or binary, buffers are memory-mapped)
+            if (!loadGltfAsset(request.gltfPath, scene->asset, err, warn))
+            {
+                std::cerr << "Failed to load gltf file" << request.gltfPath.string() << "\n";
+                std::cerr << "Error: " << err << std::endl;
+                std::cerr << "Warning: " << warn << std::endl;
+                return nullptr;
+            }
+
+            // Read the materials (shaders, base color texture) and textures of the model, plus the default material in the last slot
+            readMaterialDescriptions(scene->asset.model, scene->asset.directory, scene->materials);
+            readTextureDescriptions(scene->asset.model, scene->asset.images, textures);
+
+            // Pack every primitive of the scene into shared buffers with a draw list (and small textures into atlases)
+            if (!buildSceneMeshData(scene->asset, request.buildOptions, scene->materials, textures, scene->meshData))
+            {
+                std::cerr << "No drawable primitive in " << request.gltfPath.string() << std::endl;
+                return nullptr;
+            }
+
+            // Bake the result so that the next start skips the GLTF parsing
+            if (!writeMeshCache(meshCachePath, request.gltfPath, buildSettingsHash,
+                                getMeshCacheDependencies(scene->asset, request.gltfPath), scene->meshData, scene->materials, textures))
+            {
+                std::cerr << "Failed to write mesh cache " << meshCachePath.string() << std::endl;
+            }
+        }
+
+        // World-space triangles for picking, placed by the rest pose of the nodes, before the vertex bytes can go
+        if (request.pickingBvh)
+        {
+            auto buildStart = std::chrono::steady_clock::now();
+            SceneGraph graph;
+            buildSceneGraph(scene->meshData.nodes, graph);
+            updateSceneGraph(graph);
+            if (buildTriangleBvh(scene->meshData, graph, scene->pickingBvh))
+            {
+                std::cout << "Picking BVH: " << scene->pickingBvh.triangleDraws.size() << " triangles, "
+                          << scene->pickingBvh.nodes.size() << " nodes, built in "
+                          << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count()
+                          << " ms" << std::endl;
+            }
+        }
+
+        // Read the shader files here rather than on the render thread
+        scene->shaderSources.resize(scene->materials.size());
+        for (size_t materialId = 0; materialId < scene->materials.size(); materialId++)
+        {
+            const MaterialDescription& material = scene->materials[materialId];
+            if (material.fromAsset)
+            {
+                scene->shaderSources[materialId].vertex = readTextFile(material.vertexShaderPath);
+                scene->shaderSources[materialId].fragment = readTextFile(material.fragmentShaderPath);
+            }
+        }
+        scene->vertexShaderPrelude = buildVertexShaderPrelude(scene->meshData);
+
+        // Map the KTX2 textures, transcode or decode the others, images are independent from each other.
+        // Atlases are then composed from the decoded images placed in them
+        scene->textures.resize(textures.size());
+        getWorkerPool().parallelFor(textures.size(), [&](size_t textureIdx) {
+            if (!textures[textureIdx].isAtlas)
+            {
+                loadTexture(textures[textureIdx], request.textureFormats, scene->textures[textureIdx]);
+            }
+        });
+        composeTextureAtlases(textures, scene->textures);
+        return scene;
+    }
+}
+
+std::future<std::unique_ptr<LoadedScene>> loadSceneAsync(const SceneLoadRequest& request)
+{
+    // std::function needs a copyable callable, the promise is shared with the task
+    auto promise = std::make_shared<std::promise<std::unique_ptr<LoadedScene>>>();
+    std::future<std::unique_ptr<LoadedScene>> future = promise->get_future();
+    getWorkerPool().submit([promise, request]() {
+        promise->set_value(loadScene(request));
+    });
+    return future;
+}
+
+void addLoadedSceneMemory(const LoadedScene& scene, MemoryStats& stats)
+{
+    // Blobs built on the CPU own their bytes, the others point into a mapping
+    const MeshData& meshData = scene.meshData;
+    stats.cpuStagingBytes += meshData.indices.storage.capacity();
+    stats.cpuStagingBytes += meshData.morphDeltas.storage.capacity();
+    for (const VertexStream& stream : meshData.streams)
+    {
+        stats.cpuStagingBytes += stream.data.storage.capacity();
+    }
+    stats.mappedFileBytes += meshData.backingFile.size();
+
+    const GltfAsset& asset = scene.asset;
+    for (const std::vector<unsigned char>& view : asset.decodedBufferViews)
+    {
+        stats.cpuStagingBytes += view.capacity();
+    }
+    for (const tinygltf::Buffer& buffer : asset.model.buffers)
+    {
+        stats.cpuStagingBytes += buffer.data.capacity();
+    }
+    for (const MappedFile& file : asset.mappedFiles)
+    {
+        stats.mappedFileBytes += file.size();
+    }
+
+    // KTX2 containers are mapped, other images are decoded on the heap
+    for (const LoadedTexture& texture : scene.textures)
+    {
+        stats.cpuStagingBytes += texture.pixels.capacity();
+        stats.mappedFileBytes += texture.file.size();
+    }
+
+    const TriangleBvh& bvh = scene.pickingBvh;
+    stats.pickingBytes += bvh.nodes.capacity() * sizeof(BvhNode) + bvh.triangles.capacity() * sizeof(float) +
+                          (bvh.triangleDraws.capacity() + bvh.drawTriangles.capacity() + bvh.drawNodes.capacity() +
+                           bvh.drawTriangleCounts.capacity()) * sizeof(uint32_t);
+
+    for (const MaterialShaderSources& sources : scene.shaderSources)
+    {
+        stats.shaderSourceBytes += sources.vertex.size() + sources.fragment.size();
+    }
+    stats.shaderSourceBytes += scene.vertexShaderPrelude.size();
+}
+
+void releaseLoadedSceneCpuData(LoadedScene& scene)
+{
+    // Assigning empty objects (rather than clear()) also gives the capacity back
+    scene.asset = GltfAsset();
+    scene.textures = std::vector<LoadedTexture>();
+    scene.shaderSources = std::vector<MaterialShaderSources>();
+    scene.vertexShaderPrelude = std::string();
+    if (scene.cpuAccess)
+    {
+        return;
+    }
+    for (VertexStream& stream : scene.meshData.streams)
+    {
+        stream.data = MeshBlob();
+    }
+    scene.meshData.indices = MeshBlob();
+    scene.meshData.morphDeltas = MeshBlob();
+    scene.meshData.backingFile.close();
+}
@@ -0,0 +1,60 @@
+#ifndef SCENE_LOADER_HPP
+#define SCENE_LOADER_HPP
+
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include "gltf_asset.hpp"
+#include "material_description.hpp"
+#include "memory_stats.hpp"
+#include "mesh_builder.hpp"
+#include "mesh_data.hpp"
+#include "texture_loader.hpp"
+#include "triangle_bvh.hpp"
+
+// Shader sources of one material, read from disk by the loader (empty when the file is missing)
+struct MaterialShaderSources
+{
+    std::string vertex;
+    std::string fragment;
+};
+
+// Everything the render thread needs to create the GL objects of a scene
+struct LoadedScene
+{
+    MeshData meshData;                                  // GPU-ready mesh, from the cache or built from the asset
+    std::vector<MaterialDescription> materials;         // Materials, the default material in the last slot
+    std::vector<MaterialShaderSources> shaderSources;   // Shader sources, indexed like materials
+    std::string vertexShaderPrelude;                    // Prelude matching the vertex formats of meshData
+    std::vector<LoadedTexture> textures;                // Textures waiting for upload, indexed like the glTF textures
+    GltfAsset asset;                                    // Parsed asset and its mappings (cache miss only)
+    TriangleBvh pickingBvh;                             // World-space triangles for picking (empty unless requested)
+    bool cpuAccess = false;                             // Keep the vertex / index bytes after upload
+};
+
+// Settings of a scene load
+struct SceneLoadRequest
+{
+    std::filesystem::path gltfPath;         // .gltf or .glb file to load
+    std::filesystem::path cacheDirectory;   // Directory of the baked mesh caches
+    MeshBuildOptions buildOptions;          // Settings of the mesh build, part of the cache key
+    bool cpuAccess = false;                 // Keep the vertex / index bytes on the CPU after upload (picking, physics)
+    bool pickingBvh = false;                // Build a BVH of the triangles of the scene for ray queries
+    TextureFormatSupport textureFormats;    // Compressed formats of the GPU, Basis Universal textures are transcoded to one of them
+};
+
+// Function to load a scene on the worker pool: cache lookup, glTF parsing, mesh build, texture and shader reads.
+// No GL call is made; the future holds nullptr if the scene could not be loaded (the reason is printed)
+std::future<std::unique_ptr<LoadedScene>> loadSceneAsync(const SceneLoadRequest& request);
+
+// Function to add the CPU memory held by a loaded scene to a memory report
+void addLoadedSceneMemory(const LoadedScene& scene, MemoryStats& stats);
+
+// Function to free the CPU data of a scene once the GPU has its own copy.
+// The parsed asset, its mappings, the textures and the shader sources always go; the vertex and index bytes of
+// meshData go too unless the scene was loaded with cpuAccess. The draw list, layout, segments and picking BVH stay
+void releaseLoadedSceneCpuData(LoadedScene& scene);
+
+#endif // SCENE_LOADER_HPP
@@ -0,0 +1,261 @@
+#include "shader_prelude.hpp"
+
+#include <GLES3/gl3.h>
+#include <algorithm>
+#include <sstream>
+#include "scene_graph.hpp"
+#include "skinning.hpp"
+
+namespace
+{
+    const VertexAttribute* findAttribute(const MeshData& meshData, uint32_t location)
+    {
+        for (const VertexAttribute& attribute : meshData.attributes)
+        {
+            if (attribute.location == location)
+            {
+                return &attribute;
+            }
+        }
+        return nullptr;
+    }
+
+    // Function to tell whether a line is a preprocessor directive that must precede any declaration
+    bool isLeadingDirective(const std::string& line)
+    {
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line[start] != '#')
+        {
+            return false;
+        }
+        size_t name = line.find_first_not_of(" \t", start + 1);
+        return name != std::string::npos &&
+               (line.compare(name, 7, "version") == 0 || line.compare(name, 9, "extension") == 0);
+    }
+}
+
+std::string buildVertexShaderPrelude(const MeshData& meshData)
+{
+    const VertexAttribute* position = findAttribute(meshData, kPositionLocation);
+    const VertexAttribute* normal = findAttribute(meshData, kNormalLocation);
+    const VertexAttribute* texCoord = findAttribute(meshData, kTexCoordLocation);
+    bool quantizedPositions = position && position->componentType != GL_FLOAT;
+    bool octahedralNormals = normal && normal->componentCount == 2;
+    bool quantizedTexCoords = texCoord && texCoord->componentType != GL_FLOAT;
+    bool skinned = findAttribute(meshData, kJointsLocation) && findAttribute(meshData, kWeightsLocation) &&
+                   !meshData.skins.empty();
+    bool paletteTexture = useJointPaletteTexture(meshData);
+    uint32_t maxMorphTargets = 0;
+    for (const MorphTargetSet& set : meshData.morphTargetSets)
+    {
+        maxMorphTargets = std::max(maxMorphTargets, set.targetCount);
+    }
+
+    std::ostringstream prelude;
+    prelude << "// Built-in vertex decoding, inserted by the loader\n"
+            << "#define VERTEX_POSITION_QUANTIZED " << (quantizedPositions ? 1 : 0) << "\n"
+            << "#define VERTEX_NORMAL_OCTAHEDRAL " << (octahedralNormals ? 1 : 0) << "\n"
+            << "#define VERTEX_TEXCOORD_QUANTIZED " << (quantizedTexCoords ? 1 : 0) << "\n"
+            << "uniform highp mat4 " << kPositionDequantizationUniform << ";\n"
+            << "uniform highp vec4 " << kTexCoordTransformUniform << ";\n";
+    if (skinned)
+    {
+        // Joints and weights are declared here, skinning needs integer attributes (GLSL ES 3.00)
+        prelude << "#define VERTEX_SKINNED 1\n"
+                << "#define VERTEX_JOINT_PALETTE_TEXTURE " << (paletteTexture ? 1 : 0) << "\n"
+                << "#define VERTEX_MAX_JOINTS " << getMaxSkinJointCount(meshData) << "\n"
+                << "#if __VERSION__ >= 300\n"
+                << "layout(location = " << kJointsLocation << ") in highp uvec4 aJoints;\n"
+                << "layout(location = " << kWeightsLocation << ") in highp vec4 aWeights;\n"
+                << "uniform bool " << kSkinnedUniform << ";\n";
+        if (paletteTexture)
+        {
+            prelude << "uniform highp int " << kSkinJointOffsetUniform << ";\n"
+                    << "uniform highp sampler2D " << kJointPaletteTextureUniform << ";\n"
+                    << "highp mat4 getJointMatrix(highp uint joint)\n"
+                    << "{\n"
+                    << "    highp int index = " << kSkinJointOffsetUniform << " + int(joint);\n"
+                    << "    highp ivec2 texel = ivec2((index % " << kJointPaletteTextureJointsPerRow << ") * 4, index / "
+                    << kJointPaletteTextureJointsPerRow << ");\n"
+                    << "    return mat4(texelFetch(" << kJointPaletteTextureUniform << ", texel, 0),\n"
+                    << "                texelFetch(" << kJointPaletteTextureUniform << ", texel + ivec2(1, 0), 0),\n"
+                    << "                texelFetch(" << kJointPaletteTextureUniform << ", texel + ivec2(2, 0), 0),\n"
+                    << "                texelFetch(" << kJointPaletteTextureUniform << ", texel + ivec2(3, 0), 0));\n"
+                    << "}\n";
+        }
+        else
+        {
+            prelude << "layout(std140) uniform " << kJointPaletteBlock << "\n"
+                    << "{\n"
+                    << "    highp mat4 uJointMatrices[VERTEX_MAX_JOINTS];\n"
+                    << "};\n"
+                    << "highp mat4 getJointMatrix(highp uint joint)\n"
+                    << "{\n"
+                    << "    return uJointMatrices[joint];\n"
+                    << "}\n";
+        }
+        prelude << "highp mat4 getSkinMatrix()\n"
+                << "{\n"
+                << "    if (!" << kSkinnedUniform << ")\n"
+                << "    {\n"
+                << "        return mat4(1.0);\n"
+                << "    }\n"
+                << "    return aWeights.x * getJointMatrix(aJoints.x) + aWeights.y * getJointMatrix(aJoints.y) +\n"
+                << "           aWeights.z * getJointMatrix(aJoints.z) + aWeights.w * getJointMatrix(aJoints.w);\n"
+                << "}\n"
+                << "#else\n"
+                << "#undef VERTEX_SKINNED\n"
+                << "#define VERTEX_SKINNED 0\n"
+                << "#endif\n";
+    }
+    else
+    {
+        prelude << "#define VERTEX_SKINNED 0\n";
+    }
+    if (maxMorphTargets > 0)
+    {
+        // Deltas are fetched by vertex index, a draw without morph targets sets the target count to 0
+        prelude << "#define VERTEX_MORPHED 1\n"
+                << "#define VERTEX_MAX_MORPH_TARGETS " << maxMorphTargets << "\n"
+                << "#if __VERSION__ >= 300\n"
+                << "uniform highp sampler2D " << kMorphDeltaTextureUniform << ";\n"
+                << "uniform highp int " << kMorphTexelBaseUniform << ";\n"
+                << "uniform int " << kMorphTargetCountUniform << ";\n"
+                << "uniform int " << kMorphTexelsPerTargetUniform << ";\n"
+                << "uniform highp vec4 " << kMorphWeightsUniform << "[" << (maxMorphTargets + 3) / 4 << "];\n"
+                << "highp vec3 getMorphDelta(int attribute)\n"
+                << "{\n"
+                << "    highp vec3 delta = vec3(0.0);\n"
+                << "    if (attribute >= " << kMorphTexelsPerTargetUniform << ")\n"
+                << "    {\n"
+                << "        return delta;\n"
+                << "    }\n"
+                << "    highp int texel = " << kMorphTexelBaseUniform << " + gl_VertexID * " << kMorphTargetCountUniform
+                << " * " << kMorphTexelsPerTargetUniform << " + attribute;\n"
+                << "    for (int target = 0; target < " << kMorphTargetCountUniform << "; target++)\n"
+                << "    {\n"
+                << "        highp float weight = " << kMorphWeightsUniform << "[target / 4][target % 4];\n"
+                << "        if (weight != 0.0)\n"
+                << "        {\n"
+                << "            delta += weight * texelFetch(" << kMorphDeltaTextureUniform << ", ivec2(texel % "
+                << kMorphDeltaTextureWidth << ", texel / " << kMorphDeltaTextureWidth << "), 0).xyz;\n"
+                << "        }\n"
+                << "        texel += " << kMorphTexelsPerTargetUniform << ";\n"
+                << "    }\n"
+                << "    return delta;\n"
+                << "}\n"
+                << "#else\n"
+                << "#undef VERTEX_MORPHED\n"
+                << "#define VERTEX_MORPHED 0\n"
+                << "#endif\n";
+    }
+    else
+    {
+        prelude << "#define VERTEX_MORPHED 0\n";
+    }
+    prelude << "highp vec4 decodePosition(highp vec4 position)\n"
+            << "{\n"
+            << "    highp vec4 p = " << kPositionDequantizationUniform << " * vec4(position.xyz, 1.0);\n"
+            << "#if VERTEX_MORPHED\n"
+            << "    p.xyz += getMorphDelta(0);\n"
+            << "#endif\n"
+            << "#if VERTEX_SKINNED\n"
+            << "    p = getSkinMatrix() * p;\n"
+            << "#endif\n"
+            << "    return p;\n"
+            << "}\n"
+            << "highp vec3 decodeNormal(highp vec3 normal)\n"
+            << "{\n";
+    if (octahedralNormals)
+    {
+        prelude << "    highp vec3 n = vec3(normal.xy, 1.0 - abs(normal.x) - abs(normal.y));\n"
+                << "    highp float t = max(-n.z, 0.0);\n"
+                << "    n.x += n.x >= 0.0 ? -t : t;\n"
+                << "    n.y += n.y >= 0.0 ? -t : t;\n"
+                << "    n = normalize(n);\n";
+    }
+    else
+    {
+        prelude << "    highp vec3 n = normal;\n";
+    }
+    prelude << "#if VERTEX_MORPHED\n"
+            << "    n = normalize(n + getMorphDelta(1));\n"
+            << "#endif\n"
+            << "#if VERTEX_SKINNED\n"
+            << "    n = normalize(mat3(getSkinMatrix()) * n);\n"
+            << "#endif\n"
+            << "    return n;\n"
+            << "}\n"
+            << "highp vec2 decodeTexCoord(highp vec2 texCoord)\n"
+            << "{\n"
+            << "    return texCoord * " << kTexCoordTransformUniform << ".xy + " << kTexCoordTransformUniform << ".zw;\n"
+            << "}\n";
+
+    // World matrices of the nodes, uploaded in bulk once per frame, or of the instances of an instanced draw
+    prelude << "uniform highp mat4 " << kViewProjectionUniform << ";\n"
+            << "#if __VERSION__ >= 300\n"
+            << "uniform highp sampler2D " << kNodeMatrixTextureUniform << ";\n"
+            << "uniform highp int " << kNodeIndexUniform << ";\n"
+            << "layout(location = " << kInstanceMatrixLocation << ") in highp mat4 aInstanceMatrix;\n"
+            << "uniform bool " << kInstancedUniform << ";\n"
+            << "highp mat4 getNodeMatrix()\n"
+            << "{\n"
+            << "    if (" << kInstancedUniform << ")\n"
+            << "    {\n"
+            << "        return aInstanceMatrix;\n"
+            << "    }\n"
+            << "    if (" << kNodeIndexUniform << " < 0)\n"
+            << "    {\n"
+            << "        return mat4(1.0);\n"
+            << "    }\n"
+            << "    highp ivec2 texel = ivec2((" << kNodeIndexUniform << " % " << kNodeMatrixTextureNodesPerRow << ") * 4, "
+            << kNodeIndexUniform << " / " << kNodeMatrixTextureNodesPerRow << ");\n"
+            << "    return mat4(texelFetch(" << kNodeMatrixTextureUniform << ", texel, 0),\n"
+            << "                texelFetch(" << kNodeMatrixTextureUniform << ", texel + ivec2(1, 0), 0),\n"
+            << "                texelFetch(" << kNodeMatrixTextureUniform << ", texel + ivec2(2, 0), 0),\n"
+            << "                texelFetch(" << kNodeMatrixTextureUniform << ", texel + ivec2(3, 0), 0));\n"
+            << "}\n"
+            << "#else\n"
+            << "uniform highp mat4 " << kNodeMatrixUniform << ";\n"
+            << "highp mat4 getNodeMatrix()\n"
+            << "{\n"
+            << "    return " << kNodeMatrixUniform << ";\n"
+            << "}\n"
+            << "#endif\n"
+            << "highp vec4 transformPosition(highp vec4 position)\n"
+            << "{\n"
+            << "    return " << kViewProjectionUniform << " * (getNodeMatrix() * position);\n"
+            << "}\n";
+    return prelude.str();
+}
+
+std::string injectShaderPrelude(const std::string& source, const std::string& prelude)
+{
+    // Skip the leading #version / #extension lines, the prelude goes right after them
+    size_t insertAt = 0;
+    size_t lineStart = 0;
+    while (lineStart < source.size())
+    {
+        size_t lineEnd = source.find('\n', lineStart);
+        std::string line = source.substr(lineStart, lineEnd == std::string::npos ? std::string::npos : lineEnd - lineStart);
+        bool blank = line.find_first_not_of(" \t\r") == std::string::npos;
+        if (!blank && !isLeadingDirective(line))
+        {
+            break;
+        }
+        lineStart = lineEnd == std::string::npos ? source.size() : lineEnd + 1;
+        if (!blank)
+        {
+            insertAt = lineStart;
+        }
+    }
+
+    std::string result = source.substr(0, insertAt);
+    if (!result.empty() && result.back() != '\n')
+    {
+        result += '\n';
+    }
+    result += prelude;
+    result += source.substr(insertAt);
+    return result;
+}
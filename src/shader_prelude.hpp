@@ -0,0 +1,37 @@
+#ifndef SHADER_PRELUDE_HPP
+#define SHADER_PRELUDE_HPP
+
+#include <string>
+#include "mesh_data.hpp"
+
+// Built-in uniforms declared by the vertex shader prelude
+const char* const kPositionDequantizationUniform = "uPositionDequantization";
+const char* const kTexCoordTransformUniform = "uTexCoordTransform";
+const char* const kSkinnedUniform = "uSkinned";
+const char* const kSkinJointOffsetUniform = "uSkinJointOffset";
+const char* const kJointPaletteTextureUniform = "uJointPaletteTexture";
+const char* const kJointPaletteBlock = "JointPalette";
+const char* const kMorphDeltaTextureUniform = "uMorphDeltaTexture";
+const char* const kMorphTexelBaseUniform = "uMorphTexelBase";
+const char* const kMorphTargetCountUniform = "uMorphTargetCount";
+const char* const kMorphTexelsPerTargetUniform = "uMorphTexelsPerTarget";
+const char* const kMorphWeightsUniform = "uMorphWeights";
+const char* const kViewProjectionUniform = "uViewProjection";
+const char* const kNodeMatrixTextureUniform = "uNodeMatrices";
+const char* const kNodeIndexUniform = "uNodeIndex";
+const char* const kNodeMatrixUniform = "uNodeMatrix";
+const char* const kInstancedUniform = "uInstanced";
+
+// Function to build the vertex shader prelude matching the vertex formats of a mesh.
+// It declares the built-in uniforms and the decodePosition / decodeNormal / decodeTexCoord helpers,
+// so that material shaders work whatever the attribute quantization, and transformPosition, which
+// applies the world matrix of the draw's node and the view projection.
+// GLSL ES 3.00 shaders fetch the world matrix from the node matrix texture with uNodeIndex (-1 for
+// skinned draws, whose joints are already in world space), or take it from the per-instance attribute at
+// kInstanceMatrixLocation when uInstanced is set; GLSL ES 1.00 shaders get it in uNodeMatrix
+std::string buildVertexShaderPrelude(const MeshData& meshData);
+
+// Function to insert a prelude after the #version and #extension directives of a shader source
+std::string injectShaderPrelude(const std::string& source, const std::string& prelude);
+
+#endif // SHADER_PRELUDE_HPP
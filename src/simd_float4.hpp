@@ -0,0 +1,213 @@
+#ifndef SIMD_FLOAT4_HPP
+#define SIMD_FLOAT4_HPP
+
+// Four-lane float vector for the batched structure-of-arrays kernels, mapped to SSE or NEON when
+// available and to plain arrays otherwise. Every lane is computed independently
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define SIMD_FLOAT4_SSE 1
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define SIMD_FLOAT4_NEON 1
+#include <arm_neon.h>
+#else
+#include <cmath>
+#endif
+
+struct Float4
+{
+#if defined(SIMD_FLOAT4_SSE)
+    __m128 v;
+#elif defined(SIMD_FLOAT4_NEON)
+    float32x4_t v;
+#else
+    float v[4];
+#endif
+};
+
+// Function to load 4 consecutive floats (no alignment required)
+inline Float4 loadFloat4(const float* source)
+{
+#if defined(SIMD_FLOAT4_SSE)
+    return { _mm_loadu_ps(source) };
+#elif defined(SIMD_FLOAT4_NEON)
+    return { vld1q_f32(source) };
+#else
+    return { { source[0], source[1], source[2], source[3] } };
+#endif
+}
+
+// Function to store 4 consecutive floats (no alignment required)
+inline void storeFloat4(float* destination, Float4 value)
+{
+#if defined(SIMD_FLOAT4_SSE)
+    _mm_storeu_ps(destination, value.v);
+#elif defined(SIMD_FLOAT4_NEON)
+    vst1q_f32(destination, value.v);
+#else
+    for (int lane = 0; lane < 4; lane++)
+    {
+        destination[lane] = value.v[lane];
+    }
+#endif
+}
+
+// Function to set the 4 lanes to the same value
+inline Float4 splatFloat4(float value)
+{
+#if defined(SIMD_FLOAT4_SSE)
+    return { _mm_set1_ps(value) };
+#elif defined(SIMD_FLOAT4_NEON)
+    return { vdupq_n_f32(value) };
+#else
+    return { { value, value, value, value } };
+#endif
+}
+
+inline Float4 operator+(Float4 a, Float4 b)
+{
+#if defined(SIMD_FLOAT4_SSE)
+    return { _mm_add_ps(a.v, b.v) };
+#elif defined(SIMD_FLOAT4_NEON)
+    return { vaddq_f32(a.v, b.v) };
+#else
+    return { { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } };
+#endif
+}
+
+inline Float4 operator-(Float4 a, Float4 b)
+{
+#if defined(SIMD_FLOAT4_SSE)
+    return { _mm_sub_ps(a.v, b.v) };
+#elif defined(SIMD_FLOAT4_NEON)
+    return { vsubq_f32(a.v, b.v) };
+#else
+    return { { a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3] } };
+#endif
+}
+
+inline Float4 operator*(Float4 a, Float4 b)
+{
+#if defined(SIMD_FLOAT4_SSE)
+    return { _mm_mul_ps(a.v, b.v) };
+#elif defined(SIMD_FLOAT4_NEON)
+    return { vmulq_f32(a.v, b.v) };
+#else
+    return { { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] } };
+#endif
+}
+
+inline Float4 operator/(Float4 a, Float4 b)
+{
+#if defined(SIMD_FLOAT4_SSE)
+    return { _mm_div_ps(a.v, b.v) };
+#elif defined(SIMD_FLOAT4_NEON) && defined(__aarch64__)
+    return { vdivq_f32(a.v, b.v) };
+#elif defined(SIMD_FLOAT4_NEON)
+    // No divide on 32-bit NEON: hardware reciprocal estimate refined by two Newton-Raphson steps
+    float32x4_t reciprocal = vrecpeq_f32(b.v);
+    reciprocal = vmulq_f32(reciprocal, vrecpsq_f32(b.v, reciprocal));
+    reciprocal = vmulq_f32(reciprocal, vrecpsq_f32(b.v, reciprocal));
+    return { vmulq_f32(a.v, reciprocal) };
+#else
+    return { { a.v[0] / b.v[0], a.v[1] / b.v[1], a.v[2] / b.v[2], a.v[3] / b.v[3] } };
+#endif
+}
+
+// Function to get the smaller of a and b in every lane (b when either is NaN)
+inline Float4 minFloat4(Float4 a, Float4 b)
+{
+#if defined(SIMD_FLOAT4_SSE)
+    return { _mm_min_ps(a.v, b.v) };
+#elif defined(SIMD_FLOAT4_NEON)
+    return { vbslq_f32(vcltq_f32(a.v, b.v), a.v, b.v) };
+#else
+    return { { a.v[0] < b.v[0] ? a.v[0] : b.v[0], a.v[1] < b.v[1] ? a.v[1] : b.v[1], a.v[2] < b.v[2] ? a.v[2] : b.v[2],
+               a.v[3] < b.v[3] ? a.v[3] : b.v[3] } };
+#endif
+}
+
+// Function to get the larger of a and b in every lane (b when either is NaN)
+inline Float4 maxFloat4(Float4 a, Float4 b)
+{
+#if defined(SIMD_FLOAT4_SSE)
+    return { _mm_max_ps(a.v, b.v) };
+#elif defined(SIMD_FLOAT4_NEON)
+    return { vbslq_f32(vcgtq_f32(a.v, b.v), a.v, b.v) };
+#else
+    return { { a.v[0] > b.v[0] ? a.v[0] : b.v[0], a.v[1] > b.v[1] ? a.v[1] : b.v[1], a.v[2] > b.v[2] ? a.v[2] : b.v[2],
+               a.v[3] > b.v[3] ? a.v[3] : b.v[3] } };
+#endif
+}
+
+// Function to get the absolute value of every lane
+inline Float4 absFloat4(Float4 value)
+{
+#if defined(SIMD_FLOAT4_SSE)
+    return { _mm_andnot_ps(_mm_set1_ps(-0.0f), value.v) };
+#elif defined(SIMD_FLOAT4_NEON)
+    return { vabsq_f32(value.v) };
+#else
+    return { { std::fabs(value.v[0]), std::fabs(value.v[1]), std::fabs(value.v[2]), std::fabs(value.v[3]) } };
+#endif
+}
+
+// Function to negate the lanes of value where sign is negative (including -0)
+inline Float4 flipSignFloat4(Float4 value, Float4 sign)
+{
+#if defined(SIMD_FLOAT4_SSE)
+    return { _mm_xor_ps(value.v, _mm_and_ps(sign.v, _mm_set1_ps(-0.0f))) };
+#elif defined(SIMD_FLOAT4_NEON)
+    uint32x4_t signBits = vandq_u32(vreinterpretq_u32_f32(sign.v), vdupq_n_u32(0x80000000u));
+    return { vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(value.v), signBits)) };
+#else
+    Float4 result;
+    for (int lane = 0; lane < 4; lane++)
+    {
+        result.v[lane] = std::signbit(sign.v[lane]) ? -value.v[lane] : value.v[lane];
+    }
+    return result;
+#endif
+}
+
+// Function to compare the lanes of a and b, bit l of the result is set when lane l of a is less than lane l of b
+inline int lessThanMaskFloat4(Float4 a, Float4 b)
+{
+#if defined(SIMD_FLOAT4_SSE)
+    return _mm_movemask_ps(_mm_cmplt_ps(a.v, b.v));
+#elif defined(SIMD_FLOAT4_NEON)
+    uint32x4_t less = vshrq_n_u32(vcltq_f32(a.v, b.v), 31);
+    return static_cast<int>(vgetq_lane_u32(less, 0) | (vgetq_lane_u32(less, 1) << 1) | (vgetq_lane_u32(less, 2) << 2) |
+                            (vgetq_lane_u32(less, 3) << 3));
+#else
+    int mask = 0;
+    for (int lane = 0; lane < 4; lane++)
+    {
+        mask |= a.v[lane] < b.v[lane] ? 1 << lane : 0;
+    }
+    return mask;
+#endif
+}
+
+// Function to get 1 / sqrt(value) of every lane, to full float precision
+inline Float4 reciprocalSqrtFloat4(Float4 value)
+{
+#if defined(SIMD_FLOAT4_SSE)
+    return { _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(value.v)) };
+#elif defined(SIMD_FLOAT4_NEON)
+    // Hardware estimate refined by two Newton-Raphson steps
+    float32x4_t estimate = vrsqrteq_f32(value.v);
+    estimate = vmulq_f32(estimate, vrsqrtsq_f32(vmulq_f32(value.v, estimate), estimate));
+    estimate = vmulq_f32(estimate, vrsqrtsq_f32(vmulq_f32(value.v, estimate), estimate));
+    return { estimate };
+#else
+    Float4 result;
+    for (int lane = 0; lane < 4; lane++)
+    {
+        result.v[lane] = 1.0f / std::sqrt(value.v[lane]);
+    }
+    return result;
+#endif
+}
+
+#endif // SIMD_FLOAT4_HPP
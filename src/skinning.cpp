@@ -0,0 +1,133 @@
+#include "skinning.hpp"
+
+#include <GLES3/gl3.h>
+#include <algorithm>
+#include "transform_math.hpp"
+
+uint32_t getMaxSkinJointCount(const MeshData& meshData)
+{
+    uint32_t maxJoints = 0;
+    for (const Skin& skin : meshData.skins)
+    {
+        maxJoints = std::max(maxJoints, skin.jointCount);
+    }
+    return maxJoints;
+}
+
+bool useJointPaletteTexture(const MeshData& meshData)
+{
+    return getMaxSkinJointCount(meshData) > kMaxUniformPaletteJoints;
+}
+
+void computeJointMatrices(const MeshData& meshData, const Skin& skin, const SceneGraph& graph, float* jointMatrices)
+{
+    for (uint32_t i = 0; i < skin.jointCount; i++)
+    {
+        uint32_t joint = meshData.skinJoints[skin.firstJoint + i];
+        const float* inverseBind = &meshData.inverseBindMatrices[(skin.firstJoint + i) * 16];
+        multiplyMatrices(getNodeWorldMatrix(graph, joint), inverseBind, jointMatrices + i * 16);
+    }
+}
+
+void createJointPalette(JointPaletteGLContext& palette, const MeshData& meshData)
+{
+    palette.useTexture = useJointPaletteTexture(meshData);
+    palette.skinOffsets.clear();
+    if (meshData.skins.empty())
+    {
+        return;
+    }
+
+    if (palette.useTexture)
+    {
+        // Skins are contiguous in skinJoints, the palette keeps the same order
+        for (const Skin& skin : meshData.skins)
+        {
+            palette.skinOffsets.push_back(skin.firstJoint);
+        }
+        uint32_t jointCount = static_cast<uint32_t>(meshData.skinJoints.size());
+        uint32_t rows = (jointCount + kJointPaletteTextureJointsPerRow - 1) / kJointPaletteTextureJointsPerRow;
+        palette.staging.assign(static_cast<size_t>(rows) * kJointPaletteTextureJointsPerRow * 16, 0.0f);
+
+        glGenTextures(1, &palette.texture);
+        glActiveTexture(GL_TEXTURE0 + kJointPaletteTextureUnit);
+        glBindTexture(GL_TEXTURE_2D, palette.texture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, kJointPaletteTextureJointsPerRow * 4, rows);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glActiveTexture(GL_TEXTURE0);
+        return;
+    }
+
+    // Every skin binds a range of the size of the shader's block, starting at an aligned offset
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    uint32_t offsetAlignment = static_cast<uint32_t>(std::max(alignment, 1));
+    palette.rangeSize = getMaxSkinJointCount(meshData) * 16 * sizeof(float);
+    uint32_t offset = 0;
+    for (const Skin& skin : meshData.skins)
+    {
+        palette.skinOffsets.push_back(offset);
+        offset += skin.jointCount * 16 * sizeof(float);
+        offset = (offset + offsetAlignment - 1) / offsetAlignment * offsetAlignment;
+    }
+    uint32_t size = palette.skinOffsets.back() + palette.rangeSize;
+    palette.staging.assign(size / sizeof(float), 0.0f);
+
+    glGenBuffers(1, &palette.buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, palette.buffer);
+    glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void updateJointPalette(JointPaletteGLContext& palette, const MeshData& meshData, const SceneGraph& graph)
+{
+    if (palette.skinOffsets.empty())
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < meshData.skins.size(); i++)
+    {
+        size_t first = palette.useTexture ? palette.skinOffsets[i] * 16 : palette.skinOffsets[i] / sizeof(float);
+        computeJointMatrices(meshData, meshData.skins[i], graph, &palette.staging[first]);
+    }
+
+    if (palette.useTexture)
+    {
+        GLsizei rows = static_cast<GLsizei>(palette.staging.size() / (kJointPaletteTextureJointsPerRow * 16));
+        glActiveTexture(GL_TEXTURE0 + kJointPaletteTextureUnit);
+        glBindTexture(GL_TEXTURE_2D, palette.texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, kJointPaletteTextureJointsPerRow * 4, rows, GL_RGBA, GL_FLOAT,
+                        palette.staging.data());
+        glActiveTexture(GL_TEXTURE0);
+    }
+    else
+    {
+        // Orphan the previous frame's storage rather than waiting for the draws still reading it
+        glBindBuffer(GL_UNIFORM_BUFFER, palette.buffer);
+        glBufferData(GL_UNIFORM_BUFFER, static_cast<GLsizeiptr>(palette.staging.size() * sizeof(float)),
+                     palette.staging.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+}
+
+void bindJointPalette(const JointPaletteGLContext& palette, uint32_t skin)
+{
+    if (palette.useTexture || palette.skinOffsets.empty())
+    {
+        return;
+    }
+    // The block of a skinned program must be backed even when its draw is rigid, any skin's range will do
+    uint32_t offset = skin < palette.skinOffsets.size() ? palette.skinOffsets[skin] : palette.skinOffsets[0];
+    glBindBufferRange(GL_UNIFORM_BUFFER, kJointPaletteBinding, palette.buffer, offset, palette.rangeSize);
+}
+
+int32_t getJointPaletteOffset(const JointPaletteGLContext& palette, uint32_t skin)
+{
+    if (!palette.useTexture || skin >= palette.skinOffsets.size())
+    {
+        return 0;
+    }
+    return static_cast<int32_t>(palette.skinOffsets[skin]);
+}
@@ -0,0 +1,52 @@
+#ifndef SKINNING_HPP
+#define SKINNING_HPP
+
+#include <cstdint>
+#include <vector>
+#include "mesh_data.hpp"
+#include "scene_graph.hpp"
+
+// Skins with more joints than this keep their palette in a float texture instead of a uniform
+// buffer (256 mat4 = 16 KB, the smallest GL_MAX_UNIFORM_BLOCK_SIZE allowed by OpenGL ES 3.0)
+const uint32_t kMaxUniformPaletteJoints = 256;
+// Uniform buffer binding point of the joint palette block
+const uint32_t kJointPaletteBinding = 0;
+// Texture unit of the joint palette texture, above the units used by materials and the world matrices
+const uint32_t kJointPaletteTextureUnit = 15;
+// Joints per row of the joint palette texture (4 RGBA32F texels per joint)
+const uint32_t kJointPaletteTextureJointsPerRow = 64;
+
+// Function to get the joint count of the largest skin of a mesh
+uint32_t getMaxSkinJointCount(const MeshData& meshData);
+
+// Function to tell whether the joint palettes of a mesh live in a texture rather than a uniform buffer
+bool useJointPaletteTexture(const MeshData& meshData);
+
+// Function to compute the joint matrices of a skin: world matrix of each joint times its inverse bind matrix.
+// Following glTF, the transform of the skinned node itself is not applied
+void computeJointMatrices(const MeshData& meshData, const Skin& skin, const SceneGraph& graph, float* jointMatrices);
+
+// GPU storage of the joint palettes of every skin, refreshed once per frame
+struct JointPaletteGLContext
+{
+    bool useTexture = false;                // Palettes in a float texture instead of a uniform buffer
+    uint32_t buffer = 0;                    // Uniform buffer holding every palette (uniform buffer path)
+    uint32_t texture = 0;                   // RGBA32F texture, 4 texels per joint (texture path)
+    uint32_t rangeSize = 0;                 // Bytes bound for each skin, the size of the shader's palette block
+    std::vector<uint32_t> skinOffsets;      // Byte offset (buffer) or first joint (texture) of every skin's palette
+    std::vector<float> staging;             // Palettes of all skins, rebuilt when a node moves
+};
+
+// Function to create the buffer or texture receiving the joint palettes of a mesh
+void createJointPalette(JointPaletteGLContext& palette, const MeshData& meshData);
+
+// Function to compute the joint matrices of every skin from the world matrices of the scene graph and upload them
+void updateJointPalette(JointPaletteGLContext& palette, const MeshData& meshData, const SceneGraph& graph);
+
+// Function to bind the palette of a skin for the next draws (uniform buffer path, the texture is always bound)
+void bindJointPalette(const JointPaletteGLContext& palette, uint32_t skin);
+
+// Function to get the value of the skin joint offset uniform for the draws of a skin
+int32_t getJointPaletteOffset(const JointPaletteGLContext& palette, uint32_t skin);
+
+#endif // SKINNING_HPP
@@ -0,0 +1,282 @@
+#include "texture_atlas.hpp"
+
+#include <GLES3/gl3.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include "mapped_file.hpp"
+#include "stb_image.h"
+
+namespace
+{
+    // Images are placed on this grid so that their padding survives every mip level of the atlas
+    const uint32_t kAtlasGrid = 1u << (kAtlasMipLevels - 1);
+
+    // Function to get the room an image takes in an atlas, padding included
+    uint32_t getPaddedSize(uint32_t size)
+    {
+        return (size + 2 * kAtlasPadding + kAtlasGrid - 1) / kAtlasGrid * kAtlasGrid;
+    }
+
+    // Function to tell whether two textures can be sampled through the same atlas
+    bool canShareAtlas(const TextureDescription& a, const TextureDescription& b)
+    {
+        return a.srgb == b.srgb && a.minFilter == b.minFilter && a.magFilter == b.magFilter;
+    }
+
+    // Function to copy an RGBA8 image into an atlas, repeating its edge texels over the padding
+    void copyPaddedImage(const unsigned char* image, uint32_t width, uint32_t height, unsigned char* atlas,
+                         uint32_t atlasWidth, uint32_t x, uint32_t y)
+    {
+        const size_t texelSize = 4;
+        for (int64_t row = -static_cast<int64_t>(kAtlasPadding); row < static_cast<int64_t>(height + kAtlasPadding); row++)
+        {
+            int64_t sourceRow = std::min<int64_t>(std::max<int64_t>(row, 0), height - 1);
+            const unsigned char* source = image + static_cast<size_t>(sourceRow) * width * texelSize;
+            unsigned char* destination = atlas + (static_cast<size_t>(y + row) * atlasWidth + x - kAtlasPadding) * texelSize;
+            for (uint32_t texel = 0; texel < kAtlasPadding; texel++)
+            {
+                std::memcpy(destination + texel * texelSize, source, texelSize);
+            }
+            destination += kAtlasPadding * texelSize;
+            std::memcpy(destination, source, width * texelSize);
+            destination += width * texelSize;
+            for (uint32_t texel = 0; texel < kAtlasPadding; texel++)
+            {
+                std::memcpy(destination + texel * texelSize, source + (width - 1) * texelSize, texelSize);
+            }
+        }
+    }
+}
+
+SkylinePacker::SkylinePacker(uint32_t width, uint32_t height) : width_(width), height_(height)
+{
+    skyline_.push_back({ 0, 0, width });
+}
+
+bool SkylinePacker::insert(uint32_t width, uint32_t height, uint32_t& x, uint32_t& y)
+{
+    // Find the position where the rectangle ends lowest, resting on the highest segment it spans
+    size_t bestSegment = skyline_.size();
+    uint32_t bestY = UINT32_MAX;
+    for (size_t segmentIdx = 0; segmentIdx < skyline_.size() && skyline_[segmentIdx].x + width <= width_; segmentIdx++)
+    {
+        uint32_t top = 0;
+        uint32_t remaining = width;
+        for (size_t spanned = segmentIdx; remaining > 0; spanned++)
+        {
+            top = std::max(top, skyline_[spanned].y);
+            remaining -= std::min(remaining, skyline_[spanned].width);
+        }
+        if (top + height <= height_ && top < bestY)
+        {
+            bestSegment = segmentIdx;
+            bestY = top;
+        }
+    }
+    if (bestSegment == skyline_.size())
+    {
+        return false;
+    }
+    x = skyline_[bestSegment].x;
+    y = bestY;
+
+    // The rectangle becomes a segment, hiding the segments below it
+    uint32_t right = x + width;
+    size_t segmentIdx = bestSegment;
+    while (segmentIdx < skyline_.size() && skyline_[segmentIdx].x < right)
+    {
+        Segment& segment = skyline_[segmentIdx];
+        uint32_t segmentRight = segment.x + segment.width;
+        if (segmentRight <= right)
+        {
+            skyline_.erase(skyline_.begin() + segmentIdx);
+            continue;
+        }
+        segment.width = segmentRight - right;
+        segment.x = right;
+        break;
+    }
+    skyline_.insert(skyline_.begin() + bestSegment, Segment{ x, y + height, width });
+
+    // Neighbours at the same height are merged, fewer segments to test for the next rectangles
+    for (size_t segmentIdx = 0; segmentIdx + 1 < skyline_.size();)
+    {
+        if (skyline_[segmentIdx].y == skyline_[segmentIdx + 1].y)
+        {
+            skyline_[segmentIdx].width += skyline_[segmentIdx + 1].width;
+            skyline_.erase(skyline_.begin() + segmentIdx + 1);
+        }
+        else
+        {
+            segmentIdx++;
+        }
+    }
+    usedWidth_ = std::max(usedWidth_, right);
+    usedHeight_ = std::max(usedHeight_, y + height);
+    return true;
+}
+
+bool probeTextureImageSize(const FileRange& image, uint32_t& width, uint32_t& height)
+{
+    MappedFile file;
+    if (image.path.empty() || !file.open(image.path) || image.offset > file.size())
+    {
+        return false;
+    }
+    uint64_t size = image.size ? image.size : file.size() - image.offset;
+    if (size > file.size() - image.offset)
+    {
+        return false;
+    }
+    ByteSpan bytes = { file.data() + image.offset, static_cast<size_t>(size) };
+    int imageWidth, imageHeight, channels;
+    if (isKtx2Container(bytes) ||
+        !stbi_info_from_memory(bytes.data, static_cast<int>(bytes.size), &imageWidth, &imageHeight, &channels) ||
+        imageWidth <= 0 || imageHeight <= 0)
+    {
+        return false;
+    }
+    width = static_cast<uint32_t>(imageWidth);
+    height = static_cast<uint32_t>(imageHeight);
+    return true;
+}
+
+uint32_t packTextureAtlases(const TextureAtlasOptions& options, const std::vector<uint32_t>& candidates,
+                            std::vector<TextureDescription>& textures)
+{
+    struct Placement
+    {
+        uint32_t texture;
+        uint32_t x;
+        uint32_t y;
+    };
+    struct Atlas
+    {
+        SkylinePacker packer;
+        std::vector<Placement> placements;
+    };
+
+    // Tallest images first, the skyline stays flatter
+    std::vector<uint32_t> order = candidates;
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return textures[a].height != textures[b].height ? textures[a].height > textures[b].height
+                                                        : textures[a].width > textures[b].width;
+    });
+
+    std::vector<Atlas> atlases;
+    for (uint32_t textureIdx : order)
+    {
+        const TextureDescription& texture = textures[textureIdx];
+        uint32_t width = getPaddedSize(texture.width);
+        uint32_t height = getPaddedSize(texture.height);
+        if (width > options.atlasSize || height > options.atlasSize)
+        {
+            continue;
+        }
+        Placement placement = { textureIdx, 0, 0 };
+        bool placed = false;
+        for (Atlas& atlas : atlases)
+        {
+            if (canShareAtlas(textures[atlas.placements[0].texture], texture) &&
+                atlas.packer.insert(width, height, placement.x, placement.y))
+            {
+                atlas.placements.push_back(placement);
+                placed = true;
+                break;
+            }
+        }
+        if (!placed)
+        {
+            atlases.push_back(Atlas{ SkylinePacker(options.atlasSize, options.atlasSize), {} });
+            atlases.back().packer.insert(width, height, placement.x, placement.y);
+            atlases.back().placements.push_back(placement);
+        }
+    }
+
+    // Atlases are cropped to their content, a multiple of the grid since every placement is
+    uint32_t packedCount = 0;
+    for (const Atlas& atlas : atlases)
+    {
+        if (atlas.placements.size() < 2)
+        {
+            continue;
+        }
+        const TextureDescription& first = textures[atlas.placements[0].texture];
+        TextureDescription description;
+        description.isAtlas = true;
+        description.width = atlas.packer.usedWidth();
+        description.height = atlas.packer.usedHeight();
+        description.minFilter = first.minFilter;
+        description.magFilter = first.magFilter;
+        description.wrapS = GL_CLAMP_TO_EDGE;
+        description.wrapT = GL_CLAMP_TO_EDGE;
+        description.srgb = first.srgb;
+        int32_t atlasIdx = static_cast<int32_t>(textures.size());
+        for (const Placement& placement : atlas.placements)
+        {
+            TextureDescription& texture = textures[placement.texture];
+            texture.atlas = atlasIdx;
+            texture.atlasX = placement.x + kAtlasPadding;
+            texture.atlasY = placement.y + kAtlasPadding;
+        }
+        textures.push_back(description);
+        packedCount += static_cast<uint32_t>(atlas.placements.size());
+    }
+    return packedCount;
+}
+
+void transformAtlasTexCoords(const TextureDescription& texture, const TextureDescription& atlas, float* texCoords, size_t count)
+{
+    float scale[2] = { static_cast<float>(texture.width) / atlas.width, static_cast<float>(texture.height) / atlas.height };
+    float offset[2] = { static_cast<float>(texture.atlasX) / atlas.width, static_cast<float>(texture.atlasY) / atlas.height };
+    for (size_t i = 0; i < count; i++)
+    {
+        texCoords[i * 2] = offset[0] + texCoords[i * 2] * scale[0];
+        texCoords[i * 2 + 1] = offset[1] + texCoords[i * 2 + 1] * scale[1];
+    }
+}
+
+void composeTextureAtlases(const std::vector<TextureDescription>& descriptions, std::vector<LoadedTexture>& textures)
+{
+    for (size_t atlasIdx = 0; atlasIdx < descriptions.size(); atlasIdx++)
+    {
+        const TextureDescription& description = descriptions[atlasIdx];
+        if (!description.isAtlas)
+        {
+            continue;
+        }
+        LoadedTexture& atlas = textures[atlasIdx];
+        atlas.pixels.assign(static_cast<size_t>(description.width) * description.height * 4, 0);
+        for (size_t textureIdx = 0; textureIdx < descriptions.size(); textureIdx++)
+        {
+            const TextureDescription& imageDescription = descriptions[textureIdx];
+            if (imageDescription.atlas != static_cast<int32_t>(atlasIdx))
+            {
+                continue;
+            }
+            // The image only lives in the atlas, its own texture stays empty
+            LoadedTexture image = std::move(textures[textureIdx]);
+            textures[textureIdx] = LoadedTexture();
+            textures[textureIdx].description = imageDescription;
+            if (image.compressed || image.levels.empty() || image.levels[0].width != imageDescription.width ||
+                image.levels[0].height != imageDescription.height ||
+                imageDescription.atlasX + imageDescription.width + kAtlasPadding > description.width ||
+                imageDescription.atlasY + imageDescription.height + kAtlasPadding > description.height)
+            {
+                std::cerr << "Texture " << textureIdx << " does not match its place in atlas " << atlasIdx
+                          << ", left empty" << std::endl;
+                continue;
+            }
+            copyPaddedImage(image.levels[0].bytes.data, imageDescription.width, imageDescription.height, atlas.pixels.data(),
+                            description.width, imageDescription.atlasX, imageDescription.atlasY);
+        }
+
+        atlas.internalFormat = description.srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+        atlas.compressed = false;
+        atlas.generateMipmaps = true;
+        atlas.levelLimit = kAtlasMipLevels;
+        atlas.levels.assign(1, TextureLevel{ { atlas.pixels.data(), atlas.pixels.size() }, description.width, description.height });
+        atlas.description = description;
+    }
+}
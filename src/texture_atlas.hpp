@@ -0,0 +1,69 @@
+#ifndef TEXTURE_ATLAS_HPP
+#define TEXTURE_ATLAS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "basic_types.hpp"
+#include "material_description.hpp"
+#include "texture_loader.hpp"
+
+// Texels around every image of an atlas, copies of the image's edge so that filtering never reads a
+// neighbour. Mip level l keeps kAtlasPadding >> l of them: atlases stop at kAtlasMipLevels levels and
+// images are placed on a grid of (1 << (kAtlasMipLevels - 1)) texels so that every level stays aligned
+const uint32_t kAtlasPadding = 4;
+const uint32_t kAtlasMipLevels = 3;
+
+// Packing of the small textures of a scene into atlases, done when the meshes are built
+struct TextureAtlasOptions
+{
+    bool enabled = false;           // Pack the textures that qualify (see buildSceneMeshData)
+    uint32_t maxImageSize = 128;    // Largest width / height of a packed image
+    uint32_t atlasSize = 1024;      // Largest width / height of an atlas
+};
+
+// Bottom-left skyline packer: the packed area is described by the top edge of its columns,
+// each rectangle goes where its top ends lowest (then leftmost)
+class SkylinePacker
+{
+public:
+    SkylinePacker(uint32_t width, uint32_t height);
+
+    // Function to place a rectangle, returns false if it does not fit
+    bool insert(uint32_t width, uint32_t height, uint32_t& x, uint32_t& y);
+
+    uint32_t usedWidth() const { return usedWidth_; }
+    uint32_t usedHeight() const { return usedHeight_; }
+
+private:
+    struct Segment
+    {
+        uint32_t x;
+        uint32_t y;                 // Top of the packed area over the segment
+        uint32_t width;
+    };
+
+    uint32_t width_;
+    uint32_t height_;
+    uint32_t usedWidth_ = 0;        // Bounds of the placed rectangles
+    uint32_t usedHeight_ = 0;
+    std::vector<Segment> skyline_;  // Left to right, covering the whole width
+};
+
+// Function to read the size of an image from its header without decoding it.
+// Returns false for KTX2 containers, whose blocks are not repacked, and for unreadable images
+bool probeTextureImageSize(const FileRange& image, uint32_t& width, uint32_t& height);
+
+// Function to pack the candidate textures (indices of textures whose width and height are set) into atlases
+// appended to textures. Textures only share an atlas with textures of the same color space and filters;
+// an atlas left with a single image is dropped. Returns the number of textures placed in an atlas
+uint32_t packTextureAtlases(const TextureAtlasOptions& options, const std::vector<uint32_t>& candidates,
+                            std::vector<TextureDescription>& textures);
+
+// Function to move texture coordinates of an image ([0, 1] over the image) into its atlas
+void transformAtlasTexCoords(const TextureDescription& texture, const TextureDescription& atlas, float* texCoords, size_t count);
+
+// Function to compose every atlas from the decoded images placed in it, the images are released once copied
+void composeTextureAtlases(const std::vector<TextureDescription>& descriptions, std::vector<LoadedTexture>& textures);
+
+#endif // TEXTURE_ATLAS_HPP
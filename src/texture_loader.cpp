@@ -0,0 +1,484 @@
+#include "texture_loader.hpp"
+
+#include <GLES3/gl3.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include "stb_image.h"
+#include "thread_pool.hpp"
+#if defined(USE_BASISU_TRANSCODER)
+#include "basisu_transcoder.h"
+#endif
+
+namespace
+{
+    // KTX 2.0 container layout (Khronos KTX File Format Specification 2.0)
+    const unsigned char kKtx2Identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+    const size_t kKtx2HeaderSize = 80;          // Identifier, header and index
+    const size_t kKtx2LevelIndexEntrySize = 24; // byteOffset, byteLength, uncompressedByteLength
+
+    // Vulkan formats of the payloads sampled natively by OpenGL ES 3.0 (Basis Universal payloads are VK_FORMAT_UNDEFINED)
+    const uint32_t kVkFormatUndefined = 0;
+    const uint32_t kVkFormatR8G8B8A8Unorm = 37;
+    const uint32_t kVkFormatR8G8B8A8Srgb = 43;
+    const uint32_t kVkFormatAstc4x4Unorm = 157;     // ASTC formats follow in pairs (UNORM, SRGB), one pair per block size
+    const uint32_t kVkFormatAstc12x12Srgb = 184;
+
+    // ASTC LDR formats (KHR_texture_compression_astc_ldr), in the same block size order as the Vulkan formats
+    const GLenum kGlCompressedRgbaAstc4x4 = 0x93B0;
+    const GLenum kGlCompressedSrgb8Alpha8Astc4x4 = 0x93D0;
+    const uint32_t kAstcBlockSizes[][2] = {
+        { 4, 4 }, { 5, 4 }, { 5, 5 }, { 6, 5 }, { 6, 6 }, { 8, 5 }, { 8, 6 },
+        { 8, 8 }, { 10, 5 }, { 10, 6 }, { 10, 8 }, { 10, 10 }, { 12, 10 }, { 12, 12 },
+    };
+
+    // GL equivalent of a KTX2 payload format
+    struct Ktx2Format
+    {
+        uint32_t vkFormat;
+        GLenum internalFormat;
+        uint32_t blockWidth;        // Texels per block, 1 for uncompressed formats
+        uint32_t blockHeight;
+        uint32_t blockBytes;
+    };
+    const Ktx2Format kKtx2Formats[] = {
+        { kVkFormatR8G8B8A8Unorm, GL_RGBA8, 1, 1, 4 },
+        { kVkFormatR8G8B8A8Srgb, GL_SRGB8_ALPHA8, 1, 1, 4 },
+        { 147, GL_COMPRESSED_RGB8_ETC2, 4, 4, 8 },
+        { 148, GL_COMPRESSED_SRGB8_ETC2, 4, 4, 8 },
+        { 149, GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2, 4, 4, 8 },
+        { 150, GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2, 4, 4, 8 },
+        { 151, GL_COMPRESSED_RGBA8_ETC2_EAC, 4, 4, 16 },
+        { 152, GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC, 4, 4, 16 },
+        { 153, GL_COMPRESSED_R11_EAC, 4, 4, 8 },
+        { 154, GL_COMPRESSED_SIGNED_R11_EAC, 4, 4, 8 },
+        { 155, GL_COMPRESSED_RG11_EAC, 4, 4, 16 },
+        { 156, GL_COMPRESSED_SIGNED_RG11_EAC, 4, 4, 16 },
+    };
+
+    uint32_t readU32(const unsigned char* bytes)
+    {
+        uint32_t value;
+        std::memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+
+    uint64_t readU64(const unsigned char* bytes)
+    {
+        uint64_t value;
+        std::memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+
+    // Function to find the GL format of a KTX2 payload, returns false if OpenGL ES 3.0 cannot sample it
+    bool findKtx2Format(uint32_t vkFormat, Ktx2Format& format)
+    {
+        if (vkFormat >= kVkFormatAstc4x4Unorm && vkFormat <= kVkFormatAstc12x12Srgb)
+        {
+            uint32_t blockSize = (vkFormat - kVkFormatAstc4x4Unorm) / 2;
+            bool srgb = (vkFormat - kVkFormatAstc4x4Unorm) % 2 != 0;
+            format.vkFormat = vkFormat;
+            format.internalFormat = (srgb ? kGlCompressedSrgb8Alpha8Astc4x4 : kGlCompressedRgbaAstc4x4) + blockSize;
+            format.blockWidth = kAstcBlockSizes[blockSize][0];
+            format.blockHeight = kAstcBlockSizes[blockSize][1];
+            format.blockBytes = 16;
+            return true;
+        }
+        for (const Ktx2Format& candidate : kKtx2Formats)
+        {
+            if (candidate.vkFormat == vkFormat)
+            {
+                format = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Function to tell whether a format needs KHR_texture_compression_astc_ldr
+    bool isAstcFormat(GLenum internalFormat)
+    {
+        return (internalFormat >= kGlCompressedRgbaAstc4x4 && internalFormat < kGlCompressedRgbaAstc4x4 + 14) ||
+               (internalFormat >= kGlCompressedSrgb8Alpha8Astc4x4 && internalFormat < kGlCompressedSrgb8Alpha8Astc4x4 + 14);
+    }
+
+    // Function to decode a PNG / JPEG / ... image to RGBA8 with stb_image
+    bool decodeImage(ByteSpan bytes, bool srgb, LoadedTexture& texture, std::string& err)
+    {
+        int width, height, channels;
+        stbi_uc* pixels = stbi_load_from_memory(bytes.data, static_cast<int>(bytes.size), &width, &height, &channels, 4);
+        if (!pixels)
+        {
+            err = std::string("cannot decode image: ") + stbi_failure_reason();
+            return false;
+        }
+        texture.pixels.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+        stbi_image_free(pixels);
+
+        texture.internalFormat = srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+        texture.compressed = false;
+        texture.generateMipmaps = true;
+        texture.levels.assign(1, TextureLevel{ { texture.pixels.data(), texture.pixels.size() },
+                                               static_cast<uint32_t>(width), static_cast<uint32_t>(height) });
+        return true;
+    }
+
+#if defined(USE_BASISU_TRANSCODER)
+    // Function to transcode every mip level of a Basis Universal KTX2 container to ASTC 4x4 when the GPU
+    // has it, else to ETC2 (ETC1 blocks when there is no alpha, they are valid ETC2 RGB blocks).
+    // Levels are transcoded in parallel, each job with its own ETC1S decoding state
+    bool transcodeBasisKtx2(ByteSpan bytes, const TextureFormatSupport& support, LoadedTexture& texture, std::string& err)
+    {
+        static std::once_flag initialized;
+        std::call_once(initialized, []() { basist::basisu_transcoder_init(); });
+
+        basist::ktx2_transcoder transcoder;
+        if (!transcoder.init(bytes.data, static_cast<uint32_t>(bytes.size)) || !transcoder.start_transcoding())
+        {
+            err = "invalid Basis Universal KTX2 container";
+            return false;
+        }
+        if (transcoder.get_faces() != 1 || transcoder.get_layers() > 1)
+        {
+            err = "only 2D KTX2 textures are supported";
+            return false;
+        }
+
+        bool srgb = transcoder.get_dfd_transfer_func() == basist::KTX2_KHDF_DF_TRANSFER_SRGB;
+        basist::transcoder_texture_format targetFormat;
+        uint32_t blockBytes = 16;
+        if (support.astc)
+        {
+            targetFormat = basist::transcoder_texture_format::cTFASTC_4x4_RGBA;
+            texture.internalFormat = srgb ? kGlCompressedSrgb8Alpha8Astc4x4 : kGlCompressedRgbaAstc4x4;
+        }
+        else if (transcoder.get_has_alpha())
+        {
+            targetFormat = basist::transcoder_texture_format::cTFETC2_RGBA;
+            texture.internalFormat = srgb ? GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC : GL_COMPRESSED_RGBA8_ETC2_EAC;
+        }
+        else
+        {
+            targetFormat = basist::transcoder_texture_format::cTFETC1_RGB;
+            texture.internalFormat = srgb ? GL_COMPRESSED_SRGB8_ETC2 : GL_COMPRESSED_RGB8_ETC2;
+            blockBytes = 8;
+        }
+
+        // Every level gets its slice of one allocation, in 4x4 blocks
+        uint32_t levelCount = std::max(transcoder.get_levels(), 1u);
+        std::vector<size_t> levelOffsets(levelCount + 1, 0);
+        std::vector<basist::ktx2_image_level_info> levelInfos(levelCount);
+        for (uint32_t level = 0; level < levelCount; level++)
+        {
+            if (!transcoder.get_image_level_info(levelInfos[level], level, 0, 0))
+            {
+                err = "invalid Basis Universal level " + std::to_string(level);
+                return false;
+            }
+            levelOffsets[level + 1] = levelOffsets[level] + static_cast<size_t>(levelInfos[level].m_total_blocks) * blockBytes;
+        }
+        texture.pixels.assign(levelOffsets[levelCount], 0);
+
+        std::vector<unsigned char> transcoded(levelCount, 0);
+        getWorkerPool().parallelFor(levelCount, [&](size_t level) {
+            basist::ktx2_transcoder_state state;
+            transcoded[level] = transcoder.transcode_image_level(static_cast<uint32_t>(level), 0, 0,
+                                                                 texture.pixels.data() + levelOffsets[level],
+                                                                 levelInfos[level].m_total_blocks, targetFormat,
+                                                                 0, 0, 0, -1, -1, &state) ? 1 : 0;
+        });
+        if (std::find(transcoded.begin(), transcoded.end(), 0) != transcoded.end())
+        {
+            texture.pixels = std::vector<unsigned char>();
+            err = "Basis Universal transcoding failed";
+            return false;
+        }
+
+        texture.levels.resize(levelCount);
+        for (uint32_t level = 0; level < levelCount; level++)
+        {
+            ByteSpan levelBytes = { texture.pixels.data() + levelOffsets[level], levelOffsets[level + 1] - levelOffsets[level] };
+            texture.levels[level] = TextureLevel{ levelBytes, levelInfos[level].m_orig_width, levelInfos[level].m_orig_height };
+        }
+        texture.compressed = true;
+        texture.generateMipmaps = false;
+        return true;
+    }
+#else
+    bool transcodeBasisKtx2(ByteSpan, const TextureFormatSupport&, LoadedTexture&, std::string& err)
+    {
+        err = "Basis Universal support is not compiled in (BASISU_TRANSCODER)";
+        return false;
+    }
+#endif
+
+    // Function to load one image: KTX2 containers stay mapped, other images are decoded
+    bool loadTextureImage(const FileRange& image, bool srgb, const TextureFormatSupport& support, LoadedTexture& texture,
+                          std::string& err)
+    {
+        if (image.path.empty())
+        {
+            err = "no image";
+            return false;
+        }
+        MappedFile file;
+        if (!file.open(image.path))
+        {
+            err = "cannot open " + image.path;
+            return false;
+        }
+        uint64_t size = image.size ? image.size : file.size() - std::min<uint64_t>(image.offset, file.size());
+        if (image.offset > file.size() || size > file.size() - image.offset)
+        {
+            err = "image range is outside " + image.path;
+            return false;
+        }
+        ByteSpan bytes = { file.data() + image.offset, static_cast<size_t>(size) };
+
+        texture.levels.clear();
+        texture.pixels = std::vector<unsigned char>();
+        if (!isKtx2Container(bytes))
+        {
+            return decodeImage(bytes, srgb, texture, err);
+        }
+        if (isBasisKtx2Container(bytes))
+        {
+            // The transcoded blocks are copies, the container is no longer needed
+            return transcodeBasisKtx2(bytes, support, texture, err);
+        }
+        if (!parseKtx2Container(bytes, texture, err))
+        {
+            return false;
+        }
+        if (isAstcFormat(texture.internalFormat) && !support.astc)
+        {
+            texture.levels.clear();
+            err = "ASTC is not supported by the GPU";
+            return false;
+        }
+        // The levels point into the mapping, moving it keeps its address
+        texture.file = std::move(file);
+        return true;
+    }
+
+    // Functions to pick the sampler state of a texture, unset or invalid glTF values get the defaults
+    GLint getMinFilter(int32_t filter)
+    {
+        bool valid = filter == GL_NEAREST || filter == GL_LINEAR || filter == GL_NEAREST_MIPMAP_NEAREST ||
+                     filter == GL_LINEAR_MIPMAP_NEAREST || filter == GL_NEAREST_MIPMAP_LINEAR || filter == GL_LINEAR_MIPMAP_LINEAR;
+        return valid ? filter : GL_LINEAR_MIPMAP_LINEAR;
+    }
+    GLint getMagFilter(int32_t filter)
+    {
+        return filter == GL_NEAREST || filter == GL_LINEAR ? filter : GL_LINEAR;
+    }
+    GLint getWrapMode(int32_t wrap)
+    {
+        return wrap == GL_CLAMP_TO_EDGE || wrap == GL_MIRRORED_REPEAT || wrap == GL_REPEAT ? wrap : GL_REPEAT;
+    }
+}
+
+bool isKtx2Container(ByteSpan bytes)
+{
+    return bytes.size >= sizeof(kKtx2Identifier) && std::memcmp(bytes.data, kKtx2Identifier, sizeof(kKtx2Identifier)) == 0;
+}
+
+bool parseKtx2Container(ByteSpan bytes, LoadedTexture& texture, std::string& err)
+{
+    if (!isKtx2Container(bytes) || bytes.size < kKtx2HeaderSize)
+    {
+        err = "not a KTX2 container";
+        return false;
+    }
+    const unsigned char* header = bytes.data + sizeof(kKtx2Identifier);
+    uint32_t vkFormat = readU32(header);
+    uint32_t width = readU32(header + 8);
+    uint32_t height = readU32(header + 12);
+    uint32_t depth = readU32(header + 16);
+    uint32_t layerCount = readU32(header + 20);
+    uint32_t faceCount = readU32(header + 24);
+    uint32_t levelCount = readU32(header + 28);
+    uint32_t supercompressionScheme = readU32(header + 32);
+
+    if (supercompressionScheme != 0)
+    {
+        err = "supercompressed KTX2 (scheme " + std::to_string(supercompressionScheme) + ") is not supported";
+        return false;
+    }
+    if (width == 0 || height == 0 || depth > 1 || layerCount > 1 || faceCount != 1)
+    {
+        err = "only 2D KTX2 textures are supported";
+        return false;
+    }
+    Ktx2Format format;
+    if (!findKtx2Format(vkFormat, format))
+    {
+        err = "KTX2 format " + std::to_string(vkFormat) + " is not supported";
+        return false;
+    }
+
+    // A level count of 0 asks for generated mip levels, only the first one is stored
+    uint32_t storedLevels = std::max(levelCount, 1u);
+    if (storedLevels > 32 || kKtx2HeaderSize + storedLevels * kKtx2LevelIndexEntrySize > bytes.size)
+    {
+        err = "truncated KTX2 level index";
+        return false;
+    }
+
+    std::vector<TextureLevel> levels(storedLevels);
+    for (uint32_t level = 0; level < storedLevels; level++)
+    {
+        const unsigned char* entry = bytes.data + kKtx2HeaderSize + level * kKtx2LevelIndexEntrySize;
+        uint64_t byteOffset = readU64(entry);
+        uint64_t byteLength = readU64(entry + 8);
+        uint32_t levelWidth = std::max(width >> level, 1u);
+        uint32_t levelHeight = std::max(height >> level, 1u);
+        uint64_t blockColumns = (levelWidth + format.blockWidth - 1) / format.blockWidth;
+        uint64_t blockRows = (levelHeight + format.blockHeight - 1) / format.blockHeight;
+        if (byteLength != blockColumns * blockRows * format.blockBytes ||
+            byteOffset > bytes.size || byteLength > bytes.size - byteOffset)
+        {
+            err = "invalid KTX2 level " + std::to_string(level);
+            return false;
+        }
+        levels[level] = TextureLevel{ { bytes.data + byteOffset, static_cast<size_t>(byteLength) }, levelWidth, levelHeight };
+    }
+
+    texture.levels = std::move(levels);
+    texture.internalFormat = format.internalFormat;
+    texture.compressed = format.blockWidth > 1;
+    texture.generateMipmaps = levelCount == 0 && !texture.compressed;
+    return true;
+}
+
+bool isBasisKtx2Container(ByteSpan bytes)
+{
+    return isKtx2Container(bytes) && bytes.size >= kKtx2HeaderSize && readU32(bytes.data + sizeof(kKtx2Identifier)) == kVkFormatUndefined;
+}
+
+TextureFormatSupport detectTextureFormatSupport()
+{
+    TextureFormatSupport support;
+    GLint extensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (GLint extensionIdx = 0; extensionIdx < extensionCount; extensionIdx++)
+    {
+        const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(extensionIdx)));
+        if (extension && std::strcmp(extension, "GL_KHR_texture_compression_astc_ldr") == 0)
+        {
+            support.astc = true;
+        }
+    }
+    return support;
+}
+
+bool loadTexture(const TextureDescription& description, const TextureFormatSupport& support, LoadedTexture& texture)
+{
+    texture.description = description;
+    std::string err;
+    if (loadTextureImage(description.image, description.srgb, support, texture, err))
+    {
+        return true;
+    }
+    if (description.fallbackImage.path.empty())
+    {
+        std::cerr << "Failed to load texture " << description.image.path << ": " << err << std::endl;
+        return false;
+    }
+    std::string fallbackErr;
+    if (loadTextureImage(description.fallbackImage, description.srgb, support, texture, fallbackErr))
+    {
+        return true;
+    }
+    std::cerr << "Failed to load texture " << description.image.path << ": " << err
+              << ", fallback " << description.fallbackImage.path << ": " << fallbackErr << std::endl;
+    return false;
+}
+
+size_t getTextureStorageSize(const LoadedTexture& texture)
+{
+    size_t size = 0;
+    for (const TextureLevel& level : texture.levels)
+    {
+        size += level.bytes.size;
+    }
+    if (texture.generateMipmaps && !texture.levels.empty())
+    {
+        // Generated levels of an RGBA8 texture
+        uint32_t width = texture.levels[0].width;
+        uint32_t height = texture.levels[0].height;
+        for (uint32_t level = 1; (width > 1 || height > 1) && (texture.levelLimit == 0 || level < texture.levelLimit); level++)
+        {
+            width = std::max(width / 2, 1u);
+            height = std::max(height / 2, 1u);
+            size += static_cast<size_t>(width) * height * 4;
+        }
+    }
+    return size;
+}
+
+void queueTextureUpload(const LoadedTexture& texture, uint32_t textureObject, GpuUploadQueue& uploadQueue)
+{
+    if (texture.levels.empty())
+    {
+        return;
+    }
+
+    // Immutable storage for every level, the compressed ones included (they are copied with glCompressedTexSubImage2D)
+    const TextureLevel& first = texture.levels[0];
+    GLsizei levelCount = static_cast<GLsizei>(texture.levels.size());
+    if (texture.generateMipmaps)
+    {
+        levelCount = 1;
+        for (uint32_t size = std::max(first.width, first.height); size > 1; size /= 2)
+        {
+            levelCount++;
+        }
+        if (texture.levelLimit != 0)
+        {
+            levelCount = std::min(levelCount, static_cast<GLsizei>(texture.levelLimit));
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D, textureObject);
+    glTexStorage2D(GL_TEXTURE_2D, levelCount, texture.internalFormat, first.width, first.height);
+
+    // A container with a partial mip chain is complete up to its last level, so is a limited generated chain
+    if (!texture.generateMipmaps)
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(texture.levels.size() - 1));
+    }
+    else if (texture.levelLimit != 0)
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(texture.levelLimit - 1));
+    }
+    const TextureDescription& description = texture.description;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, getMinFilter(description.minFilter));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, getMagFilter(description.magFilter));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, getWrapMode(description.wrapS));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, getWrapMode(description.wrapT));
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Compressed levels go from the mapped container to the driver without decoding
+    for (size_t level = 0; level < texture.levels.size(); level++)
+    {
+        const TextureLevel& mip = texture.levels[level];
+        TextureRegion region;
+        region.texture = textureObject;
+        region.level = static_cast<int32_t>(level);
+        region.width = mip.width;
+        region.height = mip.height;
+        region.format = texture.compressed ? texture.internalFormat : GL_RGBA;
+        region.type = texture.compressed ? 0 : GL_UNSIGNED_BYTE;
+        region.bytes = mip.bytes;
+        uploadQueue.queueTextureRegion(region);
+    }
+    if (texture.generateMipmaps)
+    {
+        uploadQueue.queueTask([textureObject]() {
+            glBindTexture(GL_TEXTURE_2D, textureObject);
+            glGenerateMipmap(GL_TEXTURE_2D);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        });
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef TEXTURE_LOADER_HPP
+#define TEXTURE_LOADER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "basic_types.hpp"
+#include "gpu_upload_queue.hpp"
+#include "mapped_file.hpp"
+#include "material_description.hpp"
+
+// Compressed formats the GL context samples besides ETC2 / EAC, which OpenGL ES 3.0 always supports
+struct TextureFormatSupport
+{
+    bool astc = false;      // KHR_texture_compression_astc_ldr
+};
+
+// One mip level of a texture, ready for upload
+struct TextureLevel
+{
+    ByteSpan bytes;         // Texels or compressed blocks, in the mapped container or in LoadedTexture::pixels
+    uint32_t width;
+    uint32_t height;
+};
+
+// A texture loaded on a worker thread, waiting for its upload.
+// KTX2 containers are mapped and their levels are uploaded from the mapping as they are stored
+// (ETC2 / EAC / ASTC blocks). Basis Universal containers (ETC1S / UASTC) are transcoded to the best
+// format of the GPU, one mip level per worker. Other images are decoded to RGBA8 by stb_image and
+// get their mip levels generated by the GPU
+struct LoadedTexture
+{
+    MappedFile file;                    // Mapping of the KTX2 container, backs the levels
+    std::vector<unsigned char> pixels;  // Transcoded blocks, or decoded RGBA8 pixels of the fallback path
+    std::vector<TextureLevel> levels;   // Mip levels, largest first (empty if the texture could not be loaded)
+    uint32_t internalFormat = 0;        // GL internal format
+    bool compressed = false;            // Levels hold compressed blocks (glCompressedTexImage2D)
+    bool generateMipmaps = false;       // Only the first level is stored, the others are generated after upload
+    uint32_t levelLimit = 0;            // Largest number of generated levels (atlases, whose gutters shrink per level), 0 for the full chain
+    TextureDescription description;     // Sampler state of the texture
+};
+
+// Function to tell whether bytes start with the KTX2 file identifier
+bool isKtx2Container(ByteSpan bytes);
+
+// Function to locate the mip levels of a KTX2 container holding a 2D texture in a format OpenGL ES 3.0
+// samples natively (ETC2 / EAC, ASTC LDR, RGBA8). Nothing is copied, the levels point into bytes.
+// Supercompressed containers and other formats are rejected with a message in err
+bool parseKtx2Container(ByteSpan bytes, LoadedTexture& texture, std::string& err);
+
+// Function to tell whether a KTX2 container holds a Basis Universal payload (ETC1S or UASTC)
+bool isBasisKtx2Container(ByteSpan bytes);
+
+// Function to get the compressed formats supported by the current GL context (render thread only)
+TextureFormatSupport detectTextureFormatSupport();
+
+// Function to load the image of a texture, or its fallback image when the first one is missing or in a
+// format the GPU cannot sample (ASTC without support.astc, Basis Universal without the transcoder).
+// Returns false if neither can be loaded. Atlases have no image, they are composed by composeTextureAtlases
+bool loadTexture(const TextureDescription& description, const TextureFormatSupport& support, LoadedTexture& texture);
+
+// Function to get the GPU storage of a loaded texture, generated mip levels included
+size_t getTextureStorageSize(const LoadedTexture& texture);
+
+// Function to allocate the storage of a texture object and set its sampler state now, and queue the copy of
+// every level (then the mipmap generation) so that large textures are spread over several frames.
+// Must be called on the thread owning the GL context; the loaded texture must stay alive until the queue is empty
+void queueTextureUpload(const LoadedTexture& texture, uint32_t textureObject, GpuUploadQueue& uploadQueue);
+
+#endif // TEXTURE_LOADER_HPP
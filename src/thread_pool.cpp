@@ -0,0 +1,110 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+ThreadPool::ThreadPool(size_t threadCount)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t threadIdx = 0; threadIdx < threadCount; threadIdx++)
+    {
+        workers_.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    taskAvailable_.notify_all();
+    for (std::thread& worker : workers_)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    taskAvailable_.notify_one();
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& body)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    // Iterations are claimed from a shared counter, by the helpers and by the calling thread
+    struct Batch
+    {
+        std::atomic<size_t> nextIteration{ 0 };
+        size_t finishedIterations = 0;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    auto batch = std::make_shared<Batch>();
+    auto runIterations = [batch, count, &body]() {
+        size_t done = 0;
+        for (size_t iteration = batch->nextIteration++; iteration < count; iteration = batch->nextIteration++)
+        {
+            body(iteration);
+            done++;
+        }
+        if (done > 0)
+        {
+            std::lock_guard<std::mutex> lock(batch->mutex);
+            batch->finishedIterations += done;
+            if (batch->finishedIterations == count)
+            {
+                batch->finished.notify_all();
+            }
+        }
+    };
+
+    // body stays alive until every iteration has finished, helpers starting later find no work left
+    size_t helperCount = std::min(count - 1, workers_.size());
+    for (size_t helperIdx = 0; helperIdx < helperCount; helperIdx++)
+    {
+        submit(runIterations);
+    }
+    runIterations();
+
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    batch->finished.wait(lock, [&]() { return batch->finishedIterations == count; });
+}
+
+void ThreadPool::workerLoop()
+{
+    for (;;)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            taskAvailable_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+            if (tasks_.empty())
+            {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
+
+ThreadPool& getWorkerPool()
+{
+    static ThreadPool pool;
+    return pool;
+}
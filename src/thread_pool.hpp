@@ -0,0 +1,44 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running queued tasks
+class ThreadPool
+{
+public:
+    // Create the workers, threadCount = 0 uses one worker per hardware thread
+    explicit ThreadPool(size_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Queue a task, it runs on the first idle worker
+    void submit(std::function<void()> task);
+
+    // Run body(0) ... body(count - 1) on the workers and the calling thread, returns once all have run
+    void parallelFor(size_t count, const std::function<void(size_t)>& body);
+
+    size_t threadCount() const { return workers_.size(); }
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;   // Pending tasks, oldest first
+    std::mutex mutex_;                          // Protects tasks_ and stopping_
+    std::condition_variable taskAvailable_;     // Signaled when a task is queued or the pool stops
+    bool stopping_ = false;
+};
+
+// Function to get the pool shared by the loaders (created on first use)
+ThreadPool& getWorkerPool();
+
+#endif // THREAD_POOL_HPP
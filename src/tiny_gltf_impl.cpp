@@ -0,0 +1,6 @@
+// Single translation unit holding the tinygltf / stb implementations.
+// Every other file includes tiny_gltf.h for declarations only.
+#define TINYGLTF_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "tiny_gltf.h"
@@ -0,0 +1,211 @@
+#include "transform_math.hpp"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define TRANSFORM_MATH_SSE 1
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define TRANSFORM_MATH_NEON 1
+#include <arm_neon.h>
+#endif
+
+void setIdentityMatrix(float result[16])
+{
+    std::memset(result, 0, 16 * sizeof(float));
+    result[0] = result[5] = result[10] = result[15] = 1.0f;
+}
+
+void multiplyMatrices(const float a[16], const float b[16], float result[16])
+{
+    // Column j of the result is a * (column j of b): a linear combination of the columns of a
+#if defined(TRANSFORM_MATH_SSE)
+    __m128 a0 = _mm_loadu_ps(a);
+    __m128 a1 = _mm_loadu_ps(a + 4);
+    __m128 a2 = _mm_loadu_ps(a + 8);
+    __m128 a3 = _mm_loadu_ps(a + 12);
+    __m128 columns[4];
+    for (int column = 0; column < 4; column++)
+    {
+        const float* bColumn = b + column * 4;
+        __m128 sum = _mm_mul_ps(a0, _mm_set1_ps(bColumn[0]));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a1, _mm_set1_ps(bColumn[1])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a2, _mm_set1_ps(bColumn[2])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a3, _mm_set1_ps(bColumn[3])));
+        columns[column] = sum;
+    }
+    // Stored last so that result may alias a or b
+    for (int column = 0; column < 4; column++)
+    {
+        _mm_storeu_ps(result + column * 4, columns[column]);
+    }
+#elif defined(TRANSFORM_MATH_NEON)
+    float32x4_t a0 = vld1q_f32(a);
+    float32x4_t a1 = vld1q_f32(a + 4);
+    float32x4_t a2 = vld1q_f32(a + 8);
+    float32x4_t a3 = vld1q_f32(a + 12);
+    float32x4_t columns[4];
+    for (int column = 0; column < 4; column++)
+    {
+        float32x4_t bColumn = vld1q_f32(b + column * 4);
+        float32x4_t sum = vmulq_n_f32(a0, vgetq_lane_f32(bColumn, 0));
+        sum = vmlaq_n_f32(sum, a1, vgetq_lane_f32(bColumn, 1));
+        sum = vmlaq_n_f32(sum, a2, vgetq_lane_f32(bColumn, 2));
+        sum = vmlaq_n_f32(sum, a3, vgetq_lane_f32(bColumn, 3));
+        columns[column] = sum;
+    }
+    for (int column = 0; column < 4; column++)
+    {
+        vst1q_f32(result + column * 4, columns[column]);
+    }
+#else
+    float product[16];
+    for (int column = 0; column < 4; column++)
+    {
+        for (int row = 0; row < 4; row++)
+        {
+            product[column * 4 + row] = a[row] * b[column * 4] + a[4 + row] * b[column * 4 + 1] +
+                                        a[8 + row] * b[column * 4 + 2] + a[12 + row] * b[column * 4 + 3];
+        }
+    }
+    std::memcpy(result, product, sizeof(product));
+#endif
+}
+
+void composeMatrix(const float translation[3], const float rotation[4], const float scale[3], float result[16])
+{
+    float x = rotation[0], y = rotation[1], z = rotation[2], w = rotation[3];
+    float xx = x * x, yy = y * y, zz = z * z;
+    float xy = x * y, xz = x * z, yz = y * z;
+    float wx = w * x, wy = w * y, wz = w * z;
+
+    result[0] = (1.0f - 2.0f * (yy + zz)) * scale[0];
+    result[1] = 2.0f * (xy + wz) * scale[0];
+    result[2] = 2.0f * (xz - wy) * scale[0];
+    result[3] = 0.0f;
+    result[4] = 2.0f * (xy - wz) * scale[1];
+    result[5] = (1.0f - 2.0f * (xx + zz)) * scale[1];
+    result[6] = 2.0f * (yz + wx) * scale[1];
+    result[7] = 0.0f;
+    result[8] = 2.0f * (xz + wy) * scale[2];
+    result[9] = 2.0f * (yz - wx) * scale[2];
+    result[10] = (1.0f - 2.0f * (xx + yy)) * scale[2];
+    result[11] = 0.0f;
+    result[12] = translation[0];
+    result[13] = translation[1];
+    result[14] = translation[2];
+    result[15] = 1.0f;
+}
+
+void decomposeMatrix(const float matrix[16], float translation[3], float rotation[4], float scale[3])
+{
+    translation[0] = matrix[12];
+    translation[1] = matrix[13];
+    translation[2] = matrix[14];
+
+    // The scale is the length of each basis vector, a negative determinant flips the first axis
+    for (int axis = 0; axis < 3; axis++)
+    {
+        const float* basis = matrix + axis * 4;
+        scale[axis] = std::sqrt(basis[0] * basis[0] + basis[1] * basis[1] + basis[2] * basis[2]);
+    }
+    float determinant = matrix[0] * (matrix[5] * matrix[10] - matrix[9] * matrix[6]) -
+                        matrix[4] * (matrix[1] * matrix[10] - matrix[9] * matrix[2]) +
+                        matrix[8] * (matrix[1] * matrix[6] - matrix[5] * matrix[2]);
+    if (determinant < 0.0f)
+    {
+        scale[0] = -scale[0];
+    }
+
+    // Rotation matrix from the normalized basis, then quaternion (Shepperd's method)
+    float r[9];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float inverseScale = scale[axis] != 0.0f ? 1.0f / scale[axis] : 0.0f;
+        for (int row = 0; row < 3; row++)
+        {
+            r[axis * 3 + row] = matrix[axis * 4 + row] * inverseScale;
+        }
+    }
+    float trace = r[0] + r[4] + r[8];
+    if (trace > 0.0f)
+    {
+        float s = std::sqrt(trace + 1.0f) * 2.0f;
+        rotation[3] = 0.25f * s;
+        rotation[0] = (r[5] - r[7]) / s;
+        rotation[1] = (r[6] - r[2]) / s;
+        rotation[2] = (r[1] - r[3]) / s;
+    }
+    else if (r[0] > r[4] && r[0] > r[8])
+    {
+        float s = std::sqrt(1.0f + r[0] - r[4] - r[8]) * 2.0f;
+        rotation[3] = (r[5] - r[7]) / s;
+        rotation[0] = 0.25f * s;
+        rotation[1] = (r[3] + r[1]) / s;
+        rotation[2] = (r[6] + r[2]) / s;
+    }
+    else if (r[4] > r[8])
+    {
+        float s = std::sqrt(1.0f + r[4] - r[0] - r[8]) * 2.0f;
+        rotation[3] = (r[6] - r[2]) / s;
+        rotation[0] = (r[3] + r[1]) / s;
+        rotation[1] = 0.25f * s;
+        rotation[2] = (r[7] + r[5]) / s;
+    }
+    else
+    {
+        float s = std::sqrt(1.0f + r[8] - r[0] - r[4]) * 2.0f;
+        rotation[3] = (r[1] - r[3]) / s;
+        rotation[0] = (r[6] + r[2]) / s;
+        rotation[1] = (r[7] + r[5]) / s;
+        rotation[2] = 0.25f * s;
+    }
+}
+
+bool invertMatrix(const float matrix[16], float result[16])
+{
+    // Cofactors from the 2x2 determinants of the first two and of the last two columns
+    const float* m = matrix;
+    float s0 = m[0] * m[5] - m[1] * m[4];
+    float s1 = m[0] * m[6] - m[2] * m[4];
+    float s2 = m[0] * m[7] - m[3] * m[4];
+    float s3 = m[1] * m[6] - m[2] * m[5];
+    float s4 = m[1] * m[7] - m[3] * m[5];
+    float s5 = m[2] * m[7] - m[3] * m[6];
+    float c5 = m[10] * m[15] - m[11] * m[14];
+    float c4 = m[9] * m[15] - m[11] * m[13];
+    float c3 = m[9] * m[14] - m[10] * m[13];
+    float c2 = m[8] * m[15] - m[11] * m[12];
+    float c1 = m[8] * m[14] - m[10] * m[12];
+    float c0 = m[8] * m[13] - m[9] * m[12];
+    float determinant = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+    if (determinant == 0.0f)
+    {
+        return false;
+    }
+    float inverseDeterminant = 1.0f / determinant;
+    float inverse[16] = {
+        (m[5] * c5 - m[6] * c4 + m[7] * c3),
+        (-m[1] * c5 + m[2] * c4 - m[3] * c3),
+        (m[13] * s5 - m[14] * s4 + m[15] * s3),
+        (-m[9] * s5 + m[10] * s4 - m[11] * s3),
+        (-m[4] * c5 + m[6] * c2 - m[7] * c1),
+        (m[0] * c5 - m[2] * c2 + m[3] * c1),
+        (-m[12] * s5 + m[14] * s2 - m[15] * s1),
+        (m[8] * s5 - m[10] * s2 + m[11] * s1),
+        (m[4] * c4 - m[5] * c2 + m[7] * c0),
+        (-m[0] * c4 + m[1] * c2 - m[3] * c0),
+        (m[12] * s4 - m[13] * s2 + m[15] * s0),
+        (-m[8] * s4 + m[9] * s2 - m[11] * s0),
+        (-m[4] * c3 + m[5] * c1 - m[6] * c0),
+        (m[0] * c3 - m[1] * c1 + m[2] * c0),
+        (-m[12] * s3 + m[13] * s1 - m[14] * s0),
+        (m[8] * s3 - m[9] * s1 + m[10] * s0),
+    };
+    for (int i = 0; i < 16; i++)
+    {
+        result[i] = inverse[i] * inverseDeterminant;
+    }
+    return true;
+}
@@ -0,0 +1,22 @@
+#ifndef TRANSFORM_MATH_HPP
+#define TRANSFORM_MATH_HPP
+
+// 4x4 matrices are column-major float[16], as in glTF and GL; quaternions are (x, y, z, w)
+
+// Function to set a matrix to identity
+void setIdentityMatrix(float result[16]);
+
+// Function to multiply two matrices (result = a * b), result may alias a or b
+// Uses SSE or NEON when available
+void multiplyMatrices(const float a[16], const float b[16], float result[16]);
+
+// Function to build the matrix T * R * S of a translation, rotation and scale
+void composeMatrix(const float translation[3], const float rotation[4], const float scale[3], float result[16]);
+
+// Function to split a matrix without shear or projection into translation, rotation and scale
+void decomposeMatrix(const float matrix[16], float translation[3], float rotation[4], float scale[3]);
+
+// Function to invert a matrix, returns false (result untouched) when it is singular. result may alias matrix
+bool invertMatrix(const float matrix[16], float result[16]);
+
+#endif // TRANSFORM_MATH_HPP
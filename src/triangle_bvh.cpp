@@ -0,0 +1,658 @@
+#include "triangle_bvh.hpp"
+
+#include <GLES3/gl3.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include "simd_float4.hpp"
+#include "thread_pool.hpp"
+#include "transform_math.hpp"
+
+namespace
+{
+    // Bins of the SAH split search, per axis
+    const uint32_t kSahBins = 16;
+    // Largest leaf, bigger nodes are split even when the SAH prefers a leaf
+    const uint32_t kMaxLeafTriangles = 8;
+    // Cost of visiting a node, relative to a triangle test
+    const float kTraversalCost = 1.0f;
+    // Depth below which nodes are split at the median, which bounds the tree depth to this plus 32
+    const uint32_t kMaxSahDepth = 64;
+    // Entries of the traversal stack, more than the deepest tree needs
+    const uint32_t kTraversalStackSize = 128;
+    // Slack of the barycentric tests, hits on a shared edge are not lost between its two triangles
+    const float kBarycentricEpsilon = 1e-6f;
+
+    // Axis-aligned box, the 4th lane is unused
+    struct Box
+    {
+        Float4 min = splatFloat4(FLT_MAX);
+        Float4 max = splatFloat4(-FLT_MAX);
+    };
+
+    // Function to extend a box to a point
+    void growBox(Box& box, Float4 point)
+    {
+        box.min = minFloat4(box.min, point);
+        box.max = maxFloat4(box.max, point);
+    }
+
+    // Function to extend a box to another box
+    void growBox(Box& box, const Box& other)
+    {
+        box.min = minFloat4(box.min, other.min);
+        box.max = maxFloat4(box.max, other.max);
+    }
+
+    // Function to read the 3 first lanes of a vector
+    void storeFloat3(float destination[3], Float4 value)
+    {
+        float lanes[4];
+        storeFloat4(lanes, value);
+        std::copy(lanes, lanes + 3, destination);
+    }
+
+    // Function to get half the surface area of a box, 0 for an empty box
+    float getHalfArea(const Box& box)
+    {
+        float extent[4];
+        storeFloat4(extent, maxFloat4(box.max - box.min, splatFloat4(0.0f)));
+        return extent[0] * extent[1] + extent[1] * extent[2] + extent[2] * extent[0];
+    }
+
+    // Triangles of the build, in the order of the draws
+    struct BuildInput
+    {
+        std::vector<Box> bounds;            // Box of every triangle
+        std::vector<float> centroids;       // Center of the box of every triangle (4 floats, the last one unused)
+    };
+
+    // Range of the triangle order covered by a node
+    struct BuildRange
+    {
+        uint32_t node;
+        uint32_t begin;
+        uint32_t end;
+        uint32_t depth;
+    };
+
+    // Function to get the box of the triangles order[begin, end) and the box of their centroids
+    Box getRangeBox(const BuildInput& input, const std::vector<uint32_t>& order, uint32_t begin, uint32_t end, Box& centroidBox)
+    {
+        Box box;
+        centroidBox = Box();
+        for (uint32_t i = begin; i < end; i++)
+        {
+            growBox(box, input.bounds[order[i]]);
+            growBox(centroidBox, loadFloat4(&input.centroids[static_cast<size_t>(order[i]) * 4]));
+        }
+        return box;
+    }
+
+    // Function to choose how the triangles order[begin, end) of a node are split, by evaluating the SAH cost of the
+    // bin boundaries of every axis; the triangles are partitioned and middle receives the first one of the right child.
+    // Returns false when the node stays a leaf
+    bool splitNode(const BuildInput& input, std::vector<uint32_t>& order, const BuildRange& range, const Box& box,
+                   const Box& centroidBox, uint32_t& middle)
+    {
+        uint32_t count = range.end - range.begin;
+        if (count <= 1)
+        {
+            return false;
+        }
+        const float* centroids = input.centroids.data();
+        float centroidMin[3], centroidMax[3];
+        storeFloat3(centroidMin, centroidBox.min);
+        storeFloat3(centroidMax, centroidBox.max);
+        float bestCost = FLT_MAX;
+        int bestAxis = -1;
+        uint32_t bestBin = 0;
+        if (range.depth < kMaxSahDepth)
+        {
+            // One pass over the triangles fills the bins of the 3 axes
+            float binScales[3];
+            for (int axis = 0; axis < 3; axis++)
+            {
+                float extent = centroidMax[axis] - centroidMin[axis];
+                binScales[axis] = extent > 0.0f ? kSahBins / extent : 0.0f;
+            }
+            uint32_t binCounts[3][kSahBins] = {};
+            Box binBoxes[3][kSahBins];
+            for (uint32_t i = range.begin; i < range.end; i++)
+            {
+                const float* centroid = &centroids[static_cast<size_t>(order[i]) * 4];
+                const Box& bounds = input.bounds[order[i]];
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    uint32_t bin = std::min(static_cast<uint32_t>((centroid[axis] - centroidMin[axis]) * binScales[axis]), kSahBins - 1);
+                    binCounts[axis][bin]++;
+                    growBox(binBoxes[axis][bin], bounds);
+                }
+            }
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                if (binScales[axis] == 0.0f)
+                {
+                    continue;
+                }
+                // Right side costs from a sweep down, then the split after every bin from a sweep up
+                float rightCosts[kSahBins] = {};
+                Box rightBox;
+                uint32_t rightCount = 0;
+                for (uint32_t bin = kSahBins - 1; bin > 0; bin--)
+                {
+                    growBox(rightBox, binBoxes[axis][bin]);
+                    rightCount += binCounts[axis][bin];
+                    rightCosts[bin - 1] = rightCount * getHalfArea(rightBox);
+                }
+                Box leftBox;
+                uint32_t leftCount = 0;
+                for (uint32_t bin = 0; bin + 1 < kSahBins; bin++)
+                {
+                    growBox(leftBox, binBoxes[axis][bin]);
+                    leftCount += binCounts[axis][bin];
+                    float cost = leftCount * getHalfArea(leftBox) + rightCosts[bin];
+                    if (leftCount > 0 && leftCount < count && cost < bestCost)
+                    {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestBin = bin;
+                    }
+                }
+            }
+        }
+
+        if (bestAxis >= 0)
+        {
+            float area = getHalfArea(box);
+            if (count <= kMaxLeafTriangles && kTraversalCost * area + bestCost >= count * area)
+            {
+                return false;
+            }
+            float binScale = kSahBins / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+            auto split = std::partition(order.begin() + range.begin, order.begin() + range.end, [&](uint32_t triangle) {
+                float centroid = centroids[static_cast<size_t>(triangle) * 4 + bestAxis];
+                return std::min(static_cast<uint32_t>((centroid - centroidMin[bestAxis]) * binScale), kSahBins - 1) <= bestBin;
+            });
+            middle = static_cast<uint32_t>(split - order.begin());
+            return true;
+        }
+        if (count <= kMaxLeafTriangles)
+        {
+            return false;
+        }
+
+        // Too deep for the SAH or centroids in one point: halve the node along its longest centroid axis
+        int axis = 0;
+        for (int other = 1; other < 3; other++)
+        {
+            if (centroidMax[other] - centroidMin[other] > centroidMax[axis] - centroidMin[axis])
+            {
+                axis = other;
+            }
+        }
+        middle = range.begin + count / 2;
+        std::nth_element(order.begin() + range.begin, order.begin() + middle, order.begin() + range.end,
+                         [&](uint32_t a, uint32_t b) {
+                             return centroids[static_cast<size_t>(a) * 4 + axis] < centroids[static_cast<size_t>(b) * 4 + axis];
+                         });
+        return true;
+    }
+
+    // Function to build the subtree of nodes[root.node] over its triangle range, new nodes are appended to nodes.
+    // When tasks is set, ranges of at most grain triangles are not split but left to the caller as tasks
+    void buildSubtree(const BuildInput& input, std::vector<uint32_t>& order, std::vector<BvhNode>& nodes, const BuildRange& root,
+                      uint32_t grain, std::vector<BuildRange>* tasks)
+    {
+        std::vector<BuildRange> stack = { root };
+        while (!stack.empty())
+        {
+            BuildRange range = stack.back();
+            stack.pop_back();
+            Box centroidBox;
+            Box box = getRangeBox(input, order, range.begin, range.end, centroidBox);
+            BvhNode& node = nodes[range.node];
+            storeFloat3(node.boundsMin, box.min);
+            storeFloat3(node.boundsMax, box.max);
+            node.first = range.begin;
+            node.triangleCount = range.end - range.begin;
+            uint32_t middle = 0;
+            if (tasks && range.end - range.begin <= grain)
+            {
+                tasks->push_back(range);
+                continue;
+            }
+            if (!splitNode(input, order, range, box, centroidBox, middle))
+            {
+                continue;
+            }
+            uint32_t left = static_cast<uint32_t>(nodes.size());
+            node.first = left;
+            node.triangleCount = 0;
+            nodes.resize(nodes.size() + 2);
+            stack.push_back({ left + 1, middle, range.end, range.depth + 1 });
+            stack.push_back({ left, range.begin, middle, range.depth + 1 });
+        }
+    }
+
+    // Function to read the stored position of a vertex (float or 16-bit components)
+    void readStoredPosition(const unsigned char* vertex, const VertexAttribute& attribute, float position[4])
+    {
+        position[3] = 1.0f;
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            if (attribute.componentType == GL_FLOAT)
+            {
+                std::memcpy(&position[c], vertex + c * sizeof(float), sizeof(float));
+                continue;
+            }
+            int16_t value;
+            std::memcpy(&value, vertex + c * sizeof(int16_t), sizeof(int16_t));
+            position[c] = attribute.normalized ? std::max(value / 32767.0f, -1.0f) : static_cast<float>(value);
+        }
+    }
+
+    // Function to transform a point (w = 1) by a matrix, with the perspective divide
+    void transformPoint(const float matrix[16], const float point[3], float result[3])
+    {
+        float transformed[4];
+        for (int row = 0; row < 4; row++)
+        {
+            transformed[row] = matrix[row] * point[0] + matrix[4 + row] * point[1] + matrix[8 + row] * point[2] + matrix[12 + row];
+        }
+        for (int row = 0; row < 3; row++)
+        {
+            result[row] = transformed[row] / transformed[3];
+        }
+    }
+
+    // Function to get the entry distance of the rays of a packet into a box, returns the mask of the rays that
+    // enter it before their closest hit
+    int intersectBox(const BvhNode& node, const Float4 origins[3], const Float4 inverseDirections[3], Float4 closestDistances,
+                     Float4& entry)
+    {
+        Float4 entryDistance = splatFloat4(0.0f);
+        Float4 exitDistance = closestDistances;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            Float4 t0 = (splatFloat4(node.boundsMin[axis]) - origins[axis]) * inverseDirections[axis];
+            Float4 t1 = (splatFloat4(node.boundsMax[axis]) - origins[axis]) * inverseDirections[axis];
+            entryDistance = maxFloat4(entryDistance, minFloat4(t0, t1));
+            exitDistance = minFloat4(exitDistance, maxFloat4(t0, t1));
+        }
+        entry = entryDistance;
+        return ~lessThanMaskFloat4(exitDistance, entryDistance) & 0xF;
+    }
+
+    // Function to get the smallest entry distance of the rays of a mask
+    float getNearestEntry(Float4 entry, int mask)
+    {
+        float entries[4];
+        storeFloat4(entries, entry);
+        float nearest = FLT_MAX;
+        for (int lane = 0; lane < 4; lane++)
+        {
+            if (mask & (1 << lane))
+            {
+                nearest = std::min(nearest, entries[lane]);
+            }
+        }
+        return nearest;
+    }
+
+    // Function to get the number of copies of a draw in the scene: the instances of its node, for rigid draws
+    uint32_t getDrawInstanceCount(const MeshData& meshData, const DrawCommand& draw)
+    {
+        bool instanced = draw.skin == kNoSkin && draw.node < meshData.nodes.size() && meshData.nodes[draw.node].instanceCount > 0;
+        return instanced ? meshData.nodes[draw.node].instanceCount : 1;
+    }
+}
+
+bool buildTriangleBvh(const MeshData& meshData, const SceneGraph& graph, TriangleBvh& bvh)
+{
+    bvh = TriangleBvh();
+    const VertexAttribute* positionAttribute = nullptr;
+    for (const VertexAttribute& attribute : meshData.attributes)
+    {
+        if (attribute.location == kPositionLocation)
+        {
+            positionAttribute = &attribute;
+        }
+    }
+    if (!positionAttribute || positionAttribute->stream >= meshData.streams.size() || positionAttribute->componentCount < 3 ||
+        (positionAttribute->componentType != GL_FLOAT && positionAttribute->componentType != GL_SHORT))
+    {
+        std::cerr << "No readable positions, the picking BVH is empty" << std::endl;
+        return false;
+    }
+    const VertexStream& stream = meshData.streams[positionAttribute->stream];
+    uint32_t componentSize = positionAttribute->componentType == GL_FLOAT ? 4 : 2;
+    size_t stride = stream.stride ? stream.stride : positionAttribute->componentCount * componentSize;
+
+    // Triangles of every draw, repeated for every instance of its node; draws whose ranges fall outside the buffers get none
+    std::vector<uint32_t> firstTriangles(meshData.draws.size() + 1, 0);
+    bvh.drawNodes.resize(meshData.draws.size());
+    bvh.drawTriangleCounts.resize(meshData.draws.size());
+    for (size_t drawIdx = 0; drawIdx < meshData.draws.size(); drawIdx++)
+    {
+        const DrawCommand& draw = meshData.draws[drawIdx];
+        bvh.drawNodes[drawIdx] = draw.node;
+        bvh.drawTriangleCounts[drawIdx] = draw.indexCount / 3;
+        uint32_t indexSize = draw.indexType == GL_UNSIGNED_INT ? 4 : (draw.indexType == GL_UNSIGNED_SHORT ? 2 : 1);
+        bool valid = draw.segment < meshData.segments.size() && meshData.segments[draw.segment].vertexCount > 0 &&
+                     static_cast<uint64_t>(draw.indexOffset) + static_cast<uint64_t>(draw.indexCount) * indexSize <=
+                         meshData.indices.bytes.size;
+        if (valid)
+        {
+            const VertexSegment& segment = meshData.segments[draw.segment];
+            valid = static_cast<uint64_t>(segment.firstVertex + segment.vertexCount - 1) * stride + positionAttribute->offset +
+                        3 * componentSize <= stream.data.bytes.size;
+        }
+        if (!valid)
+        {
+            std::cerr << "Draw " << drawIdx << " reads outside the mesh buffers, left out of the picking BVH" << std::endl;
+        }
+        firstTriangles[drawIdx + 1] = firstTriangles[drawIdx] + (valid ? draw.indexCount / 3 * getDrawInstanceCount(meshData, draw) : 0);
+    }
+    uint32_t triangleCount = firstTriangles.back();
+    if (triangleCount == 0)
+    {
+        return false;
+    }
+
+    // World-space vertices of every triangle, the draws are independent
+    std::vector<float> vertices(static_cast<size_t>(triangleCount) * 9);
+    BuildInput input;
+    input.bounds.resize(triangleCount);
+    input.centroids.resize(static_cast<size_t>(triangleCount) * 4);
+    getWorkerPool().parallelFor(meshData.draws.size(), [&](size_t drawIdx) {
+        const DrawCommand& draw = meshData.draws[drawIdx];
+        uint32_t firstTriangle = firstTriangles[drawIdx];
+        uint32_t drawTriangleCount = firstTriangles[drawIdx + 1] - firstTriangle;
+        if (drawTriangleCount == 0)
+        {
+            return;
+        }
+        // Placed like the vertex shader does: skinned draws (and nodes missing from the graph) use the identity,
+        // the instances of a node are placed by its world matrix times their own
+        const VertexSegment& segment = meshData.segments[draw.segment];
+        uint32_t instanceCount = getDrawInstanceCount(meshData, draw);
+        uint32_t instanceTriangleCount = drawTriangleCount / instanceCount;
+        float matrix[16];
+        std::copy(segment.positionDequantization, segment.positionDequantization + 16, matrix);
+        if (draw.skin == kNoSkin && draw.node < graph.nodeSlots.size())
+        {
+            multiplyMatrices(getNodeWorldMatrix(graph, draw.node), matrix, matrix);
+        }
+        const unsigned char* indices = meshData.indices.bytes.data + draw.indexOffset;
+        const unsigned char* vertexBase = stream.data.bytes.data + static_cast<size_t>(segment.firstVertex) * stride +
+                                          positionAttribute->offset;
+        float instanceMatrix[16];
+        for (uint32_t triangle = 0; triangle < drawTriangleCount; triangle++)
+        {
+            if (triangle % instanceTriangleCount == 0 && instanceCount > 1)
+            {
+                const SceneNode& node = meshData.nodes[draw.node];
+                size_t instance = static_cast<size_t>(node.firstInstance) + triangle / instanceTriangleCount;
+                float world[16];
+                multiplyMatrices(getNodeWorldMatrix(graph, draw.node), &meshData.instanceMatrices[instance * 16], world);
+                multiplyMatrices(world, segment.positionDequantization, instanceMatrix);
+            }
+            const float* placement = instanceCount > 1 ? instanceMatrix : matrix;
+            size_t triangleIdx = firstTriangle + triangle;
+            float* corners = &vertices[triangleIdx * 9];
+            Box& bounds = input.bounds[triangleIdx];
+            bounds = Box();
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                size_t element = static_cast<size_t>(triangle % instanceTriangleCount) * 3 + corner;
+                uint32_t index = 0;
+                if (draw.indexType == GL_UNSIGNED_INT)
+                {
+                    std::memcpy(&index, indices + element * 4, 4);
+                }
+                else if (draw.indexType == GL_UNSIGNED_SHORT)
+                {
+                    uint16_t shortIndex;
+                    std::memcpy(&shortIndex, indices + element * 2, 2);
+                    index = shortIndex;
+                }
+                else
+                {
+                    index = indices[element];
+                }
+                // Out-of-range indices of a malformed cache collapse onto the last vertex
+                index = std::min(index, segment.vertexCount - 1);
+                float position[4];
+                readStoredPosition(vertexBase + static_cast<size_t>(index) * stride, *positionAttribute, position);
+                transformPoint(placement, position, corners + corner * 3);
+                float corner4[4] = { corners[corner * 3], corners[corner * 3 + 1], corners[corner * 3 + 2], 0.0f };
+                growBox(bounds, loadFloat4(corner4));
+            }
+            storeFloat4(&input.centroids[triangleIdx * 4], (bounds.min + bounds.max) * splatFloat4(0.5f));
+        }
+    });
+
+    // Top of the tree on this thread, down to ranges small enough to give every worker several subtrees
+    std::vector<uint32_t> order(triangleCount);
+    for (uint32_t triangle = 0; triangle < triangleCount; triangle++)
+    {
+        order[triangle] = triangle;
+    }
+    ThreadPool& pool = getWorkerPool();
+    uint32_t grain = std::max<uint32_t>(triangleCount / static_cast<uint32_t>(4 * (pool.threadCount() + 1)), 1024);
+    std::vector<BuildRange> tasks;
+    bvh.nodes.resize(1);
+    buildSubtree(input, order, bvh.nodes, { 0, 0, triangleCount, 0 }, grain, &tasks);
+
+    // Subtrees of disjoint ranges of the order, each into its own node list with its root first
+    std::vector<std::vector<BvhNode>> subtrees(tasks.size());
+    pool.parallelFor(tasks.size(), [&](size_t taskIdx) {
+        BuildRange root = tasks[taskIdx];
+        root.node = 0;
+        subtrees[taskIdx].resize(1);
+        buildSubtree(input, order, subtrees[taskIdx], root, 0, nullptr);
+    });
+    for (size_t taskIdx = 0; taskIdx < tasks.size(); taskIdx++)
+    {
+        // Local node i > 0 lands at base + i - 1, the local root replaces the node of the task
+        uint32_t base = static_cast<uint32_t>(bvh.nodes.size());
+        std::vector<BvhNode>& subtree = subtrees[taskIdx];
+        for (BvhNode& node : subtree)
+        {
+            if (node.triangleCount == 0)
+            {
+                node.first = base + node.first - 1;
+            }
+        }
+        bvh.nodes[tasks[taskIdx].node] = subtree[0];
+        bvh.nodes.insert(bvh.nodes.end(), subtree.begin() + 1, subtree.end());
+    }
+
+    // Triangles in leaf order, as the vertex and edges the intersection test uses
+    bvh.triangles.resize(static_cast<size_t>(triangleCount) * 9);
+    bvh.triangleDraws.resize(triangleCount);
+    bvh.drawTriangles.resize(triangleCount);
+    for (uint32_t triangle = 0; triangle < triangleCount; triangle++)
+    {
+        uint32_t source = order[triangle];
+        const float* corners = &vertices[static_cast<size_t>(source) * 9];
+        float* destination = &bvh.triangles[static_cast<size_t>(triangle) * 9];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            destination[axis] = corners[axis];
+            destination[3 + axis] = corners[3 + axis] - corners[axis];
+            destination[6 + axis] = corners[6 + axis] - corners[axis];
+        }
+        // Last draw starting at or before the triangle, draws without triangles start where the next one does
+        uint32_t drawIdx = static_cast<uint32_t>(std::upper_bound(firstTriangles.begin(), firstTriangles.end(), source) -
+                                                 firstTriangles.begin()) - 1;
+        bvh.triangleDraws[triangle] = drawIdx;
+        bvh.drawTriangles[triangle] = source - firstTriangles[drawIdx];
+    }
+    return true;
+}
+
+void intersectRayPacket(const TriangleBvh& bvh, const RayPacket& packet, RayHit hits[4])
+{
+    for (int lane = 0; lane < 4; lane++)
+    {
+        hits[lane] = RayHit();
+    }
+    if (bvh.nodes.empty())
+    {
+        return;
+    }
+
+    // Zero direction components are nudged so that the slab distances stay finite
+    Float4 origins[3], directions[3], inverseDirections[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float inverse[4];
+        for (int lane = 0; lane < 4; lane++)
+        {
+            float direction = packet.directions[axis][lane];
+            inverse[lane] = 1.0f / (std::fabs(direction) > 1e-30f ? direction : std::copysign(1e-30f, direction));
+        }
+        origins[axis] = loadFloat4(packet.origins[axis]);
+        directions[axis] = loadFloat4(packet.directions[axis]);
+        inverseDirections[axis] = loadFloat4(inverse);
+    }
+    float closest[4] = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
+    Float4 closestDistances = loadFloat4(closest);
+
+    struct StackEntry
+    {
+        uint32_t node;
+        float entry;            // Nearest entry distance of the rays into the node
+    };
+    StackEntry stack[kTraversalStackSize];
+    uint32_t stackSize = 0;
+    Float4 entry;
+    int rootMask = intersectBox(bvh.nodes[0], origins, inverseDirections, closestDistances, entry);
+    if (rootMask)
+    {
+        stack[stackSize++] = { 0, getNearestEntry(entry, rootMask) };
+    }
+    while (stackSize > 0)
+    {
+        StackEntry current = stack[--stackSize];
+        if (current.entry > std::max(std::max(closest[0], closest[1]), std::max(closest[2], closest[3])))
+        {
+            continue;
+        }
+        const BvhNode& node = bvh.nodes[current.node];
+
+        // Inner node: the children the rays enter, the nearest one popped first
+        if (node.triangleCount == 0)
+        {
+            Float4 leftEntry, rightEntry;
+            int leftMask = intersectBox(bvh.nodes[node.first], origins, inverseDirections, closestDistances, leftEntry);
+            int rightMask = intersectBox(bvh.nodes[node.first + 1], origins, inverseDirections, closestDistances, rightEntry);
+            StackEntry left = { node.first, getNearestEntry(leftEntry, leftMask) };
+            StackEntry right = { node.first + 1, getNearestEntry(rightEntry, rightMask) };
+            if (leftMask && rightMask && left.entry < right.entry)
+            {
+                std::swap(left, right);
+                std::swap(leftMask, rightMask);
+            }
+            if (leftMask && stackSize < kTraversalStackSize)
+            {
+                stack[stackSize++] = left;
+            }
+            if (rightMask && stackSize < kTraversalStackSize)
+            {
+                stack[stackSize++] = right;
+            }
+            continue;
+        }
+
+        // Leaf: Moller-Trumbore test of every triangle against the 4 rays, both faces hit
+        for (uint32_t triangle = node.first; triangle < node.first + node.triangleCount; triangle++)
+        {
+            const float* vertex = &bvh.triangles[static_cast<size_t>(triangle) * 9];
+            Float4 v0[3], edge1[3], edge2[3];
+            for (int axis = 0; axis < 3; axis++)
+            {
+                v0[axis] = splatFloat4(vertex[axis]);
+                edge1[axis] = splatFloat4(vertex[3 + axis]);
+                edge2[axis] = splatFloat4(vertex[6 + axis]);
+            }
+            Float4 p[3] = { directions[1] * edge2[2] - directions[2] * edge2[1], directions[2] * edge2[0] - directions[0] * edge2[2],
+                            directions[0] * edge2[1] - directions[1] * edge2[0] };
+            Float4 inverseDeterminant = splatFloat4(1.0f) / (edge1[0] * p[0] + edge1[1] * p[1] + edge1[2] * p[2]);
+            Float4 t[3] = { origins[0] - v0[0], origins[1] - v0[1], origins[2] - v0[2] };
+            Float4 u = (t[0] * p[0] + t[1] * p[1] + t[2] * p[2]) * inverseDeterminant;
+            Float4 q[3] = { t[1] * edge1[2] - t[2] * edge1[1], t[2] * edge1[0] - t[0] * edge1[2], t[0] * edge1[1] - t[1] * edge1[0] };
+            Float4 v = (directions[0] * q[0] + directions[1] * q[1] + directions[2] * q[2]) * inverseDeterminant;
+            Float4 distance = (edge2[0] * q[0] + edge2[1] * q[1] + edge2[2] * q[2]) * inverseDeterminant;
+
+            // Written as "less than" tests only, so that the NaN of a ray parallel to the triangle fails them
+            Float4 lowest = splatFloat4(-kBarycentricEpsilon);
+            int mask = lessThanMaskFloat4(lowest, u) & lessThanMaskFloat4(lowest, v) &
+                       lessThanMaskFloat4(u + v, splatFloat4(1.0f + kBarycentricEpsilon)) &
+                       lessThanMaskFloat4(splatFloat4(0.0f), distance) & lessThanMaskFloat4(distance, closestDistances);
+            if (!mask)
+            {
+                continue;
+            }
+            float us[4], vs[4], distances[4];
+            storeFloat4(us, u);
+            storeFloat4(vs, v);
+            storeFloat4(distances, distance);
+            for (int lane = 0; lane < 4; lane++)
+            {
+                if (mask & (1 << lane))
+                {
+                    RayHit& hit = hits[lane];
+                    hit.draw = bvh.triangleDraws[triangle];
+                    hit.node = bvh.drawNodes[hit.draw];
+                    hit.triangle = bvh.drawTriangles[triangle] % bvh.drawTriangleCounts[hit.draw];
+                    hit.instance = bvh.drawTriangles[triangle] / bvh.drawTriangleCounts[hit.draw];
+                    hit.distance = distances[lane];
+                    hit.barycentrics[0] = us[lane];
+                    hit.barycentrics[1] = vs[lane];
+                    closest[lane] = distances[lane];
+                }
+            }
+            closestDistances = loadFloat4(closest);
+        }
+    }
+}
+
+void pickScreenPoints(const TriangleBvh& bvh, const float viewProjection[16], float windowWidth, float windowHeight,
+                      const float* points, size_t pointCount, RayHit* hits)
+{
+    float inverseViewProjection[16];
+    if (!invertMatrix(viewProjection, inverseViewProjection))
+    {
+        std::fill(hits, hits + pointCount, RayHit());
+        return;
+    }
+    for (size_t first = 0; first < pointCount; first += 4)
+    {
+        // The last packet repeats its last point in the unused lanes
+        RayPacket packet;
+        for (size_t lane = 0; lane < 4; lane++)
+        {
+            const float* point = points + std::min(first + lane, pointCount - 1) * 2;
+            float x = point[0] / windowWidth * 2.0f - 1.0f;
+            float y = 1.0f - point[1] / windowHeight * 2.0f;
+            float nearPoint[3] = { x, y, -1.0f }, farPoint[3] = { x, y, 1.0f };
+            float origin[3], end[3];
+            transformPoint(inverseViewProjection, nearPoint, origin);
+            transformPoint(inverseViewProjection, farPoint, end);
+            for (int axis = 0; axis < 3; axis++)
+            {
+                packet.origins[axis][lane] = origin[axis];
+                packet.directions[axis][lane] = end[axis] - origin[axis];
+            }
+        }
+        RayHit packetHits[4];
+        intersectRayPacket(bvh, packet, packetHits);
+        std::copy(packetHits, packetHits + std::min<size_t>(4, pointCount - first), hits + first);
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef TRIANGLE_BVH_HPP
+#define TRIANGLE_BVH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "mesh_data.hpp"
+#include "scene_graph.hpp"
+
+// Draw index of a ray that hits nothing
+const uint32_t kNoRayHit = UINT32_MAX;
+
+// Node of a triangle BVH (32 bytes). The children of an inner node are stored next to each other
+struct BvhNode
+{
+    float boundsMin[3];
+    uint32_t first;             // Inner node: left child (the right one follows); leaf: first triangle
+    float boundsMax[3];
+    uint32_t triangleCount;     // 0 for inner nodes
+};
+
+// Bounding volume hierarchy over the world-space triangles of a scene, for picking and ray queries.
+// Triangles are stored in leaf order as a vertex and two edges, with the draw they come from
+struct TriangleBvh
+{
+    std::vector<BvhNode> nodes;             // Node 0 is the root
+    std::vector<float> triangles;           // Vertex 0, edge 0 -> 1 and edge 0 -> 2 of every triangle (9 floats)
+    std::vector<uint32_t> triangleDraws;    // Index in MeshData::draws of every triangle
+    std::vector<uint32_t> drawTriangles;    // Index of every triangle among the triangles of its draw, instances one after another
+    std::vector<uint32_t> drawNodes;        // Node of every draw of the mesh
+    std::vector<uint32_t> drawTriangleCounts;   // Triangles of one instance of every draw
+};
+
+// Four rays traced together, as component planes. Rays of a packet should be coherent (neighbouring
+// screen points) so that they visit the same nodes
+struct RayPacket
+{
+    float origins[3][4];        // Origin x, y, z of every ray
+    float directions[3][4];     // Direction x, y, z of every ray (any length)
+};
+
+// Closest hit of a ray
+struct RayHit
+{
+    uint32_t draw = kNoRayHit;  // Draw hit (index in MeshData::draws), kNoRayHit on a miss
+    uint32_t node = 0;          // Node of the draw
+    uint32_t triangle = 0;      // Triangle among the triangles of the draw (its indices start at 3 * triangle)
+    uint32_t instance = 0;      // Instance of the node hit (EXT_mesh_gpu_instancing), 0 for nodes drawn once
+    float distance = 0.0f;      // Ray parameter of the hit: origin + distance * direction
+    float barycentrics[2] = {}; // Weights of vertices 1 and 2 of the triangle (vertex 0 gets the rest)
+};
+
+// Function to build the BVH of the triangles of a mesh, placed by the world matrices of the scene graph (which must be
+// up to date), and by the instance matrices of nodes with instances. Skinned draws use their bind pose and morph targets
+// are ignored, the BVH is not updated by animations.
+// The vertex and index bytes of meshData are read, so this runs before they are released.
+// Binned SAH build; the top of the tree is split on the calling thread, the subtrees below on the worker pool
+bool buildTriangleBvh(const MeshData& meshData, const SceneGraph& graph, TriangleBvh& bvh);
+
+// Function to find the closest hit of the 4 rays of a packet
+void intersectRayPacket(const TriangleBvh& bvh, const RayPacket& packet, RayHit hits[4]);
+
+// Function to find what is under window points (pixels, origin at the top left) for a column-major view projection
+// matrix; rays start on the near plane. Points are traced by packets of 4 consecutive points
+void pickScreenPoints(const TriangleBvh& bvh, const float viewProjection[16], float windowWidth, float windowHeight,
+                      const float* points, size_t pointCount, RayHit* hits);
+
+#endif // TRIANGLE_BVH_HPP
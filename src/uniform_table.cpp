@@ -0,0 +1,159 @@
+#include "uniform_table.hpp"
+
+#include <GLES3/gl3.h>
+#include <cstring>
+
+namespace
+{
+    // Function to get the value type and component count of a GL uniform type, false for the types left out
+    bool getUniformType(GLenum glType, MaterialUniformType& type, uint32_t& components)
+    {
+        switch (glType)
+        {
+        case GL_FLOAT:
+            type = MaterialUniformType::Float;
+            components = 1;
+            return true;
+        case GL_FLOAT_VEC2:
+            type = MaterialUniformType::Vector2;
+            components = 2;
+            return true;
+        case GL_FLOAT_VEC3:
+            type = MaterialUniformType::Vector3;
+            components = 3;
+            return true;
+        case GL_FLOAT_VEC4:
+            type = MaterialUniformType::Vector4;
+            components = 4;
+            return true;
+        case GL_FLOAT_MAT4:
+            type = MaterialUniformType::Matrix4;
+            components = 16;
+            return true;
+        case GL_INT:
+        case GL_BOOL:
+            type = MaterialUniformType::Int;
+            components = 1;
+            return true;
+        case GL_SAMPLER_2D:
+            type = MaterialUniformType::Sampler2D;
+            components = 1;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // Function to tell whether a value type is stored in UniformTable::intValues
+    bool isIntType(MaterialUniformType type)
+    {
+        return type == MaterialUniformType::Int || type == MaterialUniformType::Sampler2D;
+    }
+}
+
+void buildUniformTable(UniformTable& table, uint32_t program)
+{
+    table = UniformTable();
+    GLint uniformCount = 0, maxNameLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniformCount);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+    std::vector<char> name(static_cast<size_t>(maxNameLength) + 1, '\0');
+    for (GLint uniform = 0; uniform < uniformCount; uniform++)
+    {
+        GLsizei nameLength = 0;
+        GLint arraySize = 0;
+        GLenum glType = 0;
+        glGetActiveUniform(program, static_cast<GLuint>(uniform), static_cast<GLsizei>(name.size()), &nameLength, &arraySize, &glType, name.data());
+        name[static_cast<size_t>(nameLength)] = '\0';
+
+        UniformBinding binding;
+        if (!getUniformType(glType, binding.type, binding.components))
+        {
+            continue;
+        }
+        // Members of uniform blocks have no location
+        binding.location = glGetUniformLocation(program, name.data());
+        if (binding.location < 0)
+        {
+            continue;
+        }
+        // Arrays are reported by their first element, they are found by their plain name
+        char* bracket = std::strchr(name.data(), '[');
+        if (bracket)
+        {
+            *bracket = '\0';
+        }
+        binding.arraySize = static_cast<uint32_t>(arraySize > 0 ? arraySize : 1);
+        binding.dirtyEnd = 0;
+        binding.nameOffset = static_cast<uint32_t>(table.names.size());
+        table.names += name.data();
+        table.names += '\0';
+
+        size_t valueCount = static_cast<size_t>(binding.components) * binding.arraySize;
+        if (isIntType(binding.type))
+        {
+            binding.valueOffset = static_cast<uint32_t>(table.intValues.size());
+            table.intValues.resize(table.intValues.size() + valueCount, 0);
+        }
+        else
+        {
+            binding.valueOffset = static_cast<uint32_t>(table.floatValues.size());
+            table.floatValues.resize(table.floatValues.size() + valueCount, 0.0f);
+        }
+        table.bindings.push_back(binding);
+    }
+    // Writes never allocate: a binding is listed at most once between two uploads
+    table.dirtyBindings.reserve(table.bindings.size());
+}
+
+uint32_t findUniformBinding(const UniformTable& table, const char* name, MaterialUniformType type)
+{
+    size_t nameLength = std::strcspn(name, "[");
+    for (uint32_t bindingId = 0; bindingId < table.bindings.size(); bindingId++)
+    {
+        const UniformBinding& binding = table.bindings[bindingId];
+        const char* bindingName = table.names.c_str() + binding.nameOffset;
+        if (binding.type == type && std::strncmp(bindingName, name, nameLength) == 0 && bindingName[nameLength] == '\0')
+        {
+            return bindingId;
+        }
+    }
+    return kNoUniform;
+}
+
+size_t applyUniforms(UniformTable& table)
+{
+    size_t bytes = 0;
+    for (uint32_t bindingId : table.dirtyBindings)
+    {
+        UniformBinding& binding = table.bindings[bindingId];
+        GLsizei count = static_cast<GLsizei>(binding.dirtyEnd);
+        const float* floats = isIntType(binding.type) ? nullptr : &table.floatValues[binding.valueOffset];
+        switch (binding.type)
+        {
+        case MaterialUniformType::Float:
+            glUniform1fv(binding.location, count, floats);
+            break;
+        case MaterialUniformType::Vector2:
+            glUniform2fv(binding.location, count, floats);
+            break;
+        case MaterialUniformType::Vector3:
+            glUniform3fv(binding.location, count, floats);
+            break;
+        case MaterialUniformType::Vector4:
+            glUniform4fv(binding.location, count, floats);
+            break;
+        case MaterialUniformType::Matrix4:
+            glUniformMatrix4fv(binding.location, count, GL_FALSE, floats);
+            break;
+        case MaterialUniformType::Int:
+        case MaterialUniformType::Sampler2D:
+            glUniform1iv(binding.location, count, &table.intValues[binding.valueOffset]);
+            break;
+        }
+        bytes += static_cast<size_t>(binding.dirtyEnd) * binding.components * 4;
+        binding.dirtyEnd = 0;
+    }
+    table.dirtyBindings.clear();
+    return bytes;
+}
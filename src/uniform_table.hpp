@@ -0,0 +1,163 @@
+#ifndef UNIFORM_TABLE_HPP
+#define UNIFORM_TABLE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "basic_types.hpp"
+#include "material_description.hpp"
+
+// Binding of no uniform: the name is not an active uniform of the program, or has another type
+const uint32_t kNoUniform = UINT32_MAX;
+
+// Active uniform of a program, found by reflection when the table is built
+struct UniformBinding
+{
+    int32_t location;           // Location of the first element
+    MaterialUniformType type;   // Value type, samplers hold their texture unit
+    uint32_t components;        // Components of one element
+    uint32_t arraySize;         // Elements (1 for a plain uniform)
+    uint32_t valueOffset;       // First component in floatValues (float types) or intValues (Int and Sampler2D)
+    uint32_t nameOffset;        // Offset of the null-terminated name in UniformTable::names
+    uint32_t dirtyEnd;          // One past the last element changed since the last upload, 0 when the program is up to date
+};
+
+// Uniforms of a linked program with a shadow copy of their values. A write that changes a value marks its uniform
+// dirty and applyUniforms sends only the dirty ones, so unchanged values cost no GL call. The copy starts at zero,
+// the value of every uniform of a newly linked program.
+// Uniforms of blocks and of types without a MaterialUniformType (integer vectors, other matrices) are left out
+struct UniformTable
+{
+    std::vector<UniformBinding> bindings;
+    std::vector<float> floatValues;     // Components of the float and vector uniforms
+    std::vector<int32_t> intValues;     // Values of the Int and Sampler2D uniforms
+    std::string names;                  // Names of the uniforms, each followed by a null character
+    std::vector<uint32_t> dirtyBindings;    // Bindings with changed values, in the order they changed
+};
+
+// Handle to a uniform of a UniformTable, typed by the value it accepts; resolved once by findUniform
+template <typename T>
+struct UniformHandle
+{
+    uint32_t binding = kNoUniform;
+};
+
+// Handle type of the mat4 uniforms, whose values are passed as 16 floats (column-major)
+struct UniformMatrix4;
+
+// Value type matching each handle type
+template <typename T> struct UniformTypeOf;
+template <> struct UniformTypeOf<float> { static const MaterialUniformType value = MaterialUniformType::Float; };
+template <> struct UniformTypeOf<int32_t> { static const MaterialUniformType value = MaterialUniformType::Int; };
+template <> struct UniformTypeOf<Vector2> { static const MaterialUniformType value = MaterialUniformType::Vector2; };
+template <> struct UniformTypeOf<Vector3> { static const MaterialUniformType value = MaterialUniformType::Vector3; };
+template <> struct UniformTypeOf<Vector4> { static const MaterialUniformType value = MaterialUniformType::Vector4; };
+template <> struct UniformTypeOf<UniformMatrix4> { static const MaterialUniformType value = MaterialUniformType::Matrix4; };
+
+// Function to build the table of a linked program from glGetActiveUniform, with every value at zero
+void buildUniformTable(UniformTable& table, uint32_t program);
+
+// Function to find the binding of a uniform by name ("name" or "name[0]" for arrays) and type, kNoUniform if
+// the program has no such uniform
+uint32_t findUniformBinding(const UniformTable& table, const char* name, MaterialUniformType type);
+
+// Function to tell whether a handle was resolved to a uniform of the program
+template <typename T>
+inline bool hasUniform(UniformHandle<T> handle)
+{
+    return handle.binding != kNoUniform;
+}
+
+// Function to resolve a uniform name to a typed handle, an unresolved handle ignores the values written through it
+template <typename T>
+UniformHandle<T> findUniform(const UniformTable& table, const char* name)
+{
+    UniformHandle<T> handle;
+    handle.binding = findUniformBinding(table, name, UniformTypeOf<T>::value);
+    return handle;
+}
+
+// Function to write the components of one element of a uniform into the shadow copy (values of the binding's
+// storage type), the uniform becomes dirty when they differ from the copy
+template <typename V>
+inline void writeUniformElement(UniformTable& table, std::vector<V>& storage, uint32_t bindingId, uint32_t element, const V* values)
+{
+    UniformBinding& binding = table.bindings[bindingId];
+    if (element >= binding.arraySize)
+    {
+        return;
+    }
+    V* stored = &storage[binding.valueOffset + static_cast<size_t>(element) * binding.components];
+    if (std::memcmp(stored, values, binding.components * sizeof(V)) == 0)
+    {
+        return;
+    }
+    std::memcpy(stored, values, binding.components * sizeof(V));
+    if (binding.dirtyEnd == 0)
+    {
+        table.dirtyBindings.push_back(bindingId);
+    }
+    binding.dirtyEnd = std::max(binding.dirtyEnd, element + 1);
+}
+
+// Functions to write the value of a uniform, or of one element of an array uniform, through its handle
+inline void setUniform(UniformTable& table, UniformHandle<float> handle, float value, uint32_t element = 0)
+{
+    if (handle.binding != kNoUniform)
+    {
+        writeUniformElement(table, table.floatValues, handle.binding, element, &value);
+    }
+}
+
+inline void setUniform(UniformTable& table, UniformHandle<int32_t> handle, int32_t value, uint32_t element = 0)
+{
+    if (handle.binding != kNoUniform)
+    {
+        writeUniformElement(table, table.intValues, handle.binding, element, &value);
+    }
+}
+
+inline void setUniform(UniformTable& table, UniformHandle<Vector2> handle, const Vector2& value, uint32_t element = 0)
+{
+    if (handle.binding != kNoUniform)
+    {
+        float values[2] = { value.x, value.y };
+        writeUniformElement(table, table.floatValues, handle.binding, element, values);
+    }
+}
+
+inline void setUniform(UniformTable& table, UniformHandle<Vector3> handle, const Vector3& value, uint32_t element = 0)
+{
+    if (handle.binding != kNoUniform)
+    {
+        float values[3] = { value.x, value.y, value.z };
+        writeUniformElement(table, table.floatValues, handle.binding, element, values);
+    }
+}
+
+inline void setUniform(UniformTable& table, UniformHandle<Vector4> handle, const Vector4& value, uint32_t element = 0)
+{
+    if (handle.binding != kNoUniform)
+    {
+        float values[4] = { value.x, value.y, value.z, value.w };
+        writeUniformElement(table, table.floatValues, handle.binding, element, values);
+    }
+}
+
+inline void setUniform(UniformTable& table, UniformHandle<UniformMatrix4> handle, const float matrix[16], uint32_t element = 0)
+{
+    if (handle.binding != kNoUniform)
+    {
+        writeUniformElement(table, table.floatValues, handle.binding, element, matrix);
+    }
+}
+
+// Function to send the dirty uniforms of the table to its program, which must be in use. The elements of an array
+// up to its last changed one go in a single glUniform*v call (ES 3.0 only locates the other elements by name).
+// Returns the number of bytes sent
+size_t applyUniforms(UniformTable& table);
+
+#endif // UNIFORM_TABLE_HPP
@@ -0,0 +1,167 @@
+#include "vertex_layout.hpp"
+
+#include <GLES3/gl3.h>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    const uint64_t kCacheLineSize = 64;
+    const size_t kCacheLineCount = 256;
+
+    uint32_t alignUp(uint32_t value, uint32_t alignment)
+    {
+        return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+    }
+
+    uint32_t getComponentSize(uint32_t componentType)
+    {
+        switch (componentType)
+        {
+        case GL_BYTE:
+        case GL_UNSIGNED_BYTE:
+            return 1;
+        case GL_SHORT:
+        case GL_UNSIGNED_SHORT:
+        case GL_HALF_FLOAT:
+            return 2;
+        default:
+            return 4;
+        }
+    }
+
+    // Rank of an attribute location in the configured order, unlisted locations go last
+    size_t getOrderRank(const std::vector<uint32_t>& order, uint32_t location)
+    {
+        auto position = std::find(order.begin(), order.end(), location);
+        return position == order.end() ? order.size() + location : static_cast<size_t>(position - order.begin());
+    }
+}
+
+uint32_t getVertexAttributeSize(const VertexAttribute& attribute)
+{
+    return attribute.componentCount * getComponentSize(attribute.componentType);
+}
+
+void VertexLayoutBuilder::addAttribute(uint32_t location, uint32_t componentCount, uint32_t componentType, bool normalized,
+                                       const void* data, size_t sourceStride)
+{
+    SourceAttribute attribute;
+    attribute.format.location = location;
+    attribute.format.stream = 0;
+    attribute.format.componentCount = componentCount;
+    attribute.format.componentType = componentType;
+    attribute.format.normalized = normalized ? 1 : 0;
+    attribute.format.offset = 0;
+    attribute.format.integer = 0;
+    attribute.data = static_cast<const unsigned char*>(data);
+    attribute.sourceStride = sourceStride;
+    attributes_.push_back(attribute);
+}
+
+void VertexLayoutBuilder::addIntegerAttribute(uint32_t location, uint32_t componentCount, uint32_t componentType,
+                                              const void* data, size_t sourceStride)
+{
+    addAttribute(location, componentCount, componentType, false, data, sourceStride);
+    attributes_.back().format.integer = 1;
+}
+
+void VertexLayoutBuilder::build(size_t vertexCount, MeshData& meshData) const
+{
+    // Sort the attributes by the configured order
+    std::vector<SourceAttribute> sorted = attributes_;
+    std::stable_sort(sorted.begin(), sorted.end(), [&](const SourceAttribute& a, const SourceAttribute& b) {
+        return getOrderRank(options_.order, a.format.location) < getOrderRank(options_.order, b.format.location);
+    });
+
+    // Assign streams and offsets: the optional position stream first, then one interleaved stream
+    uint32_t firstStream = static_cast<uint32_t>(meshData.streams.size());
+    bool hasSeparatePosition = false;
+    std::vector<uint32_t> strides;
+    for (SourceAttribute& attribute : sorted)
+    {
+        if (options_.separatePositionStream && attribute.format.location == options_.positionLocation)
+        {
+            hasSeparatePosition = true;
+        }
+    }
+    strides.assign(hasSeparatePosition ? 2 : 1, 0);
+    for (SourceAttribute& attribute : sorted)
+    {
+        uint32_t localStream = (hasSeparatePosition && attribute.format.location != options_.positionLocation) ? 1 : 0;
+        attribute.format.stream = firstStream + localStream;
+        attribute.format.offset = alignUp(strides[localStream], options_.attributeAlignment);
+        strides[localStream] = attribute.format.offset + getVertexAttributeSize(attribute.format);
+    }
+    for (uint32_t& stride : strides)
+    {
+        stride = alignUp(stride, options_.strideAlignment);
+    }
+
+    // Interleave the source arrays; padding bytes stay zero
+    std::vector<VertexStream> streams(strides.size());
+    for (size_t streamIdx = 0; streamIdx < streams.size(); streamIdx++)
+    {
+        streams[streamIdx].stride = strides[streamIdx];
+        streams[streamIdx].data.storage.assign(vertexCount * strides[streamIdx], 0);
+    }
+    for (const SourceAttribute& attribute : sorted)
+    {
+        VertexStream& stream = streams[attribute.format.stream - firstStream];
+        uint32_t elementSize = getVertexAttributeSize(attribute.format);
+        unsigned char* output = stream.data.storage.data() + attribute.format.offset;
+        const unsigned char* input = attribute.data;
+        for (size_t vertex = 0; vertex < vertexCount; vertex++)
+        {
+            std::memcpy(output, input, elementSize);
+            output += stream.stride;
+            input += attribute.sourceStride;
+        }
+    }
+
+    for (VertexStream& stream : streams)
+    {
+        stream.data.bytes.data = stream.data.storage.data();
+        stream.data.bytes.size = stream.data.storage.size();
+        meshData.streams.push_back(std::move(stream));
+    }
+    for (const SourceAttribute& attribute : sorted)
+    {
+        meshData.attributes.push_back(attribute.format);
+    }
+}
+
+uint64_t estimateVertexFetchBytes(const std::vector<VertexAttribute>& attributes, const std::vector<uint32_t>& streamStrides,
+                                  size_t vertexCount, const std::vector<uint32_t>& indices)
+{
+    // Streams are laid out one after another in a virtual address space, each starting on a fresh line
+    std::vector<uint64_t> streamBases(streamStrides.size(), 0);
+    uint64_t nextBase = 0;
+    for (size_t streamIdx = 0; streamIdx < streamStrides.size(); streamIdx++)
+    {
+        streamBases[streamIdx] = nextBase;
+        nextBase += (static_cast<uint64_t>(streamStrides[streamIdx]) * vertexCount + kCacheLineSize) / kCacheLineSize * kCacheLineSize;
+    }
+
+    // Direct-mapped cache, tags hold line address + 1 (0 = empty)
+    std::vector<uint64_t> tags(kCacheLineCount, 0);
+    uint64_t fetchedBytes = 0;
+    for (uint32_t index : indices)
+    {
+        for (const VertexAttribute& attribute : attributes)
+        {
+            uint64_t begin = streamBases[attribute.stream] + static_cast<uint64_t>(index) * streamStrides[attribute.stream] + attribute.offset;
+            uint64_t end = begin + getVertexAttributeSize(attribute);
+            for (uint64_t line = begin / kCacheLineSize; line <= (end - 1) / kCacheLineSize; line++)
+            {
+                uint64_t& tag = tags[line % kCacheLineCount];
+                if (tag != line + 1)
+                {
+                    tag = line + 1;
+                    fetchedBytes += kCacheLineSize;
+                }
+            }
+        }
+    }
+    return fetchedBytes;
+}
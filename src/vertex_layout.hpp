@@ -0,0 +1,58 @@
+#ifndef VERTEX_LAYOUT_HPP
+#define VERTEX_LAYOUT_HPP
+
+#include <cstdint>
+#include <vector>
+#include "mesh_data.hpp"
+
+// Options controlling how vertex attributes are interleaved
+struct VertexLayoutOptions
+{
+    std::vector<uint32_t> order = { 0, 1, 2 };  // Attribute locations in interleaving order, unlisted ones follow
+    uint32_t attributeAlignment = 4;            // Alignment of every attribute inside a vertex
+    uint32_t strideAlignment = 4;               // Alignment of the vertex stride
+    bool separatePositionStream = false;        // Keep positions in their own stream (depth / shadow passes)
+    uint32_t positionLocation = 0;              // Location of the position attribute
+};
+
+// Builder interleaving per-attribute arrays into as few vertex streams as possible.
+// Attribute data is copied as raw components, so any GL component type is supported.
+class VertexLayoutBuilder
+{
+public:
+    explicit VertexLayoutBuilder(const VertexLayoutOptions& options) : options_(options) {}
+
+    // Add an attribute; data holds one element per vertex, sourceStride bytes apart
+    void addAttribute(uint32_t location, uint32_t componentCount, uint32_t componentType, bool normalized,
+                      const void* data, size_t sourceStride);
+
+    // Add an integer attribute, read as ivec / uvec by the shaders (joint indices, ...)
+    void addIntegerAttribute(uint32_t location, uint32_t componentCount, uint32_t componentType,
+                             const void* data, size_t sourceStride);
+
+    // Interleave the attributes of vertexCount vertices into new streams of meshData
+    void build(size_t vertexCount, MeshData& meshData) const;
+
+private:
+    struct SourceAttribute
+    {
+        VertexAttribute format;             // Location, component count and type (stream / offset are computed)
+        const unsigned char* data;          // First element of the source array
+        size_t sourceStride;                // Distance between two source elements
+    };
+
+    VertexLayoutOptions options_;
+    std::vector<SourceAttribute> attributes_;
+};
+
+// Function to get the size in bytes of one element of a vertex attribute
+uint32_t getVertexAttributeSize(const VertexAttribute& attribute);
+
+// Function to estimate the memory traffic of fetching the vertices referenced by an index list.
+// Vertices are fetched in index order through a 16 KB direct-mapped cache of 64-byte lines,
+// which is how tile-based GPUs typically feed their vertex fetchers; the result is the number
+// of bytes transferred from memory.
+uint64_t estimateVertexFetchBytes(const std::vector<VertexAttribute>& attributes, const std::vector<uint32_t>& streamStrides,
+                                  size_t vertexCount, const std::vector<uint32_t>& indices);
+
+#endif // VERTEX_LAYOUT_HPP
@@ -0,0 +1,210 @@
+#include "vertex_quantization.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    // Function to quantize a value of [-1, 1] (or [0, 1]) to a normalized integer of the given maximum
+    int32_t quantizeNormalized(float value, int32_t maximum)
+    {
+        float clamped = std::max(-1.0f, std::min(1.0f, value));
+        return static_cast<int32_t>(std::lround(clamped * static_cast<float>(maximum)));
+    }
+}
+
+uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t magnitude = bits & 0x7FFFFFFF;
+
+    // NaN stays NaN, overflow and infinity become infinity
+    if (magnitude > 0x7F800000)
+    {
+        return static_cast<uint16_t>(sign | 0x7E00);
+    }
+    if (magnitude >= 0x477FF000)
+    {
+        return static_cast<uint16_t>(sign | 0x7C00);
+    }
+
+    // Values below the smallest normal half are rounded as denormals
+    if (magnitude < 0x38800000)
+    {
+        float absolute;
+        std::memcpy(&absolute, &magnitude, sizeof(absolute));
+        return static_cast<uint16_t>(sign | static_cast<uint32_t>(std::nearbyint(absolute * 16777216.0f)));
+    }
+
+    // Rebias the exponent and round the mantissa to nearest even
+    uint32_t rounded = magnitude + 0x0FFF + ((magnitude >> 13) & 1);
+    return static_cast<uint16_t>(sign | ((rounded - 0x38000000) >> 13));
+}
+
+void quantizePositions(const float* positions, size_t count, int16_t* destination, float dequantization[16])
+{
+    float minimum[3] = { 0.0f, 0.0f, 0.0f };
+    float maximum[3] = { 0.0f, 0.0f, 0.0f };
+    for (size_t vertex = 0; vertex < count; vertex++)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float value = positions[vertex * 3 + axis];
+            minimum[axis] = vertex ? std::min(minimum[axis], value) : value;
+            maximum[axis] = vertex ? std::max(maximum[axis], value) : value;
+        }
+    }
+
+    // Every axis is mapped to [-1, 1] around the center of the bounding box
+    float center[3], extent[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        center[axis] = (minimum[axis] + maximum[axis]) * 0.5f;
+        extent[axis] = (maximum[axis] - minimum[axis]) * 0.5f;
+        if (!(extent[axis] > 0.0f))
+        {
+            extent[axis] = 1.0f;
+        }
+    }
+
+    for (size_t vertex = 0; vertex < count; vertex++)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float normalized = (positions[vertex * 3 + axis] - center[axis]) / extent[axis];
+            destination[vertex * 4 + axis] = static_cast<int16_t>(quantizeNormalized(normalized, 32767));
+        }
+        destination[vertex * 4 + 3] = 0;
+    }
+
+    std::fill(dequantization, dequantization + 16, 0.0f);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        dequantization[axis * 4 + axis] = extent[axis];
+        dequantization[12 + axis] = center[axis];
+    }
+    dequantization[15] = 1.0f;
+}
+
+void encodeOctahedralNormals(const float* normals, size_t count, uint32_t bits, void* destination)
+{
+    int32_t maximum = bits == 8 ? 127 : 32767;
+    for (size_t vertex = 0; vertex < count; vertex++)
+    {
+        const float* normal = normals + vertex * 3;
+        float length = std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+        float x = length > 0.0f ? normal[0] / length : 0.0f;
+        float y = length > 0.0f ? normal[1] / length : 0.0f;
+
+        // Fold the lower hemisphere over the diagonals of the octahedron
+        if (normal[2] < 0.0f)
+        {
+            float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+            float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+            x = foldedX;
+            y = foldedY;
+        }
+
+        if (bits == 8)
+        {
+            int8_t* output = static_cast<int8_t*>(destination) + vertex * 2;
+            output[0] = static_cast<int8_t>(quantizeNormalized(x, maximum));
+            output[1] = static_cast<int8_t>(quantizeNormalized(y, maximum));
+        }
+        else
+        {
+            int16_t* output = static_cast<int16_t*>(destination) + vertex * 2;
+            output[0] = static_cast<int16_t>(quantizeNormalized(x, maximum));
+            output[1] = static_cast<int16_t>(quantizeNormalized(y, maximum));
+        }
+    }
+}
+
+void quantizeTexCoords(const float* texCoords, size_t count, TexCoordFormat format, void* destination, float transform[4])
+{
+    transform[0] = 1.0f;
+    transform[1] = 1.0f;
+    transform[2] = 0.0f;
+    transform[3] = 0.0f;
+    if (format == TexCoordFormat::Float)
+    {
+        std::memcpy(destination, texCoords, count * 2 * sizeof(float));
+        return;
+    }
+    if (format == TexCoordFormat::Half)
+    {
+        uint16_t* output = static_cast<uint16_t*>(destination);
+        for (size_t i = 0; i < count * 2; i++)
+        {
+            output[i] = floatToHalf(texCoords[i]);
+        }
+        return;
+    }
+
+    // Unorm16 over the bounds of the coordinates, so that tiling coordinates outside [0, 1] survive
+    float minimum[2] = { 0.0f, 0.0f };
+    float maximum[2] = { 1.0f, 1.0f };
+    for (size_t vertex = 0; vertex < count; vertex++)
+    {
+        for (int axis = 0; axis < 2; axis++)
+        {
+            minimum[axis] = std::min(minimum[axis], texCoords[vertex * 2 + axis]);
+            maximum[axis] = std::max(maximum[axis], texCoords[vertex * 2 + axis]);
+        }
+    }
+    uint16_t* output = static_cast<uint16_t*>(destination);
+    for (size_t vertex = 0; vertex < count; vertex++)
+    {
+        for (int axis = 0; axis < 2; axis++)
+        {
+            float normalized = (texCoords[vertex * 2 + axis] - minimum[axis]) / (maximum[axis] - minimum[axis]);
+            output[vertex * 2 + axis] = static_cast<uint16_t>(quantizeNormalized(normalized, 65535));
+        }
+    }
+    for (int axis = 0; axis < 2; axis++)
+    {
+        transform[axis] = maximum[axis] - minimum[axis];
+        transform[2 + axis] = minimum[axis];
+    }
+}
+
+void quantizeJointWeights(const float* weights, size_t count, uint32_t bits, void* destination)
+{
+    int32_t maximum = bits == 8 ? 255 : 65535;
+    for (size_t vertex = 0; vertex < count; vertex++)
+    {
+        const float* input = weights + vertex * 4;
+        float sum = std::max(0.0f, input[0]) + std::max(0.0f, input[1]) + std::max(0.0f, input[2]) + std::max(0.0f, input[3]);
+        float inverseSum = sum > 0.0f ? 1.0f / sum : 0.0f;
+
+        // Round every weight, then give the rounding error to the largest one
+        int32_t quantized[4];
+        int32_t total = 0;
+        int largest = 0;
+        for (int influence = 0; influence < 4; influence++)
+        {
+            quantized[influence] = quantizeNormalized(std::max(0.0f, input[influence]) * inverseSum, maximum);
+            total += quantized[influence];
+            largest = quantized[influence] > quantized[largest] ? influence : largest;
+        }
+        if (total > 0)
+        {
+            quantized[largest] += maximum - total;
+        }
+
+        for (int influence = 0; influence < 4; influence++)
+        {
+            if (bits == 8)
+            {
+                static_cast<uint8_t*>(destination)[vertex * 4 + influence] = static_cast<uint8_t>(quantized[influence]);
+            }
+            else
+            {
+                static_cast<uint16_t*>(destination)[vertex * 4 + influence] = static_cast<uint16_t>(quantized[influence]);
+            }
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef VERTEX_QUANTIZATION_HPP
+#define VERTEX_QUANTIZATION_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Storage format of texture coordinates
+enum class TexCoordFormat : uint32_t
+{
+    Float,      // 2 x float
+    Half,       // 2 x half float, exact for the usual [0, 1] range up to 1/2048
+    Unorm16,    // 2 x normalized unsigned short over the bounds of the coordinates, with a scale / offset
+};
+
+// Load-time quantization of the vertex attributes (all disabled = float attributes)
+struct VertexQuantizationOptions
+{
+    bool positions = false;                             // Normalized int16 positions with a dequantization matrix
+    uint32_t normalBits = 0;                            // 8 or 16 for octahedral snorm normals, 0 for float normals
+    TexCoordFormat texCoords = TexCoordFormat::Float;   // Texture coordinate format
+    uint32_t weightBits = 0;                            // 8 or 16 for unorm skin weights, 0 for float weights
+};
+
+// Function to convert a float to an IEEE half float (round to nearest even)
+uint16_t floatToHalf(float value);
+
+// Function to quantize positions to normalized int16 (4 components, w = 0) over their bounding box.
+// dequantization receives the column-major matrix mapping the normalized values back to the positions
+void quantizePositions(const float* positions, size_t count, int16_t* destination, float dequantization[16]);
+
+// Function to encode unit normals with the octahedral mapping into 2 snorm components of 8 or 16 bits
+void encodeOctahedralNormals(const float* normals, size_t count, uint32_t bits, void* destination);
+
+// Function to quantize texture coordinates to half floats or normalized unsigned shorts.
+// transform receives the scale (xy) and offset (zw) restoring the original coordinates
+void quantizeTexCoords(const float* texCoords, size_t count, TexCoordFormat format, void* destination, float transform[4]);
+
+// Function to quantize skin weights (4 per vertex) to unorm8 or unorm16.
+// The weights of each vertex are renormalized so that the quantized values sum exactly to one
+void quantizeJointWeights(const float* weights, size_t count, uint32_t bits, void* destination);
+
+#endif // VERTEX_QUANTIZATION_HPP